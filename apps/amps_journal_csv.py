@@ -0,0 +1,76 @@
+#!/usr/bin/env python
+#
+# Written by Brandon Creighton <cstone@pobox.com>.
+#
+# This code is in the public domain; however, note that most of its
+# dependent code, including GNU Radio, is not.
+#
+# Dump AMPS RECC Decode event journal segments (*.amj) as CSV.  The record
+# layout here must match journal_record in lib/event_journal.h.
+
+import csv
+import struct
+import sys
+
+HEADER = struct.Struct('<8sIIQQQQ16s')
+RECORD = struct.Struct('<QQIHBB10sBB7sB7H32s6s')
+MAGIC = b'AMPSJRN1'
+
+TYPES = {
+    1: 'registration',
+    2: 'origination',
+    3: 'page_response',
+    4: 'bad_burst',
+    5: 'unknown',
+}
+
+HAS_ESN = 0x1
+BLOCKED = 0x2
+
+def text(b):
+    return b.split(b'\0', 1)[0].decode('ascii', 'replace')
+
+def dump(path, out):
+    with open(path, 'rb') as f:
+        hdr = f.read(HEADER.size)
+        if len(hdr) < HEADER.size:
+            raise ValueError('%s: short header' % path)
+        magic, record_size, _, capacity, count, created_ns, sequence, _ = HEADER.unpack(hdr)
+        if magic != MAGIC:
+            raise ValueError('%s: not a journal segment' % path)
+        if record_size != RECORD.size:
+            raise ValueError('%s: record size %d, expected %d' % (path, record_size, RECORD.size))
+        for i in range(min(count, capacity)):
+            buf = f.read(RECORD.size)
+            if len(buf) < RECORD.size:
+                break
+            r = RECORD.unpack(buf)
+            stamp_ns, pmin, esn, chan, rtype, scm, min_digits, ndigits, flags, bch_fails, nwords = r[:11]
+            manchester = r[11:18]
+            digits = r[18]
+            out.writerow([
+                sequence, stamp_ns,
+                TYPES.get(rtype, str(rtype)),
+                text(min_digits),
+                '%08x' % esn if flags & HAS_ESN else '',
+                scm, chan if chan else '',
+                1 if flags & BLOCKED else 0,
+                digits[:ndigits].decode('ascii', 'replace'),
+                nwords,
+                ' '.join(str(bytearray(bch_fails)[w]) for w in range(7)),
+                ' '.join(str(m) for m in manchester),
+            ])
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write('usage: %s segment.amj [...]\n' % sys.argv[0])
+        return 1
+    out = csv.writer(sys.stdout)
+    out.writerow(['segment', 'stamp_ns', 'type', 'min', 'esn', 'scm', 'chan', 'blocked',
+        'digits', 'nwords', 'bch_fails', 'manchester_errs'])
+    for path in sys.argv[1:]:
+        dump(path, out)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
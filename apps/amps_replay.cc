@@ -0,0 +1,293 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+/*
+ * Offline replay of a recorded RECC through the receive path, as fast as it
+ * will go.  No scheduler is involved: the file is mapped, handed to the RECC
+ * block's burst search a chunk at a time, and every burst it finds is
+ * decoded straight away by a RECC Decode block.  Each stage is timed with
+ * the thread CPU clock.
+ *
+ * The input is either a symbol file (one byte per Manchester symbol, 0 or 1,
+ * as written by the file sink in recctest.grc), or, with -s, complex float
+ * IQ at the given sample rate.  IQ is taken through roughly the same chain
+ * as recctest.grc: frequency translation and low-pass decimation, a
+ * quadrature demodulator, symbol timing recovery and a slicer.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <complex>
+#include <vector>
+#include <string>
+#include "recc_impl.h"
+#include "recc_decode_impl.h"
+#include "amps_log.h"
+
+using namespace gr::amps;
+
+static const double RECC_SYMRATE = 20000.0;     // 10 kbit/s, Manchester-encoded
+static const size_t DEFAULT_CHUNK = 8192;       // symbols per call into the burst search
+
+static double cpu_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static double wall_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/*
+ * The RECC block, with bursts kept for the harness instead of being posted
+ * to a message port.
+ */
+class replay_recc : public recc_impl {
+    public:
+    std::vector<pmt::pmt_t> d_bursts;
+
+    protected:
+    void publish_burst(pmt::pmt_t burst) {
+        d_bursts.push_back(burst);
+    }
+};
+
+/*
+ * IQ to symbols: mix down by the channel offset, low-pass and decimate,
+ * FM-discriminate, then sample once per symbol with a timing loop that
+ * steers the sample point away from zero crossings, and slice.
+ */
+class iq_demod {
+    private:
+    std::vector<float> d_taps;
+    std::vector<std::complex<float> > d_hist;   // last ntaps-1 mixed samples
+    std::complex<double> d_phasor;
+    std::complex<double> d_step;
+    size_t d_decim;
+    size_t d_phase;                             // input samples until the next filter output
+    std::complex<float> d_prev;                 // last filter output, for the discriminator
+    float d_last;                               // last discriminator output
+    double d_sps;                               // filtered samples per symbol
+    double d_next;                              // samples until the next symbol decision
+    unsigned long d_count;
+
+    public:
+    iq_demod(double samp_rate, double offset, size_t decim)
+        : d_phasor(1.0, 0.0), d_decim(decim), d_phase(0), d_prev(0.0f, 0.0f), d_last(0.0f), d_count(0) {
+        const double rate = samp_rate / decim;
+        d_sps = rate / RECC_SYMRATE;
+        d_next = d_sps / 2.0;
+        d_step = std::polar(1.0, -2.0 * M_PI * offset / samp_rate);
+
+        // Blackman-windowed sinc, 10 kHz cutoff, about 4.5 kHz transition
+        // (the same filter as recctest.grc).
+        const double cutoff = 10000.0 / samp_rate;
+        size_t ntaps = (size_t)(5.5 * samp_rate / 4500.0) | 1;
+        d_taps.resize(ntaps);
+        const double mid = (ntaps - 1) / 2.0;
+        double sum = 0.0;
+        for(size_t i = 0; i < ntaps; i++) {
+            const double x = i - mid;
+            const double sinc = (x == 0.0) ? (2.0 * cutoff) : (sin(2.0 * M_PI * cutoff * x) / (M_PI * x));
+            const double win = 0.42 - 0.5 * cos(2.0 * M_PI * i / (ntaps - 1)) + 0.08 * cos(4.0 * M_PI * i / (ntaps - 1));
+            d_taps[i] = sinc * win;
+            sum += d_taps[i];
+        }
+        for(size_t i = 0; i < ntaps; i++) {
+            d_taps[i] /= sum;
+        }
+        d_hist.assign(ntaps - 1, std::complex<float>(0.0f, 0.0f));
+    }
+
+    /*
+     * Demodulate nsamps samples, appending symbols to out.
+     */
+    void work(const std::complex<float> *in, size_t nsamps, std::vector<unsigned char> &out) {
+        const size_t ntaps = d_taps.size();
+        std::vector<std::complex<float> > buf(d_hist);
+        buf.reserve(d_hist.size() + nsamps);
+        for(size_t i = 0; i < nsamps; i++) {
+            buf.push_back(in[i] * std::complex<float>(d_phasor));
+            d_phasor *= d_step;
+            if((++d_count & 0xfff) == 0) {
+                d_phasor /= std::abs(d_phasor);
+            }
+        }
+        size_t n;
+        for(n = d_phase; n + ntaps <= buf.size(); n += d_decim) {
+            std::complex<float> acc(0.0f, 0.0f);
+            const std::complex<float> *x = &buf[n];
+            for(size_t t = 0; t < ntaps; t++) {
+                acc += x[t] * d_taps[t];
+            }
+            const float f = std::arg(acc * std::conj(d_prev));
+            d_prev = acc;
+
+            // A zero crossing belongs halfway between two decisions; nudge
+            // the next decision toward that.
+            if((f > 0.0f) != (d_last > 0.0f)) {
+                const double err = d_next - (d_sps / 2.0);
+                d_next -= 0.1 * err;
+            }
+            d_last = f;
+            d_next -= 1.0;
+            if(d_next <= 0.0) {
+                out.push_back(f > 0.0f ? 1 : 0);
+                d_next += d_sps;
+            }
+        }
+        d_phase = n - (buf.size() - (ntaps - 1));
+        d_hist.assign(buf.end() - (ntaps - 1), buf.end());
+    }
+};
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-s samp_rate [-o offset_hz] [-d decim]] [-c chunk] [-n loops] [-r registry] [-j journal_prefix] [-v] file\n", argv0);
+    fprintf(stderr, "  without -s, file holds one byte per RECC symbol; with -s, complex float IQ\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    double samp_rate = 0.0;
+    double offset = 160000.0;
+    size_t decim = 2;
+    size_t chunk = DEFAULT_CHUNK;
+    int loops = 1;
+    std::string registry_path;
+    std::string journal_prefix;
+    int loglevel = LOG_LEVEL_WARNING;
+    int c;
+
+    while((c = getopt(argc, argv, "s:o:d:c:n:r:j:v")) != -1) {
+        switch(c) {
+            case 's': samp_rate = atof(optarg); break;
+            case 'o': offset = atof(optarg); break;
+            case 'd': decim = strtoul(optarg, NULL, 0); break;
+            case 'c': chunk = strtoul(optarg, NULL, 0); break;
+            case 'n': loops = atoi(optarg); break;
+            case 'r': registry_path = optarg; break;
+            case 'j': journal_prefix = optarg; break;
+            case 'v': loglevel = LOG_LEVEL_DEBUG; break;
+            default: usage(argv[0]);
+        }
+    }
+    if(optind != argc - 1 || decim < 1 || loops < 1 || chunk < 1 || chunk > 32768) {
+        usage(argv[0]);
+    }
+    set_log_level(loglevel);
+
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size == 0) {
+        fprintf(stderr, "%s: empty or unreadable\n", path);
+        return 1;
+    }
+    const size_t len = st.st_size;
+    const unsigned char *map = (const unsigned char *)mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED) {
+        fprintf(stderr, "%s: mmap: %s\n", path, strerror(errno));
+        return 1;
+    }
+    madvise((void *)map, len, MADV_SEQUENTIAL);
+
+    const bool iq = (samp_rate > 0.0);
+    const size_t item = iq ? sizeof(std::complex<float>) : 1;
+    const size_t nitems = len / item;
+    const double seconds = iq ? (nitems / samp_rate) : (nitems / RECC_SYMRATE);
+
+    double demod_cpu = 0.0, recc_cpu = 0.0, decode_cpu = 0.0;
+    unsigned long long nsyms = 0;
+    unsigned long long nbursts = 0;
+    recc_decode_stats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    const double wall_start = wall_now();
+    for(int loop = 0; loop < loops; loop++) {
+        boost::shared_ptr<replay_recc> recc = gnuradio::get_initial_sptr(new replay_recc());
+        // No duplicate suppression: it goes by the wall clock, and replay
+        // runs faster than real time.
+        recc_decode::sptr decode_sptr = recc_decode::make(registry_path, 355, 2, std::vector<int>(), 0, journal_prefix, 0.0);
+        recc_decode_impl *decode = dynamic_cast<recc_decode_impl *>(decode_sptr.get());
+        iq_demod *demod = iq ? new iq_demod(samp_rate, offset, decim) : NULL;
+        std::vector<unsigned char> syms;
+
+        // In IQ mode, take enough samples per pass to make about one chunk
+        // of symbols.
+        const size_t step = iq ? MAX((size_t)1, (size_t)(chunk * (samp_rate / RECC_SYMRATE))) : chunk;
+        for(size_t off = 0; off < nitems; off += step) {
+            const size_t n = MIN(step, nitems - off);
+            const unsigned char *in = &map[off * item];
+            if(iq) {
+                syms.clear();
+                double t0 = cpu_now();
+                demod->work((const std::complex<float> *)in, n, syms);
+                demod_cpu += cpu_now() - t0;
+                in = syms.empty() ? NULL : &syms[0];
+            }
+            const size_t nin = iq ? syms.size() : n;
+            for(size_t s = 0; s < nin; s += chunk) {
+                double t0 = cpu_now();
+                recc->search(&in[s], MIN(chunk, nin - s));
+                double t1 = cpu_now();
+                recc_cpu += t1 - t0;
+                for(size_t b = 0; b < recc->d_bursts.size(); b++) {
+                    decode->bursts_message(recc->d_bursts[b]);
+                }
+                nbursts += recc->d_bursts.size();
+                recc->d_bursts.clear();
+                decode_cpu += cpu_now() - t1;
+            }
+            nsyms += nin;
+        }
+
+        const recc_decode_stats &ls = decode->stats();
+        stats.bursts += ls.bursts;
+        stats.bad_word_a += ls.bad_word_a;
+        stats.rejected += ls.rejected;
+        stats.registrations += ls.registrations;
+        stats.originations += ls.originations;
+        stats.page_responses += ls.page_responses;
+        stats.unknown += ls.unknown;
+        delete demod;
+    }
+    const double wall = wall_now() - wall_start;
+    log_flush();
+
+    const unsigned long long decoded = stats.bursts - stats.bad_word_a;
+    printf("%s: %zu %s, %.2f s of signal, %d pass%s\n", path, nitems, iq ? "samples" : "symbols",
+            seconds, loops, loops == 1 ? "" : "es");
+    printf("replayed in %.3f s (%.1fx real time); %llu symbols\n", wall, (seconds * loops) / wall, nsyms);
+    printf("bursts: %llu (%.1f/s)\n", nbursts, nbursts / wall);
+    printf("decoded: %llu of %llu (%.2f%%): %llu registrations, %llu originations, %llu page responses, %llu unknown, %llu rejected\n",
+            decoded, (unsigned long long)stats.bursts, stats.bursts ? (100.0 * decoded / stats.bursts) : 0.0,
+            (unsigned long long)stats.registrations, (unsigned long long)stats.originations,
+            (unsigned long long)stats.page_responses, (unsigned long long)stats.unknown,
+            (unsigned long long)stats.rejected);
+    printf("cpu: demod %.3f s, recc %.3f s (%.1f ns/symbol), decode %.3f s (%.1f us/burst)\n",
+            demod_cpu, recc_cpu, nsyms ? (recc_cpu * 1e9 / nsyms) : 0.0,
+            decode_cpu, nbursts ? (decode_cpu * 1e6 / nbursts) : 0.0);
+
+    munmap((void *)map, len);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_CALL_CONTROL_H
+#define INCLUDED_AMPS_CALL_CONTROL_H
+
+#include <amps/api.h>
+#include <gnuradio/block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief AMPS land station call control.
+     * \ingroup amps
+     *
+     * Keeps a state machine per mobile (553 3.6: paging, waiting for the
+     * mobile's SAT on its voice channel, alerting, conversation, release)
+     * and runs the timers between those states on its own thread.
+     *
+     * Inputs are dicts: "call_events" takes page, page_response,
+     * origination and release events (from the RECC Decode block and the
+     * command processor), "voice_events" takes SAT/ST events from the RVC
+     * Supervision block.  Outputs: "focc_words" (repages), "fvc_bank_words"
+     * (release orders), "channel_events" (busy/release, for the RECC
+     * Decode block's channel pool) and "call_state" (every transition).
+     */
+    class AMPS_API call_control : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<call_control> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::call_control.
+       *
+       * \param max_calls maximum number of concurrent transactions
+       * \param page_timeout seconds to wait for a page response
+       * \param page_retries number of times to repeat an unanswered page
+       * \param alert_timeout seconds to alert before giving up on an answer
+       */
+      static sptr make(int max_calls = 4096, double page_timeout = 5.0, int page_retries = 1, double alert_timeout = 65.0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_CALL_CONTROL_H */
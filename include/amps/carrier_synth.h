@@ -0,0 +1,55 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_CARRIER_SYNTH_H
+#define INCLUDED_AMPS_CARRIER_SYNTH_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_interpolator.h>
+#include <vector>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief Polyphase synthesis channelizer: many carriers, one stream.
+     * \ingroup amps
+     *
+     * Each input port is one carrier's complex baseband (the FOCC's or an
+     * FVC's modulator output), at twice the channel spacing.  The block
+     * puts every active port on its channel and sums them into a single
+     * stream at samp_rate = fft_size * spacing, with one inverse FFT and
+     * one short polyphase filter for all of them.  Bin k is centered at
+     * k * spacing (bins past fft_size / 2 are below the center frequency);
+     * with a 30 kHz spacing, AMPS channel n goes in bin
+     * (n - center channel) mod fft_size.
+     *
+     * Ports can be moved or switched off while the block runs, by sending
+     * a dict with "port" and "bin" (negative for off) to the channels
+     * port.  An idle port's samples are still consumed, but ignored.
+     */
+    class AMPS_API carrier_synth : virtual public gr::sync_interpolator
+    {
+     public:
+      typedef boost::shared_ptr<carrier_synth> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::carrier_synth.
+       *
+       * \param samp_rate output sample rate
+       * \param fft_size number of channels the output spans (even)
+       * \param bins each input port's bin (negative for off); one port per entry
+       * \param taps_per_phase prototype filter length, per output phase
+       * \param gain each carrier's amplitude in the output
+       */
+      static sptr make(double samp_rate, int fft_size, const std::vector<int> &bins,
+              int taps_per_phase = 12, float gain = 1.0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_CARRIER_SYNTH_H */
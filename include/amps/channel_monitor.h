@@ -0,0 +1,61 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_CHANNEL_MONITOR_H
+#define INCLUDED_AMPS_CHANNEL_MONITOR_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief Wideband voice channel occupancy monitor.
+     * \ingroup amps
+     *
+     * Takes complex samples covering a block of AMPS channels (30 kHz
+     * apart) and, every \p interval seconds, averages \p average FFTs of
+     * them into a power spectrum.  From that it works out each channel's
+     * power and whether it carries SAT, and posts a dict on "occupancy":
+     *
+     *     first_chan: channel number of the first entry
+     *     power_db:   f32vector, per channel power in dBFS
+     *     busy:       u8vector, 1 if the power is over the threshold
+     *     sat:        u8vector, 1 if a busy channel also shows SAT sidebands
+     *     time_ns:    when the spectrum was finished (CLOCK_MONOTONIC)
+     *
+     * Entry i is channel first_chan + i, which is also voice channel i of
+     * amps::recc_decode set up with the same first channel; connect
+     * occupancy to its occupancy port to keep it off busy channels.
+     */
+    class AMPS_API channel_monitor : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<channel_monitor> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::channel_monitor.
+       *
+       * \param samp_rate input sample rate
+       * \param center_chan channel number at the input's center frequency
+       * \param first_chan first channel to monitor
+       * \param nchans number of channels to monitor
+       * \param fft_size FFT length; a bin of 3 kHz or less is needed to see SAT
+       * \param average FFTs averaged per report
+       * \param interval seconds between reports
+       * \param threshold_db power (dBFS) over which a channel is busy
+       * \param sat_margin_db how far the SAT sidebands must stand out, in dB
+       */
+      static sptr make(double samp_rate, int center_chan, int first_chan, int nchans,
+              int fft_size = 1024, int average = 32, double interval = 1.0,
+              float threshold_db = -70.0, float sat_margin_db = 6.0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_CHANNEL_MONITOR_H */
@@ -3,6 +3,7 @@
 
 #include <amps/api.h>
 #include <gnuradio/block.h>
+#include <string>
 
 namespace gr {
   namespace amps {
@@ -12,7 +13,7 @@ namespace gr {
      public:
       typedef boost::shared_ptr<command_processor> sptr;
 
-      static sptr make();
+      static sptr make(const std::string &registry_path = "", int max_silence = 0);
     };
 
   } // namespace amps
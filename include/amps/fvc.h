@@ -14,9 +14,18 @@ namespace gr {
   namespace amps {
 
     /*!
-     * \brief <+description of block+>
+     * \brief AMPS forward voice channel (blank-and-burst) data generator.
      * \ingroup amps
      *
+     * Orders arrive on the fvc_words port and are repeated until
+     * \p repeats bursts or \p duration output samples have been sent
+     * (whichever comes first; 0 disables a limit).  A message may override
+     * both limits.  Orders may also be prefixed with a voice channel, as
+     * amps::fvc_bank takes them; those for any channel but \p chan are
+     * ignored.  An order confirmation from amps::rvc_data (or ST on \p chan
+     * from amps::rvc_supervision) on the order_ack port ends the order
+     * early.  When the order completes, the block posts true on fvc_mute,
+     * false on audio_mute, and a completion dict on fvc_status.
      */
     class AMPS_API fvc : virtual public gr::sync_block
     {
@@ -31,7 +40,7 @@ namespace gr {
        * class. amps::fvc::make is the public interface for
        * creating new instances.
        */
-      static sptr make(unsigned long symrate);
+      static sptr make(unsigned long symrate, unsigned long repeats = 0, unsigned long duration = 0, int chan = 0);
     };
 
   } // namespace amps
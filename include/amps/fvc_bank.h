@@ -0,0 +1,49 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_FVC_BANK_H
+#define INCLUDED_AMPS_FVC_BANK_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief N forward voice channel data generators in one block.
+     * \ingroup amps
+     *
+     * Behaves like N amps::fvc blocks, one per output port, but all
+     * channels are filled in a single work() call and share one cache of
+     * rendered order bursts.
+     *
+     * fvc_words messages are tuples of (chan, nwords, word blob...), with
+     * the same optional lifetime element as amps::fvc.  order_ack messages
+     * are amps::rvc_data dicts with an added "chan" key.  Mute changes are
+     * posted on the per-channel ports fvc_mute<chan> and audio_mute<chan>;
+     * completion events on fvc_status carry a "chan" key.
+     */
+    class AMPS_API fvc_bank : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<fvc_bank> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::fvc_bank.
+       *
+       * \param symrate output symbol rate (any rate from 20 kHz up)
+       * \param nchans number of voice channels (output ports)
+       * \param repeats default bursts per order (0 for no limit)
+       * \param duration default samples per order (0 for no limit)
+       */
+      static sptr make(unsigned long symrate, int nchans, unsigned long repeats = 0, unsigned long duration = 0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_FVC_BANK_H */
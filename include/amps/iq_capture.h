@@ -0,0 +1,61 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_IQ_CAPTURE_H
+#define INCLUDED_AMPS_IQ_CAPTURE_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_block.h>
+#include <string>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief Burst-triggered IQ capture.
+     * \ingroup amps
+     *
+     * Keeps the last \p ring_ms of its complex input in memory.  Each
+     * message on the trigger port names a RECC burst: either a burst from
+     * amps::recc ((metadata . blob)), or a dict like the ones
+     * amps::recc_decode posts on bad_bursts.  Its "offset" (in RECC symbols,
+     * 20000 a second) is mapped to an input sample, and \p pre_ms before to
+     * \p post_ms after it are written out, by a background thread, as a
+     * SigMF recording: <prefix>.<sequence>.sigmf-data (cf32_le) and
+     * <prefix>.<sequence>.sigmf-meta.  The input has to start at the same
+     * time as the RECC's, from the same source.
+     *
+     * A dict is posted on "captures" for each recording written: path,
+     * reason, trace_id, samples and truncated (some of the window had
+     * already left the ring).  A burst named by more than one trigger is
+     * recorded once, labelled with every reason, comma-separated; if a
+     * reason comes in after the recording was written, its .sigmf-meta is
+     * rewritten and the dict posted again.
+     */
+    class AMPS_API iq_capture : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<iq_capture> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::iq_capture.
+       *
+       * \param samp_rate input sample rate
+       * \param prefix path prefix for the recordings
+       * \param pre_ms milliseconds to keep before the burst's offset
+       * \param post_ms milliseconds to keep after it (a full RECC message is about 170)
+       * \param ring_ms milliseconds of input kept in memory
+       * \param delay input samples between the IQ and the RECC's symbols
+       * \param max_pending recordings waiting to be written before triggers are dropped
+       */
+      static sptr make(double samp_rate, const std::string &prefix, double pre_ms = 20.0,
+              double post_ms = 180.0, double ring_ms = 2000.0, int delay = 0, int max_pending = 8);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_IQ_CAPTURE_H */
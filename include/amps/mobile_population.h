@@ -0,0 +1,61 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_MOBILE_POPULATION_H
+#define INCLUDED_AMPS_MOBILE_POPULATION_H
+
+#include <amps/api.h>
+#include <gnuradio/block.h>
+#include <string>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief Simulated population of mobiles, for loading the control channel.
+     * \ingroup amps
+     *
+     * Generates registrations, originations and page responses from
+     * nmobiles virtual mobiles (MINs first_min, first_min + 1, ...) as
+     * independent Poisson processes, and posts each one as a RECC burst on
+     * "bursts", in the form the RECC block produces, for the RECC Decode
+     * block.  Each burst carries a trace ID, which RECC Decode passes on to
+     * its answer; the FOCC block's "latency" output is connected back to
+     * "focc_sent" here, and the time from a burst to its answer going out
+     * on the FOCC is that mobile's response latency.
+     *
+     * Every report_interval seconds the block posts a dict on "stats":
+     * offered load, bursts sent, responses, timeouts and latency
+     * percentiles (p50, p99, max) over the interval.  A dict on "control"
+     * with any of reg_rate, orig_rate and resp_rate changes the load and
+     * starts a new interval.
+     */
+    class AMPS_API mobile_population : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<mobile_population> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::mobile_population.
+       *
+       * \param nmobiles number of virtual mobiles
+       * \param first_min ten-digit MIN of the first mobile
+       * \param reg_rate registrations per second, over all mobiles
+       * \param orig_rate originations per second, over all mobiles
+       * \param resp_rate page responses per second, over all mobiles
+       * \param timeout seconds after which an unanswered burst counts as lost
+       * \param report_interval seconds between stats reports
+       * \param seed random seed (0 picks one from the clock)
+       */
+      static sptr make(int nmobiles = 1000, const std::string &first_min = "2125550000",
+              double reg_rate = 10.0, double orig_rate = 1.0, double resp_rate = 1.0,
+              double timeout = 2.0, double report_interval = 5.0, int seed = 0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_MOBILE_POPULATION_H */
@@ -0,0 +1,73 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_MS_EMULATOR_H
+#define INCLUDED_AMPS_MS_EMULATOR_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_decimator.h>
+#include <string>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief Emulated mobile stations, closing the loop from FOCC to RECC.
+     * \ingroup amps
+     *
+     * Input: the FOCC block's output symbols (symrate samples per second).
+     * Output: RECC symbols (one byte per Manchester symbol, 0 or 1, 20000
+     * per second), for the RECC block.
+     *
+     * The FOCC is decoded once, as all the mobiles would hear it: word
+     * sync, BCH decoding, busy-idle bits and the overhead train (SID, DCC,
+     * REGH/REGR, REGID, REGINCR, CMAX).  Each of nmobiles mobiles registers
+     * after it powers on (at a random time in the first power_on_spread
+     * seconds) and again whenever REGID passes its next registration
+     * point, originates calls (orig_rate per second, over all mobiles) and
+     * answers pages addressed to it.  Accesses follow 553 2.6.3 loosely:
+     * a random delay, a busy-idle check, then the seizure precursor and
+     * message.  Every mobile has its own SNR and delay on the reverse
+     * channel; overlapping transmissions add, with unit-variance Gaussian
+     * noise, before the output is sliced.
+     *
+     * All timing is in output symbols, so the block runs as fast as the
+     * flowgraph lets it; throttle the FOCC to run in real time.  Every
+     * report_interval seconds (of channel time) it posts a dict on
+     * "stats": accesses by kind, successes, failures, and access latency
+     * (from the start of an access to the FOCC response) percentiles.
+     */
+    class AMPS_API ms_emulator : virtual public gr::sync_decimator
+    {
+     public:
+      typedef boost::shared_ptr<ms_emulator> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::ms_emulator.
+       *
+       * \param symrate FOCC symbol rate (a multiple of 20000)
+       * \param nmobiles number of emulated mobiles
+       * \param first_min ten-digit MIN of the first mobile
+       * \param orig_rate call originations per second, over all mobiles
+       * \param hold_time mean call length in seconds
+       * \param snr_db mean reverse-channel SNR
+       * \param snr_spread each mobile's SNR is snr_db +/- up to this much
+       * \param max_delay largest reverse-channel delay, in RECC symbols
+       * \param power_on_spread mobiles power on within this many seconds
+       * \param report_interval seconds between stats reports
+       * \param seed random seed (0 picks one from the clock)
+       */
+      static sptr make(unsigned long symrate = 20000, int nmobiles = 100,
+              const std::string &first_min = "2125550000", double orig_rate = 0.1,
+              double hold_time = 30.0, double snr_db = 20.0, double snr_spread = 10.0,
+              int max_delay = 4, double power_on_spread = 60.0,
+              double report_interval = 10.0, int seed = 0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_MS_EMULATOR_H */
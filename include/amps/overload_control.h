@@ -0,0 +1,57 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_OVERLOAD_CONTROL_H
+#define INCLUDED_AMPS_OVERLOAD_CONTROL_H
+
+#include <amps/api.h>
+#include <gnuradio/block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief RECC overload control.
+     * \ingroup amps
+     *
+     * Watches the seizure rate and the fraction of bursts that fail to
+     * decode (from the RECC Decode block's "decode_stats") and the number
+     * of messages waiting for an FOCC slot (from the FOCC block's
+     * "queue_stats"), and sheds access load a step at a time while any of
+     * them is over its limit: first by turning on busy-idle checking (BIS),
+     * then by stopping autonomous registration (REGH/REGR), then by barring
+     * more and more access overload classes 0-9 from originating with an
+     * overload control message (553 3.7.1.2.3).  Classes 10-15 are never
+     * barred.  Load is only given back one step at a time, after everything
+     * has stayed below release times its limit for hold intervals.
+     *
+     * Connect "overhead" to the FOCC block's "overhead" input.  Every
+     * interval the block posts a dict on "stats" with its level and the
+     * measurements behind it.
+     */
+    class AMPS_API overload_control : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<overload_control> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::overload_control.
+       *
+       * \param interval seconds between measurements
+       * \param max_seizure_rate RECC bursts per second
+       * \param max_failures fraction of bursts that fail Word A or are rejected
+       * \param max_queue FOCC messages waiting for a slot
+       * \param release fraction of each limit that load must drop below to count as cleared
+       * \param hold intervals load must stay cleared before stepping down a level
+       */
+      static sptr make(double interval = 1.0, double max_seizure_rate = 4.0, double max_failures = 0.25,
+              int max_queue = 20, double release = 0.7, int hold = 5);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_OVERLOAD_CONTROL_H */
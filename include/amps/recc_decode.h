@@ -3,6 +3,8 @@
 
 #include <amps/api.h>
 #include <gnuradio/block.h>
+#include <string>
+#include <vector>
 
 namespace gr {
   namespace amps {
@@ -25,7 +27,9 @@ namespace gr {
        * class. amps::recc_decode::make is the public interface for
        * creating new instances.
        */
-      static sptr make();
+      static sptr make(const std::string &registry_path = "", int first_chan = 355, int nchans = 2,
+              const std::vector<int> &scc = std::vector<int>(), int vmac = 0,
+              const std::string &journal_prefix = "", double dup_ttl = 10.0);
     };
 
   } // namespace amps
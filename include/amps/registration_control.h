@@ -0,0 +1,60 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_REGISTRATION_CONTROL_H
+#define INCLUDED_AMPS_REGISTRATION_CONTROL_H
+
+#include <amps/api.h>
+#include <gnuradio/block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief Autonomous registration load controller.
+     * \ingroup amps
+     *
+     * Advances REGID by one every regid_period seconds, so that mobiles'
+     * NXTREG values (553 2.6.1.1.2) come due spread out over time rather
+     * than all at once, and tunes REGINCR so that the registration rate the
+     * RECC Decode block reports settles near target_rate.  REGINCR is only
+     * changed when the rate is well off target, and is pushed up further
+     * when too many bursts collide (fail Word A).
+     *
+     * Connect the RECC Decode block's "decode_stats" output to
+     * "decode_stats", and "overhead" to the FOCC block's "overhead" input.
+     * If an amps::overload_control block is used, connect its "overhead"
+     * output to "overload" too: REGINCR is held while it has registration
+     * turned off.
+     * Every report_interval seconds the block posts a dict on "stats" with
+     * REGID, REGINCR and the measured registration and collision rates.
+     */
+    class AMPS_API registration_control : virtual public gr::block
+    {
+     public:
+      typedef boost::shared_ptr<registration_control> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::registration_control.
+       *
+       * \param regid_period seconds between REGID increments
+       * \param target_rate registrations per second to aim for
+       * \param regincr REGINCR to start with
+       * \param min_regincr smallest REGINCR to use
+       * \param max_regincr largest REGINCR to use (at most 4095)
+       * \param max_collisions fraction of bursts that may fail Word A before
+       *        REGINCR is raised to shed load
+       * \param report_interval seconds between REGINCR adjustments and stats reports
+       */
+      static sptr make(double regid_period = 1.0, double target_rate = 2.0, int regincr = 100,
+              int min_regincr = 10, int max_regincr = 4095, double max_collisions = 0.1,
+              double report_interval = 10.0);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_REGISTRATION_CONTROL_H */
@@ -0,0 +1,45 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_RVC_DATA_H
+#define INCLUDED_AMPS_RVC_DATA_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief AMPS reverse voice channel blank-and-burst data decoder.
+     * \ingroup amps
+     *
+     * Takes demodulated voice-channel audio, finds RVC word sync, and
+     * decodes the five repeats of each 48-bit word (majority vote, then
+     * BCH).  Each decoded message is posted on the "messages" port as a
+     * dict with a "type" of either order_confirmation (with local, ordq and
+     * order) or called_address (with digits).  If \p chan is set, it's
+     * added to every message as "chan", so an FVC Bank can tell which of
+     * its channels the message came in on.
+     */
+    class AMPS_API rvc_data : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<rvc_data> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::rvc_data.
+       *
+       * \param samp_rate input sample rate; must be a multiple of 20 kHz
+       * \param chan FVC Bank channel this RVC belongs to, or -1 for none
+       */
+      static sptr make(double samp_rate, int chan = -1);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_RVC_DATA_H */
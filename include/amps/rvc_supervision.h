@@ -0,0 +1,50 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_RVC_SUPERVISION_H
+#define INCLUDED_AMPS_RVC_SUPERVISION_H
+
+#include <amps/api.h>
+#include <gnuradio/sync_block.h>
+
+namespace gr {
+  namespace amps {
+
+    /*!
+     * \brief RVC supervisory audio tone (SAT) and signaling tone (ST) detector.
+     * \ingroup amps
+     *
+     * Takes one demodulated audio stream per reverse voice channel and runs
+     * a Goertzel bank (5970, 6000 and 6030 Hz SAT; 10 kHz ST) over all of
+     * them at once.  Whenever a channel's SAT color code or ST state changes
+     * and stays changed for \p debounce analysis windows, a dict is posted on
+     * the "events" port:
+     *
+     *     chan:  input port number
+     *     event: sat_detected, sat_lost, st_on or st_off
+     *     sat:   detected SAT color code (0-2), or -1 if none
+     *     st:    true if the signaling tone is present
+     */
+    class AMPS_API rvc_supervision : virtual public gr::sync_block
+    {
+     public:
+      typedef boost::shared_ptr<rvc_supervision> sptr;
+
+      /*!
+       * \brief Return a shared_ptr to a new instance of amps::rvc_supervision.
+       *
+       * \param samp_rate input sample rate (must be above 20 kHz)
+       * \param nchans number of reverse voice channels (input ports)
+       * \param threshold fraction of the window's energy a tone must hold to be present
+       * \param debounce consecutive windows a new state must hold before it is reported
+       */
+      static sptr make(double samp_rate, int nchans, float threshold, int debounce);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_RVC_SUPERVISION_H */
@@ -0,0 +1,631 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "amps_log.h"
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+#include <vector>
+
+namespace gr {
+    namespace amps {
+
+        int log_threshold = LOG_LEVEL_DEBUG;
+
+        static const size_t LOG_RING_RECORDS = 1024;    // per thread; power of two
+        static const size_t LOG_ARGS_SIZE = 224;
+        static const useconds_t LOG_POLL_US = 2000;
+
+        /*
+         * One log call.  Arguments are stored in 8-byte slots in the order
+         * the format consumes them, except %s, which is a 2-byte length and
+         * the bytes.
+         */
+        struct log_record {
+            uint64_t stamp_ns;      // CLOCK_REALTIME
+            const char *fmt;
+            const char *file;
+            uint32_t line;
+            uint16_t argbytes;
+            uint8_t level;
+            uint8_t nconv;          // conversions captured; the rest are lost
+            unsigned char args[LOG_ARGS_SIZE];
+        };
+
+        /*
+         * Single-producer single-consumer ring.  head is only written by the
+         * owning thread and tail only by the writer thread; each lives on
+         * its own cache line.
+         */
+        struct log_ring {
+            log_record records[LOG_RING_RECORDS];
+            char pad0[64];
+            uint64_t head;
+            char pad1[64];
+            uint64_t tail;
+            char pad2[64];
+            uint64_t dropped;           // written by the owner
+            uint64_t dropped_reported;  // writer's copy
+            int dead;                   // owning thread has exited
+            log_ring *next;
+        };
+
+        static boost::mutex ring_list_mutex;
+        static log_ring *ring_list = NULL;
+        static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+        static pthread_key_t ring_key;
+        static __thread log_ring *tls_ring = NULL;
+        static boost::thread *writer = NULL;
+        static int writer_running = 0;
+
+        // The writer's scratch space.  Allocated before the writer starts
+        // and never freed, so it outlives the final drain in log_shutdown()
+        // however late at exit that runs.
+        struct log_drain_state {
+            std::vector<log_ring *> rings;
+            std::vector<uint64_t> heads;
+            std::string out;
+        };
+        static log_drain_state *drain_state = NULL;
+
+        static void log_drain_loop();
+        static size_t log_drain();
+
+        static void ring_thread_exit(void *p) {
+            __atomic_store_n(&static_cast<log_ring *>(p)->dead, 1, __ATOMIC_RELEASE);
+        }
+
+        static void log_shutdown() {
+            __atomic_store_n(&writer_running, 0, __ATOMIC_RELEASE);
+            if(writer != NULL) {
+                writer->join();
+            }
+        }
+
+        static void log_init() {
+            pthread_key_create(&ring_key, ring_thread_exit);
+            drain_state = new log_drain_state();
+            writer_running = 1;
+            writer = new boost::thread(log_drain_loop);
+            atexit(log_shutdown);
+        }
+
+        // Pick up AMPS_LOG_LEVEL before any block is constructed.
+        static struct log_env_init {
+            log_env_init() {
+                const char *env = getenv("AMPS_LOG_LEVEL");
+                if(env != NULL && set_log_level(std::string(env)) == false) {
+                    fprintf(stderr, "invalid AMPS_LOG_LEVEL %s\n", env);
+                }
+            }
+        } log_env_init_instance;
+
+        static log_ring *get_ring() {
+            if(tls_ring != NULL) {
+                return tls_ring;
+            }
+            pthread_once(&log_once, log_init);
+            log_ring *ring = new (std::nothrow) log_ring();
+            if(ring == NULL) {
+                return NULL;
+            }
+            pthread_setspecific(ring_key, ring);
+            boost::mutex::scoped_lock lock(ring_list_mutex);
+            ring->next = ring_list;
+            ring_list = ring;
+            tls_ring = ring;
+            return ring;
+        }
+
+        enum log_length {
+            LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_J, LEN_Z, LEN_T, LEN_BIG_L
+        };
+
+        struct log_conv {
+            const char *start;      // the '%'
+            size_t len;             // through the conversion character
+            int nstars;
+            log_length length;
+            char conv;
+        };
+
+        /*
+         * Parse the conversion starting at p (just past a '%').  Returns a
+         * pointer past it, or NULL if it's not something we understand.
+         */
+        static const char *parse_conv(const char *p, log_conv &c) {
+            c.start = p - 1;
+            c.nstars = 0;
+            c.length = LEN_NONE;
+            while(*p != 0 && strchr("-+ #0'", *p) != NULL) {
+                p++;
+            }
+            if(*p == '*') {
+                c.nstars++;
+                p++;
+            }
+            while(*p >= '0' && *p <= '9') {
+                p++;
+            }
+            if(*p == '.') {
+                p++;
+                if(*p == '*') {
+                    c.nstars++;
+                    p++;
+                }
+                while(*p >= '0' && *p <= '9') {
+                    p++;
+                }
+            }
+            switch(*p) {
+                case 'h':
+                    p++;
+                    c.length = LEN_H;
+                    if(*p == 'h') {
+                        p++;
+                        c.length = LEN_HH;
+                    }
+                    break;
+                case 'l':
+                    p++;
+                    c.length = LEN_L;
+                    if(*p == 'l') {
+                        p++;
+                        c.length = LEN_LL;
+                    }
+                    break;
+                case 'q':
+                    p++;
+                    c.length = LEN_LL;
+                    break;
+                case 'j':
+                    p++;
+                    c.length = LEN_J;
+                    break;
+                case 'z':
+                    p++;
+                    c.length = LEN_Z;
+                    break;
+                case 't':
+                    p++;
+                    c.length = LEN_T;
+                    break;
+                case 'L':
+                    p++;
+                    c.length = LEN_BIG_L;
+                    break;
+            }
+            if(*p == 0 || strchr("diouxXcsfFeEgGaApn", *p) == NULL) {
+                return NULL;
+            }
+            c.conv = *p;
+            p++;
+            c.len = p - c.start;
+            return p;
+        }
+
+        static inline void log_put64(log_record &rec, uint64_t v) {
+            memcpy(&rec.args[rec.argbytes], &v, 8);
+            rec.argbytes += 8;
+        }
+
+        static inline uint64_t log_get64(const unsigned char *&a) {
+            uint64_t v;
+            memcpy(&v, a, 8);
+            a += 8;
+            return v;
+        }
+
+        /*
+         * Copy the arguments the format will need into the record.  This
+         * only walks the format; nothing is formatted.
+         */
+        static void capture_args(log_record &rec, const char *fmt, va_list ap) {
+            rec.argbytes = 0;
+            rec.nconv = 0;
+            for(const char *p = fmt; *p != 0; ) {
+                if(*p++ != '%') {
+                    continue;
+                }
+                if(*p == '%') {
+                    p++;
+                    continue;
+                }
+                log_conv c;
+                p = parse_conv(p, c);
+                if(p == NULL) {
+                    return;
+                }
+                if((size_t)rec.argbytes + (8 * (c.nstars + 1)) > LOG_ARGS_SIZE) {
+                    return;
+                }
+                for(int i = 0; i < c.nstars; i++) {
+                    log_put64(rec, (int64_t)va_arg(ap, int));
+                }
+                switch(c.conv) {
+                    case 'd':
+                    case 'i': {
+                        int64_t v;
+                        switch(c.length) {
+                            case LEN_L: v = va_arg(ap, long); break;
+                            case LEN_LL: v = va_arg(ap, long long); break;
+                            case LEN_J: v = va_arg(ap, intmax_t); break;
+                            case LEN_Z: v = va_arg(ap, ssize_t); break;
+                            case LEN_T: v = va_arg(ap, ptrdiff_t); break;
+                            default: v = va_arg(ap, int); break;
+                        }
+                        log_put64(rec, v);
+                        break;
+                    }
+                    case 'o':
+                    case 'u':
+                    case 'x':
+                    case 'X': {
+                        uint64_t v;
+                        switch(c.length) {
+                            case LEN_L: v = va_arg(ap, unsigned long); break;
+                            case LEN_LL: v = va_arg(ap, unsigned long long); break;
+                            case LEN_J: v = va_arg(ap, uintmax_t); break;
+                            case LEN_Z: v = va_arg(ap, size_t); break;
+                            case LEN_T: v = va_arg(ap, ptrdiff_t); break;
+                            default: v = va_arg(ap, unsigned int); break;
+                        }
+                        log_put64(rec, v);
+                        break;
+                    }
+                    case 'c':
+                        log_put64(rec, va_arg(ap, int));
+                        break;
+                    case 'p':
+                        log_put64(rec, (uintptr_t)va_arg(ap, void *));
+                        break;
+                    case 'n':
+                        (void)va_arg(ap, void *);
+                        break;
+                    case 's': {
+                        const char *s = va_arg(ap, const char *);
+                        if(s == NULL) {
+                            s = "(null)";
+                        }
+                        if((size_t)rec.argbytes + 2 > LOG_ARGS_SIZE) {
+                            return;
+                        }
+                        const uint16_t len = strnlen(s, LOG_ARGS_SIZE - rec.argbytes - 2);
+                        memcpy(&rec.args[rec.argbytes], &len, 2);
+                        memcpy(&rec.args[rec.argbytes + 2], s, len);
+                        rec.argbytes += 2 + len;
+                        break;
+                    }
+                    default: {
+                        double v;
+                        if(c.length == LEN_BIG_L) {
+                            v = va_arg(ap, long double);
+                        } else {
+                            v = va_arg(ap, double);
+                        }
+                        memcpy(&rec.args[rec.argbytes], &v, 8);
+                        rec.argbytes += 8;
+                        break;
+                    }
+                }
+                rec.nconv++;
+            }
+        }
+
+        void log_write(int level, const char *file, int line, const char *fmt, ...) {
+            log_ring *ring = get_ring();
+            if(ring == NULL) {
+                return;
+            }
+            const uint64_t head = ring->head;
+            const uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            if(head - tail >= LOG_RING_RECORDS) {
+                __atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+                return;
+            }
+            log_record &rec = ring->records[head & (LOG_RING_RECORDS - 1)];
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            rec.stamp_ns = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+            rec.fmt = fmt;
+            rec.file = file;
+            rec.line = line;
+            rec.level = level;
+            va_list ap;
+            va_start(ap, fmt);
+            capture_args(rec, fmt, ap);
+            va_end(ap);
+            __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        }
+
+        // snprintf one conversion, passing its star arguments first.
+        #define LOG_SNPRINTF(val) \
+            ((c.nstars == 0) ? snprintf(buf, sizeof(buf), spec, val) : \
+             (c.nstars == 1) ? snprintf(buf, sizeof(buf), spec, stars[0], val) : \
+             snprintf(buf, sizeof(buf), spec, stars[0], stars[1], val))
+
+        /*
+         * Format a record's message: the deferred half of log_write().  Each
+         * conversion is handed to snprintf on its own, with an argument of
+         * exactly the type its length modifier calls for.
+         */
+        static void format_message(const log_record &rec, std::string &out) {
+            const unsigned char *a = rec.args;
+            int nconv = 0;
+            const char *p = rec.fmt;
+            while(*p != 0) {
+                const char *pct = strchr(p, '%');
+                if(pct == NULL) {
+                    out.append(p);
+                    return;
+                }
+                out.append(p, pct - p);
+                p = pct + 1;
+                if(*p == '%') {
+                    out.push_back('%');
+                    p++;
+                    continue;
+                }
+                log_conv c;
+                const char *next = parse_conv(p, c);
+                if(next == NULL || nconv >= rec.nconv || c.len >= 32) {
+                    out.append("...");
+                    return;
+                }
+                p = next;
+                nconv++;
+                char spec[32];
+                memcpy(spec, c.start, c.len);
+                spec[c.len] = 0;
+                int stars[2] = { 0, 0 };
+                for(int i = 0; i < c.nstars; i++) {
+                    stars[i] = (int)(int64_t)log_get64(a);
+                }
+                char buf[512];
+                buf[0] = 0;
+                switch(c.conv) {
+                    case 'd':
+                    case 'i': {
+                        const int64_t v = (int64_t)log_get64(a);
+                        switch(c.length) {
+                            case LEN_L: LOG_SNPRINTF((long)v); break;
+                            case LEN_LL: LOG_SNPRINTF((long long)v); break;
+                            case LEN_J: LOG_SNPRINTF((intmax_t)v); break;
+                            case LEN_Z: LOG_SNPRINTF((ssize_t)v); break;
+                            case LEN_T: LOG_SNPRINTF((ptrdiff_t)v); break;
+                            default: LOG_SNPRINTF((int)v); break;
+                        }
+                        break;
+                    }
+                    case 'o':
+                    case 'u':
+                    case 'x':
+                    case 'X': {
+                        const uint64_t v = log_get64(a);
+                        switch(c.length) {
+                            case LEN_L: LOG_SNPRINTF((unsigned long)v); break;
+                            case LEN_LL: LOG_SNPRINTF((unsigned long long)v); break;
+                            case LEN_J: LOG_SNPRINTF((uintmax_t)v); break;
+                            case LEN_Z: LOG_SNPRINTF((size_t)v); break;
+                            case LEN_T: LOG_SNPRINTF((ptrdiff_t)v); break;
+                            default: LOG_SNPRINTF((unsigned int)v); break;
+                        }
+                        break;
+                    }
+                    case 'c':
+                        LOG_SNPRINTF((int)log_get64(a));
+                        break;
+                    case 'p':
+                        LOG_SNPRINTF((void *)(uintptr_t)log_get64(a));
+                        break;
+                    case 'n':
+                        break;
+                    case 's': {
+                        uint16_t len;
+                        memcpy(&len, a, 2);
+                        std::string s((const char *)a + 2, len);
+                        a += 2 + len;
+                        LOG_SNPRINTF(s.c_str());
+                        break;
+                    }
+                    default: {
+                        double v;
+                        memcpy(&v, a, 8);
+                        a += 8;
+                        if(c.length == LEN_BIG_L) {
+                            LOG_SNPRINTF((long double)v);
+                        } else {
+                            LOG_SNPRINTF(v);
+                        }
+                        break;
+                    }
+                }
+                out.append(buf);
+            }
+        }
+
+        #undef LOG_SNPRINTF
+
+        // Same format getstamp() always used; the date part is cached, as
+        // it only changes once a second.
+        static void format_stamp(uint64_t stamp_ns, std::string &out) {
+            static time_t cached_sec = -1;
+            static char cached[64];
+            const time_t sec = stamp_ns / 1000000000ULL;
+            if(sec != cached_sec) {
+                struct tm gtm;
+                memset(&gtm, 0, sizeof(gtm));
+                if(gmtime_r(&sec, &gtm) == NULL || strftime(cached, sizeof(cached), "%F %T", &gtm) == 0) {
+                    cached[0] = 0;
+                }
+                cached_sec = sec;
+            }
+            char usec[16];
+            snprintf(usec, sizeof(usec), ".%06lu", (unsigned long)((stamp_ns % 1000000000ULL) / 1000));
+            out.append(cached);
+            out.append(usec);
+        }
+
+        static void format_record(const log_record &rec, std::string &out) {
+            char where[64];
+            format_stamp(rec.stamp_ns, out);
+            snprintf(where, sizeof(where), ":%u %s: ", rec.line, log_level_name(rec.level));
+            out.append(": ");
+            out.append(rec.file);
+            out.append(where);
+            format_message(rec, out);
+            out.push_back('\n');
+        }
+
+        /*
+         * Write out everything that's in the rings right now, merged into
+         * timestamp order, and free the rings of threads that have exited.
+         * Only ever called from the writer thread.  Returns the number of
+         * records written.
+         */
+        static size_t log_drain() {
+            std::vector<log_ring *> &rings = drain_state->rings;
+            std::vector<uint64_t> &heads = drain_state->heads;
+            std::string &out = drain_state->out;
+
+            rings.clear();
+            {
+                boost::mutex::scoped_lock lock(ring_list_mutex);
+                log_ring **prev = &ring_list;
+                while(*prev != NULL) {
+                    log_ring *ring = *prev;
+                    if(__atomic_load_n(&ring->dead, __ATOMIC_ACQUIRE)
+                            && __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail) {
+                        *prev = ring->next;
+                        delete ring;
+                        continue;
+                    }
+                    rings.push_back(ring);
+                    prev = &ring->next;
+                }
+            }
+            heads.resize(rings.size());
+            for(size_t i = 0; i < rings.size(); i++) {
+                heads[i] = __atomic_load_n(&rings[i]->head, __ATOMIC_ACQUIRE);
+            }
+
+            out.clear();
+            size_t n = 0;
+            while(true) {
+                int best = -1;
+                for(size_t i = 0; i < rings.size(); i++) {
+                    const log_ring *r = rings[i];
+                    if(r->tail == heads[i]) {
+                        continue;
+                    }
+                    if(best < 0 || r->records[r->tail & (LOG_RING_RECORDS - 1)].stamp_ns
+                            < rings[best]->records[rings[best]->tail & (LOG_RING_RECORDS - 1)].stamp_ns) {
+                        best = i;
+                    }
+                }
+                if(best < 0) {
+                    break;
+                }
+                log_ring *r = rings[best];
+                format_record(r->records[r->tail & (LOG_RING_RECORDS - 1)], out);
+                __atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_RELEASE);
+                n++;
+            }
+            for(size_t i = 0; i < rings.size(); i++) {
+                const uint64_t dropped = __atomic_load_n(&rings[i]->dropped, __ATOMIC_RELAXED);
+                if(dropped != rings[i]->dropped_reported) {
+                    char msg[96];
+                    snprintf(msg, sizeof(msg), "log: %llu messages dropped (ring full)\n",
+                            (unsigned long long)(dropped - rings[i]->dropped_reported));
+                    out.append(msg);
+                    rings[i]->dropped_reported = dropped;
+                }
+            }
+            if(out.empty() == false) {
+                fwrite(out.data(), 1, out.size(), stdout);
+                fflush(stdout);
+            }
+            return n;
+        }
+
+        static void log_drain_loop() {
+            while(__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) {
+                if(log_drain() == 0) {
+                    usleep(LOG_POLL_US);
+                }
+            }
+            log_drain();
+        }
+
+        void set_log_level(int level) {
+            if(level < LOG_LEVEL_NONE) {
+                level = LOG_LEVEL_NONE;
+            } else if(level > LOG_LEVEL_DEBUG) {
+                level = LOG_LEVEL_DEBUG;
+            }
+            __atomic_store_n(&log_threshold, level, __ATOMIC_RELAXED);
+        }
+
+        // Accepts a level name (none, warning, info, debug) or number.
+        bool set_log_level(const std::string &name) {
+            for(int level = LOG_LEVEL_NONE; level <= LOG_LEVEL_DEBUG; level++) {
+                if(strcasecmp(name.c_str(), log_level_name(level)) == 0) {
+                    set_log_level(level);
+                    return true;
+                }
+            }
+            if(name.length() == 1 && name[0] >= '0' && name[0] <= '3') {
+                set_log_level(name[0] - '0');
+                return true;
+            }
+            return false;
+        }
+
+        const char *log_level_name(int level) {
+            switch(level) {
+                case LOG_LEVEL_NONE:
+                    return "NONE";
+                case LOG_LEVEL_WARNING:
+                    return "WARNING";
+                case LOG_LEVEL_INFO:
+                    return "INFO";
+                case LOG_LEVEL_DEBUG:
+                    return "DEBUG";
+            }
+            return "?";
+        }
+
+        /*
+         * Wait until everything logged so far by this thread has been
+         * written.  Not for hot paths.
+         */
+        void log_flush() {
+            log_ring *ring = tls_ring;
+            if(ring == NULL) {
+                return;
+            }
+            const uint64_t head = ring->head;
+            while(__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < head
+                    && __atomic_load_n(&writer_running, __ATOMIC_ACQUIRE)) {
+                usleep(LOG_POLL_US);
+            }
+        }
+    }
+}
@@ -0,0 +1,62 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_LOG_H
+#define INCLUDED_AMPS_LOG_H
+
+#include <string>
+#include <amps/api.h>
+
+/*
+ * Asynchronous logging.  A log call never formats anything or touches
+ * stdout: it timestamps the message, copies the format pointer and the raw
+ * arguments into a record in a ring buffer owned by the calling thread, and
+ * returns.  A background thread drains every thread's ring, formats the
+ * records in timestamp order and writes them out.  If a ring is full the
+ * message is dropped (and counted) rather than blocking the caller.
+ *
+ * Formats must be string literals (or otherwise live forever), since only
+ * the pointer is kept.  %s arguments are copied, and may be truncated.
+ */
+
+#define AMPS_LOG(level, fmt, ...) do { \
+        if(gr::amps::log_enabled(level)) { \
+            gr::amps::log_write(level, __FILE__, __LINE__, fmt, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#define LOG_WARNING(fmt, ...) AMPS_LOG(gr::amps::LOG_LEVEL_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) AMPS_LOG(gr::amps::LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) AMPS_LOG(gr::amps::LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+namespace gr {
+    namespace amps {
+        enum log_level {
+            LOG_LEVEL_NONE = 0,
+            LOG_LEVEL_WARNING = 1,
+            LOG_LEVEL_INFO = 2,
+            LOG_LEVEL_DEBUG = 3
+        };
+
+        // Messages at or below this level are logged.  Set from the
+        // AMPS_LOG_LEVEL environment variable at startup, and at runtime
+        // with set_log_level().
+        extern int log_threshold;
+
+        inline bool log_enabled(int level) {
+            return level <= __atomic_load_n(&log_threshold, __ATOMIC_RELAXED);
+        }
+
+        void log_write(int level, const char *file, int line, const char *fmt, ...)
+            __attribute__((format(printf, 4, 5)));
+        AMPS_API void set_log_level(int level);
+        bool set_log_level(const std::string &name);
+        const char *log_level_name(int level);
+        AMPS_API void log_flush();
+    }
+}
+
+#endif /* INCLUDED_AMPS_LOG_H */
@@ -94,6 +94,84 @@ namespace gr {
         expandbits(&word[17], 11, chan);
     }
 
+    /**
+     * Generate a 36-bit (1 byte/bit) array of RECC Word A (Abbreviated
+     * Address Word; 553 2.7.1.1).  E is always set, since Word B always
+     * follows.  scm is the full station class mark; its fourth bit goes in
+     * Word B.
+     */
+    void recc_word_a_bits(unsigned char *word, const unsigned char nawc, const bool T, const bool S, const unsigned char scm, const u_int64_t MIN1) {
+        word[0] = 1;
+        expandbits(&word[1], 3, nawc);
+        word[4] = T ? 1 : 0;
+        word[5] = S ? 1 : 0;
+        word[6] = 1;
+        word[7] = 0;
+        expandbits(&word[8], 4, scm & 0xf);
+        expandbits(&word[12], 24, MIN1);
+    }
+
+    /**
+     * Generate a 36-bit (1 byte/bit) array of RECC Word B (Extended Address
+     * Word).
+     */
+    void recc_word_b_bits(unsigned char *word, const unsigned char nawc, const unsigned char msg_type, const unsigned char ordq, const unsigned char order, const unsigned char scm, const u_int64_t MIN2) {
+        word[0] = 0;
+        expandbits(&word[1], 3, nawc);
+        expandbits(&word[4], 5, msg_type);
+        expandbits(&word[9], 3, ordq);
+        expandbits(&word[12], 5, order);
+        word[17] = 0;           // LT
+        word[18] = 0;           // EP
+        word[19] = ((scm & 0x10) == 0x10) ? 1 : 0;
+        expandbits(&word[20], 2, 0);        // MPCI: AMPS only
+        expandbits(&word[22], 2, 0);        // SDCC1
+        expandbits(&word[24], 2, 0);        // SDCC2
+        expandbits(&word[26], 10, MIN2);
+    }
+
+    /**
+     * Generate a 36-bit (1 byte/bit) array of RECC Word C (Serial Number
+     * Word).
+     */
+    void recc_word_c_serial_bits(unsigned char *word, const unsigned char nawc, const unsigned long esn) {
+        word[0] = 0;
+        expandbits(&word[1], 3, nawc);
+        expandbits(&word[4], 32, esn & 0xffffffffUL);
+    }
+
+    /**
+     * Generate a 36-bit (1 byte/bit) array of a RECC Word of the Called
+     * Address, holding up to eight digits (Table 2.7.1-2).  Returns false if
+     * there are too many digits or one of them can't be encoded.
+     */
+    bool recc_word_called_bits(unsigned char *word, const unsigned char nawc, const std::string &digits) {
+        if(digits.size() > 8) {
+            return false;
+        }
+        word[0] = 0;
+        expandbits(&word[1], 3, nawc);
+        for(size_t i = 0; i < 8; i++) {
+            unsigned char v = 0;
+            if(i < digits.size()) {
+                const char c = digits[i];
+                if(c >= '1' && c <= '9') {
+                    v = c - '0';
+                } else if(c == '0') {
+                    v = 10;
+                } else if(c == '*') {
+                    v = 11;
+                } else if(c == '#') {
+                    v = 12;
+                } else {
+                    return false;
+                }
+            }
+            expandbits(&word[4 + (4 * i)], 4, v);
+        }
+        return true;
+    }
+
 
   }
 }
@@ -7,6 +7,7 @@
 #ifndef AMPS_PACKET_H
 #define AMPS_PACKET_H
 
+#include <pmt/pmt.h>
 #include "utils.h"
 
 #define GLOBAL_SID 16
@@ -33,6 +34,18 @@ namespace gr {
           STREAM_BOTH = 3,
       };
 
+      // Order codes (ORDER field, ORDQ 000); TIA/EIA-553-A Table 3.7.1-1.
+      enum amps_order {
+          ORDER_PAGE = 0x00,
+          ORDER_ALERT = 0x01,
+          ORDER_RELEASE = 0x03,
+          ORDER_REORDER = 0x04,
+          ORDER_STOP_ALERT = 0x06,
+          ORDER_AUDIT = 0x07,
+          ORDER_SEND_CALLED_ADDRESS = 0x08,
+          ORDER_INTERCEPT = 0x09
+      };
+
       /**
        * focc_segment's data is manchester-encoded.
        */
@@ -69,7 +82,7 @@ namespace gr {
                           optr++;
                       }
                   } else {
-                      std::cout << "XXX invalid value: " << ndata[i] << std::endl;
+                      LOG_WARNING("invalid value: %d", (int)ndata[i]);
                       assert(0);
                   }
               }
@@ -86,10 +99,11 @@ namespace gr {
           bool is_ephemeral;
           bool is_filler;
           std::vector<focc_segment *> segments;
+          pmt::pmt_t trace;     // trace dict of the RECC burst this answers, or PMT_NIL
           focc_frame(std::vector<focc_segment *> nsegs) 
-              : segments(nsegs), is_ephemeral(false), is_filler(false) { }
+              : is_ephemeral(false), is_filler(false), segments(nsegs), trace(pmt::PMT_NIL) { }
           focc_frame(std::vector<focc_segment *> nsegs, bool ephemeral, bool filler) 
-              : segments(nsegs), is_ephemeral(ephemeral), is_filler(filler) { }
+              : is_ephemeral(ephemeral), is_filler(filler), segments(nsegs), trace(pmt::PMT_NIL) { }
           ~focc_frame() {
               for(int i = 0; i < segments.size(); i++) {
                   if(segments[i] != NULL) {
@@ -273,6 +287,37 @@ namespace gr {
           }
       };
 
+      /**
+       * RVC words (553 2.7.2.1) start like RECC words, but NAWC is only two
+       * bits wide and is followed by T.
+       */
+      class rvc_word {
+          public:
+          bool F;               // First - 1 when it's the first word in a message
+          unsigned char NAWC;   // Number of Additional Words Coming
+          bool T;               // 1 for an order confirmation; 0 for a called-address word
+
+          rvc_word(const unsigned char *bytebuf) {
+              F = ((bytebuf[0] & 1) == 1);
+              NAWC = get8(&bytebuf[1], 2);
+              T = BIT(bytebuf[3]);
+          }
+      };
+
+      // RVC Order Confirmation Message (553 Table 2.7.2-1)
+      class rvc_word_order : public rvc_word {
+          public:
+          unsigned char LOCAL;      // local control field
+          unsigned char ORDQ;       // order qualifier field (table 3.7.1-1)
+          unsigned char ORDER;      // order type (table 3.7.1-1)
+
+          rvc_word_order(const unsigned char *bytebuf) : rvc_word(bytebuf) {
+              LOCAL = get8(&bytebuf[4], 5);
+              ORDQ = get8(&bytebuf[9], 3);
+              ORDER = get8(&bytebuf[12], 5);
+          }
+      };
+
       // Extract three MIN digits using the procedure in section 2.3.1.1-1.
       inline std::string extract_min_3(u_int64_t val) {
           std::string digs = "";
@@ -368,6 +413,10 @@ namespace gr {
       void focc_word2_voice_channel(unsigned char *word, const unsigned char scc, const u_int64_t MIN2, const unsigned char vmac, const unsigned short chan);
       void focc_word2_general(unsigned char *word, const u_int64_t MIN2, const unsigned char msg_type, const unsigned char ordq, const unsigned char order);
       void fvc_word1_general(unsigned char *word, const unsigned char pscc, const unsigned char msg_type, const unsigned char ordq, const unsigned char order);
+      void recc_word_a_bits(unsigned char *word, const unsigned char nawc, const bool T, const bool S, const unsigned char scm, const u_int64_t MIN1);
+      void recc_word_b_bits(unsigned char *word, const unsigned char nawc, const unsigned char msg_type, const unsigned char ordq, const unsigned char order, const unsigned char scm, const u_int64_t MIN2);
+      void recc_word_c_serial_bits(unsigned char *word, const unsigned char nawc, const unsigned long esn);
+      bool recc_word_called_bits(unsigned char *word, const unsigned char nawc, const std::string &digits);
 
   }
 }
@@ -0,0 +1,139 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "block_profiler.h"
+#include <stdlib.h>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    static const uint64_t PROFILE_DEFAULT_INTERVAL = 60;
+
+    block_profiler::block_profiler(const std::string &block)
+        : d_block(block), d_interval_ns(PROFILE_DEFAULT_INTERVAL * 1000000000ULL) {
+        const char *env = getenv("AMPS_PROFILE_INTERVAL");
+        if(env != NULL) {
+            d_interval_ns = strtoull(env, NULL, 10) * 1000000000ULL;
+        }
+        d_next_dump_ns = monotonic_ns() + d_interval_ns;
+    }
+
+    block_profiler::~block_profiler() {
+        for(size_t i = 0; i < d_sites.size(); i++) {
+            delete d_sites[i];
+        }
+    }
+
+    // Only from the block's constructor, before anything records.
+    int block_profiler::add_site(const std::string &name) {
+        profile_site *site = new profile_site;
+        site->name = name;
+        site->over_budget = 0;
+        site->busy_ns = 0;
+        d_sites.push_back(site);
+        return d_sites.size() - 1;
+    }
+
+    void block_profiler::record(int site, uint64_t start_ns, uint64_t end_ns, uint64_t budget_ns) {
+        profile_site *s = d_sites[site];
+        const uint64_t ns = end_ns - start_ns;
+        s->hist.record(ns);
+        __atomic_fetch_add(&s->busy_ns, ns, __ATOMIC_RELAXED);
+        if(budget_ns > 0 && ns > budget_ns) {
+            __atomic_fetch_add(&s->over_budget, 1, __ATOMIC_RELAXED);
+        }
+        maybe_dump(end_ns);
+    }
+
+    void block_profiler::maybe_dump(uint64_t now) {
+        if(d_interval_ns == 0) {
+            return;
+        }
+        uint64_t next = __atomic_load_n(&d_next_dump_ns, __ATOMIC_RELAXED);
+        if(now < next) {
+            return;
+        }
+        // Whoever moves the deadline does the dump.
+        if(__atomic_compare_exchange_n(&d_next_dump_ns, &next, now + d_interval_ns, false,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            dump();
+        }
+    }
+
+    /*
+     * A dict of site name -> dict of count, busy time, calls over budget,
+     * and p50/p90/p99/p99.9/max in microseconds.
+     */
+    pmt::pmt_t block_profiler::stats() const {
+        pmt::pmt_t d = pmt::make_dict();
+        for(size_t i = 0; i < d_sites.size(); i++) {
+            const profile_site *s = d_sites[i];
+            const latency_histogram &h = s->hist;
+            pmt::pmt_t sd = pmt::make_dict();
+            sd = pmt::dict_add(sd, pmt::mp("count"), pmt::from_uint64(h.count()));
+            sd = pmt::dict_add(sd, pmt::mp("busy_ms"), pmt::from_double(__atomic_load_n(&s->busy_ns, __ATOMIC_RELAXED) / 1e6));
+            sd = pmt::dict_add(sd, pmt::mp("over_budget"), pmt::from_uint64(__atomic_load_n(&s->over_budget, __ATOMIC_RELAXED)));
+            sd = pmt::dict_add(sd, pmt::mp("p50_us"), pmt::from_double(h.percentile(50) / 1000.0));
+            sd = pmt::dict_add(sd, pmt::mp("p90_us"), pmt::from_double(h.percentile(90) / 1000.0));
+            sd = pmt::dict_add(sd, pmt::mp("p99_us"), pmt::from_double(h.percentile(99) / 1000.0));
+            sd = pmt::dict_add(sd, pmt::mp("p999_us"), pmt::from_double(h.percentile(99.9) / 1000.0));
+            sd = pmt::dict_add(sd, pmt::mp("max_us"), pmt::from_double(h.max() / 1000.0));
+            d = pmt::dict_add(d, pmt::mp(s->name), sd);
+        }
+        return d;
+    }
+
+    /*
+     * Answer a stats query: (block . stats).  If the query is a dict with
+     * "reset" set, the counters start over after the answer is taken.
+     */
+    pmt::pmt_t block_profiler::query(pmt::pmt_t msg) {
+        pmt::pmt_t answer = pmt::cons(pmt::mp(d_block), stats());
+        if(pmt::is_dict(msg) && pmt::is_true(pmt::dict_ref(msg, pmt::mp("reset"), pmt::PMT_F))) {
+            reset();
+        }
+        return answer;
+    }
+
+    void block_profiler::dump() const {
+        for(size_t i = 0; i < d_sites.size(); i++) {
+            const profile_site *s = d_sites[i];
+            const latency_histogram &h = s->hist;
+            if(h.count() == 0) {
+                continue;
+            }
+            LOG_INFO("profile %s %s: %llu calls, %.1f ms busy, %llu over budget; p50 %.1f us p99 %.1f us p99.9 %.1f us max %.1f us",
+                    d_block.c_str(), s->name.c_str(), (unsigned long long)h.count(),
+                    __atomic_load_n(&s->busy_ns, __ATOMIC_RELAXED) / 1e6,
+                    (unsigned long long)__atomic_load_n(&s->over_budget, __ATOMIC_RELAXED),
+                    h.percentile(50) / 1000.0, h.percentile(99) / 1000.0,
+                    h.percentile(99.9) / 1000.0, h.max() / 1000.0);
+        }
+    }
+
+    void block_profiler::reset() {
+        for(size_t i = 0; i < d_sites.size(); i++) {
+            d_sites[i]->hist.reset();
+            __atomic_store_n(&d_sites[i]->over_budget, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&d_sites[i]->busy_ns, 0, __ATOMIC_RELAXED);
+        }
+    }
+
+    profile_scope::profile_scope(block_profiler &profiler, int site)
+        : d_profiler(profiler), d_site(site), d_start(monotonic_ns()), d_budget(0) {
+    }
+
+    profile_scope::~profile_scope() {
+        d_profiler.record(d_site, d_start, monotonic_ns(), d_budget);
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,86 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_BLOCK_PROFILER_H
+#define INCLUDED_AMPS_BLOCK_PROFILER_H
+
+#include <pmt/pmt.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "latency_histogram.h"
+
+namespace gr {
+  namespace amps {
+
+    // One instrumented call site: work(), or a message handler.
+    struct profile_site {
+        std::string name;
+        latency_histogram hist;     // nanoseconds per call
+        uint64_t over_budget;       // calls that took longer than the signal they produced lasts
+        uint64_t busy_ns;           // total time spent in the call
+    };
+
+    /*
+     * Per-block timing of work() and the message handlers.  Sites are
+     * added in the block's constructor; after that, recording is lock-free,
+     * so the scheduler thread and the message handler threads can record
+     * while someone else asks for the numbers.
+     *
+     * For work(), the caller can pass a budget: how long the samples it
+     * produced (or consumed) take in real time.  A call over budget is one
+     * that, by itself, fell behind the hardware -- the thing to look for
+     * when the sink underruns.
+     *
+     * Every AMPS_PROFILE_INTERVAL seconds (60 by default; 0 turns it off)
+     * the profiler logs a line per site; the dump is done by whichever
+     * thread records first after the interval is up.
+     */
+    class block_profiler {
+        private:
+        const std::string d_block;
+        std::vector<profile_site *> d_sites;
+        uint64_t d_interval_ns;
+        uint64_t d_next_dump_ns;
+
+        void maybe_dump(uint64_t now);
+
+        public:
+        block_profiler(const std::string &block);
+        ~block_profiler();
+
+        int add_site(const std::string &name);
+        void record(int site, uint64_t start_ns, uint64_t end_ns, uint64_t budget_ns = 0);
+        pmt::pmt_t stats() const;
+        pmt::pmt_t query(pmt::pmt_t msg);
+        void dump() const;
+        void reset();
+    };
+
+    /*
+     * Times the enclosing scope against a site:
+     *
+     *     profile_scope prof(d_profiler, d_prof_work);
+     *     ...
+     *     prof.set_budget(produced * 1e9 / rate);
+     */
+    class profile_scope {
+        private:
+        block_profiler &d_profiler;
+        const int d_site;
+        const uint64_t d_start;
+        uint64_t d_budget;
+
+        public:
+        profile_scope(block_profiler &profiler, int site);
+        ~profile_scope();
+        void set_budget(uint64_t budget_ns) { d_budget = budget_ns; }
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_BLOCK_PROFILER_H */
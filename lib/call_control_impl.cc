@@ -0,0 +1,436 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "call_control_impl.h"
+#include "voice_channel_pool.h"
+#include <time.h>
+#include <stdexcept>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    // Everything in milliseconds; 553 3.6.
+    static const uint64_t CALL_SAT_MS = VCHAN_SAT_TIMEOUT * 1000;  // designation -> SAT
+    static const uint64_t CALL_FADE_MS = 5000;          // SAT lost -> release
+    static const uint64_t CALL_RELEASE_MS = 5000;       // release order -> channel free
+    static const uint64_t CALL_ST_RELEASE_MS = 1500;    // ST longer than this is a release (1.8 s), shorter a flash (400 ms)
+
+    static inline uint64_t ms_to_ticks(uint64_t ms) {
+        return (ms + CALL_TICK_MS - 1) / CALL_TICK_MS;
+    }
+
+    call_control::sptr
+    call_control::make(int max_calls, double page_timeout, int page_retries, double alert_timeout) {
+        return gnuradio::get_initial_sptr (new call_control_impl(max_calls, page_timeout, page_retries, alert_timeout));
+    }
+
+    call_control_impl::call_control_impl(int max_calls, double page_timeout, int page_retries, double alert_timeout)
+      : gr::block("call_control",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(0, 0, 0)),
+        d_page_ticks(ms_to_ticks(page_timeout * 1000)), d_page_retries(page_retries),
+        d_alert_ticks(ms_to_ticks(alert_timeout * 1000)),
+        d_free_head(-1), d_finished(false), d_wheel(now_ticks())
+    {
+        if(max_calls < 1) {
+            throw std::invalid_argument("call_control: max_calls must be at least 1");
+        }
+        if(page_timeout <= 0 || alert_timeout <= 0 || page_retries < 0) {
+            throw std::invalid_argument("call_control: timeouts must be positive");
+        }
+        d_calls.resize(max_calls);
+        for(int i = max_calls - 1; i >= 0; i--) {
+            d_calls[i].state = CALL_IDLE;
+            d_calls[i].next_free = d_free_head;
+            d_free_head = i;
+        }
+        d_expired.reserve(256);
+
+        message_port_register_in(pmt::mp("call_events"));
+        set_msg_handler(pmt::mp("call_events"),
+            boost::bind(&call_control_impl::call_events_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("voice_events"));
+        set_msg_handler(pmt::mp("voice_events"),
+            boost::bind(&call_control_impl::voice_events_message, this, _1)
+        );
+        message_port_register_out(pmt::mp("focc_words"));
+        message_port_register_out(pmt::mp("fvc_bank_words"));
+        message_port_register_out(pmt::mp("channel_events"));
+        message_port_register_out(pmt::mp("call_state"));
+    }
+
+    call_control_impl::~call_control_impl()
+    {
+    }
+
+    uint64_t
+    call_control_impl::now_ticks() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t)ts.tv_sec * 1000 + (ts.tv_nsec / 1000000)) / CALL_TICK_MS;
+    }
+
+    bool
+    call_control_impl::start() {
+        d_finished = false;
+        d_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&call_control_impl::run, this)));
+        return block::start();
+    }
+
+    bool
+    call_control_impl::stop() {
+        {
+            boost::mutex::scoped_lock lock(d_inbox_mutex);
+            d_finished = true;
+        }
+        d_inbox_cond.notify_one();
+        if(d_thread) {
+            d_thread->join();
+            d_thread.reset();
+        }
+        return block::stop();
+    }
+
+    /*
+     * The message handlers only queue events; all call state belongs to the
+     * call control thread.
+     */
+    void
+    call_control_impl::post(call_input input, pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            LOG_WARNING("call_control: ignoring event that isn't a dict");
+            return;
+        }
+        {
+            boost::mutex::scoped_lock lock(d_inbox_mutex);
+            d_inbox.push_back(std::make_pair(input, msg));
+        }
+        d_inbox_cond.notify_one();
+    }
+
+    void
+    call_control_impl::call_events_message(pmt::pmt_t msg) {
+        post(CALL_INPUT_CALL, msg);
+    }
+
+    void
+    call_control_impl::voice_events_message(pmt::pmt_t msg) {
+        post(CALL_INPUT_VOICE, msg);
+    }
+
+    /*
+     * Call control thread: wake up once per tick (or as soon as an event
+     * comes in), handle queued events, then run the timer wheel up to now.
+     */
+    void
+    call_control_impl::run() {
+        std::deque<std::pair<call_input, pmt::pmt_t> > events;
+        while(true) {
+            {
+                boost::mutex::scoped_lock lock(d_inbox_mutex);
+                if(d_inbox.empty() && d_finished == false) {
+                    d_inbox_cond.timed_wait(lock, boost::posix_time::milliseconds(CALL_TICK_MS));
+                }
+                if(d_finished) {
+                    break;
+                }
+                events.swap(d_inbox);
+            }
+            const uint64_t now = now_ticks();
+            for(size_t i = 0; i < events.size(); i++) {
+                if(events[i].first == CALL_INPUT_CALL) {
+                    handle_call_event(events[i].second, now);
+                } else {
+                    handle_voice_event(events[i].second, now);
+                }
+            }
+            events.clear();
+
+            d_expired.clear();
+            d_wheel.advance(now, d_expired);
+            for(size_t i = 0; i < d_expired.size(); i++) {
+                const int idx = ((char *)d_expired[i] - (char *)&d_calls[0]) / sizeof(call);
+                handle_timeout(idx, now);
+            }
+        }
+    }
+
+    // Take a call slot for a mobile.  Returns -1 if they're all in use.
+    int
+    call_control_impl::new_call(uint64_t min) {
+        if(d_free_head < 0) {
+            return -1;
+        }
+        const int idx = d_free_head;
+        call &c = d_calls[idx];
+        d_free_head = c.next_free;
+        c.min = min;
+        c.chan = -1;
+        c.scc = GLOBAL_SCC;
+        c.originated = false;
+        c.fading = false;
+        c.repages_left = d_page_retries;
+        c.st_since = 0;
+        c.next_free = -1;
+        d_by_min[min] = idx;
+        return idx;
+    }
+
+    /*
+     * Tear down a call: hand its voice channel back and free the slot.
+     */
+    void
+    call_control_impl::end_call(int idx, const char *reason) {
+        call &c = d_calls[idx];
+        d_wheel.cancel(&c.timer);
+        if(c.chan >= 0) {
+            send_channel_event(c.chan, "release");
+            d_by_chan.erase(c.chan);
+        }
+        c.state = CALL_IDLE;
+        publish_state(c, reason);
+        d_by_min.erase(c.min);
+        c.next_free = d_free_head;
+        d_free_head = idx;
+    }
+
+    // Move to a new state, (re)arming the call's timer if timeout is nonzero.
+    void
+    call_control_impl::enter(int idx, call_state state, uint64_t timeout, const char *event) {
+        call &c = d_calls[idx];
+        c.state = state;
+        c.fading = false;
+        if(timeout > 0) {
+            d_wheel.schedule(&c.timer, timeout);
+        } else {
+            d_wheel.cancel(&c.timer);
+        }
+        publish_state(c, event);
+    }
+
+    void
+    call_control_impl::publish_state(const call &c, const char *event) {
+        pmt::pmt_t msg = pmt::make_dict();
+        msg = pmt::dict_add(msg, pmt::mp("min"), pmt::from_uint64(c.min));
+        msg = pmt::dict_add(msg, pmt::mp("chan"), pmt::from_long(c.chan));
+        msg = pmt::dict_add(msg, pmt::mp("state"), pmt::mp(call_state_name(c.state)));
+        msg = pmt::dict_add(msg, pmt::mp("event"), pmt::mp(event));
+        message_port_pub(pmt::mp("call_state"), msg);
+    }
+
+    // Page Message: Word 1 + Word 2 with SCC = 11
+    void
+    call_control_impl::send_page(const call &c) {
+        unsigned char word1[28], word2[28];
+        focc_word1(word1, true, GLOBAL_DCC_SHORT, c.min & 0xffffff);
+        focc_word2_general(word2, c.min >> 24, 0, 0, ORDER_PAGE);
+        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(STREAM_BOTH), pmt::from_long(2), pmt::mp(word1, 28), pmt::mp(word2, 28));
+        message_port_pub(pmt::mp("focc_words"), tuple);
+    }
+
+    void
+    call_control_impl::send_fvc_order(const call &c, unsigned char order) {
+        unsigned char word1[28];
+        fvc_word1_general(word1, c.scc, 0, 0, order);
+        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(c.chan), pmt::from_long(1), pmt::mp(word1, 28));
+        message_port_pub(pmt::mp("fvc_bank_words"), tuple);
+    }
+
+    void
+    call_control_impl::send_channel_event(int chan, const char *event) {
+        pmt::pmt_t msg = pmt::make_dict();
+        msg = pmt::dict_add(msg, pmt::mp("chan"), pmt::from_long(chan));
+        msg = pmt::dict_add(msg, pmt::mp("event"), pmt::mp(event));
+        message_port_pub(pmt::mp("channel_events"), msg);
+    }
+
+    /*
+     * Events about a mobile, keyed by its packed MIN:
+     *   page          {min}                        the land side paged it
+     *   page_response {min, chan, scc}             it answered; chan is designated
+     *   origination   {min, chan, scc}             it called; chan is designated
+     *   release       {min}                        the land side hung up
+     */
+    void
+    call_control_impl::handle_call_event(pmt::pmt_t msg, uint64_t now) {
+        pmt::pmt_t eventp = pmt::dict_ref(msg, pmt::mp("event"), pmt::PMT_NIL);
+        pmt::pmt_t minp = pmt::dict_ref(msg, pmt::mp("min"), pmt::PMT_NIL);
+        if(pmt::is_symbol(eventp) == false || pmt::is_integer(minp) == false) {
+            LOG_WARNING("call_control: ignoring call event without event/min");
+            return;
+        }
+        const std::string event = pmt::symbol_to_string(eventp);
+        const uint64_t min = pmt::to_uint64(minp);
+        boost::unordered_map<uint64_t, int>::const_iterator it = d_by_min.find(min);
+        int idx = (it == d_by_min.end()) ? -1 : it->second;
+
+        if(event == "page") {
+            if(idx >= 0) {
+                return;         // already paging it, or it's busy
+            }
+            idx = new_call(min);
+            if(idx < 0) {
+                LOG_WARNING("call_control: out of call slots; not tracking page");
+                return;
+            }
+            enter(idx, CALL_PAGING, d_page_ticks, event.c_str());
+        } else if(event == "page_response" || event == "origination") {
+            const int chan = pmt::to_long(pmt::dict_ref(msg, pmt::mp("chan"), pmt::from_long(-1)));
+            if(idx < 0) {
+                idx = new_call(min);
+                if(idx < 0) {
+                    LOG_WARNING("call_control: out of call slots; not tracking %s", event.c_str());
+                    return;
+                }
+            } else if(d_calls[idx].chan >= 0 && d_calls[idx].chan != chan) {
+                // Shouldn't happen: the channel pool hands a mobile back the
+                // channel it already has.
+                d_by_chan.erase(d_calls[idx].chan);
+            }
+            call &c = d_calls[idx];
+            c.chan = chan;
+            c.scc = pmt::to_long(pmt::dict_ref(msg, pmt::mp("scc"), pmt::from_long(GLOBAL_SCC)));
+            c.originated = (event == "origination");
+            if(chan >= 0) {
+                d_by_chan[chan] = idx;
+            }
+            enter(idx, CALL_AWAIT_SAT, ms_to_ticks(CALL_SAT_MS), event.c_str());
+        } else if(event == "release") {
+            if(idx < 0) {
+                return;
+            }
+            call &c = d_calls[idx];
+            if(c.chan >= 0 && (c.state == CALL_ALERTING || c.state == CALL_CONVERSATION)) {
+                send_fvc_order(c, ORDER_RELEASE);
+                enter(idx, CALL_RELEASE, ms_to_ticks(CALL_RELEASE_MS), event.c_str());
+            } else {
+                end_call(idx, event.c_str());
+            }
+        } else {
+            LOG_WARNING("call_control: unknown call event %s", event.c_str());
+        }
+    }
+
+    /*
+     * SAT/ST events from the RVC Supervision block, keyed by voice channel.
+     */
+    void
+    call_control_impl::handle_voice_event(pmt::pmt_t msg, uint64_t now) {
+        pmt::pmt_t chanp = pmt::dict_ref(msg, pmt::mp("chan"), pmt::PMT_NIL);
+        pmt::pmt_t eventp = pmt::dict_ref(msg, pmt::mp("event"), pmt::PMT_NIL);
+        if(pmt::is_integer(chanp) == false || pmt::is_symbol(eventp) == false) {
+            LOG_WARNING("call_control: ignoring voice event without chan/event");
+            return;
+        }
+        boost::unordered_map<int, int>::const_iterator it = d_by_chan.find(pmt::to_long(chanp));
+        if(it == d_by_chan.end()) {
+            return;             // nobody's call
+        }
+        const int idx = it->second;
+        call &c = d_calls[idx];
+        const std::string event = pmt::symbol_to_string(eventp);
+
+        if(event == "sat_detected") {
+            if(c.state == CALL_AWAIT_SAT) {
+                send_channel_event(c.chan, "sat_detected");
+                if(c.originated) {
+                    enter(idx, CALL_CONVERSATION, 0, "connected");
+                } else {
+                    enter(idx, CALL_ALERTING, d_alert_ticks, "alerting");
+                }
+            } else if(c.fading) {
+                enter(idx, c.state, (c.state == CALL_ALERTING) ? d_alert_ticks : 0, "sat_regained");
+            }
+        } else if(event == "sat_lost") {
+            if(c.state == CALL_CONVERSATION || c.state == CALL_ALERTING) {
+                // Fade timer: the mobile has 5 s to come back.
+                d_wheel.schedule(&c.timer, ms_to_ticks(CALL_FADE_MS));
+                c.fading = true;
+                publish_state(c, "fade");
+            } else if(c.state == CALL_RELEASE) {
+                end_call(idx, "released");
+            }
+        } else if(event == "st_on") {
+            c.st_since = now;
+        } else if(event == "st_off") {
+            const uint64_t st_ms = (c.st_since == 0) ? 0 : (now - c.st_since) * CALL_TICK_MS;
+            c.st_since = 0;
+            if(c.state == CALL_ALERTING) {
+                // The mobile sends ST while alerting and drops it on answer.
+                enter(idx, CALL_CONVERSATION, 0, "answered");
+            } else if(c.state == CALL_CONVERSATION) {
+                if(st_ms >= CALL_ST_RELEASE_MS) {
+                    end_call(idx, "mobile_release");
+                } else {
+                    publish_state(c, "flash");
+                }
+            } else if(c.state == CALL_RELEASE) {
+                // Release confirmed with ST.
+                end_call(idx, "released");
+            }
+        }
+    }
+
+    void
+    call_control_impl::handle_timeout(int idx, uint64_t now) {
+        call &c = d_calls[idx];
+        if(c.fading) {
+            end_call(idx, "fade_timeout");
+            return;
+        }
+        switch(c.state) {
+            case CALL_PAGING:
+                if(c.repages_left > 0) {
+                    c.repages_left--;
+                    send_page(c);
+                    enter(idx, CALL_PAGING, d_page_ticks, "repage");
+                } else {
+                    end_call(idx, "page_timeout");
+                }
+                break;
+            case CALL_AWAIT_SAT:
+                end_call(idx, "no_sat");
+                break;
+            case CALL_ALERTING:
+                send_fvc_order(c, ORDER_RELEASE);
+                enter(idx, CALL_RELEASE, ms_to_ticks(CALL_RELEASE_MS), "no_answer");
+                break;
+            case CALL_RELEASE:
+                end_call(idx, "release_timeout");
+                break;
+            case CALL_CONVERSATION:
+            case CALL_IDLE:
+                break;
+        }
+    }
+
+    const char *call_state_name(call_state state) {
+        switch(state) {
+            case CALL_IDLE:
+                return "idle";
+            case CALL_PAGING:
+                return "paging";
+            case CALL_AWAIT_SAT:
+                return "await_sat";
+            case CALL_ALERTING:
+                return "alerting";
+            case CALL_CONVERSATION:
+                return "conversation";
+            case CALL_RELEASE:
+                return "release";
+        }
+        return "unknown";
+    }
+
+  } /* namespace amps */
+} /* namespace gr */
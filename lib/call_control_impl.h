@@ -0,0 +1,114 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_CALL_CONTROL_IMPL_H
+#define INCLUDED_AMPS_CALL_CONTROL_IMPL_H
+
+#include <amps/call_control.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/unordered_map.hpp>
+#include <deque>
+#include <string>
+#include <vector>
+#include "amps_packet.h"
+#include "timer_wheel.h"
+
+namespace gr {
+  namespace amps {
+
+    // Timer resolution.
+    static const uint64_t CALL_TICK_MS = 10;
+
+    enum call_state {
+        CALL_IDLE = 0,          // slot not in use
+        CALL_PAGING,            // page sent; waiting for the page response
+        CALL_AWAIT_SAT,         // voice channel designated; waiting for the mobile's SAT
+        CALL_ALERTING,          // alert order sent; waiting for the mobile to answer
+        CALL_CONVERSATION,
+        CALL_RELEASE            // release order sent; waiting for the mobile to go away
+    };
+
+    /*
+     * One transaction.  Calls live in a fixed array (so their embedded
+     * timers never move) and are found by MIN or by voice channel.
+     */
+    struct call {
+        uint64_t min;           // packed MIN
+        call_state state;
+        int chan;               // voice channel (pool index), or -1
+        unsigned char scc;      // SAT color code of chan
+        bool originated;        // mobile-originated (no alerting)
+        bool fading;            // SAT lost; the timer is the fade timer
+        int repages_left;
+        uint64_t st_since;      // tick the mobile's ST came on, 0 if off
+        wheel_timer timer;      // the one timer that's running in every state
+        int next_free;
+    };
+
+    enum call_input {
+        CALL_INPUT_CALL,        // from call_events
+        CALL_INPUT_VOICE        // from voice_events
+    };
+
+    class call_control_impl : public call_control
+    {
+    private:
+        const uint64_t d_page_ticks;
+        const int d_page_retries;
+        const uint64_t d_alert_ticks;
+
+        std::vector<call> d_calls;
+        int d_free_head;
+        boost::unordered_map<uint64_t, int> d_by_min;
+        boost::unordered_map<int, int> d_by_chan;
+
+        // Everything below is shared between the message handlers and the
+        // call control thread.
+        boost::mutex d_inbox_mutex;
+        boost::condition_variable d_inbox_cond;
+        std::deque<std::pair<call_input, pmt::pmt_t> > d_inbox;
+        bool d_finished;
+        boost::shared_ptr<boost::thread> d_thread;
+
+        // Owned by the call control thread.
+        timer_wheel d_wheel;
+        std::vector<wheel_timer *> d_expired;
+
+        static uint64_t now_ticks();
+        void run();
+        void post(call_input input, pmt::pmt_t msg);
+
+        int new_call(uint64_t min);
+        void end_call(int idx, const char *reason);
+        void enter(int idx, call_state state, uint64_t timeout, const char *event);
+        void publish_state(const call &c, const char *event);
+        void send_page(const call &c);
+        void send_fvc_order(const call &c, unsigned char order);
+        void send_channel_event(int chan, const char *event);
+
+        void handle_call_event(pmt::pmt_t msg, uint64_t now);
+        void handle_voice_event(pmt::pmt_t msg, uint64_t now);
+        void handle_timeout(int idx, uint64_t now);
+
+    public:
+        call_control_impl(int max_calls, double page_timeout, int page_retries, double alert_timeout);
+        ~call_control_impl();
+
+        bool start();
+        bool stop();
+
+        void call_events_message(pmt::pmt_t msg);
+        void voice_events_message(pmt::pmt_t msg);
+    };
+
+    const char *call_state_name(call_state state);
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_CALL_CONTROL_IMPL_H */
@@ -0,0 +1,206 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "carrier_synth_impl.h"
+#include <math.h>
+#include <string.h>
+#include <stdexcept>
+#include "utils.h"
+
+using std::vector;
+
+namespace gr {
+    namespace amps {
+
+        carrier_synth::sptr
+        carrier_synth::make(double samp_rate, int fft_size, const vector<int> &bins, int taps_per_phase, float gain) {
+            return gnuradio::get_initial_sptr (new carrier_synth_impl(samp_rate, fft_size, bins, taps_per_phase, gain));
+        }
+
+        carrier_synth_impl::carrier_synth_impl(double samp_rate, int fft_size, const vector<int> &bins,
+                int taps_per_phase, float gain)
+          : sync_interpolator("carrier_synth",
+                  io_signature::make(bins.size(), bins.size(), sizeof (gr_complex)),
+                  io_signature::make(1, 1, sizeof (gr_complex)), fft_size / 2),
+          d_samp_rate(samp_rate), d_fft_size(fft_size), d_interp(fft_size / 2), d_ntaps(taps_per_phase),
+          d_bins(bins), d_work_bins(bins), d_bins_changed(false), d_hist_pos(0), d_odd(false),
+          d_profiler("carrier_synth"), d_prof_work(d_profiler.add_site("work"))
+        {
+            if(samp_rate <= 0) {
+                throw std::invalid_argument("carrier_synth: samp_rate must be positive");
+            }
+            if(fft_size < 2 || (fft_size % 2) != 0) {
+                throw std::invalid_argument("carrier_synth: fft_size must be even");
+            }
+            if(taps_per_phase < 1) {
+                throw std::invalid_argument("carrier_synth: need at least one tap per phase");
+            }
+            if(bins.empty()) {
+                throw std::invalid_argument("carrier_synth: need at least one port");
+            }
+            for(size_t p = 0; p < bins.size(); p++) {
+                if(bins[p] >= fft_size) {
+                    throw std::invalid_argument("carrier_synth: bin out of range");
+                }
+            }
+            design_taps(gain);
+            d_hist.assign(d_ntaps * d_fft_size, gr_complex(0, 0));
+            d_spectrum.set_size(d_fft_size);
+            d_branch.set_size(d_fft_size);
+            LOG_DEBUG("carrier synthesizer: %d ports, %d bins of %.0f Hz, %d taps",
+                    (int)bins.size(), d_fft_size, d_samp_rate / d_fft_size, d_ntaps * d_interp);
+
+            message_port_register_in(pmt::mp("channels"));
+            set_msg_handler(pmt::mp("channels"),
+                boost::bind(&carrier_synth_impl::channels_message, this, _1)
+            );
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&carrier_synth_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
+        }
+
+        carrier_synth_impl::~carrier_synth_impl()
+        {
+        }
+
+        /*
+         * Blackman-windowed sinc prototype, at the output rate.  Each input
+         * runs at twice the spacing, so a carrier's first image is two bins
+         * away: passing +/- half a bin and stopping everything past a bin
+         * and a half is enough, and the cutoff goes halfway, at one bin.
+         * The DC gain is d_interp (to make up for the zeroes interpolation
+         * puts in), times the carrier gain, times d_fft_size (to undo
+         * itpp::ifft's normalization).  The taps are stored by phase.
+         */
+        void carrier_synth_impl::design_taps(float gain) {
+            const int ntaps = d_ntaps * d_interp;
+            const double fc = 1.0 / d_fft_size;
+            const double mid = (ntaps - 1) / 2.0;
+            vector<double> h(ntaps);
+            double sum = 0;
+            for(int i = 0; i < ntaps; i++) {
+                const double x = i - mid;
+                const double sinc = (x == 0) ? 2 * fc : sin(2 * M_PI * fc * x) / (M_PI * x);
+                const double w = (ntaps == 1) ? 1.0 : 0.42 - (0.5 * cos((2 * M_PI * i) / (ntaps - 1)))
+                    + (0.08 * cos((4 * M_PI * i) / (ntaps - 1)));
+                h[i] = sinc * w;
+                sum += h[i];
+            }
+            const double scale = (d_interp * gain * d_fft_size) / sum;
+            d_taps.resize(ntaps);
+            for(int phase = 0; phase < d_interp; phase++) {
+                for(int i = 0; i < d_ntaps; i++) {
+                    d_taps[(phase * d_ntaps) + i] = h[(i * d_interp) + phase] * scale;
+                }
+            }
+        }
+
+        /*
+         * Move a port to another bin, or switch it off: a dict with "port"
+         * and "bin" (negative for off).
+         */
+        void carrier_synth_impl::channels_message(pmt::pmt_t msg) {
+            if(pmt::is_dict(msg) == false) {
+                LOG_WARNING("carrier synthesizer: channels message isn't a dict");
+                return;
+            }
+            pmt::pmt_t port = pmt::dict_ref(msg, pmt::mp("port"), pmt::PMT_NIL);
+            pmt::pmt_t bin = pmt::dict_ref(msg, pmt::mp("bin"), pmt::PMT_NIL);
+            if(pmt::is_integer(port) == false || pmt::is_integer(bin) == false) {
+                LOG_WARNING("carrier synthesizer: channels message needs an integer port and bin");
+                return;
+            }
+            const long p = pmt::to_long(port);
+            const long b = pmt::to_long(bin);
+            boost::mutex::scoped_lock lock(d_bins_mutex);
+            if(p < 0 || p >= (long)d_bins.size() || b >= d_fft_size) {
+                LOG_WARNING("carrier synthesizer: port %ld or bin %ld out of range", p, b);
+                return;
+            }
+            d_bins[p] = (b < 0) ? -1 : b;
+            d_bins_changed = true;
+            if(b < 0) {
+                LOG_INFO("carrier synthesizer: port %ld off", p);
+            } else {
+                LOG_INFO("carrier synthesizer: port %ld on bin %ld", p, b);
+            }
+        }
+
+        void carrier_synth_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+        }
+
+        /*
+         * For each input sample: put every active port's sample in its bin,
+         * inverse FFT, and run the result through the prototype's phases to
+         * get d_interp output samples.  With the input at twice the spacing,
+         * each output sample is a whole number of bins' worth of half
+         * cycles further along than the one d_interp before it, so odd bins
+         * change sign on odd input samples, and a filter branch reaches
+         * d_interp FFT outputs further into every other history row.
+         */
+        int
+        carrier_synth_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            gr_complex *out = (gr_complex *) output_items[0];
+            profile_scope prof(d_profiler, d_prof_work);
+            prof.set_budget((noutput_items * 1e9) / d_samp_rate);
+            {
+                boost::mutex::scoped_lock lock(d_bins_mutex);
+                if(d_bins_changed) {
+                    d_work_bins = d_bins;
+                    d_bins_changed = false;
+                }
+            }
+
+            const int ninput = noutput_items / d_interp;
+            const int nports = d_work_bins.size();
+            for(int n = 0; n < ninput; n++) {
+                d_spectrum.zeros();
+                for(int p = 0; p < nports; p++) {
+                    const int bin = d_work_bins[p];
+                    if(bin < 0) {
+                        continue;
+                    }
+                    const gr_complex x = ((const gr_complex *) input_items[p])[n];
+                    const std::complex<double> v(x.real(), x.imag());
+                    d_spectrum[bin] += (d_odd && (bin & 1)) ? -v : v;
+                }
+                itpp::ifft(d_spectrum, d_branch);
+
+                d_hist_pos = (d_hist_pos + 1) % d_ntaps;
+                gr_complex *row = &d_hist[d_hist_pos * d_fft_size];
+                for(int m = 0; m < d_fft_size; m++) {
+                    row[m] = gr_complex(d_branch[m].real(), d_branch[m].imag());
+                }
+
+                gr_complex *o = &out[n * d_interp];
+                for(int phase = 0; phase < d_interp; phase++) {
+                    const float *taps = &d_taps[phase * d_ntaps];
+                    gr_complex acc(0, 0);
+                    int pos = d_hist_pos;
+                    for(int i = 0; i < d_ntaps; i++) {
+                        const int idx = phase + ((i & 1) ? d_interp : 0);
+                        acc += taps[i] * d_hist[(pos * d_fft_size) + idx];
+                        pos = (pos == 0) ? (d_ntaps - 1) : (pos - 1);
+                    }
+                    o[phase] = acc;
+                }
+                d_odd = !d_odd;
+            }
+            return ninput * d_interp;
+        }
+
+    } /* namespace amps */
+} /* namespace gr */
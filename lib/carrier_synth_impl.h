@@ -0,0 +1,66 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_CARRIER_SYNTH_IMPL_H
+#define INCLUDED_AMPS_CARRIER_SYNTH_IMPL_H
+
+#include <amps/carrier_synth.h>
+#include <boost/thread/mutex.hpp>
+#include <itpp/signal/transforms.h>
+#include <vector>
+#include "amps_common.h"
+#include "block_profiler.h"
+
+namespace gr {
+  namespace amps {
+
+    class carrier_synth_impl : public carrier_synth
+    {
+    private:
+        const double d_samp_rate;
+        const int d_fft_size;
+        const int d_interp;             // output samples per input sample: fft_size / 2
+        const int d_ntaps;              // taps per phase
+
+        // Port -> bin.  The handler changes d_bins; work() picks the
+        // change up at its next call.
+        std::vector<int> d_bins;
+        std::vector<int> d_work_bins;
+        bool d_bins_changed;
+        boost::mutex d_bins_mutex;
+
+        // d_taps[(phase * d_ntaps) + i] is prototype tap (i * d_interp) + phase.
+        std::vector<float> d_taps;
+
+        // The last d_ntaps inverse FFTs, newest at d_hist_pos.
+        std::vector<gr_complex> d_hist;
+        int d_hist_pos;
+        bool d_odd;                     // input sample count is odd
+        itpp::cvec d_spectrum;
+        itpp::cvec d_branch;
+
+        // work() timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+
+        void design_taps(float gain);
+
+    public:
+        carrier_synth_impl(double samp_rate, int fft_size, const std::vector<int> &bins,
+                int taps_per_phase, float gain);
+        ~carrier_synth_impl();
+
+        void channels_message(pmt::pmt_t msg);
+        void profile_query_message(pmt::pmt_t msg);
+        int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_CARRIER_SYNTH_IMPL_H */
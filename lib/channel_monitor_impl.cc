@@ -0,0 +1,218 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "channel_monitor_impl.h"
+#include <math.h>
+#include <stdexcept>
+#include <algorithm>
+#include "utils.h"
+
+using std::vector;
+
+namespace gr {
+    namespace amps {
+
+        static const double MONITOR_SPACING_HZ = 30000.0;
+        static const double MONITOR_HALF_WIDTH_HZ = 12500.0;
+        static const double MONITOR_SAT_HZ = 6000.0;
+
+        channel_monitor::sptr
+        channel_monitor::make(double samp_rate, int center_chan, int first_chan, int nchans,
+                int fft_size, int average, double interval, float threshold_db, float sat_margin_db) {
+            return gnuradio::get_initial_sptr (new channel_monitor_impl(samp_rate, center_chan, first_chan, nchans,
+                        fft_size, average, interval, threshold_db, sat_margin_db));
+        }
+
+        channel_monitor_impl::channel_monitor_impl(double samp_rate, int center_chan, int first_chan, int nchans,
+                int fft_size, int average, double interval, float threshold_db, float sat_margin_db)
+          : sync_block("channel_monitor",
+                  io_signature::make(1, 1, sizeof (gr_complex)),
+                  io_signature::make(0, 0, 0)),
+          d_samp_rate(samp_rate), d_first_chan(first_chan), d_nchans(nchans), d_fft_size(fft_size),
+          d_average(average), d_interval_samples((uint64_t)(interval * samp_rate)), d_threshold_db(threshold_db),
+          d_sat_margin(pow(10.0, sat_margin_db / 10.0)), d_see_sat(false), d_norm(0), d_frame_fill(0),
+          d_nffts(0), d_interval_pos(0), d_profiler("channel_monitor"), d_prof_work(d_profiler.add_site("work"))
+        {
+            if(samp_rate <= 0) {
+                throw std::invalid_argument("channel_monitor: samp_rate must be positive");
+            }
+            if(nchans < 1) {
+                throw std::invalid_argument("channel_monitor: need at least one channel");
+            }
+            if(fft_size < 16) {
+                throw std::invalid_argument("channel_monitor: fft_size must be at least 16");
+            }
+            if(average < 1 || ((uint64_t)average * fft_size) > d_interval_samples) {
+                throw std::invalid_argument("channel_monitor: the FFTs to average must fit in the interval");
+            }
+            const double bin_hz = samp_rate / fft_size;
+            for(int c = 0; c < nchans; c++) {
+                const double offset = (first_chan + c - center_chan) * MONITOR_SPACING_HZ;
+                if(fabs(offset) + MONITOR_HALF_WIDTH_HZ > samp_rate / 2) {
+                    throw std::invalid_argument("channel_monitor: channel outside the input's bandwidth");
+                }
+                monitor_chan mc;
+                const int lo = (int)ceil((offset - MONITOR_HALF_WIDTH_HZ) / bin_hz);
+                const int hi = (int)floor((offset + MONITOR_HALF_WIDTH_HZ) / bin_hz);
+                for(int k = lo; k <= hi; k++) {
+                    mc.bins.push_back(freq_bin(k * bin_hz));
+                }
+                if(mc.bins.empty()) {
+                    throw std::invalid_argument("channel_monitor: fft_size too small to resolve a channel");
+                }
+                mc.sat_bins[0] = freq_bin(offset - MONITOR_SAT_HZ);
+                mc.sat_bins[1] = freq_bin(offset + MONITOR_SAT_HZ);
+                mc.ref_bins[0] = freq_bin(offset - (1.5 * MONITOR_SAT_HZ));
+                mc.ref_bins[1] = freq_bin(offset - (0.5 * MONITOR_SAT_HZ));
+                mc.ref_bins[2] = freq_bin(offset + (0.5 * MONITOR_SAT_HZ));
+                mc.ref_bins[3] = freq_bin(offset + (1.5 * MONITOR_SAT_HZ));
+                d_chans.push_back(mc);
+            }
+            // The SAT sidebands have to land in a different bin than the
+            // carrier and the reference points on either side of them.
+            d_see_sat = (bin_hz <= (0.5 * MONITOR_SAT_HZ));
+            if(d_see_sat == false) {
+                LOG_WARNING("channel monitor: %.0f Hz bins are too wide to see SAT; only power will be reported", bin_hz);
+            }
+
+            // Hann window.  A bin sum times d_norm is the band's mean-square
+            // power, averaged over the FFTs.
+            d_window.resize(fft_size);
+            double wsq = 0;
+            for(int i = 0; i < fft_size; i++) {
+                d_window[i] = 0.5 - (0.5 * cos((2 * M_PI * i) / fft_size));
+                wsq += d_window[i] * d_window[i];
+            }
+            d_norm = 1.0 / (fft_size * wsq * average);
+            d_frame.set_size(fft_size);
+            d_spectrum.set_size(fft_size);
+            d_accum.assign(fft_size, 0.0);
+
+            message_port_register_out(pmt::mp("occupancy"));
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&channel_monitor_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
+        }
+
+        channel_monitor_impl::~channel_monitor_impl()
+        {
+        }
+
+        // FFT bin nearest to the given offset from the center frequency.
+        int channel_monitor_impl::freq_bin(double offset_hz) const {
+            const int k = (int)lround(offset_hz * d_fft_size / d_samp_rate);
+            return ((k % d_fft_size) + d_fft_size) % d_fft_size;
+        }
+
+        void channel_monitor_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+        }
+
+        /*
+         * Transform the frame just filled and add its power spectrum to the
+         * running sum.  The sum is a flat loop over plain arrays, so the
+         * compiler can vectorize it.
+         */
+        void channel_monitor_impl::transform() {
+            itpp::fft(d_frame, d_spectrum);
+            const double *s = reinterpret_cast<const double *>(d_spectrum._data());
+            float *acc = &d_accum[0];
+            for(int k = 0; k < d_fft_size; k++) {
+                acc[k] += (s[2*k] * s[2*k]) + (s[(2*k)+1] * s[(2*k)+1]);
+            }
+        }
+
+        /*
+         * The interval's FFTs are done: work out each channel's power and
+         * SAT from the averaged spectrum and post them.
+         */
+        void channel_monitor_impl::report() {
+            vector<float> power_db(d_nchans);
+            vector<uint8_t> busy(d_nchans, 0);
+            vector<uint8_t> sat(d_nchans, 0);
+            int nbusy = 0;
+            for(int c = 0; c < d_nchans; c++) {
+                const monitor_chan &mc = d_chans[c];
+                double p = 0;
+                for(size_t i = 0; i < mc.bins.size(); i++) {
+                    p += d_accum[mc.bins[i]];
+                }
+                power_db[c] = 10.0 * log10((p * d_norm) + 1e-20);
+                if(power_db[c] <= d_threshold_db) {
+                    continue;
+                }
+                busy[c] = 1;
+                nbusy++;
+                if(d_see_sat) {
+                    const double side = (d_accum[mc.sat_bins[0]] + d_accum[mc.sat_bins[1]]) / 2;
+                    double ref = 0;
+                    for(int i = 0; i < 4; i++) {
+                        ref += d_accum[mc.ref_bins[i]];
+                    }
+                    sat[c] = (side > (ref / 4) * d_sat_margin) ? 1 : 0;
+                }
+            }
+            std::fill(d_accum.begin(), d_accum.end(), 0.0);
+
+            pmt::pmt_t d = pmt::make_dict();
+            d = pmt::dict_add(d, pmt::mp("first_chan"), pmt::from_long(d_first_chan));
+            d = pmt::dict_add(d, pmt::mp("power_db"), pmt::init_f32vector(d_nchans, &power_db[0]));
+            d = pmt::dict_add(d, pmt::mp("busy"), pmt::init_u8vector(d_nchans, &busy[0]));
+            d = pmt::dict_add(d, pmt::mp("sat"), pmt::init_u8vector(d_nchans, &sat[0]));
+            d = pmt::dict_add(d, pmt::mp("time_ns"), pmt::from_uint64(monotonic_ns()));
+            message_port_pub(pmt::mp("occupancy"), d);
+            LOG_DEBUG("channel monitor: %d of %d channels busy", nbusy, d_nchans);
+        }
+
+        int
+        channel_monitor_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            const gr_complex *in = (const gr_complex *) input_items[0];
+            profile_scope prof(d_profiler, d_prof_work);
+            prof.set_budget((noutput_items * 1e9) / d_samp_rate);
+
+            int i = 0;
+            while(i < noutput_items) {
+                int n;
+                if(d_nffts < d_average) {
+                    n = MIN(noutput_items - i, d_fft_size - d_frame_fill);
+                    for(int j = 0; j < n; j++) {
+                        const float w = d_window[d_frame_fill + j];
+                        d_frame[d_frame_fill + j] = std::complex<double>(in[i+j].real() * w, in[i+j].imag() * w);
+                    }
+                    d_frame_fill += n;
+                    if(d_frame_fill == d_fft_size) {
+                        transform();
+                        d_frame_fill = 0;
+                        d_nffts++;
+                        if(d_nffts == d_average) {
+                            report();
+                        }
+                    }
+                } else {
+                    // Averaged enough for this interval; skip to the next.
+                    n = (int)MIN((uint64_t)(noutput_items - i), d_interval_samples - d_interval_pos);
+                }
+                i += n;
+                d_interval_pos += n;
+                if(d_interval_pos >= d_interval_samples) {
+                    d_interval_pos = 0;
+                    d_nffts = 0;
+                }
+            }
+            return noutput_items;
+        }
+
+    } /* namespace amps */
+} /* namespace gr */
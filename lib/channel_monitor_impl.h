@@ -0,0 +1,79 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_CHANNEL_MONITOR_IMPL_H
+#define INCLUDED_AMPS_CHANNEL_MONITOR_IMPL_H
+
+#include <amps/channel_monitor.h>
+#include <itpp/signal/transforms.h>
+#include <vector>
+#include "amps_common.h"
+#include "block_profiler.h"
+
+#ifndef MIN
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#endif /* MIN */
+
+namespace gr {
+  namespace amps {
+
+    // Where a channel's energy is found in the spectrum, as FFT bins.
+    struct monitor_chan {
+        std::vector<int> bins;      // within +/- 12.5 kHz of the carrier
+        int sat_bins[2];            // nearest the SAT sidebands, +/- 6 kHz
+        int ref_bins[4];            // between and past them, +/- 3 and 9 kHz
+    };
+
+    class channel_monitor_impl : public channel_monitor
+    {
+    private:
+        const double d_samp_rate;
+        const int d_first_chan;
+        const int d_nchans;
+        const int d_fft_size;
+        const int d_average;
+        const uint64_t d_interval_samples;
+        const float d_threshold_db;
+        const float d_sat_margin;       // power ratio
+        bool d_see_sat;                 // bins are narrow enough to resolve SAT
+
+        std::vector<monitor_chan> d_chans;
+        std::vector<float> d_window;
+        float d_norm;                   // turns a bin sum into mean-square power
+
+        // The spectrum being built: the first d_average frames of every
+        // interval are transformed and their power summed into d_accum; the
+        // rest of the interval is skipped.
+        itpp::cvec d_frame;
+        itpp::cvec d_spectrum;
+        std::vector<float> d_accum;
+        int d_frame_fill;
+        int d_nffts;
+        uint64_t d_interval_pos;        // samples into the current interval
+
+        // work() timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+
+        int freq_bin(double offset_hz) const;
+        void transform();
+        void report();
+
+    public:
+        channel_monitor_impl(double samp_rate, int center_chan, int first_chan, int nchans,
+                int fft_size, int average, double interval, float threshold_db, float sat_margin_db);
+        ~channel_monitor_impl();
+
+        void profile_query_message(pmt::pmt_t msg);
+        int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_CHANNEL_MONITOR_IMPL_H */
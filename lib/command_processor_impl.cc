@@ -14,6 +14,9 @@
 #include "amps_packet.h"
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/trim.hpp>
+#include <string.h>
+#include <time.h>
+#include <stdexcept>
 #include "utils.h"
 
 using namespace std;
@@ -23,21 +26,29 @@ namespace gr {
   namespace amps {
 
     command_processor::sptr
-    command_processor::make()
+    command_processor::make(const std::string &registry_path, int max_silence)
     {
       return gnuradio::get_initial_sptr
-        (new command_processor_impl());
+        (new command_processor_impl(registry_path, max_silence));
     }
 
     /*
      * The private constructor
      */
-    command_processor_impl::command_processor_impl()
-      : bch(63, 2, true),
-      gr::block("command_processor",
+    command_processor_impl::command_processor_impl(const std::string &registry_path, int max_silence)
+      : gr::block("command_processor",
               gr::io_signature::make(0, 0, 0),
-              gr::io_signature::make(0, 0, 0))
+              gr::io_signature::make(0, 0, 0)),
+      bch(63, 2, true), d_max_silence(max_silence),
+      d_profiler("command_processor"), d_prof_commands(d_profiler.add_site("commands_message"))
     {
+        if(max_silence < 0) {
+            throw std::invalid_argument("command_processor: max_silence must not be negative");
+        }
+        // Without a registry, every page goes out.
+        if(registry_path.empty() == false) {
+            d_registry = subscriber_registry::open(registry_path);
+        }
         message_port_register_in(pmt::mp("commands"));
 	  	set_msg_handler(pmt::mp("commands"),
 			boost::bind(&command_processor_impl::commands_message, this, _1)
@@ -47,6 +58,13 @@ namespace gr {
         message_port_register_out(pmt::mp("fvc_words"));
         message_port_register_out(pmt::mp("audio_mute"));
         message_port_register_out(pmt::mp("fvc_mute"));
+        message_port_register_out(pmt::mp("results"));
+        message_port_register_out(pmt::mp("call_events"));
+        message_port_register_in(pmt::mp("profile_query"));
+        set_msg_handler(pmt::mp("profile_query"),
+            boost::bind(&command_processor_impl::profile_query_message, this, _1)
+        );
+        message_port_register_out(pmt::mp("profile"));
     }
 
     void command_processor_impl::debug_msg(const char *msg) {
@@ -55,22 +73,39 @@ namespace gr {
 
     }
 
-    void command_processor_impl::handle_page(const std::string numstr) {
-        std::cout << "XXX paging: *" << numstr << "*" << std::endl;
+    /*
+     * Page the given MIN.  If there's a subscriber registry, MINs that never
+     * registered -- or haven't been heard from in max_silence seconds --
+     * aren't worth the FOCC time and are skipped.
+     *
+     * Returns CMD_OK, or the reason the page wasn't sent.
+     */
+    uint8_t command_processor_impl::handle_page(const std::string numstr) {
         if(numstr.length() < 1) {
             debug_msg("missing MIN in page command\n");
-            return;
+            return CMD_BAD_ARGUMENT;
         }
-        debug_msg("paging!\n");
         unsigned char word1[28], word2[28];
         u_int64_t min1, min2;
 
         if(parse_min(numstr, min1, min2) == false) {
             debug_msg("invalid MIN entered");
-            return;
+            return CMD_BAD_ARGUMENT;
         }
-        std::string XXXtestmin = calc_min(min1, min2);
-        LOG_DEBUG("XXX min *%s* *%s*", numstr.c_str(), XXXtestmin.c_str());
+        if(d_registry) {
+            subscriber_record rec;
+            if(d_registry->lookup(pack_min(min1, min2), rec) == false || (rec.flags & SUBSCRIBER_REGISTERED) == 0) {
+                LOG_DEBUG("not paging unregistered MIN %s", numstr.c_str());
+                debug_msg("MIN not registered; not paging\n");
+                return CMD_NOT_REGISTERED;
+            }
+            if(d_max_silence > 0 && (time(NULL) - rec.last_seen) > d_max_silence) {
+                LOG_DEBUG("not paging MIN %s: last heard from %lld s ago", numstr.c_str(), (long long)(time(NULL) - rec.last_seen));
+                debug_msg("MIN silent too long; not paging\n");
+                return CMD_NOT_REGISTERED;
+            }
+        }
+        LOG_DEBUG("paging MIN %s", numstr.c_str());
 
         // sending a Page Message: Word 1 + Word 2 with SCC = 11
         focc_word1(word1, true, GLOBAL_DCC_SHORT, min1);
@@ -79,43 +114,186 @@ namespace gr {
 
         pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(stream), pmt::from_long(2), pmt::mp(word1, 28), pmt::mp(word2, 28));
         message_port_pub(pmt::mp("focc_words"), tuple);
+
+        pmt::pmt_t event = pmt::make_dict();
+        event = pmt::dict_add(event, pmt::mp("event"), pmt::mp("page"));
+        event = pmt::dict_add(event, pmt::mp("min"), pmt::from_uint64(pack_min(min1, min2)));
+        message_port_pub(pmt::mp("call_events"), event);
+        return CMD_OK;
     }
 
-    void command_processor_impl::commands_message(pmt::pmt_t msg) {
-        pmt::pmt_t cmdvec = cdr(msg);
-        if(is_u8vector(cmdvec) == false) {
-            std::cout << "XXX command proc: got invalid message: " << msg << std::endl;
-            return;
-        }
-        const std::vector<uint8_t> cmdchars = u8vector_elements(cmdvec);
-        char carray[cmdchars.size()+1];
-        memset(carray, 0, cmdchars.size()+1);
-        for(size_t i = 0; i < cmdchars.size(); i++) {
-            carray[i] = cmdchars[i];
-        }
-        std::string cmdstr(carray);
+    void command_processor_impl::set_fvc_data(bool on) {
+        message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(!on));
+        message_port_pub(pmt::mp("audio_mute"), pmt::from_bool(on));
+    }
+
+    void command_processor_impl::fvc_alert() {
+        unsigned char word1[28];
+        fvc_word1_general(word1, GLOBAL_SCC, 0, 0, 1);
+        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(1), pmt::mp(word1, 28));
+        message_port_pub(pmt::mp("fvc_words"), tuple);
+    }
+
+    void command_processor_impl::handle_text_command(const std::string &cmdstr) {
         if(boost::starts_with(cmdstr, "fvc off")) {
-            message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(true));
-            message_port_pub(pmt::mp("audio_mute"), pmt::from_bool(false));
+            set_fvc_data(false);
             debug_msg("turning FVC data OFF; audio ON\n");
         } else if(boost::starts_with(cmdstr, "fvc on")) {
-            message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(false));
-            message_port_pub(pmt::mp("audio_mute"), pmt::from_bool(true));
+            set_fvc_data(true);
             debug_msg("turning FVC data ON; audio OFF\n");
         } else if(boost::starts_with(cmdstr, "fvc alert")) {
-            unsigned char word1[28];
-            fvc_word1_general(word1, GLOBAL_SCC, 0, 0, 1);
-            pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(1), pmt::mp(word1, 28));
-            message_port_pub(pmt::mp("fvc_words"), tuple);
+            fvc_alert();
         } else if(boost::istarts_with(cmdstr, "page ")) {
             std::string num(cmdstr.substr(5));
             boost::trim(num);
-            handle_page(num);
+            if(handle_page(num) == CMD_OK) {
+                debug_msg("paging!\n");
+            }
+        } else if(boost::istarts_with(cmdstr, "loglevel ")) {
+            std::string level(cmdstr.substr(9));
+            boost::trim(level);
+            if(set_log_level(level)) {
+                debug_msg("log level changed\n");
+            } else {
+                debug_msg("invalid log level; use none, warning, info or debug\n");
+            }
         } else {
             debug_msg("invalid command\n");
         }
     }
 
+    static inline uint32_t read_be(const uint8_t *p, size_t n) {
+        uint32_t v = 0;
+        for(size_t i = 0; i < n; i++) {
+            v = (v << 8) | p[i];
+        }
+        return v;
+    }
+
+    static inline void write_be(std::vector<uint8_t> &out, uint32_t v, size_t n) {
+        for(size_t i = n; i > 0; i--) {
+            out.push_back((v >> (8 * (i - 1))) & 0xff);
+        }
+    }
+
+    /*
+     * Execute a binary batch (see command_processor_impl.h) and post one
+     * result PDU with an ack/nack per command.  A truncated command ends the
+     * batch; it and everything after it is lost, so it's nacked and the
+     * count in the result header covers only what was seen.
+     */
+    void command_processor_impl::handle_batch(const uint8_t *data, size_t len) {
+        std::vector<uint8_t> results;
+        const uint16_t count = read_be(&data[5], 2);
+        results.reserve(7 + (count * 6));
+        results.push_back('A');
+        results.push_back('M');
+        results.push_back('P');
+        results.push_back('R');
+        results.push_back(CMD_BATCH_VERSION);
+        write_be(results, 0, 2);       // filled in below
+
+        size_t off = 7;
+        uint16_t done = 0;
+        for( ; done < count; done++) {
+            if((off + 7) > len) {
+                break;
+            }
+            const uint8_t type = data[off];
+            const uint32_t id = read_be(&data[off+1], 4);
+            const uint16_t plen = read_be(&data[off+5], 2);
+            off += 7;
+            uint8_t status = CMD_ACK;
+            uint8_t reason = CMD_OK;
+            if((off + plen) > len) {
+                status = CMD_NACK;
+                reason = CMD_TRUNCATED;
+            } else {
+                switch(type) {
+                    case CMD_PAGE:
+                        reason = handle_page(std::string((const char *)&data[off], plen));
+                        if(reason != CMD_OK) {
+                            status = CMD_NACK;
+                        }
+                        break;
+                    case CMD_FVC_ON:
+                        set_fvc_data(true);
+                        break;
+                    case CMD_FVC_OFF:
+                        set_fvc_data(false);
+                        break;
+                    case CMD_FVC_ALERT:
+                        fvc_alert();
+                        break;
+                    default:
+                        status = CMD_NACK;
+                        reason = CMD_UNKNOWN;
+                        break;
+                }
+            }
+            write_be(results, id, 4);
+            results.push_back(status);
+            results.push_back(reason);
+            if(reason == CMD_TRUNCATED) {
+                done++;
+                break;
+            }
+            off += plen;
+        }
+        results[5] = (done >> 8) & 0xff;
+        results[6] = done & 0xff;
+        if(done < count) {
+            LOG_WARNING("command batch truncated: %u of %u commands", done, count);
+        }
+        pmt::pmt_t pdu = pmt::cons(pmt::make_dict(), pmt::init_u8vector(results.size(), &results[0]));
+        message_port_pub(pmt::mp("results"), pdu);
+    }
+
+    void command_processor_impl::reject_batch() {
+        std::vector<uint8_t> results;
+        results.push_back('A');
+        results.push_back('M');
+        results.push_back('P');
+        results.push_back('R');
+        results.push_back(CMD_BATCH_VERSION);
+        write_be(results, 1, 2);
+        write_be(results, 0, 4);
+        results.push_back(CMD_NACK);
+        results.push_back(CMD_BAD_VERSION);
+        pmt::pmt_t pdu = pmt::cons(pmt::make_dict(), pmt::init_u8vector(results.size(), &results[0]));
+        message_port_pub(pmt::mp("results"), pdu);
+    }
+
+    void command_processor_impl::profile_query_message(pmt::pmt_t msg) {
+        message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+    }
+
+    void command_processor_impl::commands_message(pmt::pmt_t msg) {
+        profile_scope prof(d_profiler, d_prof_commands);
+        pmt::pmt_t cmdvec = cdr(msg);
+        if(is_u8vector(cmdvec) == false) {
+            LOG_WARNING("command processor got an invalid message");
+            return;
+        }
+        size_t len = 0;
+        const uint8_t *data = pmt::u8vector_elements(cmdvec, len);
+        if(len >= 7 && memcmp(data, "AMPB", 4) == 0) {
+            if(data[4] != CMD_BATCH_VERSION) {
+                LOG_WARNING("unsupported command batch version %u", data[4]);
+                reject_batch();
+                return;
+            }
+            handle_batch(data, len);
+            return;
+        }
+        // Text commands may or may not be NUL-terminated.
+        size_t textlen = 0;
+        while(textlen < len && data[textlen] != 0) {
+            textlen++;
+        }
+        handle_text_command(std::string((const char *)data, textlen));
+    }
+
     /*
      * Our virtual destructor.
      */
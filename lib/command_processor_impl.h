@@ -11,22 +11,71 @@
 #include <itpp/comm/bch.h>
 #include <amps/command_processor.h>
 #include "amps_packet.h"
+#include "subscriber_registry.h"
+#include "block_profiler.h"
 
 using namespace itpp;
 
 namespace gr {
   namespace amps {
 
+    /*
+     * Binary batch command PDUs.  All integers are big-endian.
+     *
+     *   request:  "AMPB" version(1) count(2), then count times:
+     *             type(1) id(4) len(2) payload(len)
+     *   result:   "AMPR" version(1) count(2), then count times:
+     *             id(4) status(1) reason(1)
+     *
+     * One result PDU is posted on the "results" port per request PDU, with
+     * one record per command, in order.  A request with an unsupported
+     * version gets a single record with id 0, CMD_NACK and CMD_BAD_VERSION,
+     * since its commands can't be parsed.
+     */
+    enum command_type {
+        CMD_PAGE = 0x01,            // payload: MIN as ASCII digits
+        CMD_FVC_ON = 0x02,
+        CMD_FVC_OFF = 0x03,
+        CMD_FVC_ALERT = 0x04
+    };
+
+    enum command_status {
+        CMD_ACK = 0,
+        CMD_NACK = 1
+    };
+
+    enum command_nack_reason {
+        CMD_OK = 0,
+        CMD_UNKNOWN = 1,            // unknown command type
+        CMD_BAD_ARGUMENT = 2,       // e.g. invalid MIN
+        CMD_TRUNCATED = 3,          // command ran past the end of the PDU
+        CMD_NOT_REGISTERED = 4,     // page skipped: MIN unregistered or silent too long
+        CMD_BAD_VERSION = 5         // whole batch rejected: version not supported
+    };
+
+    static const uint8_t CMD_BATCH_VERSION = 1;
+
     class command_processor_impl : public command_processor
     {
      private:
          itpp::BCH bch;
+         subscriber_registry::sptr d_registry;
+         int d_max_silence;         // seconds; 0 means any registered MIN is paged
+
+         // Message handler timing (see block_profiler.h)
+         block_profiler d_profiler;
+         const int d_prof_commands;
 
          void debug_msg(const char *msg);
-        void handle_page(const std::string numstr);
+         uint8_t handle_page(const std::string numstr);
+         void set_fvc_data(bool on);
+         void fvc_alert();
+         void handle_text_command(const std::string &cmdstr);
+         void handle_batch(const uint8_t *data, size_t len);
+         void reject_batch();
 
      public:
-      command_processor_impl();
+      command_processor_impl(const std::string &registry_path, int max_silence);
       ~command_processor_impl();
 
       // Where all the action really happens
@@ -38,6 +87,7 @@ namespace gr {
            gr_vector_void_star &output_items);
 
       void commands_message(pmt::pmt_t msg);
+      void profile_query_message(pmt::pmt_t msg);
     };
 
   } // namespace amps
@@ -0,0 +1,164 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "event_journal.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdexcept>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    static const char JOURNAL_MAGIC[8] = { 'A', 'M', 'P', 'S', 'J', 'R', 'N', '1' };
+
+    // Records per commit of the header count.
+    static const uint64_t JOURNAL_BATCH = 64;
+    static const uint64_t JOURNAL_FLUSH_NS = 1000000000ULL;
+
+    // Keep the reader-visible layout honest.
+    typedef char journal_record_size_check[(sizeof(journal_record) == 96) ? 1 : -1];
+    typedef char journal_header_size_check[(sizeof(journal_header) == 64) ? 1 : -1];
+
+    event_journal::event_journal(const std::string &prefix, uint64_t records_per_segment)
+        : d_prefix(prefix), d_capacity(records_per_segment), d_sequence(0), d_fd(-1), d_maplen(0),
+        d_header(NULL), d_records(NULL), d_next(0), d_failed(0), d_flushed_ns(0) {
+        if(records_per_segment < JOURNAL_BATCH) {
+            throw std::invalid_argument("event_journal: segments must hold at least one batch");
+        }
+        if(open_segment() == false) {
+            throw std::runtime_error("event_journal: can't create a segment for " + prefix);
+        }
+    }
+
+    event_journal::~event_journal() {
+        close_segment();
+        if(d_failed > 0) {
+            LOG_WARNING("event journal %s: %llu records lost", d_prefix.c_str(), (unsigned long long)d_failed);
+        }
+    }
+
+    /*
+     * Create, preallocate and map the next unused segment.  Segments from
+     * earlier runs are never overwritten; numbering just carries on past
+     * them.
+     */
+    bool event_journal::open_segment() {
+        char name[32];
+        for( ; ; d_sequence++) {
+            snprintf(name, sizeof(name), ".%06llu.amj", (unsigned long long)d_sequence);
+            d_fd = ::open((d_prefix + name).c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+            if(d_fd != -1 || errno != EEXIST) {
+                break;
+            }
+        }
+        const std::string path = d_prefix + name;
+        if(d_fd == -1) {
+            LOG_WARNING("can't create journal segment %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+        d_maplen = sizeof(journal_header) + (d_capacity * sizeof(journal_record));
+        int err = posix_fallocate(d_fd, 0, d_maplen);
+        if(err != 0) {
+            LOG_WARNING("can't preallocate journal segment %s: %s", path.c_str(), strerror(err));
+            ::close(d_fd);
+            d_fd = -1;
+            unlink(path.c_str());
+            return false;
+        }
+        void *map = mmap(NULL, d_maplen, PROT_READ | PROT_WRITE, MAP_SHARED, d_fd, 0);
+        if(map == MAP_FAILED) {
+            LOG_WARNING("can't map journal segment %s: %s", path.c_str(), strerror(errno));
+            ::close(d_fd);
+            d_fd = -1;
+            unlink(path.c_str());
+            return false;
+        }
+        d_header = static_cast<journal_header *>(map);
+        d_records = reinterpret_cast<journal_record *>(d_header + 1);
+        memcpy(d_header->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        d_header->record_size = sizeof(journal_record);
+        d_header->capacity = d_capacity;
+        d_header->count = 0;
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        d_header->created_ns = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+        d_header->sequence = d_sequence;
+        d_next = 0;
+        LOG_DEBUG("journal segment %s: room for %llu records", path.c_str(), (unsigned long long)d_capacity);
+        return true;
+    }
+
+    void event_journal::close_segment() {
+        if(d_header == NULL) {
+            return;
+        }
+        flush();
+        munmap(d_header, d_maplen);
+        ::close(d_fd);
+        d_header = NULL;
+        d_records = NULL;
+        d_fd = -1;
+        d_sequence++;
+    }
+
+    /*
+     * Return the next record, zeroed, to be filled in place and then
+     * committed.  Returns NULL (and counts the loss) if no segment can be
+     * opened.
+     */
+    journal_record *event_journal::next_record() {
+        if(d_header != NULL && d_next == d_capacity) {
+            close_segment();
+        }
+        if(d_header == NULL && open_segment() == false) {
+            d_failed++;
+            return NULL;
+        }
+        journal_record *rec = &d_records[d_next];
+        memset(rec, 0, sizeof(*rec));
+        return rec;
+    }
+
+    void event_journal::commit() {
+        const uint64_t stamp = d_records[d_next].stamp_ns;
+        d_next++;
+        if((d_next - d_header->count) >= JOURNAL_BATCH || d_next == d_capacity
+                || (stamp - d_flushed_ns) >= JOURNAL_FLUSH_NS) {
+            flush();
+            d_flushed_ns = stamp;
+        }
+    }
+
+    /*
+     * Publish everything committed so far: bump the header count and start
+     * writeback of the new records.
+     */
+    void event_journal::flush() {
+        if(d_header == NULL || d_next == d_header->count) {
+            return;
+        }
+        const long pagesz = sysconf(_SC_PAGESIZE);
+        const size_t start = (sizeof(journal_header) + (d_header->count * sizeof(journal_record))) & ~(pagesz - 1);
+        const size_t end = sizeof(journal_header) + (d_next * sizeof(journal_record));
+        __atomic_store_n(&d_header->count, d_next, __ATOMIC_RELEASE);
+        msync((char *)d_header + start, end - start, MS_ASYNC);
+        msync(d_header, sizeof(journal_header), MS_ASYNC);
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,105 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_EVENT_JOURNAL_H
+#define INCLUDED_AMPS_EVENT_JOURNAL_H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    enum journal_event_type {
+        JOURNAL_REGISTRATION = 1,
+        JOURNAL_ORIGINATION = 2,
+        JOURNAL_PAGE_RESPONSE = 3,
+        JOURNAL_BAD_BURST = 4,      // Word A didn't decode
+        JOURNAL_UNKNOWN = 5         // decoded, but not a message we handle
+    };
+
+    enum journal_flags {
+        JOURNAL_HAS_ESN = 0x1,
+        JOURNAL_BLOCKED = 0x2       // no voice channel was free
+    };
+
+    /*
+     * On-disk record.  Fixed size and naturally aligned, so a reader can
+     * map a segment and index it directly.  apps/amps_journal_csv.py knows
+     * this layout; keep the two in sync.
+     */
+    struct journal_record {
+        uint64_t stamp_ns;          // CLOCK_REALTIME
+        uint64_t min;               // packed MIN: (MIN2 << 24) | MIN1
+        uint32_t esn;
+        uint16_t chan;              // voice channel number assigned, 0 if none
+        uint8_t type;               // journal_event_type
+        uint8_t scm;
+        char min_digits[10];
+        uint8_t ndigits;
+        uint8_t flags;              // journal_flags
+        uint8_t bch_fails[7];       // per word: repeats that failed BCH before one passed (5 = none did)
+        uint8_t nwords;             // words in the message
+        uint16_t manchester_errs[7];    // per word, over all 5 repeats
+        char digits[32];            // dialed digits (origination)
+        uint8_t reserved[6];
+    };
+
+    struct journal_header {
+        char magic[8];              // "AMPSJRN1"
+        uint32_t record_size;
+        uint32_t reserved0;
+        uint64_t capacity;          // records the segment has room for
+        uint64_t count;             // records committed
+        uint64_t created_ns;
+        uint64_t sequence;          // segment number
+        uint8_t reserved1[16];
+    };
+
+    /*
+     * Append-only journal of decoded RECC traffic, written as a series of
+     * segment files (<prefix>.<sequence>.amj).  Each segment is preallocated
+     * and mapped; records are built in place, and the header's count is
+     * only advanced (and the pages handed to the kernel) once per batch --
+     * or once a second, when traffic is light, as long as the owner also
+     * calls flush() about once a second -- so a reader never sees a
+     * half-written record.  When a segment fills up, the journal moves on
+     * to the next one.
+     *
+     * Not thread safe: the journal belongs to the block that writes it.
+     */
+    class event_journal {
+        private:
+        const std::string d_prefix;
+        const uint64_t d_capacity;
+        uint64_t d_sequence;
+        int d_fd;
+        size_t d_maplen;
+        journal_header *d_header;
+        journal_record *d_records;
+        uint64_t d_next;            // next record to fill
+        uint64_t d_failed;          // records lost because a segment couldn't be opened
+        uint64_t d_flushed_ns;      // stamp of the last record when we last flushed
+
+        bool open_segment();
+        void close_segment();
+
+        public:
+        event_journal(const std::string &prefix, uint64_t records_per_segment = 65536);
+        ~event_journal();
+
+        journal_record *next_record();
+        void commit();
+        void flush();
+
+        uint64_t sequence() const { return d_sequence; }
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_EVENT_JOURNAL_H */
@@ -16,6 +16,8 @@
 #include <fstream>
 #include <algorithm>
 #include <vector>
+#include <string.h>
+#include <stdexcept>
 #include "utils.h"
 
 using namespace itpp;
@@ -30,17 +32,28 @@ namespace gr {
 
         volatile bool busy_idle_bit;
 
+        // How long rendering one word may take before it counts as over
+        // budget (a small fraction of the 46.3 ms frame it's headed for).
+        static const uint64_t FOCC_RENDER_BUDGET_NS = 2000000ULL;
+
+        // Overhead train period limits (0.8 +/- 0.3 s), in 463-bit frames
+        // from the start of one train to the start of the next.
+        static const unsigned int FOCC_FRAME_BITS = 463;
+        static const unsigned int OVERHEAD_MIN_FRAMES = (5000 + FOCC_FRAME_BITS - 1) / FOCC_FRAME_BITS;
+        static const unsigned int OVERHEAD_MAX_FRAMES = 11000 / FOCC_FRAME_BITS;
+
 
         /**
          * AMPS BS FOCC.  553 3.7.1.2 says that the system parameter overhead 
          * message needs to be sent every 0.8 +/- 0.3 s.
          *
-         * The BS simulator is repeating the overhead words every 18 or 19 
-         * frames, putting this squarely in the range:
-         *     18 x 463 bits = 8334 bits (0.8334s)
-         *     19 x 463 bits = 8797 bits (0.8797s)
-         *
-         * This code uses 18 in a superframe, starting with word 1 and word 2.
+         * Each overhead train is followed by filler frames (19 frames from
+         * train to train by default: 19 x 463 bits = 8797 bits, 0.8797 s).
+         * Those are slots: a queued mobile station control message takes a
+         * slot's place, and filler only goes out when nothing is waiting.
+         * When messages are still queued as the next train comes due, the
+         * train is pushed back a frame at a time, up to the 1.1 s limit, so
+         * a backlog gets as many slots as the spec allows.
          */
 
         focc::sptr
@@ -52,7 +65,7 @@ namespace gr {
         void
         focc_impl::queue_file() {
             std::ifstream bitfile("/tmp/out.bits");
-            std::cout << "XXX queue_file:    start: sz " << queuesize() << std::endl;
+            LOG_DEBUG("queue_file: start: sz %zu", (size_t)queuesize());
             unsigned long zerocount = 0, onecount = 1;
             while(bitfile) {
                 char buf[1];
@@ -69,11 +82,10 @@ namespace gr {
                     queuebit(1);
                     queuebit(0);
                 } else {
-                    std::cout << "error: invalid value in bits file" << std::endl;
+                    LOG_WARNING("invalid value in bits file");
                 }
             }
-            std::cout << "XXX queue_file:    final: sz " << queuesize() << std::endl;
-            std::cout << "XXX queue_file:    zerocount " << zerocount << " onecount " << onecount << std::endl;
+            LOG_DEBUG("queue_file: final: sz %zu zerocount %lu onecount %lu", (size_t)queuesize(), zerocount, onecount);
         }
 
 
@@ -102,13 +114,24 @@ namespace gr {
 
 
         focc_impl::focc_impl(unsigned long symrate, bool aggressive_registration)
-          : d_symrate(symrate), cur_burst_state(FOCC_END), cur_off(0), bch(63, 2, true),
-            samples_per_sym(symrate / 20000), d_aggressive_registration(aggressive_registration),
-          sync_block("focc",
+          : sync_block("focc",
                   io_signature::make(0, 0, 0),
-                  io_signature::make(1, 1, sizeof (unsigned char)))
+                  io_signature::make(1, 1, sizeof (unsigned char))),
+            d_symrate(symrate), d_aggressive_registration(aggressive_registration), bch(63, 2, true),
+            d_clock(symrate), samples_per_sym(d_clock.integral() ? d_clock.nominal() : 1),
+            d_hb_off(0), d_hb_len(0), d_hold_val(0), d_hold_left(0),
+            cur_burst_state(FOCC_END), cur_off(0),
+            d_pending_superframe(NULL), d_period_frames(0), d_message_slots(0), d_filler_slots(0),
+            d_extra_slots(0), d_queue_report_ns(0), d_trace_start(false), d_latency_report_ns(0), d_profiler("focc"),
+            d_prof_work(d_profiler.add_site("work")), d_prof_focc_words(d_profiler.add_site("focc_words_message")),
+            d_prof_render(d_profiler.add_site("render")), d_render_bch(63, 2, true), d_render_inline(0), d_render_running(false)
         {
+            if(symrate < symbol_clock::HALFBIT_RATE) {
+                throw std::invalid_argument("focc: symrate must be at least 20000");
+            }
             busy_idle_bit = 1;
+            d_inbox.head = 0;
+            d_inbox.tail = 0;
             BI_zero_buf = new char[samples_per_sym * 2];
             BI_one_buf = new char[samples_per_sym * 2];
             for(int i = 0; i < samples_per_sym; i++) {
@@ -117,36 +140,50 @@ namespace gr {
                 BI_one_buf[i] = -1;
                 BI_one_buf[samples_per_sym+i] = 1;
             }
-            if(d_aggressive_registration) {
-                make_registration_superframe();
-            } else {
-                make_superframe();
-            }
+            d_overhead = default_overhead(d_aggressive_registration);
+            build_superframe(d_overhead, superframe_frames);
+            start_superframe();
             validate_superframe();
 
             message_port_register_in(pmt::mp("focc_words"));
             set_msg_handler(pmt::mp("focc_words"),
                 boost::bind(&focc_impl::focc_words_message, this, _1)
             );
+            message_port_register_in(pmt::mp("overhead"));
+            set_msg_handler(pmt::mp("overhead"),
+                boost::bind(&focc_impl::overhead_message, this, _1)
+            );
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&focc_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
+            message_port_register_out(pmt::mp("latency"));
+            message_port_register_out(pmt::mp("latency_stats"));
+            message_port_register_out(pmt::mp("queue_stats"));
 
 #ifdef AMPS_DEBUG
-            std::cout << "AMPS_DEBUG is enabled!" << std::endl;
+            LOG_DEBUG("AMPS_DEBUG is enabled!");
             debugfd = open("/tmp/debug.bits", O_CREAT | O_APPEND, 0755);
 #endif
         }
 
         // Insert bits into the queue.  Here is also where we repeat a single bit
-        // so that we're emitting d_symrate symbols per second.
+        // so that we're emitting samples_per_sym symbols per half-bit.
         inline void 
         focc_impl::queuebit(bool bit) {
-            const unsigned int interp = d_symrate / 20000;
-            for(unsigned int i = 0; i < interp; i++) {
+            for(unsigned int i = 0; i < samples_per_sym; i++) {
                 d_bitqueue.push(bit);
             }
         }
 
         focc_impl::~focc_impl()
         {
+            focc_superframe_update *pending = __atomic_exchange_n(&d_pending_superframe,
+                    (focc_superframe_update *)NULL, __ATOMIC_ACQ_REL);
+            if(pending != NULL) {
+                free_update(pending);
+            }
         }
 
         /*
@@ -154,13 +191,13 @@ namespace gr {
          * being numeric 0 and 1) to a 40-bit bch-encoded word.
          */
         std::vector<char>
-        focc_impl::focc_bch(const std::vector<char> inbits) {
+        focc_impl::focc_bch(const std::vector<char> inbits, itpp::BCH &coder) {
             std::vector<char> outvec(40);
             bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
             bvec srcbvec(28);
             charv_to_bvec(inbits, srcbvec);
             bvec padded(concat(zeroes, srcbvec));
-            bvec encoded = bch.encode(padded);
+            bvec encoded = coder.encode(padded);
             bvec final = encoded(23, encoded.size()-1);
             assert(final.size() == 40);
             for(int i = 0; i < 40; i++) {
@@ -177,11 +214,14 @@ namespace gr {
 
         focc_frame *
         focc_impl::make_frame(const std::vector<char> word_a, const std::vector<char> word_b, bool ephemeral, bool filler) {
-            // XXX: remove this
-            const unsigned int samples_per_sym = d_symrate / 20000;
+            return make_frame(word_a, word_b, ephemeral, filler, bch);
+        }
+
+        focc_frame *
+        focc_impl::make_frame(const std::vector<char> word_a, const std::vector<char> word_b, bool ephemeral, bool filler, itpp::BCH &coder) {
             std::vector<focc_segment *> segments;
-            std::vector<char> bch_a = focc_bch(word_a);
-            std::vector<char> bch_b = focc_bch(word_b);
+            std::vector<char> bch_a = focc_bch(word_a, coder);
+            std::vector<char> bch_b = focc_bch(word_b, coder);
             segments.push_back(new focc_segment(FOCC_BI_BIT));
             char dotting[] = { 1, 0, 1, 0, 1, 0, 1, 0, 1, 0 };
             segments.push_back(new focc_segment(dotting, 10, samples_per_sym));
@@ -218,8 +258,6 @@ namespace gr {
         }
 
         void focc_impl::validate_superframe() {
-            // XXX: remove this
-            const unsigned int samples_per_sym = d_symrate / 20000;     // XXX factor this out into the class or something
             unsigned long totalsyms = 0;
             for(unsigned int i = 0; i < superframe_frames.size(); i++) {
                 focc_frame *frame = superframe_frames[i];
@@ -242,9 +280,9 @@ namespace gr {
                 }
             }
             // XXX DO THIS
-            const unsigned int totalbits = totalsyms / (samples_per_sym * 2);     // XXX factor this out into the class or something
+            const unsigned int totalbits = totalsyms / (samples_per_sym * 2);
             assert(totalbits == (superframe_frames.size() * 463));
-            std::cerr << "validate: totalsyms " << totalsyms << " totalbits " << totalbits << std::endl;
+            LOG_DEBUG("validate: totalsyms %lu totalbits %u", (unsigned long)totalsyms, totalbits);
             std::cerr << "---" << std::endl;
             std::cerr << "--- gr-amps --- --- part of the ninjatel family --- written by cstone@pobox.com" << std::endl;
             std::cerr << "---" << std::endl;
@@ -293,7 +331,7 @@ namespace gr {
         std::vector<char> control_filler_word() {
             return string_to_cvec("1 1 0 0 0 1 0 1 1 1 0 0 0 0 0 1 1 0 0 1 1 1 1 1 1 0 0 1");
         }
-        std::vector<char> access_type_parameters_global_action(unsigned char dcc, const bool end = 0) {
+        std::vector<char> access_type_parameters_global_action(unsigned char dcc, const bool bis, const bool end = 0) {
             unsigned char word[28];
             word[0] = 1;                                // T1T2 = 11
             word[1] = 1;
@@ -305,7 +343,7 @@ namespace gr {
             word[6] = 0;
             word[7] = 1;
 
-            word[8] = 0;                                // BIS = 0
+            word[8] = bis ? 1 : 0;                      // BIS
             word[9] = 0;                                // PCI HOME = 0
             word[10] = 0;                               // PCI ROAM = 0
 
@@ -361,6 +399,33 @@ namespace gr {
             return ch;
         }
 
+        // OLC holds one bit per access overload class, class 0 in the low
+        // bit; a mobile whose class bit is 0 may not originate.
+        vector<char> overload_control_global_action(unsigned char dcc, unsigned short olc, bool end = false) {
+            unsigned char word[28];
+            word[0] = 1;                                // T1T2 = 11
+            word[1] = 1;
+            word[2] = ((dcc & 0x2) == 0x2) ? 1 : 0;     // DCC
+            word[3] = ((dcc & 0x1) == 0x1) ? 1 : 0;
+
+            word[4] = 0;                                // ACT = 0110
+            word[5] = 1;
+            word[6] = 1;
+            word[7] = 0;
+
+            for(int i = 0; i < 16; i++) {               // OLC 0-15
+                word[8 + i] = ((olc >> i) & 1);
+            }
+
+            word[24] = end ? 1 : 0;                     // END
+            word[25] = 1;                               // OHD = 100
+            word[26] = 0;
+            word[27] = 0;
+
+            vector<char> ch(word, word+28);
+            return ch;
+        }
+
         // 3.7.1.2.3 Registration ID message
         vector<char> registration_id(unsigned char dcc, unsigned long regid, bool end = false) {
             unsigned char word[28];
@@ -380,30 +445,93 @@ namespace gr {
             return ch;
         }
 
+        /*
+         * Overhead settings the block starts with: one train per superframe,
+         * or with aggressive registration, two trains whose REGIDs a REGINCR
+         * apart straddle every mobile's NXTREG, so they all register.
+         */
+        focc_overhead
+        focc_impl::default_overhead(bool aggressive_registration) {
+            focc_overhead cfg;
+            cfg.sid = GLOBAL_SID;
+            cfg.dcc = GLOBAL_DCC_SHORT;
+            cfg.ep = true;
+            cfg.auth = false;
+            cfg.pci = false;
+            cfg.s = true;
+            cfg.e = true;
+            cfg.regh = true;
+            cfg.regr = true;
+            cfg.dtx = 0;
+            cfg.nminusone = 23;
+            cfg.rcf = true;
+            cfg.cpa = true;
+            cfg.cmax = 23;
+            cfg.bis = false;
+            cfg.olc = OLC_ALL;
+            if(aggressive_registration) {
+                cfg.regincr = 100;
+                cfg.regids.push_back(0);
+                cfg.regids.push_back(500);
+                cfg.fillers = 14;
+            } else {
+                cfg.regincr = 0;
+                cfg.regids.push_back(0);
+                cfg.fillers = 15;
+            }
+            return cfg;
+        }
+
+        // Frames in one overhead train, not counting the fillers after it.
+        static unsigned int
+        train_frames(const focc_overhead &cfg) {
+            return 4 + ((cfg.regincr > 0) ? 1 : 0) + ((cfg.olc != OLC_ALL) ? 1 : 0);
+        }
+
+        /*
+         * Lay out a superframe: for each REGID, an overhead train (553
+         * 3.7.1.2: system parameter words 1 and 2, the access type
+         * parameters global action, REGINCR and overload control if they're
+         * in use, then the REGID with END set), followed by filler frames
+         * that queued messages can take over.  Both streams carry the same
+         * overhead.  This only lays out the words; nothing is encoded.
+         */
         void
-        focc_impl::make_superframe() {
-            superframe_frames.push_back(make_frame(overhead_word_1(GLOBAL_DCC_SHORT, GLOBAL_SID, 1, 0, 0, 3), overhead_word_1(GLOBAL_DCC_SHORT, GLOBAL_SID, 1, 0, 0, 3)));
-            superframe_frames.push_back(make_frame(
-                        overhead_word_2(GLOBAL_DCC_SHORT, 1, 1, 1, 1, 0, 23, 1, 1, 23, 0),
-                        overhead_word_2(GLOBAL_DCC_SHORT, 1, 1, 1, 1, 0, 23, 1, 1, 23, 0)
-                        ));
-            superframe_frames.push_back(make_frame(access_type_parameters_global_action(GLOBAL_DCC_SHORT, false), access_type_parameters_global_action(GLOBAL_DCC_SHORT, false)));
-            superframe_frames.push_back(make_frame(registration_id(GLOBAL_DCC_SHORT, 0, true), registration_id(GLOBAL_DCC_SHORT, 0, true)));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
+        focc_impl::superframe_words(const focc_overhead &cfg, std::vector<std::vector<char> > &words, std::vector<bool> &fillers) {
+            const unsigned char nawc = train_frames(cfg) - 1;
+            words.clear();
+            fillers.clear();
+            for(size_t t = 0; t < cfg.regids.size(); t++) {
+                words.push_back(overhead_word_1(cfg.dcc, cfg.sid, cfg.ep, cfg.auth, cfg.pci, nawc));
+                words.push_back(overhead_word_2(cfg.dcc, cfg.s, cfg.e, cfg.regh, cfg.regr, cfg.dtx, cfg.nminusone, cfg.rcf, cfg.cpa, cfg.cmax, false));
+                words.push_back(access_type_parameters_global_action(cfg.dcc, cfg.bis, false));
+                if(cfg.regincr > 0) {
+                    words.push_back(registration_increment_global_action(cfg.dcc, cfg.regincr, false));
+                }
+                if(cfg.olc != OLC_ALL) {
+                    words.push_back(overload_control_global_action(cfg.dcc, cfg.olc, false));
+                }
+                words.push_back(registration_id(cfg.dcc, cfg.regids[t], true));
+                fillers.resize(words.size(), false);
+                for(unsigned int i = 0; i < cfg.fillers; i++) {
+                    words.push_back(control_filler_word());
+                }
+                fillers.resize(words.size(), true);
+            }
+        }
+
+        void
+        focc_impl::build_superframe(const focc_overhead &cfg, std::vector<focc_frame *> &frames) {
+            std::vector<std::vector<char> > words;
+            std::vector<bool> fillers;
+            superframe_words(cfg, words, fillers);
+            for(size_t i = 0; i < words.size(); i++) {
+                frames.push_back(make_frame(words[i], words[i], false, fillers[i]));
+            }
+        }
+
+        void
+        focc_impl::start_superframe() {
             cur_off = 0;
             cur_seg_idx = -1;   // XXX: hack because next_burst_state increments
             cur_seg_len = 0;
@@ -411,72 +539,217 @@ namespace gr {
             cur_seg_data = NULL;
             cur_frame = superframe_frames[cur_frame_idx];
             if(cur_frame == NULL) {
-                std::cout << "XXX cur_frame NULL" << std::endl;
+                LOG_WARNING("cur_frame NULL");
+                log_flush();
                 exit(1);
             }
             next_burst_state();
         }
 
+        /*
+         * Encode the overhead words the new settings change, off to the
+         * side, and leave them for work() to put in place at the next
+         * superframe boundary, so the channel never carries a partial or
+         * mixed overhead train.  Only a change in layout (trains, fillers,
+         * REGINCR or overload control words coming or going) rebuilds the
+         * whole superframe; a REGID step re-encodes one word per train.
+         */
         void
-        focc_impl::make_registration_superframe() {
-            superframe_frames.push_back(make_frame(overhead_word_1(GLOBAL_DCC_SHORT, GLOBAL_SID, 1, 0, 0, 4), overhead_word_1(GLOBAL_DCC_SHORT, GLOBAL_SID, 1, 0, 0, 4)));
-            superframe_frames.push_back(make_frame(
-                        overhead_word_2(GLOBAL_DCC_SHORT, 1, 1, 1, 1, 0, 23, 1, 1, 23, 0), 
-                        overhead_word_2(GLOBAL_DCC_SHORT, 1, 1, 1, 1, 0, 23, 1, 1, 23, 0)
-                        ));
-            superframe_frames.push_back(make_frame(access_type_parameters_global_action(GLOBAL_DCC_SHORT, false), access_type_parameters_global_action(GLOBAL_DCC_SHORT, false)));
-            superframe_frames.push_back(make_frame(registration_increment_global_action(GLOBAL_DCC_SHORT, 100, false), registration_increment_global_action(GLOBAL_DCC_SHORT, 100, false)));
-            superframe_frames.push_back(make_frame(registration_id(GLOBAL_DCC_SHORT, 0, true), registration_id(GLOBAL_DCC_SHORT, 0, true)));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-
-            superframe_frames.push_back(make_frame(overhead_word_1(GLOBAL_DCC_SHORT, GLOBAL_SID, 1, 0, 0, 4), overhead_word_1(GLOBAL_DCC_SHORT, GLOBAL_SID, 1, 0, 0, 4)));
-            superframe_frames.push_back(make_frame(
-                        overhead_word_2(GLOBAL_DCC_SHORT, 1, 1, 1, 1, 0, 23, 1, 1, 23, 0), 
-                        overhead_word_2(GLOBAL_DCC_SHORT, 1, 1, 1, 1, 0, 23, 1, 1, 23, 0)
-                        ));
-            superframe_frames.push_back(make_frame(access_type_parameters_global_action(GLOBAL_DCC_SHORT, false), access_type_parameters_global_action(GLOBAL_DCC_SHORT, false)));
-            superframe_frames.push_back(make_frame(registration_increment_global_action(GLOBAL_DCC_SHORT, 100, false), registration_increment_global_action(GLOBAL_DCC_SHORT, 100, false)));
-            superframe_frames.push_back(make_frame(registration_id(GLOBAL_DCC_SHORT, 500, true), registration_id(GLOBAL_DCC_SHORT, 500, true)));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
-            superframe_frames.push_back(make_frame(control_filler_word(), control_filler_word(), false, true));
+        focc_impl::configure_overhead(const focc_overhead &cfg) {
+            std::vector<std::vector<char> > oldwords, newwords;
+            std::vector<bool> oldfillers, newfillers;
+            superframe_words(d_overhead, oldwords, oldfillers);
+            superframe_words(cfg, newwords, newfillers);
+            focc_superframe_update *update = new focc_superframe_update();
+            update->whole = (newfillers != oldfillers);
+            for(size_t i = 0; i < newwords.size(); i++) {
+                if(update->whole || newwords[i] != oldwords[i]) {
+                    update->frames.push_back(make_frame(newwords[i], newwords[i], false, newfillers[i]));
+                    update->slots.push_back(i);
+                }
+            }
+            d_overhead = cfg;
 
+            // An update work() hasn't picked up yet was made against the
+            // superframe still on the air; fold it in, the newer frames
+            // winning.  work() may find nothing pending in between, which
+            // only puts the change off by a superframe.
+            focc_superframe_update *old = __atomic_exchange_n(&d_pending_superframe,
+                    (focc_superframe_update *)NULL, __ATOMIC_ACQ_REL);
+            if(old != NULL && update->whole == false) {
+                std::vector<bool> replaced(newwords.size(), false);
+                for(size_t i = 0; i < update->slots.size(); i++) {
+                    replaced[update->slots[i]] = true;
+                }
+                for(size_t i = 0; i < old->slots.size(); i++) {
+                    if(replaced[old->slots[i]] == false) {
+                        update->frames.push_back(old->frames[i]);
+                        update->slots.push_back(old->slots[i]);
+                        old->frames[i] = NULL;
+                    }
+                }
+                update->whole = old->whole;
+                if(update->whole) {
+                    // Back in slot order, as a whole superframe.
+                    std::vector<focc_frame *> frames(newwords.size(), (focc_frame *)NULL);
+                    for(size_t i = 0; i < update->slots.size(); i++) {
+                        frames[update->slots[i]] = update->frames[i];
+                        update->slots[i] = i;
+                    }
+                    update->frames.swap(frames);
+                }
+            }
+            if(old != NULL) {
+                free_update(old);
+            }
+            if(update->frames.empty()) {
+                delete update;
+                return;
+            }
+            __atomic_store_n(&d_pending_superframe, update, __ATOMIC_RELEASE);
+        }
 
-            cur_off = 0;
-            cur_seg_idx = -1;   // XXX: hack because next_burst_state increments
-            cur_seg_len = 0;
-            cur_frame_idx = 0;
-            cur_seg_data = NULL;
-            cur_frame = superframe_frames[cur_frame_idx];
-            if(cur_frame == NULL) {
-                std::cout << "XXX cur_frame NULL" << std::endl;
-                exit(1);
+        void
+        focc_impl::free_update(focc_superframe_update *update) {
+            for(size_t i = 0; i < update->frames.size(); i++) {
+                delete update->frames[i];
             }
-            next_burst_state();
+            delete update;
+        }
+
+        // At a superframe boundary: put the pending overhead change, if any,
+        // in place.
+        void
+        focc_impl::swap_superframe() {
+            focc_superframe_update *next = __atomic_exchange_n(&d_pending_superframe,
+                    (focc_superframe_update *)NULL, __ATOMIC_ACQ_REL);
+            if(next == NULL) {
+                return;
+            }
+            if(next->whole) {
+                superframe_frames.swap(next->frames);
+            } else {
+                for(size_t i = 0; i < next->slots.size(); i++) {
+                    std::swap(superframe_frames[next->slots[i]], next->frames[i]);
+                }
+            }
+            LOG_DEBUG("FOCC overhead train updated: %zu of %zu frames replaced", next->frames.size(), superframe_frames.size());
+            free_update(next);
+        }
+
+        // Read an integer setting, if present.  Returns false if it's there
+        // but isn't an integer in [lo, hi].
+        static bool
+        overhead_int(pmt::pmt_t cfg, const char *key, long lo, long hi, long &val) {
+            pmt::pmt_t v = pmt::dict_ref(cfg, pmt::mp(key), pmt::PMT_NIL);
+            if(v == pmt::PMT_NIL) {
+                return true;
+            }
+            if(pmt::is_integer(v) == false || pmt::to_long(v) < lo || pmt::to_long(v) > hi) {
+                LOG_WARNING("FOCC overhead: %s must be an integer from %ld to %ld", key, lo, hi);
+                return false;
+            }
+            val = pmt::to_long(v);
+            return true;
+        }
+
+        static bool
+        overhead_bool(pmt::pmt_t cfg, const char *key, bool &val) {
+            pmt::pmt_t v = pmt::dict_ref(cfg, pmt::mp(key), pmt::PMT_NIL);
+            if(v == pmt::PMT_NIL) {
+                return true;
+            }
+            if(pmt::is_bool(v)) {
+                val = pmt::to_bool(v);
+            } else if(pmt::is_integer(v)) {
+                val = (pmt::to_long(v) != 0);
+            } else {
+                LOG_WARNING("FOCC overhead: %s must be a boolean", key);
+                return false;
+            }
+            return true;
+        }
+
+        /*
+         * A dict of overhead settings to change; anything left out keeps its
+         * current value.  If any setting is bad, nothing changes.
+         */
+        void
+        focc_impl::overhead_message(pmt::pmt_t msg) {
+            if(pmt::is_dict(msg) == false) {
+                LOG_WARNING("FOCC overhead: ignoring message that isn't a dict");
+                return;
+            }
+            focc_overhead cfg = d_overhead;
+            long sid = cfg.sid, dcc = cfg.dcc, dtx = cfg.dtx, nminusone = cfg.nminusone;
+            long cmax = cfg.cmax, regincr = cfg.regincr, fillers = cfg.fillers, olc = cfg.olc;
+            bool ok = overhead_int(msg, "sid", 0, 32767, sid)
+                && overhead_int(msg, "dcc", 0, 3, dcc)
+                && overhead_int(msg, "dtx", 0, 3, dtx)
+                && overhead_int(msg, "nminusone", 0, 31, nminusone)
+                && overhead_int(msg, "cmax", 0, 127, cmax)
+                && overhead_int(msg, "regincr", 0, 4095, regincr)
+                && overhead_int(msg, "fillers", 0, 1000, fillers)
+                && overhead_int(msg, "olc", 0, OLC_ALL, olc)
+                && overhead_bool(msg, "ep", cfg.ep)
+                && overhead_bool(msg, "auth", cfg.auth)
+                && overhead_bool(msg, "pci", cfg.pci)
+                && overhead_bool(msg, "s", cfg.s)
+                && overhead_bool(msg, "e", cfg.e)
+                && overhead_bool(msg, "regh", cfg.regh)
+                && overhead_bool(msg, "regr", cfg.regr)
+                && overhead_bool(msg, "rcf", cfg.rcf)
+                && overhead_bool(msg, "cpa", cfg.cpa)
+                && overhead_bool(msg, "bis", cfg.bis);
+            pmt::pmt_t regids = pmt::dict_ref(msg, pmt::mp("regid"), pmt::PMT_NIL);
+            if(ok && regids != pmt::PMT_NIL) {
+                // one REGID, or a tuple/vector of them (one train each)
+                cfg.regids.clear();
+                if(pmt::is_integer(regids)) {
+                    cfg.regids.push_back(pmt::to_long(regids));
+                } else if(pmt::is_tuple(regids) || pmt::is_vector(regids)) {
+                    for(size_t i = 0; i < pmt::length(regids); i++) {
+                        pmt::pmt_t r = pmt::is_tuple(regids) ? pmt::tuple_ref(regids, i) : pmt::vector_ref(regids, i);
+                        if(pmt::is_integer(r) == false) {
+                            ok = false;
+                            break;
+                        }
+                        cfg.regids.push_back(pmt::to_long(r));
+                    }
+                } else {
+                    ok = false;
+                }
+                for(size_t i = 0; ok && i < cfg.regids.size(); i++) {
+                    if(cfg.regids[i] > 0xfffffUL) {
+                        ok = false;
+                    }
+                }
+                if(ok == false || cfg.regids.empty()) {
+                    LOG_WARNING("FOCC overhead: regid must be one or more integers from 0 to 1048575");
+                    ok = false;
+                }
+            }
+            if(ok == false) {
+                return;
+            }
+            cfg.sid = sid;
+            cfg.dcc = dcc;
+            cfg.dtx = dtx;
+            cfg.nminusone = nminusone;
+            cfg.cmax = cmax;
+            cfg.regincr = regincr;
+            cfg.fillers = fillers;
+            cfg.olc = olc;
+            const unsigned int period = train_frames(cfg) + cfg.fillers;
+            if(period < OVERHEAD_MIN_FRAMES || period > OVERHEAD_MAX_FRAMES) {
+                LOG_WARNING("FOCC overhead: a train and its fillers take %u frames; 553 3.7.1.2 needs %u to %u",
+                        period, OVERHEAD_MIN_FRAMES, OVERHEAD_MAX_FRAMES);
+                return;
+            }
+            configure_overhead(cfg);
+            LOG_DEBUG("FOCC overhead: SID %hu DCC %u REGH %d REGR %d CMAX %u N-1 %u BIS %d REGINCR %u OLC %04x; swapping in at the next superframe",
+                    cfg.sid, (unsigned int)cfg.dcc, (int)cfg.regh, (int)cfg.regr, (unsigned int)cfg.cmax,
+                    (unsigned int)cfg.nminusone, (int)cfg.bis, (unsigned int)cfg.regincr, cfg.olc);
         }
 
         /* This method has been called when all the samples in the current 
@@ -489,22 +762,48 @@ namespace gr {
             //std::cout << "XXX next_burst_state cur_seg_idx " << cur_seg_idx << " size " << cur_frame->segments.size() << std::endl;
             assert(cur_seg_idx <= cur_frame->segments.size());
             if(cur_seg_idx == cur_frame->segments.size()) {
-                cur_frame_idx = cur_frame_idx + 1;
-                assert(cur_frame_idx <= superframe_frames.size());      // XXX remove
-                if(cur_frame_idx == superframe_frames.size()) {
-                    cur_frame_idx = 0;
+                d_period_frames++;
+                // cur_frame_idx still points at the slot, if a queued
+                // message took it
+                const bool in_slot = superframe_frames[cur_frame_idx]->is_filler;
+                unsigned int next_idx = cur_frame_idx + 1;
+                assert(next_idx <= superframe_frames.size());      // XXX remove
+                if(next_idx == superframe_frames.size()) {
+                    next_idx = 0;
                 }
                 if(cur_frame->is_ephemeral) {
                     delete cur_frame;
                 }
-                cur_frame = superframe_frames[cur_frame_idx];
-                if(cur_frame->is_filler) {
-                    focc_frame *nframe = pop_frame_queue();
+                focc_frame *nframe = NULL;
+                if(superframe_frames[next_idx]->is_filler) {
+                    cur_frame_idx = next_idx;
+                    cur_frame = superframe_frames[cur_frame_idx];
+                    nframe = pop_frame_queue();
                     if(nframe != NULL) {
                         cur_frame = nframe;
+                        d_message_slots++;
+                    } else {
+                        d_filler_slots++;
                     }
+                } else if(in_slot && d_period_frames < OVERHEAD_MAX_FRAMES
+                        && (nframe = pop_frame_queue()) != NULL) {
+                    // The next train is due, but messages are waiting and
+                    // it can still be put off: send one in an extra slot.
+                    cur_frame = nframe;
+                    d_message_slots++;
+                    d_extra_slots++;
+                } else {
+                    cur_frame_idx = next_idx;
+                    if(cur_frame_idx == 0) {
+                        swap_superframe();
+                    }
+                    if(in_slot) {
+                        d_period_frames = 0;        // a new train starts
+                    }
+                    cur_frame = superframe_frames[cur_frame_idx];
                 }
                 cur_seg_idx = 0;
+                d_trace_start = (cur_frame->trace != pmt::PMT_NIL);
             }
             focc_segment *seg = cur_frame->segments[cur_seg_idx];
             cur_burst_state = seg->state;
@@ -520,46 +819,160 @@ namespace gr {
 
         void 
         focc_impl::focc_words_message(pmt::pmt_t msg) {
+            profile_scope prof(d_profiler, d_prof_focc_words);
             assert(msg.is_tuple());
             size_t len = length(msg);
             assert(len > 2);
             long stream = to_long(tuple_ref(msg, 0));
             long nwords = to_long(tuple_ref(msg, 1));
-            assert(nwords == len-2);
+            // The words may be followed by a trace dict (see RECC Decode).
+            assert(nwords == len-2 || nwords == len-3);
+            pmt::pmt_t trace = pmt::PMT_NIL;
+            if(nwords == len-3 && pmt::is_dict(tuple_ref(msg, len-1))) {
+                trace = tuple_ref(msg, len-1);
+            }
+            const uint64_t now = monotonic_ns();
             for(long i = 0; i < nwords; i++) {
                 pmt::pmt_t blob = tuple_ref(msg, 2+i);
                 size_t blen = pmt::blob_length(blob);
                 assert(blen == 28);
-                const char *bdata = static_cast<const char *>(pmt::blob_data(blob));
-                focc_frame *frame = NULL;
-                switch(stream) {
-                    case STREAM_A:
-                        {
-                            std::vector<char> word_a(bdata, bdata+blen);
-                            std::vector<char> word_b = control_filler_word();
-                            frame = make_frame(word_a, word_b, true, false);
-                        }
-                        break;
-                    case STREAM_B:
-                        {
-                            std::vector<char> word_a = control_filler_word();
-                            std::vector<char> word_b(bdata, bdata+blen);
-                            frame = make_frame(word_a, word_b, true, false);
-                        }
-                        break;
-                    case STREAM_BOTH:
-                        {
-                            std::vector<char> word_a(bdata, bdata+blen);
-                            std::vector<char> word_b(bdata, bdata+blen);
-                            frame = make_frame(word_a, word_b, true, false);
-                        }
-                        break;
-                    default:
-                        assert(0);
+                render_job job;
+                job.stream = stream;
+                memcpy(job.word, pmt::blob_data(blob), sizeof(job.word));
+                // Word 1 of a mobile station control message (T1T2 = 0x)
+                // carries the DCC; make it match the overhead train's.
+                if(job.word[0] == 0) {
+                    job.word[2] = ((d_overhead.dcc & 0x2) == 0x2) ? 1 : 0;
+                    job.word[3] = ((d_overhead.dcc & 0x1) == 0x1) ? 1 : 0;
+                }
+                job.trace = (i == 0) ? trace : pmt::PMT_NIL;
+                job.queued_ns = now;
+                if(post_render(job) == false) {
+                    d_render_inline++;
+                    render(job, bch);
+                }
+            }
+        }
+
+        /*
+         * Hand a word to the render thread, waiting for room if the inbox
+         * is full (which keeps the words in order).  Returns false, leaving
+         * the word to the caller, if there's no render thread.  The word is
+         * queued with d_render_mutex held, so once stop() has cleared
+         * d_render_running nothing more can land in the inbox behind its
+         * final drain.
+         */
+        bool
+        focc_impl::post_render(const render_job &job) {
+            {
+                boost::mutex::scoped_lock lock(d_render_mutex);
+                while(d_render_running && d_inbox.head - d_inbox.tail == FOCC_RENDER_RING) {
+                    d_room_cond.wait(lock);
+                }
+                if(d_render_running == false) {
+                    return false;
+                }
+                d_inbox.jobs[d_inbox.head & (FOCC_RENDER_RING - 1)] = job;
+                d_inbox.head++;
+            }
+            d_render_cond.notify_one();
+            return true;
+        }
+
+        // Encode one word into a frame and queue it for a slot.
+        void
+        focc_impl::render(const render_job &job, itpp::BCH &coder) {
+            profile_scope prof(d_profiler, d_prof_render);
+            prof.set_budget(FOCC_RENDER_BUDGET_NS);
+            std::vector<char> word(job.word, job.word + sizeof(job.word));
+            focc_frame *frame = NULL;
+            switch(job.stream) {
+                case STREAM_A:
+                    frame = make_frame(word, control_filler_word(), true, false, coder);
+                    break;
+                case STREAM_B:
+                    frame = make_frame(control_filler_word(), word, true, false, coder);
+                    break;
+                case STREAM_BOTH:
+                    frame = make_frame(word, word, true, false, coder);
+                    break;
+                default:
+                    assert(0);
+                    return;
+            }
+            frame->trace = job.trace;
+            push_frame_queue(frame);
+            d_render_hist.record((monotonic_ns() - job.queued_ns) / 1000);
+        }
+
+        /*
+         * Render thread: take words from the inbox as they come, and sleep
+         * until the next one when there are none.  Each word is rendered
+         * with the lock released, so the handler can keep queueing.
+         */
+        void
+        focc_impl::render_loop() {
+            while(true) {
+                render_job job;
+                {
+                    boost::mutex::scoped_lock lock(d_render_mutex);
+                    while(d_render_running && d_inbox.tail == d_inbox.head) {
+                        d_render_cond.wait(lock);
+                    }
+                    if(d_render_running == false) {
                         break;
+                    }
+                    render_job &queued = d_inbox.jobs[d_inbox.tail & (FOCC_RENDER_RING - 1)];
+                    job = queued;
+                    queued.trace = pmt::PMT_NIL;
+                    d_inbox.tail++;
+                }
+                d_room_cond.notify_one();
+                render(job, d_render_bch);
+            }
+        }
+
+        bool
+        focc_impl::start() {
+            {
+                boost::mutex::scoped_lock lock(d_render_mutex);
+                d_render_running = true;
+            }
+            d_render_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&focc_impl::render_loop, this)));
+            return block::start();
+        }
+
+        /*
+         * Stop the render thread, then render whatever it left behind, so
+         * no message is lost across a stop and start.  Handlers that run
+         * after this render their words themselves (see post_render()).
+         */
+        bool
+        focc_impl::stop() {
+            {
+                boost::mutex::scoped_lock lock(d_render_mutex);
+                d_render_running = false;
+            }
+            d_render_cond.notify_one();
+            d_room_cond.notify_all();
+            if(d_render_thread) {
+                d_render_thread->join();
+                d_render_thread.reset();
+            }
+            {
+                boost::mutex::scoped_lock lock(d_render_mutex);
+                while(d_inbox.tail != d_inbox.head) {
+                    render_job &job = d_inbox.jobs[d_inbox.tail & (FOCC_RENDER_RING - 1)];
+                    render(job, d_render_bch);
+                    job.trace = pmt::PMT_NIL;
+                    d_inbox.tail++;
                 }
-                push_frame_queue(frame);
             }
+            return block::stop();
+        }
+
+        void focc_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
         }
 
         void 
@@ -568,6 +981,24 @@ namespace gr {
             frame_queue.push(frame);
         }
 
+        /*
+         * Once a second, post how many mobile station control messages are
+         * waiting for a slot, for overload control.
+         */
+        void
+        focc_impl::report_queue(uint64_t now) {
+            size_t depth;
+            {
+                boost::mutex::scoped_lock lock(frame_queue_mutex);
+                depth = frame_queue.size();
+            }
+            pmt::pmt_t d = pmt::make_dict();
+            d = pmt::dict_add(d, pmt::mp("queue_depth"), pmt::from_uint64(depth));
+            d = pmt::dict_add(d, pmt::mp("time_ns"), pmt::from_uint64(now));
+            message_port_pub(pmt::mp("queue_stats"), d);
+            d_queue_report_ns = now + 1000000000ULL;
+        }
+
         focc_frame *
         focc_impl::pop_frame_queue() {
             boost::mutex::scoped_lock lock(frame_queue_mutex);
@@ -579,24 +1010,136 @@ namespace gr {
             return frame;
         }
 
+        /*
+         * The traced frame's first sample is about to go out at out[optr]:
+         * tag it with the trace (so a sink that knows the hardware clock can
+         * finish the measurement on the air), and account for the latency
+         * as far as this block can see it.
+         */
+        void
+        focc_impl::emit_trace(unsigned int optr) {
+            d_trace_start = false;
+            const uint64_t now = monotonic_ns();
+            const uint64_t offset = nitems_written(0) + optr;
+            pmt::pmt_t trace = cur_frame->trace;
+            trace = pmt::dict_add(trace, pmt::mp("tx_offset"), pmt::from_uint64(offset));
+            trace = pmt::dict_add(trace, pmt::mp("tx_ns"), pmt::from_uint64(now));
+            add_item_tag(0, offset, pmt::mp("amps_trace"), trace);
+
+            pmt::pmt_t detect = pmt::dict_ref(trace, pmt::mp("detect_ns"), pmt::PMT_NIL);
+            pmt::pmt_t decode = pmt::dict_ref(trace, pmt::mp("decode_ns"), pmt::PMT_NIL);
+            if(pmt::is_integer(detect) || pmt::is_uint64(detect)) {
+                const uint64_t total_us = (now - pmt::to_uint64(detect)) / 1000;
+                d_total_hist.record(total_us);
+                trace = pmt::dict_add(trace, pmt::mp("total_ms"), pmt::from_double(total_us / 1000.0));
+            }
+            if(pmt::is_integer(decode) || pmt::is_uint64(decode)) {
+                const uint64_t queue_us = (now - pmt::to_uint64(decode)) / 1000;
+                d_queue_hist.record(queue_us);
+                trace = pmt::dict_add(trace, pmt::mp("queue_ms"), pmt::from_double(queue_us / 1000.0));
+            }
+            message_port_pub(pmt::mp("latency"), trace);
+            if(d_latency_report_ns == 0) {
+                d_latency_report_ns = now;
+            } else if(now - d_latency_report_ns >= 10000000000ULL) {
+                report_latency(now);
+            }
+        }
+
+        /*
+         * Post (and log) the response-latency distribution and slot usage
+         * since the last report, then start over.
+         */
+        void
+        focc_impl::report_latency(uint64_t now) {
+            const latency_histogram &t = d_total_hist;
+            const latency_histogram &q = d_queue_hist;
+            pmt::pmt_t d = pmt::make_dict();
+            d = pmt::dict_add(d, pmt::mp("count"), pmt::from_uint64(t.count()));
+            d = pmt::dict_add(d, pmt::mp("p50_ms"), pmt::from_double(t.percentile(50) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("p90_ms"), pmt::from_double(t.percentile(90) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("p99_ms"), pmt::from_double(t.percentile(99) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("max_ms"), pmt::from_double(t.max() / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("queue_p50_ms"), pmt::from_double(q.percentile(50) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("queue_p99_ms"), pmt::from_double(q.percentile(99) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("render_p50_ms"), pmt::from_double(d_render_hist.percentile(50) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("render_p99_ms"), pmt::from_double(d_render_hist.percentile(99) / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("render_max_ms"), pmt::from_double(d_render_hist.max() / 1000.0));
+            d = pmt::dict_add(d, pmt::mp("render_inline"), pmt::from_uint64(d_render_inline));
+            d = pmt::dict_add(d, pmt::mp("message_slots"), pmt::from_uint64(d_message_slots));
+            d = pmt::dict_add(d, pmt::mp("filler_slots"), pmt::from_uint64(d_filler_slots));
+            d = pmt::dict_add(d, pmt::mp("extra_slots"), pmt::from_uint64(d_extra_slots));
+            message_port_pub(pmt::mp("latency_stats"), d);
+            LOG_INFO("FOCC response latency: %llu answers; p50 %.1f ms p90 %.1f ms p99 %.1f ms max %.1f ms (waiting for a slot: p50 %.1f ms p99 %.1f ms)",
+                    (unsigned long long)t.count(), t.percentile(50) / 1000.0, t.percentile(90) / 1000.0,
+                    t.percentile(99) / 1000.0, t.max() / 1000.0, q.percentile(50) / 1000.0, q.percentile(99) / 1000.0);
+            LOG_INFO("FOCC render: p50 %.2f ms p99 %.2f ms max %.2f ms",
+                    d_render_hist.percentile(50) / 1000.0, d_render_hist.percentile(99) / 1000.0,
+                    d_render_hist.max() / 1000.0);
+            LOG_INFO("FOCC slots: %llu messages (%llu past the nominal train period), %llu filler",
+                    (unsigned long long)d_message_slots, (unsigned long long)d_extra_slots,
+                    (unsigned long long)d_filler_slots);
+            d_total_hist.reset();
+            d_queue_hist.reset();
+            d_render_hist.reset();
+            d_message_slots = 0;
+            d_filler_slots = 0;
+            d_extra_slots = 0;
+            d_latency_report_ns = now;
+        }
+
         int
         focc_impl::work(int noutput_items,
                   gr_vector_const_void_star &input_items,
                   gr_vector_void_star &output_items) {
             unsigned char *out = (unsigned char *) output_items[0];
-            // XXX: remove this
-            const unsigned int samples_per_sym = d_symrate / 20000;
+            profile_scope prof(d_profiler, d_prof_work);
 
             if(noutput_items < 1) {
-                std::cout << "noutput_items is empty: " << noutput_items << std::endl;
+                LOG_WARNING("noutput_items is empty: %d", noutput_items);
                 return -1;
             }
+
+            const uint64_t now = monotonic_ns();
+            if(now >= d_queue_report_ns) {
+                report_queue(now);
+            }
+
+            int totalout;
+            if(d_clock.integral()) {
+                totalout = fill(out, noutput_items, 0);
+            } else {
+                totalout = stretch(out, noutput_items);
+            }
+
+#ifdef AMPS_DEBUG
+            static unsigned int debugcount = 500000;
+            if(totalout > 0 && debugcount > 0) {
+                write(debugfd, out, totalout);
+                debugcount -= totalout;
+            }
+#endif
+            prof.set_budget((totalout * 1000000000ULL) / d_symrate);
+            return totalout;
+        }
+
+        /*
+         * Copy up to noutput_items rendered samples of the current frame
+         * into out, stopping early at the end of each frame's word.  base is
+         * out's offset from the start of this work() call's output, for
+         * trace tags.  Returns the number of samples written.
+         */
+        int
+        focc_impl::fill(unsigned char *out, int noutput_items, unsigned int base) {
             unsigned int optr = 0;
             int totalout = 0;
 
             int outleft = noutput_items;
             while(outleft > 0) {
                 //printf("XXX YO optr %u c_b_s %d  cur_off %d\n", optr, cur_burst_state, cur_off);
+                if(d_trace_start) {
+                    emit_trace(base + optr);
+                }
                 if(cur_burst_state == FOCC_BI_BIT) {
                     int samps_to_send = (samples_per_sym*2) - cur_off;
                     int toxfer = MIN(outleft, samps_to_send);
@@ -631,19 +1174,40 @@ namespace gr {
                     next_burst_state();
                     return totalout;
                 } else {
-                    std::cout << "invalid value for cur_burst_state: " << cur_burst_state << std::endl;
+                    LOG_WARNING("invalid value for cur_burst_state: %d", (int)cur_burst_state);
                     assert(0);
                 }
             }
+            return totalout;
+        }
 
-#ifdef AMPS_DEBUG
-            static unsigned int debugcount = 500000;
-            if(totalout > 0 && debugcount > 0) {
-                write(debugfd, out, totalout);
-                debugcount -= totalout;
+        /*
+         * Output at a rate that isn't a multiple of 20 kHz: take rendered
+         * half-bits from fill(), a chunk at a time, and give each one as
+         * many output samples as d_clock says.  A traced frame always starts
+         * a fresh chunk, right where the last half-bit ran out, so its tag
+         * still lands on its first sample.
+         */
+        int
+        focc_impl::stretch(unsigned char *out, int noutput_items) {
+            int produced = 0;
+            while(produced < noutput_items) {
+                if(d_hold_left == 0) {
+                    if(d_hb_off == d_hb_len) {
+                        d_hb_len = fill(d_halfbits, FOCC_HALFBIT_CHUNK, produced);
+                        d_hb_off = 0;
+                        continue;
+                    }
+                    d_hold_val = d_halfbits[d_hb_off];
+                    d_hb_off++;
+                    d_hold_left = d_clock.next();
+                }
+                const int toxfer = MIN((int)d_hold_left, noutput_items - produced);
+                memset(&out[produced], d_hold_val, toxfer);
+                produced += toxfer;
+                d_hold_left -= toxfer;
             }
-#endif
-            return totalout;
+            return produced;
         }
 
 
@@ -677,7 +1241,8 @@ namespace gr {
                         out[i] = 1;
                         break;
                     default:
-                        std::cout << "invalid value in bitqueue" << std::endl;
+                        LOG_WARNING("invalid value in bitqueue");
+                        log_flush();
                         abort();
                         break;
                 }
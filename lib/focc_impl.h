@@ -12,9 +12,15 @@
 
 #include <amps/focc.h>
 #include <queue>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <itpp/comm/bch.h>
 #include "amps_packet.h"
 #include "amps_common.h"
+#include "latency_histogram.h"
+#include "block_profiler.h"
+#include "symbol_clock.h"
 
 using namespace itpp;
 using std::string;
@@ -30,7 +36,62 @@ using boost::shared_ptr;
 
 namespace gr {
   namespace amps {
+
+    // All access overload classes may originate: no overload control word.
+    static const unsigned int OLC_ALL = 0xffff;
+
+    // Overhead train contents (553 3.7.1.2).  NAWC isn't set here: it
+    // follows from whether there's a REGINCR word.
+    struct focc_overhead {
+        unsigned short sid;
+        unsigned char dcc;
+        bool ep, auth, pci;             // overhead word 1
+        bool s, e, regh, regr;          // overhead word 2
+        unsigned char dtx;
+        unsigned char nminusone;
+        bool rcf, cpa;
+        unsigned char cmax;
+        bool bis;                       // access type parameters global action
+        unsigned int olc;               // overload control global action; OLC_ALL for none
+        unsigned int regincr;           // REGINCR global action; 0 for none
+        std::vector<unsigned long> regids;  // one overhead train per REGID
+        unsigned int fillers;           // filler frames after each train
+    };
+
+    // An overhead change waiting for the next superframe boundary: either a
+    // whole new superframe (if the layout changed), or new frames for just
+    // the slots whose words changed.
+    struct focc_superframe_update {
+        bool whole;
+        std::vector<focc_frame *> frames;
+        std::vector<size_t> slots;      // frames[i] goes in slot slots[i]
+    };
       
+    // Half-bits work() asks fill() for at a time at fractional rates.
+    static const int FOCC_HALFBIT_CHUNK = 64;
+
+    // Render inbox size, in words; a power of two.
+    static const size_t FOCC_RENDER_RING = 512;
+
+    // One mobile station control word waiting to be made into a frame.
+    struct render_job {
+        long stream;
+        char word[28];
+        pmt::pmt_t trace;               // for the message's first word; else PMT_NIL
+        uint64_t queued_ns;
+    };
+
+    /*
+     * Ring of words from focc_words_message to the render thread, guarded
+     * by focc_impl::d_render_mutex.  The handler queues at head and the
+     * render thread takes from tail.
+     */
+    struct render_inbox {
+        render_job jobs[FOCC_RENDER_RING];
+        uint64_t head;
+        uint64_t tail;
+    };
+
     class focc_impl : public focc
     {
     private:
@@ -39,14 +100,23 @@ namespace gr {
         boost::mutex frame_queue_mutex;
 
         std::queue<bool> d_bitqueue;    // Queue of symbols to be sent out.
-        unsigned long d_symrate;        // output symbol rate (must be evenly divisible by the baud rate)
+        unsigned long d_symrate;        // output symbol rate (at least 20000; see symbol_clock.h)
         bool d_aggressive_registration; // Enables aggressive registration superframe
         itpp::BCH bch;
 
         char *BI_zero_buf;        // Entire burst of symbols to send when B/I bit = 0
         char *BI_one_buf;         // Entire burst of symbols to send when B/I bit = 1
 
-        const unsigned int samples_per_sym;
+        // At a multiple of 20 kHz, frames are rendered at the output rate and
+        // copied straight out.  Otherwise they're rendered one sample per
+        // half-bit, and work() stretches each half-bit out with d_clock.
+        symbol_clock d_clock;
+        const unsigned int samples_per_sym;     // per half-bit, in rendered frames
+        unsigned char d_halfbits[FOCC_HALFBIT_CHUNK];
+        int d_hb_off;
+        int d_hb_len;
+        unsigned char d_hold_val;       // half-bit being stretched
+        unsigned int d_hold_left;       // output samples still owed to it
         burst_state cur_burst_state; 
 #ifdef AMPS_DEBUG
         int debugfd;
@@ -60,21 +130,78 @@ namespace gr {
 
         std::vector<focc_frame *> superframe_frames;
 
+        // Runtime overhead changes: configure_overhead() encodes the words
+        // that changed off to the side, and next_burst_state() puts them in
+        // place when the current superframe ends.
+        focc_overhead d_overhead;
+        focc_superframe_update *d_pending_superframe;
+
+        // Slot scheduling (see next_burst_state())
+        unsigned int d_period_frames;   // frames since the current train started
+        uint64_t d_message_slots;       // since the last latency report
+        uint64_t d_filler_slots;
+        uint64_t d_extra_slots;         // messages sent past the nominal period
+        uint64_t d_queue_report_ns;     // next queue_stats post
+
+        // Response latency: from the RECC burst's detection (and from
+        // RECC Decode's answer) to the first sample of the answering frame.
+        bool d_trace_start;             // cur_frame is traced and hasn't started yet
+        latency_histogram d_total_hist;
+        latency_histogram d_queue_hist;
+        uint64_t d_latency_report_ns;
+
+        // work() and message handler timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+        const int d_prof_focc_words;
+        const int d_prof_render;
+
+        // Render stage: focc_words_message only queues words; the render
+        // thread BCH-encodes them (with its own coder) into frames.
+        render_inbox d_inbox;
+        itpp::BCH d_render_bch;
+        latency_histogram d_render_hist;        // words queued -> frame ready, in us
+        uint64_t d_render_inline;               // rendered in the handler: no render thread
+        bool d_render_running;
+        boost::mutex d_render_mutex;            // guards d_inbox and d_render_running
+        boost::condition_variable d_render_cond;        // a word was queued, or stop()
+        boost::condition_variable d_room_cond;          // a word was taken, or stop()
+        boost::shared_ptr<boost::thread> d_render_thread;
+
         inline void queuebit(bool bit);
         inline unsigned long queuesize() { return d_bitqueue.size(); }
         void queue_dup(bvec &bv);
-        void make_superframe();
-        void make_registration_superframe();
+        static focc_overhead default_overhead(bool aggressive_registration);
+        void superframe_words(const focc_overhead &cfg, std::vector<std::vector<char> > &words, std::vector<bool> &fillers);
+        void build_superframe(const focc_overhead &cfg, std::vector<focc_frame *> &frames);
+        void start_superframe();
+        void swap_superframe();
+        static void free_update(focc_superframe_update *update);
         void validate_superframe();
-        std::vector<char> focc_bch(std::vector<char> inbits);
+        std::vector<char> focc_bch(std::vector<char> inbits, itpp::BCH &coder);
         focc_frame *make_frame(std::vector<char> word_a, std::vector<char> word_b, bool ephemeral=false, bool filler=false);
+        focc_frame *make_frame(std::vector<char> word_a, std::vector<char> word_b, bool ephemeral, bool filler, itpp::BCH &coder);
+        void render(const render_job &job, itpp::BCH &coder);
+        bool post_render(const render_job &job);
+        void render_loop();
         void next_burst_state();
+        int fill(unsigned char *out, int noutput_items, unsigned int base);
+        int stretch(unsigned char *out, int noutput_items);
+        void emit_trace(unsigned int optr);
+        void report_latency(uint64_t now);
+        void report_queue(uint64_t now);
 
     public:
         focc_impl(unsigned long symrate, bool aggressive_registration);
         ~focc_impl();
 
+        bool start();
+        bool stop();
+
         void focc_words_message(pmt::pmt_t msg);
+        void overhead_message(pmt::pmt_t msg);
+        void configure_overhead(const focc_overhead &cfg);
+        void profile_query_message(pmt::pmt_t msg);
         void push_frame_queue(focc_frame *frame);
         focc_frame *pop_frame_queue();
         void queue_file();
@@ -0,0 +1,147 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "focc_receiver.h"
+#include <string.h>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    // Dotting (1010101010), a busy-idle bit, then word sync (11100010010):
+    // the 22 bits that end at the start of a frame's words.
+    static const uint32_t FOCC_SYNC_PATTERN = (0x2aaU << 12) | 0x712U;
+    static const uint32_t FOCC_SYNC_MASK = (0x3ffU << 12) | 0x7ffU;
+    static const int FOCC_SYNC_MAX_ERRS = 2;    // once locked
+    static const unsigned int FOCC_FRAME_BITS = 440;   // 5 x (A, B), each 4 x (BI + 10 bits)
+    static const unsigned int FOCC_GAP_BITS = 23;      // BI, dotting, BI, word sync
+
+    focc_receiver::focc_receiver()
+        : bch(63, 2, true), d_state(RX_HUNT), d_prev(0.0f), d_nhalf(0), d_parity(0),
+        d_shift(0), d_bitidx(0), d_idle(true),
+        d_frames(0), d_bad_words(0), d_sync_losses(0) {
+        d_violations[0] = d_violations[1] = 0;
+        memset(&d_frame, 0, sizeof(d_frame));
+    }
+
+    /*
+     * Take one half-bit.  Returns true when it completed a frame, which is
+     * then available from frame().
+     */
+    bool focc_receiver::push(float halfbit) {
+        const int parity = d_nhalf & 1;
+        const bool violation = ((halfbit > 0.0f) == (d_prev > 0.0f));
+        const float prev = d_prev;
+        d_prev = halfbit;
+        d_nhalf++;
+
+        // Leaky count of violations for each pairing.  The right one only
+        // sees them from noise; the wrong one from about half the bit
+        // boundaries.
+        unsigned int &v = d_violations[parity];
+        v -= v >> 5;
+        if(violation) {
+            v += 16;
+        }
+        if(parity != d_parity) {
+            return false;
+        }
+        if(d_violations[d_parity] > d_violations[d_parity ^ 1] + 64) {
+            d_parity ^= 1;
+            if(d_state == RX_FRAME) {
+                d_sync_losses++;
+            }
+            d_state = RX_HUNT;
+            return false;
+        }
+        // 0 is sent high-low, 1 low-high.
+        return push_bit(halfbit > prev ? 1 : 0);
+    }
+
+    bool focc_receiver::push_bit(unsigned char bit) {
+        d_shift = (d_shift << 1) | bit;
+        if(d_state == RX_HUNT) {
+            if((d_shift & FOCC_SYNC_MASK) == FOCC_SYNC_PATTERN) {
+                d_idle = ((d_shift >> 11) & 1) == 1;
+                d_state = RX_FRAME;
+                d_bitidx = 0;
+            }
+            return false;
+        }
+
+        if(d_bitidx < FOCC_FRAME_BITS) {
+            if((d_bitidx % 11) == 0) {
+                d_idle = (bit == 1);
+            }
+            d_bits[d_bitidx] = bit;
+            d_bitidx++;
+            if(d_bitidx == FOCC_FRAME_BITS) {
+                decode_frame();
+                d_frames++;
+                return true;
+            }
+            return false;
+        }
+
+        // Between frames: the leading busy-idle bit, dotting, another
+        // busy-idle bit and word sync.  Check the sync loosely, since we
+        // know where it should be.
+        d_bitidx++;
+        if(d_bitidx == FOCC_FRAME_BITS + 1 || d_bitidx == FOCC_FRAME_BITS + 12) {
+            d_idle = (bit == 1);
+        }
+        if(d_bitidx == FOCC_FRAME_BITS + FOCC_GAP_BITS) {
+            const int errs = __builtin_popcount((d_shift ^ FOCC_SYNC_PATTERN) & FOCC_SYNC_MASK);
+            if(errs <= FOCC_SYNC_MAX_ERRS) {
+                d_bitidx = 0;
+            } else {
+                d_sync_losses++;
+                d_state = RX_HUNT;
+            }
+        }
+        return false;
+    }
+
+    /*
+     * Pull the five repeats of each stream's codeword out of the frame
+     * (skipping busy-idle bits) and decode them.
+     */
+    void focc_receiver::decode_frame() {
+        unsigned char reps[2][5][40];
+        for(unsigned int i = 0; i < FOCC_FRAME_BITS; i++) {
+            const unsigned int j = i % 11;
+            if(j == 0) {
+                continue;
+            }
+            const unsigned int group = i / 44;      // A0, B0, A1, B1, ...
+            const unsigned int bitno = ((i % 44) / 11) * 10 + (j - 1);
+            reps[group & 1][group >> 1][bitno] = d_bits[i];
+        }
+        for(int s = 0; s < 2; s++) {
+            unsigned char vote[40];
+            for(int b = 0; b < 40; b++) {
+                int ones = 0;
+                for(int r = 0; r < 5; r++) {
+                    ones += reps[s][r][b];
+                }
+                vote[b] = (ones >= 3) ? 1 : 0;
+            }
+            d_frame.valid[s] = bch_decode_40(bch, vote, d_frame.words[s]);
+            for(int r = 0; r < 5 && d_frame.valid[s] == false; r++) {
+                d_frame.valid[s] = bch_decode_40(bch, reps[s][r], d_frame.words[s]);
+            }
+            if(d_frame.valid[s] == false) {
+                d_bad_words++;
+            }
+        }
+    }
+
+  } // namespace amps
+} // namespace gr
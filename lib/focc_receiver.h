@@ -0,0 +1,73 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_FOCC_RECEIVER_H
+#define INCLUDED_AMPS_FOCC_RECEIVER_H
+
+#include <itpp/comm/bch.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    // One decoded FOCC frame: a word from each stream.
+    struct focc_rx_frame {
+        bool valid[2];              // [0] is stream A, [1] stream B
+        unsigned char words[2][28];
+    };
+
+    /*
+     * Mobile-side FOCC receiver (553 3.7.1).  It takes the channel as soft
+     * Manchester half-bits at 20 kHz (positive for the first half of a 0),
+     * picks the half-bit pairing with the fewest Manchester violations,
+     * finds dotting and word sync, strips the busy-idle bits and decodes
+     * the five repeats of each stream's word: by majority vote first, then
+     * repeat by repeat if the vote doesn't pass the BCH check.
+     */
+    class focc_receiver {
+        private:
+        enum rx_state {
+            RX_HUNT,                // looking for dotting + word sync
+            RX_FRAME                // collecting a frame's words
+        };
+
+        itpp::BCH bch;
+        rx_state d_state;
+        float d_prev;               // previous half-bit
+        uint64_t d_nhalf;           // half-bits seen
+        int d_parity;               // which half-bit parity starts a bit
+        unsigned int d_violations[2];
+        uint32_t d_shift;           // last 32 bits, newest in bit 0
+        unsigned int d_bitidx;      // bits into the current frame
+        unsigned char d_bits[440];
+        bool d_idle;                // last busy-idle bit
+        focc_rx_frame d_frame;
+
+        uint64_t d_frames;
+        uint64_t d_bad_words;
+        uint64_t d_sync_losses;
+
+        bool push_bit(unsigned char bit);
+        void decode_frame();
+
+        public:
+        focc_receiver();
+
+        bool push(float halfbit);
+        const focc_rx_frame &frame() const { return d_frame; }
+        bool idle() const { return d_idle; }
+        bool locked() const { return d_state == RX_FRAME; }
+
+        uint64_t frames() const { return d_frames; }
+        uint64_t bad_words() const { return d_bad_words; }
+        uint64_t sync_losses() const { return d_sync_losses; }
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_FOCC_RECEIVER_H */
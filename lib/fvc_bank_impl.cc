@@ -0,0 +1,160 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "fvc_bank_impl.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdexcept>
+#include "utils.h"
+
+using std::vector;
+
+namespace gr {
+    namespace amps {
+
+        fvc_bank::sptr
+        fvc_bank::make(unsigned long symrate, int nchans, unsigned long repeats, unsigned long duration) {
+            return gnuradio::get_initial_sptr (new fvc_bank_impl(symrate, nchans, repeats, duration));
+        }
+
+        fvc_bank_impl::fvc_bank_impl(unsigned long symrate, int nchans, unsigned long repeats, unsigned long duration)
+          : sync_block("fvc_bank",
+                  io_signature::make(0, 0, 0),
+                  io_signature::make(nchans, nchans, sizeof (unsigned char))),
+          d_symrate(symrate), d_nchans(nchans), d_cache(symrate),
+          d_default_repeats(repeats), d_default_duration(duration), d_profiler("fvc_bank"),
+          d_prof_work(d_profiler.add_site("work")), d_prof_fvc_words(d_profiler.add_site("fvc_words_message"))
+        {
+            if(nchans < 1) {
+                throw std::invalid_argument("fvc_bank: need at least one channel");
+            }
+            if(symrate < symbol_clock::HALFBIT_RATE) {
+                throw std::invalid_argument("fvc_bank: symrate must be at least 20000");
+            }
+            d_orders.resize(d_nchans);
+
+            message_port_register_in(pmt::mp("fvc_words"));
+            set_msg_handler(pmt::mp("fvc_words"),
+                boost::bind(&fvc_bank_impl::fvc_words_message, this, _1)
+            );
+            message_port_register_in(pmt::mp("order_ack"));
+            set_msg_handler(pmt::mp("order_ack"),
+                boost::bind(&fvc_bank_impl::order_ack_message, this, _1)
+            );
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&fvc_bank_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
+            message_port_register_out(pmt::mp("fvc_status"));
+            for(int c = 0; c < d_nchans; c++) {
+                char name[32];
+                snprintf(name, sizeof(name), "fvc_mute%d", c);
+                d_fvc_mute_ports.push_back(pmt::mp(name));
+                message_port_register_out(d_fvc_mute_ports[c]);
+                snprintf(name, sizeof(name), "audio_mute%d", c);
+                d_audio_mute_ports.push_back(pmt::mp(name));
+                message_port_register_out(d_audio_mute_ports[c]);
+            }
+        }
+
+        fvc_bank_impl::~fvc_bank_impl()
+        {
+        }
+
+        // Called with d_orders_mutex held.
+        void fvc_bank_impl::start_order(int chan, fvc_burst_ptr burst, uint64_t repeats, uint64_t duration, const vector<char> &word1) {
+            d_orders[chan].start(burst, repeats, duration, word1);
+            message_port_pub(d_fvc_mute_ports[chan], pmt::from_bool(false));
+            message_port_pub(d_audio_mute_ports[chan], pmt::from_bool(true));
+        }
+
+        // Called with d_orders_mutex held.
+        void fvc_bank_impl::finish_order(int chan, const char *event) {
+            d_orders[chan].stop();
+            message_port_pub(d_fvc_mute_ports[chan], pmt::from_bool(true));
+            message_port_pub(d_audio_mute_ports[chan], pmt::from_bool(false));
+            pmt::pmt_t status = fvc_status_dict(event, d_orders[chan]);
+            status = pmt::dict_add(status, pmt::mp("chan"), pmt::from_long(chan));
+            message_port_pub(pmt::mp("fvc_status"), status);
+        }
+
+        void fvc_bank_impl::fvc_words_message(pmt::pmt_t msg) {
+            profile_scope prof(d_profiler, d_prof_fvc_words);
+            if(pmt::is_tuple(msg) == false || pmt::length(msg) < 3) {
+                LOG_WARNING("got invalid FVC bank words message");
+                return;
+            }
+            const long chan = pmt::to_long(pmt::tuple_ref(msg, 0));
+            if(chan < 0 || chan >= d_nchans) {
+                LOG_WARNING("FVC bank order for nonexistent channel %ld", chan);
+                return;
+            }
+            uint64_t repeats = d_default_repeats;
+            uint64_t duration = d_default_duration;
+            vector<vector<char> > words;
+            if(parse_fvc_order(msg, 1, repeats, duration, words) == false) {
+                LOG_WARNING("got invalid FVC bank words message");
+                return;
+            }
+            fvc_burst_ptr burst = d_cache.get(words);
+
+            boost::mutex::scoped_lock lock(d_orders_mutex);
+            start_order(chan, burst, repeats, duration, words[0]);
+        }
+
+        void fvc_bank_impl::order_ack_message(pmt::pmt_t msg) {
+            if(pmt::is_dict(msg) == false) {
+                return;
+            }
+            pmt::pmt_t chanv = pmt::dict_ref(msg, pmt::mp("chan"), pmt::PMT_NIL);
+            if(pmt::is_integer(chanv) == false) {
+                return;
+            }
+            const long chan = pmt::to_long(chanv);
+            if(chan < 0 || chan >= d_nchans) {
+                return;
+            }
+            boost::mutex::scoped_lock lock(d_orders_mutex);
+            if(d_orders[chan].acknowledged_by(msg)) {
+                finish_order(chan, "acknowledged");
+            }
+        }
+
+        void fvc_bank_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+        }
+
+        /*
+         * Fill every channel's output in one pass.  Channels without an
+         * active order are muted downstream and just get zeroes.
+         */
+        int
+        fvc_bank_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            profile_scope prof(d_profiler, d_prof_work);
+            prof.set_budget((noutput_items * 1000000000ULL) / d_symrate);
+            boost::mutex::scoped_lock lock(d_orders_mutex);
+            for(int c = 0; c < d_nchans; c++) {
+                char *out = (char *) output_items[c];
+                bool done = false;
+                const size_t written = d_orders[c].emit(out, noutput_items, done);
+                if(done) {
+                    finish_order(c, "complete");
+                }
+                memset(&out[written], 0, noutput_items - written);
+            }
+            return noutput_items;
+        }
+
+    } /* namespace amps */
+} /* namespace gr */
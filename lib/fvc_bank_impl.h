@@ -0,0 +1,56 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_FVC_BANK_IMPL_H
+#define INCLUDED_AMPS_FVC_BANK_IMPL_H
+
+#include <amps/fvc_bank.h>
+#include <vector>
+#include "amps_common.h"
+#include "fvc_order.h"
+#include "block_profiler.h"
+
+namespace gr {
+  namespace amps {
+
+    class fvc_bank_impl : public fvc_bank
+    {
+    private:
+        const unsigned long d_symrate;
+        const int d_nchans;
+        fvc_burst_cache d_cache;
+        const uint64_t d_default_repeats;
+        const uint64_t d_default_duration;
+
+        std::vector<fvc_order_state> d_orders;
+        std::vector<pmt::pmt_t> d_fvc_mute_ports;
+        std::vector<pmt::pmt_t> d_audio_mute_ports;
+        boost::mutex d_orders_mutex;
+
+        // work() and message handler timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+        const int d_prof_fvc_words;
+
+        void start_order(int chan, fvc_burst_ptr burst, uint64_t repeats, uint64_t duration, const std::vector<char> &word1);
+        void finish_order(int chan, const char *event);
+
+    public:
+        fvc_bank_impl(unsigned long symrate, int nchans, unsigned long repeats, unsigned long duration);
+        ~fvc_bank_impl();
+
+        void fvc_words_message(pmt::pmt_t msg);
+        void order_ack_message(pmt::pmt_t msg);
+        void profile_query_message(pmt::pmt_t msg);
+        int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_FVC_BANK_IMPL_H */
@@ -10,11 +10,13 @@
 
 #include <gnuradio/io_signature.h>
 #include "fvc_impl.h"
+#include <string.h>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
 #include <vector>
+#include <stdexcept>
 #include "utils.h"
 
 using namespace itpp;
@@ -31,60 +33,40 @@ namespace gr {
          * AMPS BS FVC. 553 3.7.2.  
          */
         fvc::sptr
-        fvc::make(unsigned long symrate) {
-            return gnuradio::get_initial_sptr (new fvc_impl(symrate));
+        fvc::make(unsigned long symrate, unsigned long repeats, unsigned long duration, int chan) {
+            return gnuradio::get_initial_sptr (new fvc_impl(symrate, repeats, duration, chan));
         }
 
-
-
-        void 
-        fvc_impl::queue(bvec &bv) {
-            for(unsigned int i = 0; i < bv.size(); i++) {
-                queuebit(bv[i]);
-            }
-        }
-        void 
-        fvc_impl::queue(uint32_t val) {
-            for(int i = 0; i < 32; i++) {
-                queuebit(((val & 0x80000000) == 0x80000000) ? 1 : 0);
-                val = val << 1;
-            }
-        }
-
-
-
-        fvc_impl::fvc_impl(unsigned long symrate)
-          : timerhack(0), d_symrate(symrate), bch(63, 2, true), samples_per_sym(symrate / 20000),
-          sync_block("fvc",
+        fvc_impl::fvc_impl(unsigned long symrate, unsigned long repeats, unsigned long duration, int chan)
+          : sync_block("fvc",
                   io_signature::make(0, 0, 0),
-                  io_signature::make(1, 1, sizeof (unsigned char)))
+                  io_signature::make(1, 1, sizeof (unsigned char))),
+          d_symrate(symrate), d_chan(chan), d_cache(symrate),
+          d_default_repeats(repeats), d_default_duration(duration), d_profiler("fvc"),
+          d_prof_work(d_profiler.add_site("work")), d_prof_fvc_words(d_profiler.add_site("fvc_words_message"))
         {
+            if(symrate < symbol_clock::HALFBIT_RATE) {
+                throw std::invalid_argument("fvc: symrate must be at least 20000");
+            }
+            if(chan < 0) {
+                throw std::invalid_argument("fvc: chan must not be negative");
+            }
             message_port_register_in(pmt::mp("fvc_words"));
             set_msg_handler(pmt::mp("fvc_words"),
                 boost::bind(&fvc_impl::fvc_words_message, this, _1)
             );
-            message_port_register_out(pmt::mp("command_out"));
-        }
-
-        // Insert bits into the queue.  Here is also where we repeat a single bit
-        // so that we're emitting d_symrate symbols per second.
-        inline void 
-        fvc_impl::queuebit(bool bit) {
-            if(bit == 1) {
-                for(unsigned int i = 0; i < samples_per_sym; i++) {
-                    d_curdata.push(0);
-                }
-                for(unsigned int i = 0; i < samples_per_sym; i++) {
-                    d_curdata.push(1);
-                }
-            } else {
-                for(unsigned int i = 0; i < samples_per_sym; i++) {
-                    d_curdata.push(1);
-                }
-                for(unsigned int i = 0; i < samples_per_sym; i++) {
-                    d_curdata.push(0);
-                }
-            }
+            message_port_register_in(pmt::mp("order_ack"));
+            set_msg_handler(pmt::mp("order_ack"),
+                boost::bind(&fvc_impl::order_ack_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("fvc_mute"));
+            message_port_register_out(pmt::mp("audio_mute"));
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&fvc_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
+            message_port_register_out(pmt::mp("fvc_status"));
         }
 
         fvc_impl::~fvc_impl()
@@ -92,58 +74,84 @@ namespace gr {
         }
 
         /*
-         * Convert a 28-bit vector (represented as one bit per char, values 
-         * being numeric 0 and 1) to a 40-bit bch-encoded word.
+         * Arm the lifecycle counters for a newly-queued order and switch the
+         * channel from audio to data.  Called with d_order_mutex held.
+         */
+        void fvc_impl::start_order(fvc_burst_ptr burst, uint64_t repeats, uint64_t duration, const vector<char> &word1) {
+            d_order.start(burst, repeats, duration, word1);
+            message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(false));
+            message_port_pub(pmt::mp("audio_mute"), pmt::from_bool(true));
+        }
+
+        /*
+         * The current order has been sent as many times (or for as long) as
+         * requested, or the mobile has confirmed it: stop sending it, hand the
+         * channel back to audio, and report completion.  Called with
+         * d_order_mutex held.
          */
-        void fvc_impl::fvc_bch(std::vector<char> inbits, bvec &outbv) {
-            std::vector<char> outvec(40);
-            bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
-            bvec srcbvec(28);
-            charv_to_bvec(inbits, srcbvec);
-            bvec padded(concat(zeroes, srcbvec));
-            bvec encoded = bch.encode(padded);
-            outbv = encoded(23, encoded.size()-1);
-            assert(outbv.size() == 40);
+        void fvc_impl::finish_order(const char *event) {
+            d_order.stop();
+            message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(true));
+            message_port_pub(pmt::mp("audio_mute"), pmt::from_bool(false));
+            message_port_pub(pmt::mp("fvc_status"), fvc_status_dict(event, d_order));
         }
 
+        /*
+         * fvc_words messages are tuples of (nwords, word blob...), optionally
+         * followed by the order's lifetime; see parse_fvc_order().  They may
+         * also be FVC Bank orders, (chan, nwords, word blob...), in which
+         * case only those for our channel are taken.
+         */
         void fvc_impl::fvc_words_message(pmt::pmt_t msg) {
-            printf("XXX: got new FVC words\n");
-            assert(msg.is_tuple());
-            size_t len = length(msg);
-            assert(len > 1);
-            long nwords = to_long(tuple_ref(msg, 0));
+            profile_scope prof(d_profiler, d_prof_fvc_words);
+            uint64_t repeats = d_default_repeats;
+            uint64_t duration = d_default_duration;
             vector<vector<char> > words;
-            for(long i = 0; i < nwords; i++) {
-                pmt::pmt_t blob = tuple_ref(msg, 1+i);
-                size_t blen = pmt::blob_length(blob);
-                assert(blen == 28);
-                const char *bdata = static_cast<const char *>(pmt::blob_data(blob));
-                vector<char> word(bdata, bdata+blen);
-                words.push_back(word);
+            size_t first = 0;
+            if(pmt::is_tuple(msg) && pmt::length(msg) >= 3 && pmt::is_integer(pmt::tuple_ref(msg, 1))) {
+                if(pmt::to_long(pmt::tuple_ref(msg, 0)) != d_chan) {
+                    return;
+                }
+                first = 1;
             }
-            if(len > (1+nwords)) {
-                timerhack = to_uint64(tuple_ref(msg, 1+nwords));
-                printf("XXX: setting timerhack to %lld\n", timerhack);
+            if(parse_fvc_order(msg, first, repeats, duration, words) == false) {
+                LOG_WARNING("got invalid FVC words message");
+                return;
             }
-            bvec bigdot("1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1");
-            bvec smalldot("1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1 0 1");
-            bvec wsync("1 1 1 0 0 0 1 0 0 1 0");
-            for(long i = 0; i < nwords; i++) {
-                queue(bigdot);
-                bvec encoded(40);
-                fvc_bch(words[i], encoded);
-                for(int j = 0; j < 11; j++) {
-                    queue(wsync);
-                    queue(encoded);
-                    if(j < 10) {
-                        queue(smalldot);
-                    }
-                }
+            LOG_DEBUG("new FVC order: %zu words, repeats %llu, duration %llu", words.size(), (unsigned long long)repeats, (unsigned long long)duration);
+            fvc_burst_ptr burst = d_cache.get(words);
+
+            boost::mutex::scoped_lock lock(d_order_mutex);
+            start_order(burst, repeats, duration, words[0]);
+        }
+
+        /*
+         * Messages from the RVC data decoder and RVC supervision.  Once the
+         * mobile has confirmed the current order there's no point in
+         * repeating it any longer.  ST on any channel but ours is someone
+         * else's.
+         */
+        void fvc_impl::order_ack_message(pmt::pmt_t msg) {
+            if(pmt::is_dict(msg) == false) {
+                return;
+            }
+            pmt::pmt_t chanv = pmt::dict_ref(msg, pmt::mp("chan"), pmt::PMT_NIL);
+            if(pmt::dict_has_key(msg, pmt::mp("event")) && pmt::is_integer(chanv) && pmt::to_long(chanv) != d_chan) {
+                return;
+            }
+            boost::mutex::scoped_lock lock(d_order_mutex);
+            if(d_order.acknowledged_by(msg)) {
+                finish_order("acknowledged");
             }
         }
 
-        // Move data from our internal queue (d_curqueue) out to gnuradio.  Here 
-        // we also convert our data from bits (0 and 1) to symbols (1 and -1).  
+        void fvc_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+        }
+
+        // Move data from the current order out to gnuradio, wrapping around
+        // until the order's lifetime is up.  The burst is already rendered as
+        // symbols (1 and -1).
         //
         // These symbols are then used by the FM block to generate signals that are
         // +/- the max deviation.  (For POCSAG, that deviation is 4500 Hz.)  All of
@@ -153,43 +161,19 @@ namespace gr {
         fvc_impl::work(int noutput_items,
                   gr_vector_const_void_star &input_items,
                   gr_vector_void_star &output_items) {
-            const float *in = (const float *) input_items[0];
-            unsigned char *out = (unsigned char *) output_items[0];
-
-            if(d_curdata.empty()) {
-                return noutput_items;
-            }
-            if(d_curqueue.empty()) {
-                if(timerhack >= 1) {
-                    timerhack--;
-                    if(timerhack == 0) {
-                        printf("FVC Hack: Time out\n");
-                        const char *msg = "fvc off";
-                        pmt::pmt_t pdu = pmt::cons(pmt::make_dict(), pmt::init_u8vector(strlen(msg), (const uint8_t *)msg));
-                        message_port_pub(pmt::mp("command_out"), pdu);
-                    }
-                }
-                d_curqueue = (const std::queue<bool> &)d_curdata;
-            }
-            const int toxfer = noutput_items < d_curqueue.size() ? noutput_items : d_curqueue.size();
-            assert(toxfer >= 0);
-            for(int i = 0; i < toxfer ; i++) {
-                const bool bbit = d_curqueue.front();
-                switch((int)bbit) {
-                    case 0:
-                        out[i] = -1;
-                        break;
-                    case 1:
-                        out[i] = 1;
-                        break;
-                    default:
-                        std::cout << "invalid value in bitqueue" << std::endl;
-                        abort();
-                        break;
-                }
-                d_curqueue.pop();
+            char *out = (char *) output_items[0];
+            profile_scope prof(d_profiler, d_prof_work);
+            prof.set_budget((noutput_items * 1000000000ULL) / d_symrate);
+
+            boost::mutex::scoped_lock lock(d_order_mutex);
+            bool done = false;
+            const size_t written = d_order.emit(out, noutput_items, done);
+            if(done) {
+                finish_order("complete");
             }
-            return toxfer;
+            // Idle; the channel is muted, so just emit something constant.
+            memset(&out[written], 0, noutput_items - written);
+            return noutput_items;
         }
     } /* namespace amps */
 } /* namespace gr */
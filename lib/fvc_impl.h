@@ -8,10 +8,11 @@
 #define INCLUDED_AMPS_FVC_IMPL_H
 
 #include <amps/fvc.h>
-#include <queue>
 #include <itpp/comm/bch.h>
 #include "amps_packet.h"
 #include "amps_common.h"
+#include "fvc_order.h"
+#include "block_profiler.h"
 
 using namespace itpp;
 using std::string;
@@ -31,25 +32,33 @@ namespace gr {
     class fvc_impl : public fvc
     {
     private:
-        std::queue<bool> d_curqueue;    // Queue of symbols to be sent out.
-        unsigned long d_symrate;        // output symbol rate (must be evenly divisible by the baud rate)
-        std::queue<bool> d_curdata;     // current words
-        itpp::BCH bch;
+        unsigned long d_symrate;        // output symbol rate (at least 20000; see symbol_clock.h)
+        const int d_chan;               // the voice channel (pool index) this FVC carries
+        fvc_burst_cache d_cache;
 
-        uint64_t timerhack;             // XXX HACK: When >0, after this many message blocks have been sent, sent "fvc off" to command_out
+        // Order lifecycle.  An order is sent until either limit is reached
+        // (0 means no limit); the FVC then mutes itself, unmutes audio, and
+        // reports on fvc_status.
+        const uint64_t d_default_repeats;   // bursts per order, if the message doesn't say
+        const uint64_t d_default_duration;  // samples per order, if the message doesn't say
+        fvc_order_state d_order;
+        boost::mutex d_order_mutex;
 
-        const unsigned int samples_per_sym;
+        // work() and message handler timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+        const int d_prof_fvc_words;
 
-        inline void queuebit(bool bit);
-        void fvc_bch(std::vector<char> inbits, bvec &outbv);
+        void start_order(fvc_burst_ptr burst, uint64_t repeats, uint64_t duration, const std::vector<char> &word1);
+        void finish_order(const char *event);
 
     public:
-        fvc_impl(unsigned long symrate);
+        fvc_impl(unsigned long symrate, unsigned long repeats, unsigned long duration, int chan);
         ~fvc_impl();
 
         void fvc_words_message(pmt::pmt_t msg);
-        void queue(bvec &bv);
-        void queue(uint32_t val);
+        void order_ack_message(pmt::pmt_t msg);
+        void profile_query_message(pmt::pmt_t msg);
         int work(int noutput_items,
            gr_vector_const_void_star &input_items,
            gr_vector_void_star &output_items);
@@ -0,0 +1,251 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fvc_order.h"
+#include <string.h>
+#include "utils.h"
+
+using namespace itpp;
+using std::vector;
+
+namespace gr {
+  namespace amps {
+
+    static const char fvc_bigdot[101] = {
+        1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0,
+        1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0,
+        1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0,
+        1,0,1,0,1,0,1,0,1,0, 1
+    };
+    static const char fvc_smalldot[37] = {
+        1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0, 1,0,1,0,1,0,1,0,1,0,
+        1,0,1,0,1,0,1
+    };
+    static const char fvc_wsync[11] = { 1,1,1,0,0,0,1,0,0,1,0 };
+
+    fvc_burst_cache::fvc_burst_cache(unsigned long symrate)
+        : bch(63, 2, true), clock(symrate) {
+    }
+
+    // Append bits to a burst as output symbols.  Here is also where we
+    // stretch each half-bit out to the output symbol rate.
+    void fvc_burst_cache::render_bits(vector<char> &out, const char *bits, size_t nbits) {
+        for(size_t i = 0; i < nbits; i++) {
+            const char first = (bits[i] == 1) ? -1 : 1;
+            out.insert(out.end(), clock.next(), first);
+            out.insert(out.end(), clock.next(), -first);
+        }
+    }
+
+    /*
+     * BCH-encode a 28-bit word (one bit per char) into its 40-bit codeword
+     * and append the full FVC word: 101 bits of dotting, then 11 repeats of
+     * word sync + codeword, separated by 37 bits of dotting (553 3.7.2).
+     */
+    void fvc_burst_cache::render_word(vector<char> &out, const vector<char> &word) {
+        bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
+        bvec srcbvec(28);
+        charv_to_bvec(word, srcbvec);
+        bvec encoded = bch.encode(concat(zeroes, srcbvec));
+        char codeword[40];
+        for(int i = 0; i < 40; i++) {
+            codeword[i] = (encoded[23 + i] == 1) ? 1 : 0;
+        }
+
+        render_bits(out, fvc_bigdot, sizeof(fvc_bigdot));
+        for(int j = 0; j < 11; j++) {
+            render_bits(out, fvc_wsync, sizeof(fvc_wsync));
+            render_bits(out, codeword, sizeof(codeword));
+            if(j < 10) {
+                render_bits(out, fvc_smalldot, sizeof(fvc_smalldot));
+            }
+        }
+    }
+
+    /*
+     * Return the rendered burst for the given words, rendering it first if
+     * it hasn't been seen before.  The key is the packed words themselves,
+     * which covers both the order and the PSCC.
+     */
+    fvc_burst_ptr fvc_burst_cache::get(const vector<vector<char> > &words) {
+        vector<uint32_t> key(words.size());
+        for(size_t i = 0; i < words.size(); i++) {
+            assert(words[i].size() == 28);
+            key[i] = get32((const unsigned char *)&words[i][0], 28);
+        }
+
+        boost::mutex::scoped_lock lock(cache_mutex);
+        std::map<vector<uint32_t>, fvc_burst_ptr>::const_iterator it = cache.find(key);
+        if(it != cache.end()) {
+            return it->second;
+        }
+        vector<char> *burst = new vector<char>();
+        clock.reset();
+        for(size_t i = 0; i < words.size(); i++) {
+            render_word(*burst, words[i]);
+        }
+        fvc_burst_ptr ptr(burst);
+        cache[key] = ptr;
+        return ptr;
+    }
+
+    size_t fvc_burst_cache::size() {
+        boost::mutex::scoped_lock lock(cache_mutex);
+        return cache.size();
+    }
+
+    void fvc_order_state::start(fvc_burst_ptr nburst, uint64_t repeats, uint64_t duration, const vector<char> &word1) {
+        burst = nburst;
+        off = 0;
+        repeats_left = repeats;
+        samples_left = duration;
+        bursts_sent = 0;
+        samples_sent = 0;
+        // Mobile Station Control Message word 1 (553 3.7.2.1): ORDQ is bits
+        // 20-22, ORDER bits 23-27.
+        ordq = 0;
+        order = 0;
+        for(int i = 20; i < 23; i++) {
+            ordq = (ordq << 1) | (word1[i] ? 1 : 0);
+        }
+        for(int i = 23; i < 28; i++) {
+            order = (order << 1) | (word1[i] ? 1 : 0);
+        }
+    }
+
+    /*
+     * Whether a message from the RVC confirms this order.  The mobile
+     * confirms an alert by turning on ST (553 2.6.4.4), reported by RVC
+     * Supervision as st_on; anything else is confirmed by an order
+     * confirmation from RVC Data, which has to repeat its ORDQ and ORDER
+     * (553 2.7.2.1).
+     */
+    bool fvc_order_state::acknowledged_by(pmt::pmt_t msg) const {
+        if(active() == false || pmt::is_dict(msg) == false) {
+            return false;
+        }
+        pmt::pmt_t event = pmt::dict_ref(msg, pmt::mp("event"), pmt::PMT_NIL);
+        if(pmt::is_symbol(event)) {
+            return order == ORDER_ALERT && pmt::symbol_to_string(event) == "st_on";
+        }
+        pmt::pmt_t type = pmt::dict_ref(msg, pmt::mp("type"), pmt::PMT_NIL);
+        if(pmt::is_symbol(type) == false || pmt::symbol_to_string(type) != "order_confirmation") {
+            return false;
+        }
+        pmt::pmt_t ackordq = pmt::dict_ref(msg, pmt::mp("ordq"), pmt::PMT_NIL);
+        pmt::pmt_t ackorder = pmt::dict_ref(msg, pmt::mp("order"), pmt::PMT_NIL);
+        if(pmt::is_integer(ackordq) == false || pmt::is_integer(ackorder) == false) {
+            return false;
+        }
+        return order != ORDER_ALERT && pmt::to_long(ackordq) == ordq && pmt::to_long(ackorder) == order;
+    }
+
+    void fvc_order_state::stop() {
+        burst.reset();
+        off = 0;
+    }
+
+    /*
+     * Copy up to nout symbols of the order into out, wrapping around at the
+     * end of the burst.  Stops early (and sets done) when the order's
+     * lifetime is up.  Returns the number of symbols written.
+     */
+    size_t fvc_order_state::emit(char *out, size_t nout, bool &done) {
+        done = false;
+        size_t written = 0;
+        if(active() == false || burst->empty()) {
+            return 0;
+        }
+        const vector<char> &b = *burst;
+        while(written < nout && done == false) {
+            size_t toxfer = MIN(nout - written, b.size() - off);
+            if(samples_left > 0) {
+                toxfer = MIN(toxfer, samples_left);
+            }
+            memcpy(&out[written], &b[off], toxfer);
+            written += toxfer;
+            off += toxfer;
+            samples_sent += toxfer;
+            if(samples_left > 0) {
+                samples_left -= toxfer;
+                done = (samples_left == 0);
+            }
+            if(off == b.size()) {
+                off = 0;
+                bursts_sent++;
+                if(repeats_left > 0) {
+                    repeats_left--;
+                    done = done || (repeats_left == 0);
+                }
+            }
+        }
+        return written;
+    }
+
+    /*
+     * Parse an FVC order out of a message tuple, starting at element
+     * `first`: (nwords, word blob...), optionally followed by the order's
+     * lifetime -- either an integer repeat count, or a dict with "repeats"
+     * and/or "duration" (in output samples).  repeats and duration should
+     * hold the defaults on entry.
+     *
+     * Returns false if the message is malformed.
+     */
+    bool parse_fvc_order(pmt::pmt_t msg, size_t first, uint64_t &repeats, uint64_t &duration, vector<vector<char> > &words) {
+        if(pmt::is_tuple(msg) == false) {
+            return false;
+        }
+        const size_t len = pmt::length(msg);
+        if(len < first + 2) {
+            return false;
+        }
+        const long nwords = pmt::to_long(pmt::tuple_ref(msg, first));
+        if(nwords < 1 || len < (first + 1 + nwords)) {
+            return false;
+        }
+        words.clear();
+        for(long i = 0; i < nwords; i++) {
+            pmt::pmt_t blob = pmt::tuple_ref(msg, first+1+i);
+            if(pmt::is_blob(blob) == false || pmt::blob_length(blob) != 28) {
+                return false;
+            }
+            const char *bdata = static_cast<const char *>(pmt::blob_data(blob));
+            words.push_back(vector<char>(bdata, bdata+28));
+        }
+        if(len > (first + 1 + nwords)) {
+            pmt::pmt_t limits = pmt::tuple_ref(msg, first+1+nwords);
+            if(pmt::is_dict(limits)) {
+                pmt::pmt_t v = pmt::dict_ref(limits, pmt::mp("repeats"), pmt::PMT_NIL);
+                if(pmt::is_number(v)) {
+                    repeats = pmt::to_uint64(v);
+                }
+                v = pmt::dict_ref(limits, pmt::mp("duration"), pmt::PMT_NIL);
+                if(pmt::is_number(v)) {
+                    duration = pmt::to_uint64(v);
+                }
+            } else if(pmt::is_number(limits)) {
+                repeats = pmt::to_uint64(limits);
+            } else {
+                LOG_WARNING("ignoring invalid FVC order limit");
+            }
+        }
+        return true;
+    }
+
+    pmt::pmt_t fvc_status_dict(const char *event, const fvc_order_state &order) {
+        pmt::pmt_t status = pmt::make_dict();
+        status = pmt::dict_add(status, pmt::mp("event"), pmt::mp(event));
+        status = pmt::dict_add(status, pmt::mp("bursts"), pmt::from_uint64(order.bursts_sent));
+        status = pmt::dict_add(status, pmt::mp("samples"), pmt::from_uint64(order.samples_sent));
+        return status;
+    }
+
+  } // namespace amps
+} // namespace gr
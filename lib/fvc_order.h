@@ -0,0 +1,82 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_FVC_ORDER_H
+#define INCLUDED_AMPS_FVC_ORDER_H
+
+#include <itpp/comm/bch.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pmt/pmt.h>
+#include <map>
+#include <vector>
+#include "amps_packet.h"
+#include "symbol_clock.h"
+
+#ifndef MIN
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#endif /* MIN */
+
+namespace gr {
+  namespace amps {
+
+    typedef boost::shared_ptr<const std::vector<char> > fvc_burst_ptr;
+
+    /*
+     * Renders FVC orders (553 3.7.2) into output symbols (+1/-1, at the
+     * output rate; see symbol_clock.h), and keeps every burst it has
+     * rendered.  Orders only differ by a handful of fields (PSCC, order
+     * type), so after warm-up nearly every order is a cache hit and costs
+     * no BCH encoding at all.  Bursts are immutable once rendered and can be
+     * shared between channels.
+     */
+    class fvc_burst_cache {
+        private:
+        itpp::BCH bch;
+        symbol_clock clock;         // restarted for each burst
+        std::map<std::vector<uint32_t>, fvc_burst_ptr> cache;
+        boost::mutex cache_mutex;
+
+        void render_bits(std::vector<char> &out, const char *bits, size_t nbits);
+        void render_word(std::vector<char> &out, const std::vector<char> &word);
+
+        public:
+        fvc_burst_cache(unsigned long symrate);
+        fvc_burst_ptr get(const std::vector<std::vector<char> > &words);
+        size_t size();
+    };
+
+    /*
+     * Lifecycle of one order on one FVC: the burst is repeated until either
+     * limit is reached (0 means no limit).
+     */
+    struct fvc_order_state {
+        fvc_burst_ptr burst;
+        size_t off;                 // offset of the next symbol to send within burst
+        uint64_t repeats_left;
+        uint64_t samples_left;
+        uint64_t bursts_sent;
+        uint64_t samples_sent;
+        int ordq;                   // ORDQ and ORDER from the first word, so
+        int order;                  // an acknowledgement can be matched to it
+
+        fvc_order_state()
+            : off(0), repeats_left(0), samples_left(0), bursts_sent(0), samples_sent(0), ordq(-1), order(-1) { }
+
+        bool active() const { return burst.get() != NULL; }
+        void start(fvc_burst_ptr nburst, uint64_t repeats, uint64_t duration, const std::vector<char> &word1);
+        void stop();
+        bool acknowledged_by(pmt::pmt_t msg) const;
+        size_t emit(char *out, size_t nout, bool &done);
+    };
+
+    bool parse_fvc_order(pmt::pmt_t msg, size_t first, uint64_t &repeats, uint64_t &duration, std::vector<std::vector<char> > &words);
+    pmt::pmt_t fvc_status_dict(const char *event, const fvc_order_state &order);
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_FVC_ORDER_H */
@@ -0,0 +1,459 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "iq_capture_impl.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <stdexcept>
+#include "utils.h"
+
+namespace gr {
+    namespace amps {
+
+        // RECC burst offsets are in symbols.
+        static const double IQ_RECC_SYMRATE = 20000.0;
+
+        iq_capture::sptr
+        iq_capture::make(double samp_rate, const std::string &prefix, double pre_ms, double post_ms,
+                double ring_ms, int delay, int max_pending) {
+            return gnuradio::get_initial_sptr (new iq_capture_impl(samp_rate, prefix, pre_ms, post_ms,
+                        ring_ms, delay, max_pending));
+        }
+
+        iq_capture_impl::iq_capture_impl(double samp_rate, const std::string &prefix, double pre_ms, double post_ms,
+                double ring_ms, int delay, int max_pending)
+          : sync_block("iq_capture",
+                  io_signature::make(1, 1, sizeof (gr_complex)),
+                  io_signature::make(0, 0, 0)),
+          d_samp_rate(samp_rate), d_prefix(prefix), d_pre((uint64_t)(pre_ms * samp_rate / 1000.0)),
+          d_post((uint64_t)(post_ms * samp_rate / 1000.0)), d_delay(delay), d_max_pending(max_pending),
+          d_total(0), d_last_trigger(UINT64_MAX), d_finished(false), d_sequence(0), d_last_written(NULL), d_dropped(0), d_failed(0),
+          d_profiler("iq_capture"), d_prof_work(d_profiler.add_site("work"))
+        {
+            if(samp_rate <= 0) {
+                throw std::invalid_argument("iq_capture: samp_rate must be positive");
+            }
+            if(prefix.empty()) {
+                throw std::invalid_argument("iq_capture: need a path prefix for the recordings");
+            }
+            if(pre_ms < 0 || post_ms <= 0) {
+                throw std::invalid_argument("iq_capture: the capture window must be positive");
+            }
+            if(ring_ms <= pre_ms + post_ms) {
+                throw std::invalid_argument("iq_capture: the ring must be longer than the capture window");
+            }
+            if(max_pending < 1) {
+                throw std::invalid_argument("iq_capture: max_pending must be at least 1");
+            }
+            d_ring.resize((size_t)(ring_ms * samp_rate / 1000.0));
+
+            message_port_register_in(pmt::mp("trigger"));
+            set_msg_handler(pmt::mp("trigger"),
+                boost::bind(&iq_capture_impl::trigger_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("captures"));
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&iq_capture_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
+        }
+
+        iq_capture_impl::~iq_capture_impl()
+        {
+            for(size_t i = 0; i < d_queue.size(); i++) {
+                delete d_queue[i];
+            }
+            delete d_last_written;
+        }
+
+        bool
+        iq_capture_impl::start() {
+            d_finished = false;
+            d_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&iq_capture_impl::run, this)));
+            return block::start();
+        }
+
+        /*
+         * The writer thread finishes whatever is queued before it exits, so
+         * stopping the flowgraph doesn't lose a capture.
+         */
+        bool
+        iq_capture_impl::stop() {
+            {
+                boost::mutex::scoped_lock lock(d_queue_mutex);
+                d_finished = true;
+            }
+            d_queue_cond.notify_one();
+            if(d_thread) {
+                d_thread->join();
+                d_thread.reset();
+            }
+            if(d_dropped > 0 || d_failed > 0) {
+                LOG_WARNING("IQ capture: %llu triggers dropped, %llu recordings couldn't be written",
+                        (unsigned long long)d_dropped, (unsigned long long)d_failed);
+            }
+            return block::stop();
+        }
+
+        void iq_capture_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+        }
+
+        /*
+         * A burst to capture: (metadata . blob) straight from the RECC block
+         * (a seizure), or a metadata dict, whose "reason" says why (RECC
+         * Decode's bad_bursts).  Only the window is worked out here; work()
+         * does the copying once the samples are in.
+         */
+        void iq_capture_impl::trigger_message(pmt::pmt_t msg) {
+            iq_trigger t;
+            if(pmt::is_pair(msg) && pmt::is_blob(pmt::cdr(msg)) && pmt::is_dict(pmt::car(msg))) {
+                t.meta = pmt::car(msg);
+                t.reason = "seizure";
+            } else if(pmt::is_dict(msg)) {
+                t.meta = msg;
+                pmt::pmt_t reason = pmt::dict_ref(msg, pmt::mp("reason"), pmt::PMT_NIL);
+                t.reason = pmt::is_symbol(reason) ? pmt::symbol_to_string(reason) : "trigger";
+            } else {
+                LOG_WARNING("IQ capture: ignoring trigger that isn't a burst or a dict");
+                return;
+            }
+            pmt::pmt_t offset = pmt::dict_ref(t.meta, pmt::mp("offset"), pmt::PMT_NIL);
+            if(pmt::is_uint64(offset) == false && pmt::is_integer(offset) == false) {
+                LOG_WARNING("IQ capture: ignoring trigger without a burst offset");
+                return;
+            }
+            // The label goes into the JSON as is; keep it to safe characters.
+            for(size_t i = 0; i < t.reason.size(); i++) {
+                const char c = t.reason[i];
+                if(isalnum((unsigned char)c) == 0 && c != '_' && c != '-') {
+                    t.reason[i] = '_';
+                }
+            }
+            const int64_t at = llround((pmt::to_uint64(offset) * d_samp_rate) / IQ_RECC_SYMRATE) + d_delay;
+            t.trigger = (at > 0) ? at : 0;
+            t.start = (t.trigger > d_pre) ? (t.trigger - d_pre) : 0;
+            t.end = t.trigger + d_post;
+            boost::mutex::scoped_lock lock(d_triggers_mutex);
+            d_triggers.push_back(t);
+        }
+
+        // Reasons are joined with commas, each listed once.
+        static void add_reason(std::string &reasons, const std::string &reason) {
+            const std::string padded = "," + reasons + ",";
+            if(padded.find("," + reason + ",") == std::string::npos) {
+                reasons += "," + reason;
+            }
+        }
+
+        /*
+         * The whole window has come in: copy what's still in the ring and
+         * hand it to the writer thread.  A burst that's already been
+         * captured isn't copied again; the new trigger's reason is added to
+         * the queued recording's label, or, if that's already been written,
+         * the writer thread is asked to relabel it.
+         */
+        void iq_capture_impl::record(const iq_trigger &t) {
+            if(t.trigger == d_last_trigger) {
+                LOG_DEBUG("IQ capture: burst at sample %llu is already captured; adding %s",
+                        (unsigned long long)t.trigger, t.reason.c_str());
+                {
+                    boost::mutex::scoped_lock lock(d_queue_mutex);
+                    for(size_t i = d_queue.size(); i > 0; i--) {
+                        iq_recording *queued = d_queue[i - 1];
+                        if(queued->relabel == false && queued->trig.trigger == t.trigger) {
+                            add_reason(queued->trig.reason, t.reason);
+                            return;
+                        }
+                    }
+                    iq_recording *rec = new iq_recording();
+                    rec->trig = t;
+                    rec->start = 0;
+                    rec->wall_ns = 0;
+                    rec->samples = 0;
+                    rec->truncated = false;
+                    rec->relabel = true;
+                    d_queue.push_back(rec);
+                }
+                d_queue_cond.notify_one();
+                return;
+            }
+            const size_t ringsz = d_ring.size();
+            const uint64_t oldest = (d_total > ringsz) ? (d_total - ringsz) : 0;
+            const uint64_t start = (t.start > oldest) ? t.start : oldest;
+            if(start >= t.end) {
+                d_dropped++;
+                LOG_WARNING("IQ capture: burst at sample %llu had left the ring before its trigger came in",
+                        (unsigned long long)t.trigger);
+                return;
+            }
+            {
+                boost::mutex::scoped_lock lock(d_queue_mutex);
+                if(d_queue.size() >= d_max_pending) {
+                    d_dropped++;
+                    LOG_WARNING("IQ capture: writer is behind; dropping the burst at sample %llu",
+                            (unsigned long long)t.trigger);
+                    return;
+                }
+            }
+
+            iq_recording *rec = new iq_recording();
+            rec->trig = t;
+            rec->start = start;
+            rec->truncated = (start > t.start);
+            rec->relabel = false;
+            rec->samples = t.end - start;
+            rec->data.resize(rec->samples);
+            size_t done = 0;
+            while(done < rec->data.size()) {
+                const size_t pos = (start + done) % ringsz;
+                const size_t n = MIN(rec->data.size() - done, ringsz - pos);
+                memcpy(&rec->data[done], &d_ring[pos], n * sizeof(gr_complex));
+                done += n;
+            }
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            const uint64_t now = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+            rec->wall_ns = now - (uint64_t)(((d_total - start) * 1e9) / d_samp_rate);
+            {
+                boost::mutex::scoped_lock lock(d_queue_mutex);
+                d_queue.push_back(rec);
+            }
+            d_queue_cond.notify_one();
+            d_last_trigger = t.trigger;
+        }
+
+        void iq_capture_impl::publish_capture(const iq_recording &rec, const std::string &path) {
+            pmt::pmt_t d = pmt::make_dict();
+            d = pmt::dict_add(d, pmt::mp("path"), pmt::mp(path));
+            d = pmt::dict_add(d, pmt::mp("reason"), pmt::mp(rec.trig.reason));
+            d = pmt::dict_add(d, pmt::mp("trace_id"),
+                    pmt::dict_ref(rec.trig.meta, pmt::mp("trace_id"), pmt::PMT_NIL));
+            d = pmt::dict_add(d, pmt::mp("samples"), pmt::from_uint64(rec.samples));
+            d = pmt::dict_add(d, pmt::mp("truncated"), pmt::from_bool(rec.truncated));
+            message_port_pub(pmt::mp("captures"), d);
+        }
+
+        /*
+         * Writer thread: write out recordings as they're queued.
+         */
+        void iq_capture_impl::run() {
+            while(true) {
+                iq_recording *rec = NULL;
+                {
+                    boost::mutex::scoped_lock lock(d_queue_mutex);
+                    while(d_queue.empty() && d_finished == false) {
+                        d_queue_cond.wait(lock);
+                    }
+                    if(d_queue.empty()) {
+                        break;
+                    }
+                    rec = d_queue.front();
+                    d_queue.pop_front();
+                }
+                if(rec->relabel) {
+                    // Another trigger named a burst that's already written out.
+                    if(d_last_written != NULL && d_last_written->trig.trigger == rec->trig.trigger) {
+                        add_reason(d_last_written->trig.reason, rec->trig.reason);
+                        if(write_meta(*d_last_written, d_last_path)) {
+                            publish_capture(*d_last_written, d_last_path);
+                            LOG_INFO("IQ capture: %s relabelled %s", d_last_path.c_str(),
+                                    d_last_written->trig.reason.c_str());
+                        }
+                    }
+                    delete rec;
+                    continue;
+                }
+                std::string path;
+                if(write_recording(*rec, path)) {
+                    publish_capture(*rec, path);
+                    LOG_INFO("IQ capture: %s burst written to %s", rec->trig.reason.c_str(), path.c_str());
+                    std::vector<gr_complex>().swap(rec->data);
+                    delete d_last_written;
+                    d_last_written = rec;
+                    d_last_path = path;
+                } else {
+                    d_failed++;
+                    delete rec;
+                }
+            }
+        }
+
+        // ISO 8601 UTC, as SigMF wants it.
+        static std::string sigmf_datetime(uint64_t ns) {
+            const time_t secs = ns / 1000000000ULL;
+            struct tm tm;
+            gmtime_r(&secs, &tm);
+            char buf[48];
+            snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%06uZ", tm.tm_year + 1900, tm.tm_mon + 1,
+                    tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, (unsigned int)((ns % 1000000000ULL) / 1000));
+            return buf;
+        }
+
+        /*
+         * Write one recording as <prefix>.<sequence>.sigmf-data and
+         * .sigmf-meta.  Like the event journal, numbering carries on past
+         * whatever earlier runs left behind.  The samples are written in
+         * host order, which is what cf32_le means on the hosts we run on.
+         */
+        bool iq_capture_impl::write_recording(const iq_recording &rec, std::string &path) {
+            char name[48];
+            int fd = -1;
+            for( ; ; d_sequence++) {
+                snprintf(name, sizeof(name), ".%06llu.sigmf-data", (unsigned long long)d_sequence);
+                fd = ::open((d_prefix + name).c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+                if(fd != -1 || errno != EEXIST) {
+                    break;
+                }
+            }
+            snprintf(name, sizeof(name), ".%06llu", (unsigned long long)d_sequence);
+            const std::string base = d_prefix + name;
+            if(fd == -1) {
+                LOG_WARNING("IQ capture: can't create %s.sigmf-data: %s", base.c_str(), strerror(errno));
+                return false;
+            }
+            d_sequence++;
+            const char *p = reinterpret_cast<const char *>(&rec.data[0]);
+            size_t left = rec.data.size() * sizeof(gr_complex);
+            while(left > 0) {
+                const ssize_t n = ::write(fd, p, left);
+                if(n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if(n <= 0) {
+                    LOG_WARNING("IQ capture: can't write %s.sigmf-data: %s", base.c_str(), strerror(errno));
+                    ::close(fd);
+                    return false;
+                }
+                p += n;
+                left -= n;
+            }
+            ::close(fd);
+            if(write_meta(rec, base) == false) {
+                return false;
+            }
+            path = base;
+            return true;
+        }
+
+        // (Re)write <base>.sigmf-meta for a recording.
+        bool iq_capture_impl::write_meta(const iq_recording &rec, const std::string &base) {
+            // Prefer the radio's clock, if the RECC had it for this burst.
+            uint64_t start_ns = rec.wall_ns;
+            pmt::pmt_t rx_time = pmt::dict_ref(rec.trig.meta, pmt::mp("rx_time"), pmt::PMT_NIL);
+            const double lead = (double)((int64_t)rec.trig.trigger - (int64_t)rec.start) / d_samp_rate;
+            if(pmt::is_tuple(rx_time) && pmt::length(rx_time) == 2) {
+                const double t = pmt::to_uint64(pmt::tuple_ref(rx_time, 0))
+                    + pmt::to_double(pmt::tuple_ref(rx_time, 1)) - lead;
+                start_ns = (uint64_t)(t * 1e9);
+            }
+            const uint64_t annot_start = (rec.trig.trigger > rec.start) ? (rec.trig.trigger - rec.start) : 0;
+            pmt::pmt_t trace_id = pmt::dict_ref(rec.trig.meta, pmt::mp("trace_id"), pmt::PMT_NIL);
+            pmt::pmt_t offset = pmt::dict_ref(rec.trig.meta, pmt::mp("offset"), pmt::PMT_NIL);
+
+            const std::string meta_path = base + ".sigmf-meta";
+            FILE *f = fopen(meta_path.c_str(), "w");
+            if(f == NULL) {
+                LOG_WARNING("IQ capture: can't create %s: %s", meta_path.c_str(), strerror(errno));
+                return false;
+            }
+            fprintf(f, "{\n");
+            fprintf(f, "    \"global\": {\n");
+            fprintf(f, "        \"core:datatype\": \"cf32_le\",\n");
+            fprintf(f, "        \"core:sample_rate\": %.17g,\n", d_samp_rate);
+            fprintf(f, "        \"core:version\": \"1.0.0\",\n");
+            fprintf(f, "        \"core:recorder\": \"gr-amps iq_capture\"\n");
+            fprintf(f, "    },\n");
+            fprintf(f, "    \"captures\": [\n");
+            fprintf(f, "        {\n");
+            fprintf(f, "            \"core:sample_start\": 0,\n");
+            fprintf(f, "            \"core:global_index\": %llu,\n", (unsigned long long)rec.start);
+            fprintf(f, "            \"core:datetime\": \"%s\"\n", sigmf_datetime(start_ns).c_str());
+            fprintf(f, "        }\n");
+            fprintf(f, "    ],\n");
+            fprintf(f, "    \"annotations\": [\n");
+            fprintf(f, "        {\n");
+            fprintf(f, "            \"core:sample_start\": %llu,\n", (unsigned long long)annot_start);
+            fprintf(f, "            \"core:sample_count\": %llu,\n", (unsigned long long)(rec.samples - annot_start));
+            fprintf(f, "            \"core:label\": \"%s\",\n", rec.trig.reason.c_str());
+            if(pmt::is_uint64(trace_id)) {
+                fprintf(f, "            \"amps:trace_id\": %llu,\n", (unsigned long long)pmt::to_uint64(trace_id));
+            }
+            if(pmt::is_uint64(offset) || pmt::is_integer(offset)) {
+                fprintf(f, "            \"amps:recc_offset\": %llu,\n", (unsigned long long)pmt::to_uint64(offset));
+            }
+            fprintf(f, "            \"amps:truncated\": %s\n", rec.truncated ? "true" : "false");
+            fprintf(f, "        }\n");
+            fprintf(f, "    ]\n");
+            fprintf(f, "}\n");
+            if(fclose(f) != 0) {
+                LOG_WARNING("IQ capture: can't write %s: %s", meta_path.c_str(), strerror(errno));
+                return false;
+            }
+            return true;
+        }
+
+        int
+        iq_capture_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            const gr_complex *in = (const gr_complex *) input_items[0];
+            profile_scope prof(d_profiler, d_prof_work);
+            prof.set_budget((noutput_items * 1e9) / d_samp_rate);
+
+            const size_t ringsz = d_ring.size();
+            size_t done = 0;
+            while(done < (size_t)noutput_items) {
+                const size_t pos = (d_total + done) % ringsz;
+                const size_t n = MIN(noutput_items - done, ringsz - pos);
+                memcpy(&d_ring[pos], &in[done], n * sizeof(gr_complex));
+                done += n;
+            }
+            d_total += noutput_items;
+
+            {
+                boost::mutex::scoped_lock lock(d_triggers_mutex);
+                // Triggers for a burst that's already waiting only add their reason.
+                for(size_t i = 0; i < d_triggers.size(); i++) {
+                    size_t j = 0;
+                    while(j < d_waiting.size() && d_waiting[j].trigger != d_triggers[i].trigger) {
+                        j++;
+                    }
+                    if(j < d_waiting.size()) {
+                        add_reason(d_waiting[j].reason, d_triggers[i].reason);
+                    } else {
+                        d_waiting.push_back(d_triggers[i]);
+                    }
+                }
+                d_triggers.clear();
+            }
+            for(size_t i = 0; i < d_waiting.size(); ) {
+                if(d_waiting[i].end <= d_total) {
+                    record(d_waiting[i]);
+                    d_waiting.erase(d_waiting.begin() + i);
+                } else {
+                    i++;
+                }
+            }
+            return noutput_items;
+        }
+
+    } /* namespace amps */
+} /* namespace gr */
@@ -0,0 +1,107 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_IQ_CAPTURE_IMPL_H
+#define INCLUDED_AMPS_IQ_CAPTURE_IMPL_H
+
+#include <amps/iq_capture.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+#include <vector>
+#include "amps_common.h"
+#include "block_profiler.h"
+
+#ifndef MIN
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#endif /* MIN */
+
+namespace gr {
+  namespace amps {
+
+    // A burst to capture, in input samples.
+    struct iq_trigger {
+        uint64_t start;             // first sample of the window
+        uint64_t end;               // one past the last
+        uint64_t trigger;           // the burst's offset
+        std::string reason;
+        pmt::pmt_t meta;            // the burst's trace metadata
+    };
+
+    // A window copied out of the ring, waiting for the writer thread.
+    struct iq_recording {
+        iq_trigger trig;
+        uint64_t start;             // sample index of data[0]
+        uint64_t wall_ns;           // CLOCK_REALTIME of data[0]
+        uint64_t samples;           // data.size(), kept once data is freed
+        bool truncated;
+        bool relabel;               // no data: add trig.reason to the burst's written recording
+        std::vector<gr_complex> data;
+    };
+
+    class iq_capture_impl : public iq_capture
+    {
+    private:
+        const double d_samp_rate;
+        const std::string d_prefix;
+        const uint64_t d_pre;
+        const uint64_t d_post;
+        const int d_delay;
+        const size_t d_max_pending;
+
+        // Owned by work().
+        std::vector<gr_complex> d_ring;
+        uint64_t d_total;               // samples seen; the ring holds the last d_ring.size()
+        std::vector<iq_trigger> d_waiting;      // windows that haven't all arrived yet
+        uint64_t d_last_trigger;        // so a burst that's already captured isn't again; later
+                                        // triggers for it only add their reason to its label
+
+        // From the trigger handler to work().
+        std::vector<iq_trigger> d_triggers;
+        boost::mutex d_triggers_mutex;
+
+        // From work() to the writer thread.
+        std::deque<iq_recording *> d_queue;
+        boost::mutex d_queue_mutex;
+        boost::condition_variable d_queue_cond;
+        bool d_finished;
+        boost::shared_ptr<boost::thread> d_thread;
+        uint64_t d_sequence;            // next file number; writer thread only
+        iq_recording *d_last_written;   // without its data, for relabelling; writer thread only
+        std::string d_last_path;
+        uint64_t d_dropped;             // triggers dropped: queue full, or too old
+        uint64_t d_failed;              // recordings that couldn't be written
+
+        // work() timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+
+        void record(const iq_trigger &t);
+        void run();
+        bool write_recording(const iq_recording &rec, std::string &path);
+        bool write_meta(const iq_recording &rec, const std::string &base);
+        void publish_capture(const iq_recording &rec, const std::string &path);
+
+    public:
+        iq_capture_impl(double samp_rate, const std::string &prefix, double pre_ms, double post_ms,
+                double ring_ms, int delay, int max_pending);
+        ~iq_capture_impl();
+
+        bool start();
+        bool stop();
+
+        void trigger_message(pmt::pmt_t msg);
+        void profile_query_message(pmt::pmt_t msg);
+        int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_IQ_CAPTURE_IMPL_H */
@@ -0,0 +1,85 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "latency_histogram.h"
+
+namespace gr {
+  namespace amps {
+
+    latency_histogram::latency_histogram() {
+        reset();
+    }
+
+    int latency_histogram::bucket(uint64_t us) {
+        if(us < 32) {
+            return (int)us;
+        }
+        const int msb = 63 - __builtin_clzll(us);
+        const int shift = msb - SUB_BITS;
+        const int idx = 32 + ((msb - 5) << SUB_BITS) + (int)((us >> shift) - (1 << SUB_BITS));
+        return (idx < NBUCKETS) ? idx : (NBUCKETS - 1);
+    }
+
+    // The largest value that lands in bucket idx.
+    uint64_t latency_histogram::bucket_high(int idx) {
+        if(idx < 32) {
+            return idx;
+        }
+        const int msb = ((idx - 32) >> SUB_BITS) + 5;
+        const uint64_t sub = (idx - 32) & ((1 << SUB_BITS) - 1);
+        const int shift = msb - SUB_BITS;
+        return (((1ULL << SUB_BITS) + sub + 1) << shift) - 1;
+    }
+
+    void latency_histogram::record(uint64_t us) {
+        __atomic_fetch_add(&d_counts[bucket(us)], 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&d_count, 1, __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&d_max, __ATOMIC_RELAXED);
+        while(us > max && __atomic_compare_exchange_n(&d_max, &max, us, true,
+                    __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false) {
+        }
+    }
+
+    void latency_histogram::reset() {
+        for(int i = 0; i < NBUCKETS; i++) {
+            __atomic_store_n(&d_counts[i], 0, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&d_count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&d_max, 0, __ATOMIC_RELAXED);
+    }
+
+    /*
+     * The value at or below which pct percent of the samples fall, to the
+     * histogram's precision (reported as the top of the bucket, but never
+     * more than the largest value recorded).
+     */
+    uint64_t latency_histogram::percentile(double pct) const {
+        const uint64_t count = this->count();
+        const uint64_t max = this->max();
+        if(count == 0) {
+            return 0;
+        }
+        uint64_t want = (uint64_t)((pct / 100.0) * count + 0.5);
+        if(want < 1) {
+            want = 1;
+        }
+        uint64_t seen = 0;
+        for(int i = 0; i < NBUCKETS; i++) {
+            seen += __atomic_load_n(&d_counts[i], __ATOMIC_RELAXED);
+            if(seen >= want) {
+                const uint64_t high = bucket_high(i);
+                return (high < max) ? high : max;
+            }
+        }
+        return max;
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,54 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_LATENCY_HISTOGRAM_H
+#define INCLUDED_AMPS_LATENCY_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    /*
+     * Log-linear histogram of latencies, in the style of HdrHistogram:
+     * values below 32 get a bucket each, and every power of two above that
+     * is split into 16 buckets, so a percentile is never off by more than
+     * about 6% however wide the range.  Values past 2^40 (in whatever unit
+     * the caller uses) land in the last bucket.
+     *
+     * Recording is lock-free (relaxed atomic adds), so any number of
+     * threads can record while another reads.  A reader racing a writer
+     * may see a count one sample behind; reset() racing a writer may lose
+     * that sample.
+     */
+    class latency_histogram {
+        public:
+        static const int SUB_BITS = 4;
+        static const int NBUCKETS = 32 + ((40 - 5) << SUB_BITS);
+
+        private:
+        uint64_t d_counts[NBUCKETS];
+        uint64_t d_count;
+        uint64_t d_max;
+
+        public:
+        latency_histogram();
+
+        static int bucket(uint64_t us);
+        static uint64_t bucket_high(int idx);
+
+        void record(uint64_t us);
+        void reset();
+        uint64_t count() const { return __atomic_load_n(&d_count, __ATOMIC_RELAXED); }
+        uint64_t max() const { return __atomic_load_n(&d_max, __ATOMIC_RELAXED); }
+        uint64_t percentile(double pct) const;
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_LATENCY_HISTOGRAM_H */
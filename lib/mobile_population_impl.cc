@@ -0,0 +1,388 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "mobile_population_impl.h"
+#include "subscriber_registry.h"
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    // Longest the generator thread sleeps, so that timeouts are noticed
+    // even when the offered load is tiny.
+    static const uint64_t POPULATION_MAX_SLEEP_NS = 100000000ULL;
+    static const unsigned char POPULATION_SCM = 0xa;
+
+    static const char *mobile_event_names[MOBILE_NEVENTS] = {
+        "registrations", "originations", "page_responses"
+    };
+
+    mobile_population::sptr
+    mobile_population::make(int nmobiles, const std::string &first_min,
+            double reg_rate, double orig_rate, double resp_rate,
+            double timeout, double report_interval, int seed) {
+        return gnuradio::get_initial_sptr (new mobile_population_impl(nmobiles, first_min,
+                    reg_rate, orig_rate, resp_rate, timeout, report_interval, seed));
+    }
+
+    mobile_population_impl::mobile_population_impl(int nmobiles, const std::string &first_min,
+            double reg_rate, double orig_rate, double resp_rate,
+            double timeout, double report_interval, int seed)
+      : gr::block("mobile_population",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(0, 0, 0)),
+        d_timeout(timeout), d_report_interval(report_interval),
+        d_rates_changed(true), d_finished(false)
+    {
+        if(nmobiles < 1) {
+            throw std::invalid_argument("mobile_population: nmobiles must be at least 1");
+        }
+        if(reg_rate < 0 || orig_rate < 0 || resp_rate < 0) {
+            throw std::invalid_argument("mobile_population: rates can't be negative");
+        }
+        if(timeout <= 0 || report_interval <= 0) {
+            throw std::invalid_argument("mobile_population: timeout and report interval must be positive");
+        }
+        if(first_min.size() != 10 || first_min.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::invalid_argument("mobile_population: first_min must be ten digits");
+        }
+        const unsigned long long base = strtoull(first_min.c_str(), NULL, 10);
+        if(base + nmobiles - 1 > 9999999999ULL) {
+            throw std::invalid_argument("mobile_population: too many mobiles for first_min");
+        }
+        d_mobiles.resize(nmobiles);
+        for(int i = 0; i < nmobiles; i++) {
+            char min[16];
+            snprintf(min, sizeof(min), "%010llu", base + i);
+            parse_min(min, d_mobiles[i].min1, d_mobiles[i].min2);
+            d_mobiles[i].esn = 0x82000000UL | (unsigned long)i;
+        }
+        d_rng.seed(seed != 0 ? (uint32_t)seed : (uint32_t)now_ns());
+        d_rate[MOBILE_REGISTRATION] = reg_rate;
+        d_rate[MOBILE_ORIGINATION] = orig_rate;
+        d_rate[MOBILE_PAGE_RESPONSE] = resp_rate;
+        d_burst.reserve(RECC_BURST_SYMS);
+        reset_window(now_ns());
+
+        message_port_register_in(pmt::mp("focc_sent"));
+        set_msg_handler(pmt::mp("focc_sent"),
+            boost::bind(&mobile_population_impl::focc_sent_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("control"));
+        set_msg_handler(pmt::mp("control"),
+            boost::bind(&mobile_population_impl::control_message, this, _1)
+        );
+        message_port_register_out(pmt::mp("bursts"));
+        message_port_register_out(pmt::mp("stats"));
+    }
+
+    mobile_population_impl::~mobile_population_impl()
+    {
+    }
+
+    uint64_t
+    mobile_population_impl::now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+    }
+
+    // Uniform on (0, 1).
+    double
+    mobile_population_impl::uniform() {
+        return (d_rng() + 0.5) / 4294967296.0;
+    }
+
+    bool
+    mobile_population_impl::start() {
+        d_finished = false;
+        d_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&mobile_population_impl::run, this)));
+        return block::start();
+    }
+
+    bool
+    mobile_population_impl::stop() {
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            d_finished = true;
+        }
+        d_cond.notify_one();
+        if(d_thread) {
+            d_thread->join();
+            d_thread.reset();
+        }
+        return block::stop();
+    }
+
+    /*
+     * Generator thread.  The three kinds of event are independent Poisson
+     * processes, so together they're one Poisson process at the total rate,
+     * with each arrival's kind picked in proportion to its rate.  Arrivals
+     * are scheduled on an absolute timeline; if the thread falls behind, it
+     * catches up by sending everything that's due rather than by silently
+     * lowering the load.
+     */
+    void
+    mobile_population_impl::run() {
+        const uint64_t report_ns = (uint64_t)(d_report_interval * 1e9);
+        uint64_t now = now_ns();
+        uint64_t next = now;
+        uint64_t next_report = now + report_ns;
+        double rate[MOBILE_NEVENTS];
+        double total = 0.0;
+
+        while(true) {
+            {
+                boost::mutex::scoped_lock lock(d_mutex);
+                if(d_finished) {
+                    break;
+                }
+                if(d_rates_changed) {
+                    d_rates_changed = false;
+                    total = 0.0;
+                    for(int i = 0; i < MOBILE_NEVENTS; i++) {
+                        rate[i] = d_rate[i];
+                        total += rate[i];
+                    }
+                    now = now_ns();
+                    if(total > 0.0) {
+                        next = now + (uint64_t)(-log(uniform()) / total * 1e9);
+                    }
+                    next_report = now + report_ns;
+                }
+            }
+
+            now = now_ns();
+            while(total > 0.0 && next <= now) {
+                double pick = uniform() * total;
+                int type = 0;
+                while(type < MOBILE_NEVENTS - 1 && pick >= rate[type]) {
+                    pick -= rate[type];
+                    type++;
+                }
+                send((mobile_event)type, now);
+                next += (uint64_t)(-log(uniform()) / total * 1e9);
+            }
+            expire(now);
+            if(now >= next_report) {
+                report(now);
+                next_report = std::max(next_report + report_ns, now);
+            }
+
+            uint64_t wake = std::min(next_report, now + POPULATION_MAX_SLEEP_NS);
+            if(total > 0.0) {
+                wake = std::min(wake, next);
+            }
+            boost::mutex::scoped_lock lock(d_mutex);
+            if(d_finished == false && d_rates_changed == false && wake > now) {
+                d_cond.timed_wait(lock, boost::posix_time::microseconds((wake - now) / 1000));
+            }
+        }
+    }
+
+    /*
+     * Build a burst for a random mobile and post it.  The mobile is marked
+     * as waiting before the burst goes out, so the answer can't beat it.
+     */
+    void
+    mobile_population_impl::send(mobile_event type, uint64_t now) {
+        const size_t idx = d_rng() % d_mobiles.size();
+        const virtual_mobile &ms = d_mobiles[idx];
+        d_burst.clear();
+        switch(type) {
+            case MOBILE_REGISTRATION:
+                d_encoder.registration(d_burst, GLOBAL_DCC_SHORT, ms.min1, ms.min2, ms.esn, POPULATION_SCM, false);
+                break;
+            case MOBILE_ORIGINATION:
+                {
+                    char dialed[11];
+                    dialed[0] = '2' + (d_rng() % 8);
+                    for(int i = 1; i < 10; i++) {
+                        dialed[i] = '0' + (d_rng() % 10);
+                    }
+                    dialed[10] = 0;
+                    d_encoder.origination(d_burst, GLOBAL_DCC_SHORT, ms.min1, ms.min2, ms.esn, POPULATION_SCM, dialed, false);
+                }
+                break;
+            default:
+                d_encoder.page_response(d_burst, GLOBAL_DCC_SHORT, ms.min1, ms.min2, POPULATION_SCM, false);
+                break;
+        }
+        // The trace rides through RECC Decode onto the answer, and comes
+        // back from the FOCC when the answer goes out.
+        const uint64_t trace_id = next_trace_id();
+        const uint64_t min = pack_min(ms.min1, ms.min2);
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            std::pair<pending_map::iterator, bool> ins = d_pending.insert(std::make_pair(min, population_pending()));
+            if(ins.second == false) {
+                d_window.superseded++;
+            }
+            ins.first->second.sent_ns = now;
+            ins.first->second.traces.push_back(trace_id);
+            d_pending_traces[trace_id] = min;
+            d_window.sent[type]++;
+        }
+        pmt::pmt_t meta = pmt::make_dict();
+        meta = pmt::dict_add(meta, pmt::mp("trace_id"), pmt::from_uint64(trace_id));
+        meta = pmt::dict_add(meta, pmt::mp("detect_ns"), pmt::from_uint64(now));
+        message_port_pub(pmt::mp("bursts"), pmt::cons(meta, pmt::make_blob(&d_burst[0], d_burst.size())));
+    }
+
+    // Stop waiting on a mobile.  Called with d_mutex held.
+    mobile_population_impl::pending_map::iterator
+    mobile_population_impl::forget(pending_map::iterator it) {
+        const std::vector<uint64_t> &traces = it->second.traces;
+        for(size_t i = 0; i < traces.size(); i++) {
+            d_pending_traces.erase(traces[i]);
+        }
+        return d_pending.erase(it);
+    }
+
+    // Give up on mobiles that have waited longer than the timeout.
+    void
+    mobile_population_impl::expire(uint64_t now) {
+        const uint64_t timeout_ns = (uint64_t)(d_timeout * 1e9);
+        boost::mutex::scoped_lock lock(d_mutex);
+        pending_map::iterator it = d_pending.begin();
+        while(it != d_pending.end()) {
+            if(now - it->second.sent_ns > timeout_ns) {
+                it = forget(it);
+                d_window.timeouts++;
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void
+    mobile_population_impl::reset_window(uint64_t now) {
+        d_window.start_ns = now;
+        for(int i = 0; i < MOBILE_NEVENTS; i++) {
+            d_window.sent[i] = 0;
+        }
+        d_window.answered = 0;
+        d_window.timeouts = 0;
+        d_window.superseded = 0;
+        d_window.latency_us.clear();
+    }
+
+    /*
+     * Post (and log) the interval's numbers, then start a new interval.
+     */
+    void
+    mobile_population_impl::report(uint64_t now) {
+        population_window w;
+        size_t npending;
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            w = d_window;
+            npending = d_pending.size();
+            reset_window(now);
+        }
+        const double secs = (now - w.start_ns) / 1e9;
+        uint64_t sent = 0;
+        for(int i = 0; i < MOBILE_NEVENTS; i++) {
+            sent += w.sent[i];
+        }
+        double p50 = 0.0, p99 = 0.0, pmax = 0.0;
+        if(w.latency_us.empty() == false) {
+            std::vector<uint32_t> &l = w.latency_us;
+            std::sort(l.begin(), l.end());
+            p50 = l[(l.size() - 1) / 2] / 1000.0;
+            p99 = l[((l.size() - 1) * 99) / 100] / 1000.0;
+            pmax = l.back() / 1000.0;
+        }
+        const double offered = (secs > 0.0) ? (sent / secs) : 0.0;
+
+        pmt::pmt_t d = pmt::make_dict();
+        d = pmt::dict_add(d, pmt::mp("offered"), pmt::from_double(offered));
+        d = pmt::dict_add(d, pmt::mp("sent"), pmt::from_uint64(sent));
+        for(int i = 0; i < MOBILE_NEVENTS; i++) {
+            d = pmt::dict_add(d, pmt::mp(mobile_event_names[i]), pmt::from_uint64(w.sent[i]));
+        }
+        d = pmt::dict_add(d, pmt::mp("answered"), pmt::from_uint64(w.answered));
+        d = pmt::dict_add(d, pmt::mp("timeouts"), pmt::from_uint64(w.timeouts));
+        d = pmt::dict_add(d, pmt::mp("superseded"), pmt::from_uint64(w.superseded));
+        d = pmt::dict_add(d, pmt::mp("pending"), pmt::from_uint64(npending));
+        d = pmt::dict_add(d, pmt::mp("p50_ms"), pmt::from_double(p50));
+        d = pmt::dict_add(d, pmt::mp("p99_ms"), pmt::from_double(p99));
+        d = pmt::dict_add(d, pmt::mp("max_ms"), pmt::from_double(pmax));
+        message_port_pub(pmt::mp("stats"), d);
+        LOG_INFO("mobile population: offered %.1f/s, sent %llu, answered %llu, timeouts %llu; latency p50 %.3f ms p99 %.3f ms max %.3f ms",
+                offered, (unsigned long long)sent, (unsigned long long)w.answered,
+                (unsigned long long)w.timeouts, p50, p99, pmax);
+    }
+
+    /*
+     * Traces of answers the FOCC has started sending, from its latency
+     * output.  A mobile has its answer once it's on the air, not when RECC
+     * Decode decides on it, so that's where its wait ends.  Traces that
+     * aren't ours (real mobiles, or answers we've stopped waiting for)
+     * just don't match.
+     */
+    void
+    mobile_population_impl::focc_sent_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            return;
+        }
+        pmt::pmt_t trace_id = pmt::dict_ref(msg, pmt::mp("trace_id"), pmt::PMT_NIL);
+        if(pmt::is_uint64(trace_id) == false && pmt::is_integer(trace_id) == false) {
+            return;
+        }
+        pmt::pmt_t tx_ns = pmt::dict_ref(msg, pmt::mp("tx_ns"), pmt::PMT_NIL);
+        const uint64_t now = (pmt::is_uint64(tx_ns) || pmt::is_integer(tx_ns)) ? pmt::to_uint64(tx_ns) : now_ns();
+
+        boost::mutex::scoped_lock lock(d_mutex);
+        boost::unordered_map<uint64_t, uint64_t>::iterator t = d_pending_traces.find(pmt::to_uint64(trace_id));
+        if(t == d_pending_traces.end()) {
+            return;
+        }
+        pending_map::iterator it = d_pending.find(t->second);
+        if(it == d_pending.end()) {
+            d_pending_traces.erase(t);
+            return;
+        }
+        const uint64_t us = (now > it->second.sent_ns) ? ((now - it->second.sent_ns) / 1000) : 0;
+        forget(it);
+        d_window.answered++;
+        d_window.latency_us.push_back(us > 0xffffffffULL ? 0xffffffffU : (uint32_t)us);
+    }
+
+    void
+    mobile_population_impl::control_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            LOG_WARNING("mobile_population: ignoring control message that isn't a dict");
+            return;
+        }
+        static const char *keys[MOBILE_NEVENTS] = { "reg_rate", "orig_rate", "resp_rate" };
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            for(int i = 0; i < MOBILE_NEVENTS; i++) {
+                pmt::pmt_t v = pmt::dict_ref(msg, pmt::mp(keys[i]), pmt::PMT_NIL);
+                if(pmt::is_number(v) && pmt::to_double(v) >= 0) {
+                    d_rate[i] = pmt::to_double(v);
+                }
+            }
+            d_rates_changed = true;
+            reset_window(now_ns());
+        }
+        d_cond.notify_one();
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,101 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_MOBILE_POPULATION_IMPL_H
+#define INCLUDED_AMPS_MOBILE_POPULATION_IMPL_H
+
+#include <amps/mobile_population.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <vector>
+#include "recc_burst.h"
+
+namespace gr {
+  namespace amps {
+
+    enum mobile_event {
+        MOBILE_REGISTRATION = 0,
+        MOBILE_ORIGINATION,
+        MOBILE_PAGE_RESPONSE,
+        MOBILE_NEVENTS
+    };
+
+    struct virtual_mobile {
+        u_int64_t min1;
+        u_int64_t min2;
+        unsigned long esn;
+    };
+
+    // A mobile waiting for its answer.
+    struct population_pending {
+        uint64_t sent_ns;               // when it last sent
+        std::vector<uint64_t> traces;   // trace IDs of its bursts, any of which the answer may carry
+    };
+
+    // Counters for one report interval.
+    struct population_window {
+        uint64_t start_ns;
+        uint64_t sent[MOBILE_NEVENTS];
+        uint64_t answered;
+        uint64_t timeouts;
+        uint64_t superseded;        // a mobile sent again before it was answered
+        std::vector<uint32_t> latency_us;
+    };
+
+    class mobile_population_impl : public mobile_population
+    {
+    private:
+        const double d_timeout;
+        const double d_report_interval;
+        std::vector<virtual_mobile> d_mobiles;
+
+        // Owned by the generator thread.
+        boost::mt19937 d_rng;
+        recc_burst_encoder d_encoder;
+        std::vector<unsigned char> d_burst;
+
+        // Everything below is shared between the generator thread and the
+        // message handlers.
+        boost::mutex d_mutex;
+        boost::condition_variable d_cond;
+        double d_rate[MOBILE_NEVENTS];
+        bool d_rates_changed;
+        typedef boost::unordered_map<uint64_t, population_pending> pending_map;
+        pending_map d_pending;                                  // packed MIN -> waiting mobile
+        boost::unordered_map<uint64_t, uint64_t> d_pending_traces;     // trace ID -> packed MIN
+        population_window d_window;
+        bool d_finished;
+        boost::shared_ptr<boost::thread> d_thread;
+
+        static uint64_t now_ns();
+        double uniform();
+        void run();
+        void send(mobile_event type, uint64_t now);
+        void expire(uint64_t now);
+        void report(uint64_t now);
+        void reset_window(uint64_t now);
+        pending_map::iterator forget(pending_map::iterator it);
+
+    public:
+        mobile_population_impl(int nmobiles, const std::string &first_min,
+                double reg_rate, double orig_rate, double resp_rate,
+                double timeout, double report_interval, int seed);
+        ~mobile_population_impl();
+
+        bool start();
+        bool stop();
+
+        void focc_sent_message(pmt::pmt_t msg);
+        void control_message(pmt::pmt_t msg);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_MOBILE_POPULATION_IMPL_H */
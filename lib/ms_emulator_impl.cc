@@ -0,0 +1,499 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "ms_emulator_impl.h"
+#include "subscriber_registry.h"
+#include <algorithm>
+#include <stdexcept>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    // One tick is one RECC symbol.
+    static const double MS_TICKS_PER_SEC = 20000.0;
+    static const unsigned char MS_SCM = 0xa;
+
+    // 553 2.6.3.1: a random delay of 0-92 ms before looking at the
+    // busy-idle bits, and at most 10 busy looks per access attempt.
+    static const uint64_t MS_ACCESS_DELAY_TICKS = 1840;
+    static const int MS_MAX_BUSY = 10;
+    static const int MS_MAX_ATTEMPTS = 2;
+    // 2.6.3.7 et al.: five seconds for the land station's answer.
+    static const uint64_t MS_RESPONSE_TICKS = 100000;
+
+    static const char *ms_access_names[MS_NACCESSES] = {
+        "registrations", "originations", "page_responses"
+    };
+
+    ms_emulator::sptr
+    ms_emulator::make(unsigned long symrate, int nmobiles, const std::string &first_min,
+            double orig_rate, double hold_time, double snr_db, double snr_spread,
+            int max_delay, double power_on_spread, double report_interval, int seed) {
+        return gnuradio::get_initial_sptr (new ms_emulator_impl(symrate, nmobiles, first_min,
+                    orig_rate, hold_time, snr_db, snr_spread, max_delay, power_on_spread,
+                    report_interval, seed));
+    }
+
+    ms_emulator_impl::ms_emulator_impl(unsigned long symrate, int nmobiles, const std::string &first_min,
+            double orig_rate, double hold_time, double snr_db, double snr_spread,
+            int max_delay, double power_on_spread, double report_interval, int seed)
+      : gr::sync_decimator("ms_emulator",
+              gr::io_signature::make(1, 1, sizeof(char)),
+              gr::io_signature::make(1, 1, sizeof(unsigned char)),
+              symrate / 20000),
+        d_decim(symrate / 20000), d_orig_rate(orig_rate), d_hold_time(hold_time),
+        d_report_ticks((uint64_t)(report_interval * MS_TICKS_PER_SEC)),
+        d_fwd_sigma(powf(10.0f, (float)(-snr_db / 20.0))),
+        d_wheel(0), d_now(0)
+    {
+        if(symrate < 20000 || (symrate % 20000) != 0) {
+            throw std::invalid_argument("ms_emulator: symrate must be a multiple of 20000");
+        }
+        if(nmobiles < 1) {
+            throw std::invalid_argument("ms_emulator: nmobiles must be at least 1");
+        }
+        if(orig_rate < 0 || hold_time <= 0 || snr_spread < 0 || max_delay < 0 || power_on_spread < 0) {
+            throw std::invalid_argument("ms_emulator: rates, times, spreads and delays can't be negative");
+        }
+        if(report_interval <= 0) {
+            throw std::invalid_argument("ms_emulator: report interval must be positive");
+        }
+        if(first_min.size() != 10 || first_min.find_first_not_of("0123456789") != std::string::npos) {
+            throw std::invalid_argument("ms_emulator: first_min must be ten digits");
+        }
+        const unsigned long long base = strtoull(first_min.c_str(), NULL, 10);
+        if(base + nmobiles - 1 > 9999999999ULL) {
+            throw std::invalid_argument("ms_emulator: too many mobiles for first_min");
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        d_rng.seed(seed != 0 ? (uint32_t)seed : (uint32_t)(ts.tv_sec ^ ts.tv_nsec));
+
+        d_mobiles.resize(nmobiles);
+        for(int i = 0; i < nmobiles; i++) {
+            emulated_mobile &ms = d_mobiles[i];
+            char min[16];
+            snprintf(min, sizeof(min), "%010llu", base + i);
+            parse_min(min, ms.min1, ms.min2);
+            ms.esn = 0x83000000UL | (unsigned long)i;
+            ms.accolc = (base + i) % 10;
+            const double snr = snr_db + ((2.0 * uniform()) - 1.0) * snr_spread;
+            ms.amp = powf(10.0f, (float)(snr / 20.0));
+            ms.delay = d_rng() % (max_delay + 1);
+            ms.state = MS_OFF;
+            ms.access = MS_REGISTRATION;
+            ms.attempts = 0;
+            ms.busy_tries = 0;
+            ms.access_start = 0;
+            ms.registered = false;
+            ms.nxtreg = 0;
+            ms.txpos = 0;
+            ms.burst.reserve(RECC_BURST_SYMS + 128);
+            d_by_min[pack_min(ms.min1, ms.min2)] = i;
+            d_wheel.schedule(&ms.timer, 1 + (uint64_t)(uniform() * power_on_spread * MS_TICKS_PER_SEC));
+        }
+        d_expired.reserve(256);
+        d_transmitting.reserve(16);
+
+        d_ohd.seen = false;
+        d_ohd.sid = 0;
+        d_ohd.dcc = GLOBAL_DCC_SHORT;
+        d_ohd.regh = false;
+        d_ohd.regr = false;
+        d_ohd.nminusone = 0;
+        d_ohd.cmax = 0;
+        d_ohd.bis = false;
+        d_ohd.regid = 0;
+        d_ohd.regincr = 0;
+        d_ohd.olc = 0xffff;
+        d_have_word1[0] = d_have_word1[1] = false;
+
+        d_next_orig = (d_orig_rate > 0.0) ? random_ticks(1.0 / d_orig_rate) : 0;
+        d_next_report = d_report_ticks;
+        reset_window();
+
+        message_port_register_out(pmt::mp("stats"));
+    }
+
+    ms_emulator_impl::~ms_emulator_impl()
+    {
+    }
+
+    // Uniform on (0, 1).
+    double
+    ms_emulator_impl::uniform() {
+        return (d_rng() + 0.5) / 4294967296.0;
+    }
+
+    // Exponentially distributed, at least one tick.
+    uint64_t
+    ms_emulator_impl::random_ticks(double mean_secs) {
+        return 1 + (uint64_t)(-log(uniform()) * mean_secs * MS_TICKS_PER_SEC);
+    }
+
+    /*
+     * Hand both streams' words to the mobiles.  Overhead words go to
+     * everyone; a mobile station control message is a Word 1 (with the
+     * MIN1) followed, on the same stream, by a Word 2 (with the MIN2).
+     */
+    void
+    ms_emulator_impl::handle_frame() {
+        const focc_rx_frame &f = d_rx.frame();
+        for(int s = 0; s < 2; s++) {
+            if(f.valid[s] == false) {
+                d_have_word1[s] = false;
+                continue;
+            }
+            const unsigned char *w = f.words[s];
+            const unsigned char t1t2 = get8(w, 2);
+            if(t1t2 == 3) {
+                handle_overhead(w);
+            } else if(t1t2 == 1) {
+                d_word1[s] = get64(&w[4], 24);
+                d_have_word1[s] = true;
+            } else if(t1t2 == 2 && d_have_word1[s]) {
+                handle_message(s, w);
+                d_have_word1[s] = false;
+            } else {
+                // single-word messages (T1T2 = 00) aren't for us
+                d_have_word1[s] = false;
+            }
+        }
+    }
+
+    // 553 3.7.1.2
+    void
+    ms_emulator_impl::handle_overhead(const unsigned char *w) {
+        const unsigned char ohd = get8(&w[25], 3);
+        switch(ohd) {
+            case 6:         // system parameter overhead, word 1
+                d_ohd.olc = 0xffff;     // until an overload control message says otherwise
+                d_ohd.dcc = get8(&w[2], 2);
+                d_ohd.sid = get32(&w[4], 14) << 1;
+                break;
+            case 7:         // system parameter overhead, word 2
+                d_ohd.regh = (w[6] == 1);
+                d_ohd.regr = (w[7] == 1);
+                d_ohd.nminusone = get8(&w[10], 5);
+                d_ohd.cmax = get8(&w[17], 7);
+                break;
+            case 4:         // global action
+                switch(get8(&w[4], 4)) {
+                    case 0x2:
+                        d_ohd.regincr = get32(&w[8], 12);
+                        break;
+                    case 0x6:
+                        d_ohd.olc = 0;
+                        for(int i = 0; i < 16; i++) {
+                            d_ohd.olc |= (w[8 + i] & 1) << i;
+                        }
+                        break;
+                    case 0x9:
+                        d_ohd.bis = (w[8] == 1);
+                        break;
+                    default:
+                        break;
+                }
+                break;
+            case 0:         // registration ID
+                d_ohd.regid = get32(&w[4], 20);
+                d_ohd.seen = true;
+                check_registrations();
+                break;
+            default:        // control filler
+                break;
+        }
+    }
+
+    /*
+     * A Word 1 / Word 2 pair.  SCC 11 means an order; anything else is a
+     * voice channel designation.  The land station sends most messages on
+     * both streams, so the second copy usually finds the mobile no longer
+     * in a state that cares.
+     */
+    void
+    ms_emulator_impl::handle_message(int stream, const unsigned char *w) {
+        boost::unordered_map<uint64_t, int>::iterator it = d_by_min.find(pack_min(d_word1[stream], get64(&w[4], 10)));
+        if(it == d_by_min.end()) {
+            return;
+        }
+        const int idx = it->second;
+        emulated_mobile &ms = d_mobiles[idx];
+        const unsigned char scc = get8(&w[2], 2);
+        const unsigned char order = get8(&w[23], 5);
+        const unsigned char ordq = get8(&w[20], 3);
+        const unsigned char msg_type = get8(&w[15], 5);
+
+        if(ms.state == MS_IDLE) {
+            if(scc == 3 && order == ORDER_PAGE && ordq == 0 && msg_type == 0) {
+                start_access(idx, MS_PAGE_RESPONSE, true);
+            }
+            return;
+        }
+        if(ms.state != MS_AWAIT_RESPONSE) {
+            return;
+        }
+        if(scc != 3) {
+            if(ms.access == MS_REGISTRATION) {
+                return;
+            }
+            end_access(idx, true);
+            ms.state = MS_CONVERSATION;
+            d_wheel.schedule(&ms.timer, random_ticks(d_hold_time));
+        } else if(order == ORDER_AUDIT && ms.access == MS_REGISTRATION) {
+            ms.registered = true;
+            ms.nxtreg = (d_ohd.regid + d_ohd.regincr) & 0xfffff;
+            end_access(idx, true);
+        } else if(order == ORDER_REORDER || order == ORDER_INTERCEPT) {
+            d_window.blocked++;
+            end_access(idx, false);
+        }
+    }
+
+    /*
+     * 553 2.6.1.1.2, roughly: on each REGID, idle mobiles that have never
+     * registered (and may, per REGH) or whose NXTREG has come around do so.
+     */
+    void
+    ms_emulator_impl::check_registrations() {
+        if(d_ohd.regh == false) {
+            return;
+        }
+        for(size_t i = 0; i < d_mobiles.size(); i++) {
+            emulated_mobile &ms = d_mobiles[i];
+            if(ms.state != MS_IDLE) {
+                continue;
+            }
+            if(ms.registered == false || (d_ohd.regincr > 0 && d_ohd.regid >= ms.nxtreg)) {
+                start_access(i, MS_REGISTRATION, true);
+            }
+        }
+    }
+
+    void
+    ms_emulator_impl::start_access(int idx, ms_access access, bool first) {
+        emulated_mobile &ms = d_mobiles[idx];
+        if(first) {
+            ms.access = access;
+            ms.attempts = 0;
+            ms.access_start = d_now;
+            d_window.accesses[access]++;
+        }
+        ms.attempts++;
+        ms.busy_tries = 0;
+        ms.state = MS_ACCESS_WAIT;
+        d_wheel.schedule(&ms.timer, 1 + (d_rng() % MS_ACCESS_DELAY_TICKS));
+    }
+
+    void
+    ms_emulator_impl::end_access(int idx, bool success) {
+        emulated_mobile &ms = d_mobiles[idx];
+        d_wheel.cancel(&ms.timer);
+        ms.state = MS_IDLE;
+        if(success) {
+            const uint64_t lat = d_now - ms.access_start;
+            d_window.successes++;
+            d_window.latency.push_back(lat > 0xffffffffULL ? 0xffffffffU : (uint32_t)lat);
+        }
+    }
+
+    void
+    ms_emulator_impl::handle_timeout(int idx) {
+        emulated_mobile &ms = d_mobiles[idx];
+        switch(ms.state) {
+            case MS_OFF:
+                ms.state = MS_IDLE;
+                if(d_ohd.seen && d_ohd.regh) {
+                    start_access(idx, MS_REGISTRATION, true);
+                }
+                break;
+            case MS_ACCESS_WAIT:
+                if(d_rx.locked() && d_rx.idle()) {
+                    ms.burst.clear();
+                    ms.burst.insert(ms.burst.end(), ms.delay, 0);
+                    const unsigned char dcc = d_ohd.dcc;
+                    if(ms.access == MS_REGISTRATION) {
+                        d_encoder.registration(ms.burst, dcc, ms.min1, ms.min2, ms.esn, MS_SCM, true);
+                    } else if(ms.access == MS_PAGE_RESPONSE) {
+                        d_encoder.page_response(ms.burst, dcc, ms.min1, ms.min2, MS_SCM, true);
+                    } else {
+                        char dialed[11];
+                        dialed[0] = '2' + (d_rng() % 8);
+                        for(int i = 1; i < 10; i++) {
+                            dialed[i] = '0' + (d_rng() % 10);
+                        }
+                        dialed[10] = 0;
+                        d_encoder.origination(ms.burst, dcc, ms.min1, ms.min2, ms.esn, MS_SCM, dialed, true);
+                    }
+                    if(d_transmitting.empty() == false) {
+                        d_window.overlaps++;
+                    }
+                    ms.txpos = 0;
+                    ms.state = MS_TRANSMITTING;
+                    d_transmitting.push_back(idx);
+                } else if(++ms.busy_tries >= MS_MAX_BUSY) {
+                    d_window.busy++;
+                    end_access(idx, false);
+                } else {
+                    d_wheel.schedule(&ms.timer, 1 + (d_rng() % MS_ACCESS_DELAY_TICKS));
+                }
+                break;
+            case MS_AWAIT_RESPONSE:
+                if(ms.attempts < MS_MAX_ATTEMPTS) {
+                    start_access(idx, ms.access, false);
+                } else {
+                    d_window.timeouts++;
+                    end_access(idx, false);
+                }
+                break;
+            case MS_CONVERSATION:
+                ms.state = MS_IDLE;
+                break;
+            default:
+                break;
+        }
+    }
+
+    /*
+     * One reverse-channel symbol: every transmitting mobile's symbol at its
+     * own amplitude (the delay is leading silence in its burst), plus unit
+     * Gaussian noise, sliced.
+     */
+    unsigned char
+    ms_emulator_impl::transmit() {
+        float sum = d_normal(d_rng);
+        size_t i = 0;
+        while(i < d_transmitting.size()) {
+            emulated_mobile &ms = d_mobiles[d_transmitting[i]];
+            if(ms.txpos >= ms.delay) {
+                sum += ms.burst[ms.txpos] ? ms.amp : -ms.amp;
+            }
+            if(++ms.txpos < ms.burst.size()) {
+                i++;
+                continue;
+            }
+            ms.state = MS_AWAIT_RESPONSE;
+            d_wheel.schedule(&ms.timer, MS_RESPONSE_TICKS);
+            d_transmitting[i] = d_transmitting.back();
+            d_transmitting.pop_back();
+        }
+        return (sum > 0.0f) ? 1 : 0;
+    }
+
+    void
+    ms_emulator_impl::reset_window() {
+        d_window.start = d_now;
+        for(int i = 0; i < MS_NACCESSES; i++) {
+            d_window.accesses[i] = 0;
+        }
+        d_window.successes = 0;
+        d_window.blocked = 0;
+        d_window.timeouts = 0;
+        d_window.busy = 0;
+        d_window.barred = 0;
+        d_window.overlaps = 0;
+        d_window.latency.clear();
+    }
+
+    void
+    ms_emulator_impl::report() {
+        double p50 = 0.0, p99 = 0.0, pmax = 0.0;
+        std::vector<uint32_t> &l = d_window.latency;
+        if(l.empty() == false) {
+            std::sort(l.begin(), l.end());
+            p50 = l[(l.size() - 1) / 2] * 1000.0 / MS_TICKS_PER_SEC;
+            p99 = l[((l.size() - 1) * 99) / 100] * 1000.0 / MS_TICKS_PER_SEC;
+            pmax = l.back() * 1000.0 / MS_TICKS_PER_SEC;
+        }
+        uint64_t accesses = 0;
+        pmt::pmt_t d = pmt::make_dict();
+        for(int i = 0; i < MS_NACCESSES; i++) {
+            accesses += d_window.accesses[i];
+            d = pmt::dict_add(d, pmt::mp(ms_access_names[i]), pmt::from_uint64(d_window.accesses[i]));
+        }
+        d = pmt::dict_add(d, pmt::mp("successes"), pmt::from_uint64(d_window.successes));
+        d = pmt::dict_add(d, pmt::mp("blocked"), pmt::from_uint64(d_window.blocked));
+        d = pmt::dict_add(d, pmt::mp("timeouts"), pmt::from_uint64(d_window.timeouts));
+        d = pmt::dict_add(d, pmt::mp("busy"), pmt::from_uint64(d_window.busy));
+        d = pmt::dict_add(d, pmt::mp("barred"), pmt::from_uint64(d_window.barred));
+        d = pmt::dict_add(d, pmt::mp("overlaps"), pmt::from_uint64(d_window.overlaps));
+        d = pmt::dict_add(d, pmt::mp("p50_ms"), pmt::from_double(p50));
+        d = pmt::dict_add(d, pmt::mp("p99_ms"), pmt::from_double(p99));
+        d = pmt::dict_add(d, pmt::mp("max_ms"), pmt::from_double(pmax));
+        d = pmt::dict_add(d, pmt::mp("focc_locked"), pmt::from_bool(d_rx.locked()));
+        d = pmt::dict_add(d, pmt::mp("focc_frames"), pmt::from_uint64(d_rx.frames()));
+        d = pmt::dict_add(d, pmt::mp("focc_bad_words"), pmt::from_uint64(d_rx.bad_words()));
+        d = pmt::dict_add(d, pmt::mp("focc_sync_losses"), pmt::from_uint64(d_rx.sync_losses()));
+        message_port_pub(pmt::mp("stats"), d);
+        LOG_INFO("ms emulator: %llu accesses, %llu answered, %llu blocked, %llu timed out, %llu busy, %llu barred, %llu overlaps; latency p50 %.1f ms p99 %.1f ms max %.1f ms",
+                (unsigned long long)accesses, (unsigned long long)d_window.successes,
+                (unsigned long long)d_window.blocked, (unsigned long long)d_window.timeouts,
+                (unsigned long long)d_window.busy, (unsigned long long)d_window.barred,
+                (unsigned long long)d_window.overlaps, p50, p99, pmax);
+        reset_window();
+    }
+
+    int
+    ms_emulator_impl::work(int noutput_items,
+            gr_vector_const_void_star &input_items,
+            gr_vector_void_star &output_items)
+    {
+        const char *in = (const char *)input_items[0];
+        unsigned char *out = (unsigned char *)output_items[0];
+
+        for(int i = 0; i < noutput_items; i++) {
+            // Forward channel: integrate a half-bit, add noise at the mean SNR.
+            int acc = 0;
+            for(unsigned int j = 0; j < d_decim; j++) {
+                acc += in[(i * d_decim) + j];
+            }
+            const float halfbit = ((float)acc / d_decim) + (d_fwd_sigma * d_normal(d_rng));
+            if(d_rx.push(halfbit)) {
+                handle_frame();
+            }
+
+            d_now++;
+            d_expired.clear();
+            d_wheel.advance(d_now, d_expired);
+            for(size_t k = 0; k < d_expired.size(); k++) {
+                const int idx = ((char *)d_expired[k] - (char *)&d_mobiles[0].timer) / sizeof(emulated_mobile);
+                handle_timeout(idx);
+            }
+
+            if(d_orig_rate > 0.0 && d_now >= d_next_orig) {
+                const int idx = d_rng() % d_mobiles.size();
+                if(d_mobiles[idx].state == MS_IDLE) {
+                    if(((d_ohd.olc >> d_mobiles[idx].accolc) & 1) == 0) {
+                        d_window.barred++;
+                    } else {
+                        start_access(idx, MS_ORIGINATION, true);
+                    }
+                }
+                d_next_orig = d_now + random_ticks(1.0 / d_orig_rate);
+            }
+
+            out[i] = transmit();
+
+            if(d_now >= d_next_report) {
+                report();
+                d_next_report = d_now + d_report_ticks;
+            }
+        }
+        return noutput_items;
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,143 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_MS_EMULATOR_IMPL_H
+#define INCLUDED_AMPS_MS_EMULATOR_IMPL_H
+
+#include <amps/ms_emulator.h>
+#include <boost/unordered_map.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/normal_distribution.hpp>
+#include <vector>
+#include "focc_receiver.h"
+#include "recc_burst.h"
+#include "timer_wheel.h"
+
+namespace gr {
+  namespace amps {
+
+    enum ms_state {
+        MS_OFF,                 // not powered on yet; the timer is the power-on time
+        MS_IDLE,                // the timer is unused
+        MS_ACCESS_WAIT,         // the timer is the random delay before the busy-idle check
+        MS_TRANSMITTING,        // sending; no timer
+        MS_AWAIT_RESPONSE,      // the timer is the response timeout
+        MS_CONVERSATION         // the timer is the end of the call
+    };
+
+    enum ms_access {
+        MS_REGISTRATION = 0,
+        MS_ORIGINATION,
+        MS_PAGE_RESPONSE,
+        MS_NACCESSES
+    };
+
+    /*
+     * One emulated mobile.  Mobiles live in a fixed array (so their
+     * embedded timers never move) and are found by MIN.
+     */
+    struct emulated_mobile {
+        u_int64_t min1;
+        u_int64_t min2;
+        unsigned long esn;
+        unsigned char accolc;   // access overload class: the MIN's last digit
+        float amp;              // reverse-channel amplitude, relative to the noise
+        unsigned int delay;     // reverse-channel delay, in symbols
+        ms_state state;
+        ms_access access;       // what the current access is for
+        int attempts;           // access attempts made for it
+        int busy_tries;         // busy-idle checks that found the channel busy
+        uint64_t access_start;  // tick the access began
+        bool registered;
+        uint32_t nxtreg;        // register again once REGID reaches this
+        std::vector<unsigned char> burst;
+        size_t txpos;           // symbols sent, counting the delay
+        wheel_timer timer;
+    };
+
+    // What the mobiles have learned from the overhead train.
+    struct ms_overhead {
+        bool seen;              // a REGID has been received
+        unsigned short sid;
+        unsigned char dcc;
+        bool regh;
+        bool regr;
+        unsigned char nminusone;
+        unsigned char cmax;
+        bool bis;
+        uint32_t regid;
+        uint32_t regincr;
+        uint16_t olc;           // overload classes that may originate
+    };
+
+    // Counters for one report interval.
+    struct ms_window {
+        uint64_t start;         // tick
+        uint64_t accesses[MS_NACCESSES];
+        uint64_t successes;
+        uint64_t blocked;       // reorder or intercept
+        uint64_t timeouts;      // no response after every attempt
+        uint64_t busy;          // gave up on a busy channel
+        uint64_t barred;        // originations held back by overload control
+        uint64_t overlaps;      // transmissions that started on top of another
+        std::vector<uint32_t> latency;  // ticks
+    };
+
+    class ms_emulator_impl : public ms_emulator
+    {
+    private:
+        const unsigned int d_decim;
+        const double d_orig_rate;
+        const double d_hold_time;
+        const uint64_t d_report_ticks;
+        const float d_fwd_sigma;
+
+        boost::mt19937 d_rng;
+        boost::random::normal_distribution<float> d_normal;
+        focc_receiver d_rx;
+        recc_burst_encoder d_encoder;
+        ms_overhead d_ohd;
+        u_int64_t d_word1[2];   // MIN1 from each stream's last Word 1
+        bool d_have_word1[2];
+
+        std::vector<emulated_mobile> d_mobiles;
+        boost::unordered_map<uint64_t, int> d_by_min;
+        std::vector<int> d_transmitting;
+        timer_wheel d_wheel;
+        std::vector<wheel_timer *> d_expired;
+        uint64_t d_now;         // ticks (RECC symbols) since start
+        uint64_t d_next_orig;
+        uint64_t d_next_report;
+        ms_window d_window;
+
+        double uniform();
+        uint64_t random_ticks(double mean_secs);
+        void handle_frame();
+        void handle_overhead(const unsigned char *word);
+        void handle_message(int stream, const unsigned char *word);
+        void check_registrations();
+        void start_access(int idx, ms_access access, bool first);
+        void end_access(int idx, bool success);
+        void handle_timeout(int idx);
+        unsigned char transmit();
+        void report();
+        void reset_window();
+
+    public:
+        ms_emulator_impl(unsigned long symrate, int nmobiles, const std::string &first_min,
+                double orig_rate, double hold_time, double snr_db, double snr_spread,
+                int max_delay, double power_on_spread, double report_interval, int seed);
+        ~ms_emulator_impl();
+
+        int work(int noutput_items,
+                gr_vector_const_void_star &input_items,
+                gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_MS_EMULATOR_IMPL_H */
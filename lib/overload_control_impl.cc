@@ -0,0 +1,251 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "overload_control_impl.h"
+#include <algorithm>
+#include <stdexcept>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    /*
+     * Levels: 0 is normal, 1 turns on BIS, 2 also stops autonomous
+     * registration, and each level from 3 up bars two more of the access
+     * overload classes 0-9 from originating.
+     */
+    static const int OVERLOAD_BIS = 1;
+    static const int OVERLOAD_NO_REG = 2;
+    static const int OVERLOAD_BAR = 3;
+    static const int OVERLOAD_MAX_LEVEL = OVERLOAD_BAR + 4;
+
+    // Too few bursts in an interval to judge the failure fraction by.
+    static const uint64_t OVERLOAD_MIN_BURSTS = 5;
+
+    overload_control::sptr
+    overload_control::make(double interval, double max_seizure_rate, double max_failures,
+            int max_queue, double release, int hold) {
+        return gnuradio::get_initial_sptr (new overload_control_impl(interval, max_seizure_rate, max_failures,
+                    max_queue, release, hold));
+    }
+
+    overload_control_impl::overload_control_impl(double interval, double max_seizure_rate, double max_failures,
+            int max_queue, double release, int hold)
+      : gr::block("overload_control",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(0, 0, 0)),
+        d_interval_ns(interval * 1e9), d_max_rate(max_seizure_rate), d_max_failures(max_failures),
+        d_max_queue(max_queue), d_release(release), d_hold(hold),
+        d_level(0), d_calm(0), d_rotate(0), d_olc(0xffff), d_last_bursts(0), d_last_failed(0), d_last_ns(0),
+        d_have_stats(false), d_bursts(0), d_failed(0), d_queue(0), d_finished(false)
+    {
+        if(interval <= 0) {
+            throw std::invalid_argument("overload_control: interval must be positive");
+        }
+        if(max_seizure_rate <= 0 || max_failures <= 0 || max_failures > 1 || max_queue < 1) {
+            throw std::invalid_argument("overload_control: limits must be positive (and max_failures at most 1)");
+        }
+        if(release <= 0 || release >= 1) {
+            throw std::invalid_argument("overload_control: release must be between 0 and 1");
+        }
+        if(hold < 1) {
+            throw std::invalid_argument("overload_control: hold must be at least 1");
+        }
+        message_port_register_in(pmt::mp("decode_stats"));
+        set_msg_handler(pmt::mp("decode_stats"),
+            boost::bind(&overload_control_impl::decode_stats_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("queue_stats"));
+        set_msg_handler(pmt::mp("queue_stats"),
+            boost::bind(&overload_control_impl::queue_stats_message, this, _1)
+        );
+        message_port_register_out(pmt::mp("overhead"));
+        message_port_register_out(pmt::mp("stats"));
+    }
+
+    overload_control_impl::~overload_control_impl()
+    {
+    }
+
+    bool
+    overload_control_impl::start() {
+        d_finished = false;
+        d_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&overload_control_impl::run, this)));
+        return block::start();
+    }
+
+    bool
+    overload_control_impl::stop() {
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            d_finished = true;
+        }
+        d_cond.notify_one();
+        if(d_thread) {
+            d_thread->join();
+            d_thread.reset();
+        }
+        return block::stop();
+    }
+
+    // Running totals from the RECC Decode block; see recc_decode_impl::publish_stats().
+    void
+    overload_control_impl::decode_stats_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            LOG_WARNING("overload_control: ignoring decode stats that aren't a dict");
+            return;
+        }
+        pmt::pmt_t bursts = pmt::dict_ref(msg, pmt::mp("bursts"), pmt::PMT_NIL);
+        pmt::pmt_t bad = pmt::dict_ref(msg, pmt::mp("bad_word_a"), pmt::PMT_NIL);
+        pmt::pmt_t rejected = pmt::dict_ref(msg, pmt::mp("rejected"), pmt::PMT_NIL);
+        if(pmt::is_uint64(bursts) == false || pmt::is_uint64(bad) == false || pmt::is_uint64(rejected) == false) {
+            LOG_WARNING("overload_control: ignoring incomplete decode stats");
+            return;
+        }
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_bursts = pmt::to_uint64(bursts);
+        d_failed = pmt::to_uint64(bad) + pmt::to_uint64(rejected);
+        d_have_stats = true;
+    }
+
+    void
+    overload_control_impl::queue_stats_message(pmt::pmt_t msg) {
+        pmt::pmt_t depth = pmt::is_dict(msg) ? pmt::dict_ref(msg, pmt::mp("queue_depth"), pmt::PMT_NIL) : pmt::PMT_NIL;
+        if(pmt::is_uint64(depth) == false) {
+            LOG_WARNING("overload_control: ignoring queue stats without queue_depth");
+            return;
+        }
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_queue = pmt::to_uint64(depth);
+    }
+
+    /*
+     * The classes barred at this level: a run of them starting at d_rotate,
+     * which moves along every interval so that no class is shut out for the
+     * whole of an overload.  A set bit lets the class originate.
+     */
+    uint16_t
+    overload_control_impl::olc_for_level() const {
+        uint16_t olc = 0xffff;
+        const int nbarred = (d_level >= OVERLOAD_BAR) ? 2 * (d_level - OVERLOAD_BAR + 1) : 0;
+        for(int i = 0; i < nbarred; i++) {
+            olc &= ~(1 << ((d_rotate + i) % 10));
+        }
+        return olc;
+    }
+
+    void
+    overload_control_impl::publish_overhead() {
+        pmt::pmt_t d = pmt::make_dict();
+        d = pmt::dict_add(d, pmt::mp("bis"), pmt::from_bool(d_level >= OVERLOAD_BIS));
+        d = pmt::dict_add(d, pmt::mp("regh"), pmt::from_bool(d_level < OVERLOAD_NO_REG));
+        d = pmt::dict_add(d, pmt::mp("regr"), pmt::from_bool(d_level < OVERLOAD_NO_REG));
+        d = pmt::dict_add(d, pmt::mp("olc"), pmt::from_long(d_olc));
+        message_port_pub(pmt::mp("overhead"), d);
+    }
+
+    /*
+     * One interval's worth of control: go up a level straight away when
+     * anything is over its limit, and down one only after everything has
+     * been well under for d_hold intervals.  In between, stay put.
+     */
+    void
+    overload_control_impl::update(uint64_t now) {
+        uint64_t bursts, failed, queue;
+        bool have;
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            have = d_have_stats;
+            bursts = d_bursts;
+            failed = d_failed;
+            queue = d_queue;
+        }
+        if(have && (d_last_ns == 0 || bursts < d_last_bursts)) {
+            // first totals, or the decoder started over
+            d_last_bursts = bursts;
+            d_last_failed = failed;
+            d_last_ns = now;
+            return;
+        }
+        double rate = 0.0, failures = 0.0;
+        if(have) {
+            const uint64_t nbursts = bursts - d_last_bursts;
+            rate = nbursts / ((now - d_last_ns) / 1e9);
+            if(nbursts >= OVERLOAD_MIN_BURSTS) {
+                failures = (double)(failed - d_last_failed) / nbursts;
+            }
+            d_last_bursts = bursts;
+            d_last_failed = failed;
+            d_last_ns = now;
+        }
+
+        const bool over = rate > d_max_rate || failures > d_max_failures || queue > d_max_queue;
+        const bool clear = rate < d_release * d_max_rate && failures < d_release * d_max_failures
+            && queue < d_release * d_max_queue;
+        const int old_level = d_level;
+        if(over) {
+            d_level = std::min(d_level + 1, OVERLOAD_MAX_LEVEL);
+            d_calm = 0;
+        } else if(clear && d_level > 0) {
+            if(++d_calm >= d_hold) {
+                d_level--;
+                d_calm = 0;
+            }
+        } else {
+            d_calm = 0;
+        }
+        if(d_level != old_level) {
+            LOG_INFO("overload control: level %d -> %d (%.1f seizures/s, %.0f%% failed, %llu queued)",
+                    old_level, d_level, rate, failures * 100.0, (unsigned long long)queue);
+        }
+        d_rotate = (d_rotate + 1) % 10;
+        const uint16_t olc = olc_for_level();
+        if(d_level != old_level || olc != d_olc) {
+            d_olc = olc;
+            publish_overhead();
+        }
+
+        pmt::pmt_t d = pmt::make_dict();
+        d = pmt::dict_add(d, pmt::mp("level"), pmt::from_long(d_level));
+        d = pmt::dict_add(d, pmt::mp("seizure_rate"), pmt::from_double(rate));
+        d = pmt::dict_add(d, pmt::mp("failures"), pmt::from_double(failures));
+        d = pmt::dict_add(d, pmt::mp("queue_depth"), pmt::from_uint64(queue));
+        d = pmt::dict_add(d, pmt::mp("bis"), pmt::from_bool(d_level >= OVERLOAD_BIS));
+        d = pmt::dict_add(d, pmt::mp("registration"), pmt::from_bool(d_level < OVERLOAD_NO_REG));
+        d = pmt::dict_add(d, pmt::mp("olc"), pmt::from_long(d_olc));
+        message_port_pub(pmt::mp("stats"), d);
+    }
+
+    void
+    overload_control_impl::run() {
+        uint64_t next = monotonic_ns() + d_interval_ns;
+        publish_overhead();
+        while(true) {
+            {
+                boost::mutex::scoped_lock lock(d_mutex);
+                const uint64_t now = monotonic_ns();
+                if(d_finished == false && next > now) {
+                    d_cond.timed_wait(lock, boost::posix_time::microseconds((next - now) / 1000));
+                }
+                if(d_finished) {
+                    break;
+                }
+            }
+            const uint64_t now = monotonic_ns();
+            if(now >= next) {
+                update(now);
+                next += d_interval_ns;
+            }
+        }
+    }
+
+  } // namespace amps
+} // namespace gr
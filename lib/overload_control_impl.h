@@ -0,0 +1,68 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_OVERLOAD_CONTROL_IMPL_H
+#define INCLUDED_AMPS_OVERLOAD_CONTROL_IMPL_H
+
+#include <amps/overload_control.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    class overload_control_impl : public overload_control
+    {
+    private:
+        const uint64_t d_interval_ns;
+        const double d_max_rate;
+        const double d_max_failures;
+        const unsigned int d_max_queue;
+        const double d_release;
+        const int d_hold;
+
+        // Owned by the controller thread.
+        int d_level;
+        int d_calm;                     // intervals in a row that load has been cleared
+        unsigned int d_rotate;          // first barred overload class
+        uint16_t d_olc;                 // as last sent
+        uint64_t d_last_bursts;
+        uint64_t d_last_failed;
+        uint64_t d_last_ns;
+
+        // Latest measurements, from the message handlers.
+        boost::mutex d_mutex;
+        boost::condition_variable d_cond;
+        bool d_have_stats;
+        uint64_t d_bursts;
+        uint64_t d_failed;
+        uint64_t d_queue;
+        bool d_finished;
+        boost::shared_ptr<boost::thread> d_thread;
+
+        void run();
+        void update(uint64_t now);
+        uint16_t olc_for_level() const;
+        void publish_overhead();
+
+    public:
+        overload_control_impl(double interval, double max_seizure_rate, double max_failures,
+                int max_queue, double release, int hold);
+        ~overload_control_impl();
+
+        bool start();
+        bool stop();
+
+        void decode_stats_message(pmt::pmt_t msg);
+        void queue_stats_message(pmt::pmt_t msg);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_OVERLOAD_CONTROL_IMPL_H */
@@ -5,11 +5,25 @@
  */
 
 #include "qa_amps.h"
+#include "qa_timer_wheel.h"
+#include "qa_latency_histogram.h"
+#include "qa_subscriber_registry.h"
+#include "qa_voice_channel_pool.h"
+#include "qa_event_journal.h"
+#include "qa_recc_burst.h"
+#include "qa_focc_receiver.h"
 
 CppUnit::TestSuite *
 qa_amps::suite()
 {
   CppUnit::TestSuite *s = new CppUnit::TestSuite("amps");
+  s->addTest(gr::amps::qa_timer_wheel::suite());
+  s->addTest(gr::amps::qa_latency_histogram::suite());
+  s->addTest(gr::amps::qa_subscriber_registry::suite());
+  s->addTest(gr::amps::qa_voice_channel_pool::suite());
+  s->addTest(gr::amps::qa_event_journal::suite());
+  s->addTest(gr::amps::qa_recc_burst::suite());
+  s->addTest(gr::amps::qa_focc_receiver::suite());
 
   return s;
 }
@@ -0,0 +1,203 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_event_journal.h"
+#include "event_journal.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+
+namespace gr {
+  namespace amps {
+
+    // A scratch directory for segments, emptied and removed afterwards.
+    class qa_journal_dir {
+        public:
+        char dir[32];
+        std::string prefix;
+
+        qa_journal_dir() {
+            snprintf(dir, sizeof(dir), "/tmp/qa_amps_XXXXXX");
+            CPPUNIT_ASSERT(mkdtemp(dir) != NULL);
+            prefix = std::string(dir) + "/journal";
+        }
+        ~qa_journal_dir() {
+            for(int i = 0; i < 8; i++) {
+                unlink(segment(i).c_str());
+            }
+            rmdir(dir);
+        }
+
+        std::string segment(int sequence) const {
+            char name[32];
+            snprintf(name, sizeof(name), ".%06d.amj", sequence);
+            return prefix + name;
+        }
+
+        // Read a segment's header; false if the segment doesn't exist.
+        bool header(int sequence, journal_header &hdr) const {
+            int fd = ::open(segment(sequence).c_str(), O_RDONLY);
+            if(fd == -1) {
+                return false;
+            }
+            const ssize_t n = pread(fd, &hdr, sizeof(hdr), 0);
+            ::close(fd);
+            return n == sizeof(hdr);
+        }
+
+        bool record(int sequence, uint64_t idx, journal_record &rec) const {
+            int fd = ::open(segment(sequence).c_str(), O_RDONLY);
+            if(fd == -1) {
+                return false;
+            }
+            const ssize_t n = pread(fd, &rec, sizeof(rec), sizeof(journal_header) + (idx * sizeof(rec)));
+            ::close(fd);
+            return n == sizeof(rec);
+        }
+    };
+
+    static void qa_commit(event_journal &j, uint64_t stamp, uint64_t min) {
+        journal_record *rec = j.next_record();
+        CPPUNIT_ASSERT(rec != NULL);
+        rec->stamp_ns = stamp;
+        rec->min = min;
+        rec->type = JOURNAL_REGISTRATION;
+        j.commit();
+    }
+
+    void qa_event_journal::t_header() {
+        qa_journal_dir d;
+        event_journal j(d.prefix, 100);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, j.sequence());
+
+        journal_header hdr;
+        CPPUNIT_ASSERT(d.header(0, hdr));
+        CPPUNIT_ASSERT(memcmp(hdr.magic, "AMPSJRN1", 8) == 0);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)sizeof(journal_record), hdr.record_size);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)100, hdr.capacity);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, hdr.count);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, hdr.sequence);
+        CPPUNIT_ASSERT(hdr.created_ns > 0);
+
+        // Preallocated to full size up front.
+        struct stat st;
+        CPPUNIT_ASSERT(stat(d.segment(0).c_str(), &st) == 0);
+        CPPUNIT_ASSERT_EQUAL((off_t)(sizeof(journal_header) + (100 * sizeof(journal_record))), st.st_size);
+    }
+
+    // The count a reader sees only moves a batch at a time, or on flush().
+    void qa_event_journal::t_batch() {
+        qa_journal_dir d;
+        journal_header hdr;
+        {
+            event_journal j(d.prefix, 1000);
+            for(uint64_t i = 0; i < 63; i++) {
+                qa_commit(j, 0, 100 + i);
+            }
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)0, hdr.count);
+
+            qa_commit(j, 0, 163);
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)64, hdr.count);
+
+            qa_commit(j, 0, 164);
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)64, hdr.count);
+            j.flush();
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)65, hdr.count);
+
+            // A record a second after the last flush is published at once.
+            qa_commit(j, 1000000000ULL, 165);
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)66, hdr.count);
+
+            qa_commit(j, 1000000001ULL, 166);
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)66, hdr.count);
+        }
+        // Closing the journal publishes the rest.
+        CPPUNIT_ASSERT(d.header(0, hdr));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)67, hdr.count);
+
+        journal_record rec;
+        for(uint64_t i = 0; i < 67; i++) {
+            CPPUNIT_ASSERT(d.record(0, i, rec));
+            CPPUNIT_ASSERT_EQUAL(100 + i, rec.min);
+            CPPUNIT_ASSERT_EQUAL((int)JOURNAL_REGISTRATION, (int)rec.type);
+        }
+    }
+
+    // A full segment is published whole, and the journal moves on.
+    void qa_event_journal::t_rollover() {
+        qa_journal_dir d;
+        journal_header hdr;
+        {
+            event_journal j(d.prefix, 64);
+            for(uint64_t i = 0; i < 64; i++) {
+                qa_commit(j, 0, i);
+            }
+            CPPUNIT_ASSERT(d.header(0, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)64, hdr.count);
+            CPPUNIT_ASSERT(d.header(1, hdr) == false);
+
+            qa_commit(j, 0, 64);
+            CPPUNIT_ASSERT_EQUAL((uint64_t)1, j.sequence());
+            CPPUNIT_ASSERT(d.header(1, hdr));
+            CPPUNIT_ASSERT_EQUAL((uint64_t)1, hdr.sequence);
+        }
+        CPPUNIT_ASSERT(d.header(0, hdr));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)64, hdr.count);
+        CPPUNIT_ASSERT(d.header(1, hdr));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, hdr.count);
+        journal_record rec;
+        CPPUNIT_ASSERT(d.record(1, 0, rec));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)64, rec.min);
+    }
+
+    // Segments from an earlier run are left alone; numbering carries on.
+    void qa_event_journal::t_sequence() {
+        qa_journal_dir d;
+        for(int i = 0; i < 2; i++) {
+            int fd = ::open(d.segment(i).c_str(), O_WRONLY | O_CREAT, 0644);
+            CPPUNIT_ASSERT(fd != -1);
+            ::close(fd);
+        }
+        {
+            event_journal j(d.prefix, 64);
+            CPPUNIT_ASSERT_EQUAL((uint64_t)2, j.sequence());
+            qa_commit(j, 0, 1);
+        }
+        struct stat st;
+        CPPUNIT_ASSERT(stat(d.segment(0).c_str(), &st) == 0);
+        CPPUNIT_ASSERT_EQUAL((off_t)0, st.st_size);
+        CPPUNIT_ASSERT(stat(d.segment(1).c_str(), &st) == 0);
+        CPPUNIT_ASSERT_EQUAL((off_t)0, st.st_size);
+        journal_header hdr;
+        CPPUNIT_ASSERT(d.header(2, hdr));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)2, hdr.sequence);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, hdr.count);
+    }
+
+    void qa_event_journal::t_invalid() {
+        qa_journal_dir d;
+        CPPUNIT_ASSERT_THROW(event_journal(d.prefix, 63), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(event_journal(std::string(d.dir) + "/missing/journal", 64), std::runtime_error);
+    }
+
+  } // namespace amps
+} // namespace gr
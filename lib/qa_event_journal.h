@@ -0,0 +1,36 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_EVENT_JOURNAL_H
+#define INCLUDED_AMPS_QA_EVENT_JOURNAL_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_event_journal : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_event_journal);
+        CPPUNIT_TEST(t_header);
+        CPPUNIT_TEST(t_batch);
+        CPPUNIT_TEST(t_rollover);
+        CPPUNIT_TEST(t_sequence);
+        CPPUNIT_TEST(t_invalid);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_header();
+        void t_batch();
+        void t_rollover();
+        void t_sequence();
+        void t_invalid();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_EVENT_JOURNAL_H */
@@ -0,0 +1,241 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_focc_receiver.h"
+#include "focc_receiver.h"
+#include "amps_packet.h"
+#include "utils.h"
+#include <string.h>
+
+namespace gr {
+  namespace amps {
+
+    static const unsigned char qa_dotting[10] = { 1,0,1,0,1,0,1,0,1,0 };
+    static const unsigned char qa_wsync[11] = { 1,1,1,0,0,0,1,0,0,1,0 };
+
+    // BCH-encode a 28-bit word to 40 bits, the way the FOCC block does.
+    static void qa_focc_bch(itpp::BCH &bch, const unsigned char *word, unsigned char *cw) {
+        bvec padded(51);
+        for(int i = 0; i < 23; i++) {
+            padded[i] = 0;
+        }
+        for(int i = 0; i < 28; i++) {
+            padded[23 + i] = word[i];
+        }
+        bvec encoded = bch.encode(padded);
+        CPPUNIT_ASSERT_EQUAL(63, encoded.size());
+        for(int i = 0; i < 40; i++) {
+            cw[i] = (encoded[23 + i] == 1) ? 1 : 0;
+        }
+    }
+
+    /*
+     * Builds a FOCC as the receiver sees it, one soft half-bit per sample:
+     * 0 is sent high-low and 1 low-high.
+     */
+    class qa_focc_stream {
+        public:
+        std::vector<float> halfbits;
+        itpp::BCH bch;
+        unsigned char busy_idle;
+
+        qa_focc_stream() : bch(63, 2, true), busy_idle(1) { }
+
+        void bits(const unsigned char *b, size_t n) {
+            for(size_t i = 0; i < n; i++) {
+                halfbits.push_back(b[i] ? -1.0f : 1.0f);
+                halfbits.push_back(b[i] ? 1.0f : -1.0f);
+            }
+        }
+
+        void bit(unsigned char b) {
+            bits(&b, 1);
+        }
+
+        // Dotting long enough for the receiver to pick its bit pairing.
+        void preamble() {
+            for(int i = 0; i < 4; i++) {
+                bits(qa_dotting, sizeof(qa_dotting));
+            }
+        }
+
+        // Busy-idle, dotting, busy-idle and word sync.
+        void sync(const unsigned char *wsync = qa_wsync) {
+            bit(busy_idle);
+            bits(qa_dotting, sizeof(qa_dotting));
+            bit(busy_idle);
+            bits(wsync, 11);
+        }
+
+        /*
+         * Five repeats of each stream's word, interleaved A, B, A, B, ...,
+         * with a busy-idle bit ahead of every 10 bits.  corrupt[s][r] flips
+         * bits of repeat r of stream s, one bit per entry of the mask.
+         */
+        void frame(const unsigned char *word_a, const unsigned char *word_b,
+                const uint64_t corrupt[2][5] = NULL) {
+            unsigned char cw[2][40];
+            qa_focc_bch(bch, word_a, cw[0]);
+            qa_focc_bch(bch, word_b, cw[1]);
+            for(int r = 0; r < 5; r++) {
+                for(int s = 0; s < 2; s++) {
+                    unsigned char rep[40];
+                    for(int i = 0; i < 40; i++) {
+                        const bool flip = (corrupt != NULL) && ((corrupt[s][r] >> i) & 1);
+                        rep[i] = cw[s][i] ^ (flip ? 1 : 0);
+                    }
+                    for(int k = 0; k < 4; k++) {
+                        bit(busy_idle);
+                        bits(&rep[k * 10], 10);
+                    }
+                }
+            }
+        }
+
+        // Feed it all to a receiver, returning the frames it decoded.
+        std::vector<focc_rx_frame> run(focc_receiver &rx) const {
+            std::vector<focc_rx_frame> frames;
+            for(size_t i = 0; i < halfbits.size(); i++) {
+                if(rx.push(halfbits[i])) {
+                    frames.push_back(rx.frame());
+                }
+            }
+            return frames;
+        }
+    };
+
+    static void qa_check_word(const unsigned char *want, bool valid, const unsigned char *got) {
+        CPPUNIT_ASSERT(valid);
+        for(int i = 0; i < 28; i++) {
+            CPPUNIT_ASSERT_EQUAL(want[i], got[i]);
+        }
+    }
+
+    // bch_decode_40() undoes the FOCC block's encoding, correcting up to
+    // two bit errors.
+    void qa_focc_receiver::t_bch_roundtrip() {
+        itpp::BCH bch(63, 2, true);
+        unsigned char word[28], cw[40], out[28];
+        for(uint64_t min = 0x100000; min < 0x100000 + 64; min += 7) {
+            focc_word1(word, true, 2, min);
+            qa_focc_bch(bch, word, cw);
+            CPPUNIT_ASSERT(bch_decode_40(bch, cw, out));
+            qa_check_word(word, true, out);
+
+            for(int a = 0; a < 40; a += 3) {
+                for(int b = a; b < 40; b += 11) {
+                    unsigned char bad[40];
+                    memcpy(bad, cw, sizeof(bad));
+                    bad[a] ^= 1;
+                    bad[b] ^= (a != b) ? 1 : 0;
+                    qa_check_word(word, bch_decode_40(bch, bad, out), out);
+                }
+            }
+        }
+    }
+
+    void qa_focc_receiver::t_frames() {
+        qa_focc_stream stream;
+        unsigned char words[3][2][28];
+        for(int f = 0; f < 3; f++) {
+            focc_word1(words[f][0], true, 1, 0x212345 + f);
+            focc_word2_general(words[f][1], 0x155 + f, 0, 0, 0x1d);
+        }
+        stream.preamble();
+        for(int f = 0; f < 3; f++) {
+            stream.sync();
+            stream.frame(words[f][0], words[f][1]);
+        }
+
+        focc_receiver rx;
+        CPPUNIT_ASSERT(rx.locked() == false);
+        const std::vector<focc_rx_frame> frames = stream.run(rx);
+        CPPUNIT_ASSERT_EQUAL((size_t)3, frames.size());
+        for(int f = 0; f < 3; f++) {
+            qa_check_word(words[f][0], frames[f].valid[0], frames[f].words[0]);
+            qa_check_word(words[f][1], frames[f].valid[1], frames[f].words[1]);
+        }
+        CPPUNIT_ASSERT(rx.locked());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)3, rx.frames());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, rx.bad_words());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, rx.sync_losses());
+    }
+
+    // Errors in a minority of the repeats are voted out; errors the vote
+    // lets through are within the BCH code's reach.
+    void qa_focc_receiver::t_repeat_errors() {
+        qa_focc_stream stream;
+        unsigned char word_a[28], word_b[28];
+        focc_word1(word_a, false, 3, 0x7fffff);
+        focc_word2_general(word_b, 0x3ff, 0, 0, 0x1d);
+        const uint64_t corrupt[2][5] = {
+            // A: 2 of 5 repeats wrong everywhere, and a third wrong at two
+            // of the same bits, so the vote gets those two wrong.
+            { 0xffffffffffULL, 0xffffffffffULL, 0x0000010001ULL, 0, 0 },
+            // B: scattered errors, never a majority.
+            { 0x8000000001ULL, 0x0000f00000ULL, 0, 0x00000000f0ULL, 0x0f00000000ULL }
+        };
+        stream.preamble();
+        stream.sync();
+        stream.frame(word_a, word_b, corrupt);
+
+        focc_receiver rx;
+        const std::vector<focc_rx_frame> frames = stream.run(rx);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, frames.size());
+        qa_check_word(word_a, frames[0].valid[0], frames[0].words[0]);
+        qa_check_word(word_b, frames[0].valid[1], frames[0].words[1]);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, rx.bad_words());
+    }
+
+    void qa_focc_receiver::t_idle() {
+        unsigned char word_a[28], word_b[28];
+        focc_word1(word_a, false, 0, 0x123456);
+        focc_word1(word_b, false, 0, 0x654321);
+        for(unsigned char bi = 0; bi < 2; bi++) {
+            qa_focc_stream stream;
+            stream.busy_idle = bi;
+            stream.preamble();
+            stream.sync();
+            stream.frame(word_a, word_b);
+
+            focc_receiver rx;
+            CPPUNIT_ASSERT_EQUAL((size_t)1, stream.run(rx).size());
+            CPPUNIT_ASSERT_EQUAL(bi == 1, rx.idle());
+        }
+    }
+
+    // A frame whose sync is gone drops the lock; the receiver hunts for
+    // the next sync and picks up again from there.
+    void qa_focc_receiver::t_sync_loss() {
+        static const unsigned char bad_wsync[11] = { 0,0,0,0,0,0,1,0,0,1,0 };
+        unsigned char words[3][28];
+        for(int f = 0; f < 3; f++) {
+            focc_word1(words[f], false, 2, 0x300000 + f);
+        }
+        qa_focc_stream stream;
+        stream.preamble();
+        stream.sync();
+        stream.frame(words[0], words[0]);
+        stream.sync(bad_wsync);
+        stream.sync();
+        stream.frame(words[2], words[2]);
+
+        focc_receiver rx;
+        const std::vector<focc_rx_frame> frames = stream.run(rx);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, frames.size());
+        qa_check_word(words[0], frames[0].valid[0], frames[0].words[0]);
+        qa_check_word(words[2], frames[1].valid[0], frames[1].words[0]);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, rx.sync_losses());
+        CPPUNIT_ASSERT(rx.locked());
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,36 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_FOCC_RECEIVER_H
+#define INCLUDED_AMPS_QA_FOCC_RECEIVER_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_focc_receiver : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_focc_receiver);
+        CPPUNIT_TEST(t_bch_roundtrip);
+        CPPUNIT_TEST(t_frames);
+        CPPUNIT_TEST(t_repeat_errors);
+        CPPUNIT_TEST(t_idle);
+        CPPUNIT_TEST(t_sync_loss);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_bch_roundtrip();
+        void t_frames();
+        void t_repeat_errors();
+        void t_idle();
+        void t_sync_loss();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_FOCC_RECEIVER_H */
@@ -0,0 +1,87 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_latency_histogram.h"
+#include "latency_histogram.h"
+
+namespace gr {
+  namespace amps {
+
+    void qa_latency_histogram::t_small_values() {
+        for(uint64_t v = 0; v < 32; v++) {
+            CPPUNIT_ASSERT_EQUAL((int)v, latency_histogram::bucket(v));
+            CPPUNIT_ASSERT_EQUAL(v, latency_histogram::bucket_high((int)v));
+        }
+        // First log-linear bucket: 32 and 33.
+        CPPUNIT_ASSERT_EQUAL(32, latency_histogram::bucket(32));
+        CPPUNIT_ASSERT_EQUAL(32, latency_histogram::bucket(33));
+        CPPUNIT_ASSERT_EQUAL(33, latency_histogram::bucket(34));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)33, latency_histogram::bucket_high(32));
+    }
+
+    // Buckets tile the range with no gaps or overlaps, each no wider than
+    // 1/16 of its lower bound.
+    void qa_latency_histogram::t_bucket_bounds() {
+        for(int idx = 32; idx < latency_histogram::NBUCKETS; idx++) {
+            const uint64_t low = latency_histogram::bucket_high(idx - 1) + 1;
+            const uint64_t high = latency_histogram::bucket_high(idx);
+            CPPUNIT_ASSERT(high >= low);
+            CPPUNIT_ASSERT_EQUAL(idx, latency_histogram::bucket(low));
+            CPPUNIT_ASSERT_EQUAL(idx, latency_histogram::bucket(high));
+            CPPUNIT_ASSERT_EQUAL(idx, latency_histogram::bucket(low + ((high - low) / 2)));
+            CPPUNIT_ASSERT((high - low + 1) * 16 <= low);
+        }
+        CPPUNIT_ASSERT_EQUAL((1ULL << 40) - 1, (unsigned long long)latency_histogram::bucket_high(latency_histogram::NBUCKETS - 1));
+    }
+
+    void qa_latency_histogram::t_overflow() {
+        const int last = latency_histogram::NBUCKETS - 1;
+        CPPUNIT_ASSERT_EQUAL(last, latency_histogram::bucket(1ULL << 40));
+        CPPUNIT_ASSERT_EQUAL(last, latency_histogram::bucket(1ULL << 50));
+        CPPUNIT_ASSERT_EQUAL(last, latency_histogram::bucket(~0ULL));
+
+        latency_histogram h;
+        h.record(1ULL << 45);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1 << 45, h.max());
+        // Reported as the top of the last bucket, since that's below max.
+        CPPUNIT_ASSERT_EQUAL(latency_histogram::bucket_high(last), h.percentile(50.0));
+    }
+
+    void qa_latency_histogram::t_percentile() {
+        latency_histogram h;
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, h.count());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, h.percentile(99.0));
+
+        for(uint64_t v = 1; v <= 1000; v++) {
+            h.record(v);
+        }
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1000, h.count());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1000, h.max());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, h.percentile(0.0));
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1000, h.percentile(100.0));
+        const double pcts[] = { 10.0, 50.0, 90.0, 99.0 };
+        for(size_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); i++) {
+            const uint64_t exact = (uint64_t)(pcts[i] * 10.0);
+            const uint64_t p = h.percentile(pcts[i]);
+            CPPUNIT_ASSERT(p >= exact);
+            CPPUNIT_ASSERT(p <= exact + (exact / 16));
+        }
+
+        h.reset();
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, h.count());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, h.max());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, h.percentile(50.0));
+        h.record(7);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)7, h.percentile(50.0));
+    }
+
+  } // namespace amps
+} // namespace gr
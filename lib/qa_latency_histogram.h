@@ -0,0 +1,34 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_LATENCY_HISTOGRAM_H
+#define INCLUDED_AMPS_QA_LATENCY_HISTOGRAM_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_latency_histogram : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_latency_histogram);
+        CPPUNIT_TEST(t_small_values);
+        CPPUNIT_TEST(t_bucket_bounds);
+        CPPUNIT_TEST(t_overflow);
+        CPPUNIT_TEST(t_percentile);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_small_values();
+        void t_bucket_bounds();
+        void t_overflow();
+        void t_percentile();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_LATENCY_HISTOGRAM_H */
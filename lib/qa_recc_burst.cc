@@ -0,0 +1,151 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_recc_burst.h"
+#include "recc_burst.h"
+#include "amps_packet.h"
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    static const unsigned char qa_coded_dcc2[7] = { 1,1,0,0,0,1,1 };
+
+    // Some distinct 36-bit words.
+    static std::vector<std::vector<unsigned char> > qa_words(size_t n) {
+        std::vector<std::vector<unsigned char> > words(n, std::vector<unsigned char>(36));
+        uint64_t x = 0x5deece66dULL;
+        for(size_t w = 0; w < n; w++) {
+            x = (x * 6364136223846793005ULL) + 1442695040888963407ULL;
+            expandbits(&words[w][0], 36, x >> 28);
+        }
+        return words;
+    }
+
+    // Manchester- and BCH-decode one repeat of a word from a burst.
+    static bool qa_decode_word(const std::vector<unsigned char> &syms, size_t start,
+            itpp::BCH &bch, unsigned char *word) {
+        unsigned char bits[48];
+        CPPUNIT_ASSERT(start + 96 <= syms.size());
+        CPPUNIT_ASSERT_EQUAL((size_t)0, manchester_decode_binbuf(&syms[start], bits, 48));
+        return bch_decode_48(bch, bits, word);
+    }
+
+    static void qa_check_words(const std::vector<unsigned char> &syms, size_t msgstart,
+            const std::vector<std::vector<unsigned char> > &words) {
+        itpp::BCH bch(63, 2, true);
+        unsigned char dcc[7];
+        CPPUNIT_ASSERT_EQUAL((size_t)0, manchester_decode_binbuf(&syms[msgstart], dcc, 7));
+        for(int i = 0; i < 7; i++) {
+            CPPUNIT_ASSERT_EQUAL(qa_coded_dcc2[i], dcc[i]);
+        }
+        for(size_t w = 0; w < words.size(); w++) {
+            for(size_t r = 0; r < 5; r++) {
+                unsigned char word[36];
+                CPPUNIT_ASSERT(qa_decode_word(syms, msgstart + 14 + (w * 480) + (r * 96), bch, word));
+                for(int i = 0; i < 36; i++) {
+                    CPPUNIT_ASSERT_EQUAL(words[w][i], word[i]);
+                }
+            }
+        }
+    }
+
+    // A burst laid out as the RECC block publishes it decodes back to the
+    // words it was built from.
+    void qa_recc_burst::t_message() {
+        recc_burst_encoder enc;
+        const std::vector<std::vector<unsigned char> > words = qa_words(5);
+        std::vector<unsigned char> syms;
+        enc.render(syms, 2, words, false);
+        CPPUNIT_ASSERT_EQUAL(RECC_BURST_SYMS, syms.size());
+        qa_check_words(syms, 0, words);
+
+        // The rest is dotting.
+        for(size_t i = 14 + (words.size() * 480); i < syms.size(); i++) {
+            CPPUNIT_ASSERT_EQUAL((unsigned char)((i - (14 + (words.size() * 480))) & 1), syms[i]);
+        }
+    }
+
+    // With the seizure precursor, as a mobile sends it: 30 bits of dotting
+    // and word sync ahead of the coded DCC, and no padding.
+    void qa_recc_burst::t_seizure() {
+        static const unsigned char wsync[11] = { 1,1,1,0,0,0,1,0,0,1,0 };
+        recc_burst_encoder enc;
+        const std::vector<std::vector<unsigned char> > words = qa_words(2);
+        std::vector<unsigned char> syms;
+        enc.render(syms, 2, words, true);
+        CPPUNIT_ASSERT_EQUAL((size_t)(82 + 14 + (2 * 480)), syms.size());
+
+        unsigned char bits[41];
+        CPPUNIT_ASSERT_EQUAL((size_t)0, manchester_decode_binbuf(&syms[0], bits, 41));
+        for(int i = 0; i < 30; i++) {
+            CPPUNIT_ASSERT_EQUAL((unsigned char)((i & 1) ? 0 : 1), bits[i]);
+        }
+        for(int i = 0; i < 11; i++) {
+            CPPUNIT_ASSERT_EQUAL(wsync[i], bits[30 + i]);
+        }
+        qa_check_words(syms, 82, words);
+    }
+
+    // Up to two bit errors in a repeat are corrected.
+    void qa_recc_burst::t_bit_errors() {
+        recc_burst_encoder enc;
+        itpp::BCH bch(63, 2, true);
+        const std::vector<std::vector<unsigned char> > words = qa_words(1);
+        std::vector<unsigned char> syms;
+        enc.render(syms, 0, words, false);
+
+        for(size_t a = 0; a < 48; a += 5) {
+            for(size_t b = a; b < 48; b += 7) {
+                std::vector<unsigned char> bad(syms);
+                // Swap both halves of a bit: a clean Manchester bit, but the
+                // wrong one.
+                for(int h = 0; h < 2; h++) {
+                    bad[14 + (2 * a) + h] ^= 1;
+                    if(b != a) {
+                        bad[14 + (2 * b) + h] ^= 1;
+                    }
+                }
+                unsigned char word[36];
+                CPPUNIT_ASSERT(qa_decode_word(bad, 14, bch, word));
+                for(int i = 0; i < 36; i++) {
+                    CPPUNIT_ASSERT_EQUAL(words[0][i], word[i]);
+                }
+            }
+        }
+    }
+
+    // The message builders put the right words in the right order.
+    void qa_recc_burst::t_registration() {
+        const u_int64_t MIN1 = 0x5a1234;
+        const u_int64_t MIN2 = 0x2c1;
+        const unsigned long esn = 0x8012abcdUL;
+        std::vector<std::vector<unsigned char> > words(3, std::vector<unsigned char>(36));
+        recc_word_a_bits(&words[0][0], 2, true, true, 0x0a, MIN1);
+        recc_word_b_bits(&words[1][0], 1, 0, 0, 0x0d, 0x0a, MIN2);
+        recc_word_c_serial_bits(&words[2][0], 0, esn);
+
+        recc_burst_encoder enc;
+        std::vector<unsigned char> syms;
+        enc.registration(syms, 2, MIN1, MIN2, esn, 0x0a, false);
+        CPPUNIT_ASSERT_EQUAL(RECC_BURST_SYMS, syms.size());
+        qa_check_words(syms, 0, words);
+
+        words.resize(2);
+        recc_word_a_bits(&words[0][0], 1, false, false, 0x0a, MIN1);
+        recc_word_b_bits(&words[1][0], 0, 0, 0, 0, 0x0a, MIN2);
+        syms.clear();
+        enc.page_response(syms, 2, MIN1, MIN2, 0x0a, false);
+        qa_check_words(syms, 0, words);
+    }
+
+  } // namespace amps
+} // namespace gr
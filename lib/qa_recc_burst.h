@@ -0,0 +1,34 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_RECC_BURST_H
+#define INCLUDED_AMPS_QA_RECC_BURST_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_recc_burst : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_recc_burst);
+        CPPUNIT_TEST(t_message);
+        CPPUNIT_TEST(t_seizure);
+        CPPUNIT_TEST(t_bit_errors);
+        CPPUNIT_TEST(t_registration);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_message();
+        void t_seizure();
+        void t_bit_errors();
+        void t_registration();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_RECC_BURST_H */
@@ -0,0 +1,171 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_subscriber_registry.h"
+#include "subscriber_registry.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdexcept>
+
+namespace gr {
+  namespace amps {
+
+    // A registry file in a scratch directory, removed afterwards.
+    class qa_registry_file {
+        public:
+        char dir[32];
+        std::string path;
+
+        qa_registry_file() {
+            snprintf(dir, sizeof(dir), "/tmp/qa_amps_XXXXXX");
+            CPPUNIT_ASSERT(mkdtemp(dir) != NULL);
+            path = std::string(dir) + "/registry";
+        }
+        ~qa_registry_file() {
+            unlink(path.c_str());
+            rmdir(dir);
+        }
+    };
+
+    void qa_subscriber_registry::t_register_lookup() {
+        qa_registry_file f;
+        subscriber_registry::sptr reg = subscriber_registry::open(f.path, 1000);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1024, reg->capacity());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, reg->count());
+
+        const uint64_t min = pack_min(0x5a1234, 0x2c1);
+        subscriber_record rec;
+        CPPUNIT_ASSERT(reg->lookup(min, rec) == false);
+
+        CPPUNIT_ASSERT(reg->registered(min, 0x8012abcd, 0x0a, 42, 1000));
+        CPPUNIT_ASSERT(reg->lookup(min, rec));
+        CPPUNIT_ASSERT_EQUAL(min, rec.min);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)0x8012abcd, rec.esn);
+        CPPUNIT_ASSERT_EQUAL((int)0x0a, (int)rec.scm);
+        CPPUNIT_ASSERT_EQUAL((int)(SUBSCRIBER_USED | SUBSCRIBER_REGISTERED), (int)rec.flags);
+        CPPUNIT_ASSERT_EQUAL((int)42, (int)rec.last_cell);
+        CPPUNIT_ASSERT_EQUAL((int64_t)1000, rec.registered);
+        CPPUNIT_ASSERT_EQUAL((int64_t)1000, rec.last_seen);
+
+        // No ESN in this one: the known ESN stays.
+        CPPUNIT_ASSERT(reg->registered(min, 0, 0x0b, 43, 2000));
+        CPPUNIT_ASSERT(reg->lookup(min, rec));
+        CPPUNIT_ASSERT_EQUAL((uint32_t)0x8012abcd, rec.esn);
+        CPPUNIT_ASSERT_EQUAL((int)0x0b, (int)rec.scm);
+        CPPUNIT_ASSERT_EQUAL((int)43, (int)rec.last_cell);
+        CPPUNIT_ASSERT_EQUAL((int64_t)2000, rec.registered);
+
+        // seen() only touches last_seen.
+        CPPUNIT_ASSERT(reg->seen(min, 3000));
+        CPPUNIT_ASSERT(reg->lookup(min, rec));
+        CPPUNIT_ASSERT_EQUAL((int64_t)2000, rec.registered);
+        CPPUNIT_ASSERT_EQUAL((int64_t)3000, rec.last_seen);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, reg->count());
+
+        // ... and adds a mobile it hasn't heard of, unregistered.
+        const uint64_t other = pack_min(0x5a1235, 0x2c1);
+        CPPUNIT_ASSERT(reg->seen(other, 4000));
+        CPPUNIT_ASSERT(reg->lookup(other, rec));
+        CPPUNIT_ASSERT_EQUAL((int)SUBSCRIBER_USED, (int)rec.flags);
+        CPPUNIT_ASSERT_EQUAL((uint32_t)0, rec.esn);
+        CPPUNIT_ASSERT_EQUAL((int64_t)4000, rec.last_seen);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)2, reg->count());
+    }
+
+    void qa_subscriber_registry::t_shared() {
+        qa_registry_file f;
+        subscriber_registry::sptr a = subscriber_registry::open(f.path, 64);
+        subscriber_registry::sptr b = subscriber_registry::open(f.path, 64);
+        CPPUNIT_ASSERT(a.get() == b.get());
+    }
+
+    // Runs of consecutive MINs, and MINs that differ only in MIN2 (the
+    // high bits), all get slots of their own and are found again.
+    void qa_subscriber_registry::t_sequential_mins() {
+        qa_registry_file f;
+        subscriber_registry::sptr reg = subscriber_registry::open(f.path, 4096);
+        uint64_t n = 0;
+        for(uint64_t area = 0; area < 3; area++) {
+            for(uint64_t i = 0; i < 1000; i++) {
+                CPPUNIT_ASSERT(reg->seen(pack_min(0x400000 + i, 0x100 + (area << 8)), n));
+                n++;
+            }
+        }
+        CPPUNIT_ASSERT_EQUAL(n, reg->count());
+
+        n = 0;
+        subscriber_record rec;
+        for(uint64_t area = 0; area < 3; area++) {
+            for(uint64_t i = 0; i < 1000; i++) {
+                const uint64_t min = pack_min(0x400000 + i, 0x100 + (area << 8));
+                CPPUNIT_ASSERT(reg->lookup(min, rec));
+                CPPUNIT_ASSERT_EQUAL(min, rec.min);
+                CPPUNIT_ASSERT_EQUAL((int64_t)n, rec.last_seen);
+                n++;
+            }
+        }
+        CPPUNIT_ASSERT(reg->lookup(pack_min(0x400000 + 1000, 0x100), rec) == false);
+    }
+
+    // New mobiles are refused past 3/4 full; known ones are still updated.
+    void qa_subscriber_registry::t_overflow() {
+        qa_registry_file f;
+        subscriber_registry::sptr reg = subscriber_registry::open(f.path, 16);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)16, reg->capacity());
+        for(uint64_t i = 0; i < 12; i++) {
+            CPPUNIT_ASSERT(reg->seen(pack_min(i, 0), 1));
+        }
+        CPPUNIT_ASSERT_EQUAL((uint64_t)12, reg->count());
+
+        CPPUNIT_ASSERT(reg->seen(pack_min(12, 0), 2) == false);
+        CPPUNIT_ASSERT(reg->registered(pack_min(12, 0), 1234, 0, 0, 2) == false);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)12, reg->count());
+        subscriber_record rec;
+        CPPUNIT_ASSERT(reg->lookup(pack_min(12, 0), rec) == false);
+
+        CPPUNIT_ASSERT(reg->registered(pack_min(5, 0), 1234, 0, 0, 3));
+        CPPUNIT_ASSERT(reg->lookup(pack_min(5, 0), rec));
+        CPPUNIT_ASSERT_EQUAL((uint32_t)1234, rec.esn);
+        for(uint64_t i = 0; i < 12; i++) {
+            CPPUNIT_ASSERT(reg->lookup(pack_min(i, 0), rec));
+        }
+    }
+
+    // The file outlives the registry, and keeps its own capacity.
+    void qa_subscriber_registry::t_reopen() {
+        qa_registry_file f;
+        const uint64_t min = pack_min(0x123456, 0x3ff);
+        {
+            subscriber_registry::sptr reg = subscriber_registry::open(f.path, 32);
+            CPPUNIT_ASSERT(reg->registered(min, 0xdeadbeef, 0x05, 7, 500));
+        }
+        subscriber_registry::sptr reg = subscriber_registry::open(f.path, 4096);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)32, reg->capacity());
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1, reg->count());
+        subscriber_record rec;
+        CPPUNIT_ASSERT(reg->lookup(min, rec));
+        CPPUNIT_ASSERT_EQUAL((uint32_t)0xdeadbeef, rec.esn);
+        CPPUNIT_ASSERT_EQUAL((int64_t)500, rec.registered);
+    }
+
+    void qa_subscriber_registry::t_bad_file() {
+        qa_registry_file f;
+        FILE *fp = fopen(f.path.c_str(), "w");
+        CPPUNIT_ASSERT(fp != NULL);
+        fputs("not a registry, but long enough to hold a header", fp);
+        fclose(fp);
+        CPPUNIT_ASSERT_THROW(subscriber_registry::open(f.path), std::runtime_error);
+        CPPUNIT_ASSERT_THROW(subscriber_registry::open(std::string(f.dir) + "/missing/registry"), std::runtime_error);
+    }
+
+  } // namespace amps
+} // namespace gr
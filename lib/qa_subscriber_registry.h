@@ -0,0 +1,38 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_SUBSCRIBER_REGISTRY_H
+#define INCLUDED_AMPS_QA_SUBSCRIBER_REGISTRY_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_subscriber_registry : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_subscriber_registry);
+        CPPUNIT_TEST(t_register_lookup);
+        CPPUNIT_TEST(t_shared);
+        CPPUNIT_TEST(t_sequential_mins);
+        CPPUNIT_TEST(t_overflow);
+        CPPUNIT_TEST(t_reopen);
+        CPPUNIT_TEST(t_bad_file);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_register_lookup();
+        void t_shared();
+        void t_sequential_mins();
+        void t_overflow();
+        void t_reopen();
+        void t_bad_file();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_SUBSCRIBER_REGISTRY_H */
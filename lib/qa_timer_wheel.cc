@@ -0,0 +1,132 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_timer_wheel.h"
+#include "timer_wheel.h"
+
+namespace gr {
+  namespace amps {
+
+    // Delays on both sides of each level boundary (256, 2^14, 2^20).
+    static const uint64_t qa_delays[] = {
+        0, 1, 2, 100, 255, 256, 257, 511, 512, 1000, 16383, 16384, 16385,
+        100000, 1048575, 1048576, 1048577, 3000000
+    };
+    static const size_t QA_NDELAYS = sizeof(qa_delays) / sizeof(qa_delays[0]);
+
+    // Every timer fires on exactly the tick it was due, across cascades.
+    void qa_timer_wheel::t_expiry_tick() {
+        const uint64_t start = 1234567;
+        timer_wheel wheel(start);
+        wheel_timer timers[QA_NDELAYS];
+        for(size_t i = 0; i < QA_NDELAYS; i++) {
+            wheel.schedule(&timers[i], qa_delays[i]);
+        }
+        CPPUNIT_ASSERT_EQUAL(QA_NDELAYS, wheel.pending());
+
+        std::vector<wheel_timer *> expired;
+        size_t nfired = 0;
+        for(uint64_t now = start; nfired < QA_NDELAYS; now++) {
+            CPPUNIT_ASSERT(now <= start + qa_delays[QA_NDELAYS - 1]);
+            expired.clear();
+            wheel.advance(now, expired);
+            for(size_t i = 0; i < expired.size(); i++) {
+                const size_t idx = expired[i] - timers;
+                CPPUNIT_ASSERT(idx < QA_NDELAYS);
+                CPPUNIT_ASSERT_EQUAL(start + qa_delays[idx], now);
+                CPPUNIT_ASSERT(timers[idx].pending() == false);
+                nfired++;
+            }
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)0, wheel.pending());
+    }
+
+    // One big advance hands back everything due, in expiry order.
+    void qa_timer_wheel::t_expiry_order() {
+        const uint64_t start = 77;
+        timer_wheel wheel(start);
+        wheel_timer timers[QA_NDELAYS];
+        // Schedule in reverse, so list order isn't expiry order.
+        for(size_t i = QA_NDELAYS; i-- > 0; ) {
+            wheel.schedule(&timers[i], qa_delays[i]);
+        }
+
+        std::vector<wheel_timer *> expired;
+        const uint64_t until = start + 100000;
+        size_t n = wheel.advance(until, expired);
+        size_t ndue = 0;
+        while(ndue < QA_NDELAYS && qa_delays[ndue] <= 100000) {
+            ndue++;
+        }
+        CPPUNIT_ASSERT_EQUAL(ndue, n);
+        CPPUNIT_ASSERT_EQUAL(ndue, expired.size());
+        for(size_t i = 1; i < expired.size(); i++) {
+            CPPUNIT_ASSERT(expired[i - 1]->expires <= expired[i]->expires);
+        }
+        CPPUNIT_ASSERT_EQUAL(QA_NDELAYS - ndue, wheel.pending());
+
+        // Nothing fires twice, and the rest come out later.
+        expired.clear();
+        n = wheel.advance(start + qa_delays[QA_NDELAYS - 1], expired);
+        CPPUNIT_ASSERT_EQUAL(QA_NDELAYS - ndue, n);
+        CPPUNIT_ASSERT_EQUAL((size_t)0, wheel.pending());
+    }
+
+    void qa_timer_wheel::t_cancel_reschedule() {
+        timer_wheel wheel(0);
+        wheel_timer a, b, c;
+        wheel.schedule(&a, 10);
+        wheel.schedule(&b, 300);
+        wheel.schedule(&c, 20000);
+        CPPUNIT_ASSERT_EQUAL((size_t)3, wheel.pending());
+
+        wheel.cancel(&b);
+        CPPUNIT_ASSERT(b.pending() == false);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, wheel.pending());
+        wheel.cancel(&b);           // not pending: a no-op
+        CPPUNIT_ASSERT_EQUAL((size_t)2, wheel.pending());
+
+        // Rescheduling a pending timer moves it rather than adding it.
+        wheel.schedule(&c, 5);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, wheel.pending());
+
+        std::vector<wheel_timer *> expired;
+        CPPUNIT_ASSERT_EQUAL((size_t)1, wheel.advance(5, expired));
+        CPPUNIT_ASSERT(expired[0] == &c);
+        expired.clear();
+        CPPUNIT_ASSERT_EQUAL((size_t)1, wheel.advance(30000, expired));
+        CPPUNIT_ASSERT(expired[0] == &a);
+
+        // An expired timer can be armed again; delays count from the last
+        // tick advanced to.
+        wheel.schedule(&a, 1);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)30002, a.expires);
+        expired.clear();
+        CPPUNIT_ASSERT_EQUAL((size_t)0, wheel.advance(30001, expired));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, wheel.advance(30002, expired));
+    }
+
+    // Delays past the top level are clamped to its span.
+    void qa_timer_wheel::t_clamp() {
+        const uint64_t max_delay = (1ULL << 26) - 1;
+        timer_wheel wheel(1000);
+        wheel_timer t;
+        wheel.schedule(&t, 1ULL << 40);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)1000 + max_delay, t.expires);
+
+        std::vector<wheel_timer *> expired;
+        CPPUNIT_ASSERT_EQUAL((size_t)0, wheel.advance(1000 + max_delay - 1, expired));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, wheel.advance(1000 + max_delay, expired));
+        CPPUNIT_ASSERT(expired[0] == &t);
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,34 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_TIMER_WHEEL_H
+#define INCLUDED_AMPS_QA_TIMER_WHEEL_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_timer_wheel : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_timer_wheel);
+        CPPUNIT_TEST(t_expiry_tick);
+        CPPUNIT_TEST(t_expiry_order);
+        CPPUNIT_TEST(t_cancel_reschedule);
+        CPPUNIT_TEST(t_clamp);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_expiry_tick();
+        void t_expiry_order();
+        void t_cancel_reschedule();
+        void t_clamp();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_TIMER_WHEEL_H */
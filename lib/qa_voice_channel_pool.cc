@@ -0,0 +1,156 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <cppunit/TestAssert.h>
+#include "qa_voice_channel_pool.h"
+#include "voice_channel_pool.h"
+#include "amps_packet.h"
+#include <stdexcept>
+
+namespace gr {
+  namespace amps {
+
+    static std::vector<int> qa_sccs() {
+        std::vector<int> scc;
+        scc.push_back(0);
+        scc.push_back(1);
+        scc.push_back(2);
+        return scc;
+    }
+
+    void qa_voice_channel_pool::t_allocate() {
+        voice_channel_pool pool(300, 4, qa_sccs(), 2);
+        CPPUNIT_ASSERT_EQUAL(4, pool.size());
+        CPPUNIT_ASSERT_EQUAL((size_t)4, pool.nfree());
+        for(int i = 0; i < 4; i++) {
+            CPPUNIT_ASSERT_EQUAL(300 + i, (int)pool[i].chan);
+            CPPUNIT_ASSERT_EQUAL(i % 3, (int)pool[i].scc);
+            CPPUNIT_ASSERT_EQUAL(2, (int)pool[i].vmac);
+            CPPUNIT_ASSERT_EQUAL(VCHAN_FREE, pool[i].state);
+        }
+
+        // A fresh pool hands channels out in ascending order.
+        for(int i = 0; i < 4; i++) {
+            CPPUNIT_ASSERT_EQUAL(i, pool.allocate(1000 + i, 50));
+            CPPUNIT_ASSERT_EQUAL(VCHAN_ASSIGNED, pool[i].state);
+            CPPUNIT_ASSERT_EQUAL((uint64_t)1000 + i, pool[i].min);
+            CPPUNIT_ASSERT_EQUAL((time_t)50, pool[i].since);
+        }
+        CPPUNIT_ASSERT_EQUAL((size_t)0, pool.nfree());
+        CPPUNIT_ASSERT_EQUAL(-1, pool.allocate(2000, 51));
+        CPPUNIT_ASSERT_EQUAL(2, pool.find(1002));
+        CPPUNIT_ASSERT_EQUAL(-1, pool.find(2000));
+
+        // No color codes given: everything gets the global one.
+        voice_channel_pool plain(1, 2, std::vector<int>(), 0);
+        CPPUNIT_ASSERT_EQUAL(GLOBAL_SCC, (int)plain[0].scc);
+        CPPUNIT_ASSERT_EQUAL(GLOBAL_SCC, (int)plain[1].scc);
+    }
+
+    void qa_voice_channel_pool::t_release() {
+        voice_channel_pool pool(300, 3, qa_sccs(), 0);
+        pool.allocate(1, 0);
+        pool.allocate(2, 0);
+        pool.allocate(3, 0);
+        CPPUNIT_ASSERT(pool.release(1));
+        CPPUNIT_ASSERT_EQUAL(VCHAN_FREE, pool[1].state);
+        CPPUNIT_ASSERT_EQUAL((uint64_t)0, pool[1].min);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, pool.nfree());
+        CPPUNIT_ASSERT_EQUAL(-1, pool.find(2));
+
+        // A second release (e.g. a duplicate SAT-lost) changes nothing.
+        CPPUNIT_ASSERT(pool.release(1) == false);
+        CPPUNIT_ASSERT_EQUAL((size_t)1, pool.nfree());
+        CPPUNIT_ASSERT(pool.release(-1) == false);
+        CPPUNIT_ASSERT(pool.release(3) == false);
+
+        CPPUNIT_ASSERT_EQUAL(1, pool.allocate(4, 0));
+        CPPUNIT_ASSERT_EQUAL(-1, pool.allocate(5, 0));
+    }
+
+    void qa_voice_channel_pool::t_mark_busy() {
+        voice_channel_pool pool(300, 2, qa_sccs(), 0);
+        CPPUNIT_ASSERT(pool.mark_busy(0, 10) == false);
+        const int idx = pool.allocate(1, 10);
+        CPPUNIT_ASSERT(pool.mark_busy(idx, 12));
+        CPPUNIT_ASSERT_EQUAL(VCHAN_BUSY, pool[idx].state);
+        CPPUNIT_ASSERT_EQUAL((time_t)12, pool[idx].since);
+        CPPUNIT_ASSERT(pool.mark_busy(idx, 13) == false);
+        CPPUNIT_ASSERT_EQUAL((time_t)12, pool[idx].since);
+        CPPUNIT_ASSERT(pool.mark_busy(5, 13) == false);
+    }
+
+    // Only channels still waiting for SAT past the timeout come back.
+    void qa_voice_channel_pool::t_reclaim() {
+        voice_channel_pool pool(300, 4, qa_sccs(), 0);
+        const int stale = pool.allocate(1, 100);
+        const int fresh = pool.allocate(2, 103);
+        const int busy = pool.allocate(3, 100);
+        pool.mark_busy(busy, 100);
+
+        CPPUNIT_ASSERT_EQUAL((size_t)0, pool.reclaim(104, VCHAN_SAT_TIMEOUT));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, pool.reclaim(105, VCHAN_SAT_TIMEOUT));
+        CPPUNIT_ASSERT_EQUAL(VCHAN_FREE, pool[stale].state);
+        CPPUNIT_ASSERT_EQUAL(VCHAN_ASSIGNED, pool[fresh].state);
+        CPPUNIT_ASSERT_EQUAL(VCHAN_BUSY, pool[busy].state);
+        CPPUNIT_ASSERT_EQUAL((size_t)2, pool.nfree());
+
+        CPPUNIT_ASSERT_EQUAL((size_t)1, pool.reclaim(1000, VCHAN_SAT_TIMEOUT));
+        CPPUNIT_ASSERT_EQUAL(VCHAN_BUSY, pool[busy].state);
+        CPPUNIT_ASSERT_EQUAL((size_t)3, pool.nfree());
+    }
+
+    void qa_voice_channel_pool::t_blocked() {
+        voice_channel_pool pool(300, 4, qa_sccs(), 0);
+
+        // Blocking a free channel in the middle of the free list unlinks it.
+        CPPUNIT_ASSERT(pool.set_blocked(2, true));
+        CPPUNIT_ASSERT(pool.set_blocked(2, true) == false);
+        CPPUNIT_ASSERT_EQUAL((size_t)3, pool.nfree());
+        CPPUNIT_ASSERT_EQUAL(0, pool.allocate(1, 0));
+        CPPUNIT_ASSERT_EQUAL(1, pool.allocate(2, 0));
+        CPPUNIT_ASSERT_EQUAL(3, pool.allocate(3, 0));
+        CPPUNIT_ASSERT_EQUAL(-1, pool.allocate(4, 0));
+
+        // A channel in use can be blocked; it stays off the list once it's
+        // released, until it's unblocked.
+        CPPUNIT_ASSERT(pool.set_blocked(1, true));
+        CPPUNIT_ASSERT_EQUAL(VCHAN_ASSIGNED, pool[1].state);
+        CPPUNIT_ASSERT(pool.release(1));
+        CPPUNIT_ASSERT_EQUAL((size_t)0, pool.nfree());
+        CPPUNIT_ASSERT_EQUAL(-1, pool.allocate(4, 0));
+
+        CPPUNIT_ASSERT(pool.set_blocked(2, false));
+        CPPUNIT_ASSERT_EQUAL((size_t)1, pool.nfree());
+        CPPUNIT_ASSERT_EQUAL(2, pool.allocate(4, 0));
+        CPPUNIT_ASSERT(pool.set_blocked(1, false));
+        CPPUNIT_ASSERT_EQUAL(1, pool.allocate(5, 0));
+        CPPUNIT_ASSERT_EQUAL((size_t)0, pool.nfree());
+
+        // Unblocking a channel that's still in use leaves the list alone.
+        CPPUNIT_ASSERT(pool.set_blocked(0, true));
+        CPPUNIT_ASSERT(pool.set_blocked(0, false));
+        CPPUNIT_ASSERT_EQUAL((size_t)0, pool.nfree());
+        CPPUNIT_ASSERT(pool.set_blocked(4, true) == false);
+    }
+
+    void qa_voice_channel_pool::t_invalid() {
+        const std::vector<int> scc = qa_sccs();
+        CPPUNIT_ASSERT_THROW(voice_channel_pool(300, 0, scc, 0), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(voice_channel_pool(0, 4, scc, 0), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(voice_channel_pool(2045, 4, scc, 0), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(voice_channel_pool(300, 4, scc, 8), std::invalid_argument);
+        CPPUNIT_ASSERT_THROW(voice_channel_pool(300, 4, std::vector<int>(1, 3), 0), std::invalid_argument);
+        voice_channel_pool top(2044, 4, scc, 7);
+        CPPUNIT_ASSERT_EQUAL(2047, (int)top[3].chan);
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,38 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_QA_VOICE_CHANNEL_POOL_H
+#define INCLUDED_AMPS_QA_VOICE_CHANNEL_POOL_H
+
+#include <cppunit/extensions/HelperMacros.h>
+#include <cppunit/TestCase.h>
+
+namespace gr {
+  namespace amps {
+
+    class qa_voice_channel_pool : public CppUnit::TestCase {
+        CPPUNIT_TEST_SUITE(qa_voice_channel_pool);
+        CPPUNIT_TEST(t_allocate);
+        CPPUNIT_TEST(t_release);
+        CPPUNIT_TEST(t_mark_busy);
+        CPPUNIT_TEST(t_reclaim);
+        CPPUNIT_TEST(t_blocked);
+        CPPUNIT_TEST(t_invalid);
+        CPPUNIT_TEST_SUITE_END();
+
+        private:
+        void t_allocate();
+        void t_release();
+        void t_mark_busy();
+        void t_reclaim();
+        void t_blocked();
+        void t_invalid();
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_QA_VOICE_CHANNEL_POOL_H */
@@ -0,0 +1,128 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "recc_burst.h"
+#include "utils.h"
+
+using std::string;
+using std::vector;
+
+namespace gr {
+  namespace amps {
+
+    // Seizure precursor (553 2.7.1): 30 bits of dotting, then word sync.
+    static const unsigned char recc_dotting[30] = {
+        1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0
+    };
+    static const unsigned char recc_wsync[11] = { 1,1,1,0,0,0,1,0,0,1,0 };
+
+    // Coded DCC, indexed by DCC (553 Table 2.7.1-1).
+    static const unsigned char recc_coded_dcc[4][7] = {
+        { 0,0,0,0,0,0,0 },
+        { 0,0,1,1,1,1,1 },
+        { 1,1,0,0,0,1,1 },
+        { 1,1,1,1,1,0,0 }
+    };
+
+    recc_burst_encoder::recc_burst_encoder()
+        : bch(63, 2, true) {
+    }
+
+    // Append bits as Manchester symbols: 0 is sent as 1,0 and 1 as 0,1.
+    void recc_burst_encoder::append_bits(vector<unsigned char> &out, const unsigned char *bits, size_t nbits) {
+        for(size_t i = 0; i < nbits; i++) {
+            out.push_back(bits[i] ? 0 : 1);
+            out.push_back(bits[i] ? 1 : 0);
+        }
+    }
+
+    void recc_burst_encoder::render(vector<unsigned char> &out, unsigned char dcc,
+            const vector<vector<unsigned char> > &words, bool seizure) {
+        if(seizure) {
+            append_bits(out, recc_dotting, sizeof(recc_dotting));
+            append_bits(out, recc_wsync, sizeof(recc_wsync));
+        }
+        const size_t msgstart = out.size();
+        append_bits(out, recc_coded_dcc[dcc & 0x3], 7);
+
+        // The word is a BCH(48, 36) code shortened from BCH(63, 51); see
+        // bch_decode_48().
+        bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
+        bvec srcbits(36);
+        unsigned char codeword[48];
+        for(size_t w = 0; w < words.size(); w++) {
+            assert(words[w].size() == 36);
+            for(int i = 0; i < 36; i++) {
+                srcbits[i] = words[w][i];
+            }
+            bvec encoded = bch.encode(concat(zeroes, srcbits));
+            for(int i = 0; i < 48; i++) {
+                codeword[i] = (encoded[15 + i] == 1) ? 1 : 0;
+            }
+            for(int r = 0; r < 5; r++) {
+                append_bits(out, codeword, sizeof(codeword));
+            }
+        }
+        if(seizure == false) {
+            for(size_t i = 0; (out.size() - msgstart) < RECC_BURST_SYMS; i++) {
+                out.push_back(i & 1);
+            }
+            out.resize(msgstart + RECC_BURST_SYMS);
+        }
+    }
+
+    /*
+     * Registration (order 01101, ORDQ 000), with Word C carrying the ESN.
+     */
+    void recc_burst_encoder::registration(vector<unsigned char> &out, unsigned char dcc, u_int64_t MIN1, u_int64_t MIN2,
+            unsigned long esn, unsigned char scm, bool seizure) {
+        vector<vector<unsigned char> > words(3, vector<unsigned char>(36));
+        recc_word_a_bits(&words[0][0], 2, true, true, scm, MIN1);
+        recc_word_b_bits(&words[1][0], 1, 0, 0, 0x0d, scm, MIN2);
+        recc_word_c_serial_bits(&words[2][0], 0, esn);
+        render(out, dcc, words, seizure);
+    }
+
+    /*
+     * Origination: Words A, B and C, then up to four called-address words
+     * (32 digits).  Returns false if the dialed digits won't fit.
+     */
+    bool recc_burst_encoder::origination(vector<unsigned char> &out, unsigned char dcc, u_int64_t MIN1, u_int64_t MIN2,
+            unsigned long esn, unsigned char scm, const string &dialed, bool seizure) {
+        const size_t ndigitwords = (dialed.size() + 7) / 8;
+        if(ndigitwords < 1 || ndigitwords > 4) {
+            return false;
+        }
+        vector<vector<unsigned char> > words(3 + ndigitwords, vector<unsigned char>(36));
+        recc_word_a_bits(&words[0][0], 2 + ndigitwords, true, true, scm, MIN1);
+        recc_word_b_bits(&words[1][0], 1 + ndigitwords, 0, 0, 0, scm, MIN2);
+        recc_word_c_serial_bits(&words[2][0], ndigitwords, esn);
+        for(size_t i = 0; i < ndigitwords; i++) {
+            if(recc_word_called_bits(&words[3 + i][0], ndigitwords - 1 - i, dialed.substr(8 * i, 8)) == false) {
+                return false;
+            }
+        }
+        render(out, dcc, words, seizure);
+        return true;
+    }
+
+    /*
+     * Page response: Words A and B, T = 0.
+     */
+    void recc_burst_encoder::page_response(vector<unsigned char> &out, unsigned char dcc, u_int64_t MIN1, u_int64_t MIN2,
+            unsigned char scm, bool seizure) {
+        vector<vector<unsigned char> > words(2, vector<unsigned char>(36));
+        recc_word_a_bits(&words[0][0], 1, false, false, scm, MIN1);
+        recc_word_b_bits(&words[1][0], 0, 0, 0, 0, scm, MIN2);
+        render(out, dcc, words, seizure);
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,57 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_RECC_BURST_H
+#define INCLUDED_AMPS_RECC_BURST_H
+
+#include <itpp/comm/bch.h>
+#include <string>
+#include <vector>
+#include "amps_packet.h"
+
+namespace gr {
+  namespace amps {
+
+    // What the RECC block captures after the seizure precursor's sync word:
+    // coded DCC (7 bits) plus 7 words of 240 bits, two symbols per bit.
+    static const size_t RECC_BURST_SYMS = 3374;
+
+    /*
+     * Builds RECC messages (553 2.7.1) as Manchester symbols, one byte per
+     * symbol (0 or 1, in the same sense the RECC block expects): each
+     * 36-bit word is BCH-encoded to 48 bits and repeated five times, after
+     * the coded DCC.
+     *
+     * With seizure set, the message is preceded by the seizure precursor's
+     * dotting and word sync, as a mobile would send it.  Otherwise it's laid
+     * out exactly as the RECC block publishes a burst -- starting at the
+     * coded DCC, padded with dotting to RECC_BURST_SYMS -- so it can be fed
+     * straight to the RECC Decode block.
+     */
+    class recc_burst_encoder {
+        private:
+        itpp::BCH bch;
+
+        void append_bits(std::vector<unsigned char> &out, const unsigned char *bits, size_t nbits);
+
+        public:
+        recc_burst_encoder();
+
+        void render(std::vector<unsigned char> &out, unsigned char dcc,
+                const std::vector<std::vector<unsigned char> > &words, bool seizure);
+
+        void registration(std::vector<unsigned char> &out, unsigned char dcc, u_int64_t MIN1, u_int64_t MIN2,
+                unsigned long esn, unsigned char scm, bool seizure);
+        bool origination(std::vector<unsigned char> &out, unsigned char dcc, u_int64_t MIN1, u_int64_t MIN2,
+                unsigned long esn, unsigned char scm, const std::string &dialed, bool seizure);
+        void page_response(std::vector<unsigned char> &out, unsigned char dcc, u_int64_t MIN1, u_int64_t MIN2,
+                unsigned char scm, bool seizure);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_RECC_BURST_H */
@@ -11,6 +11,11 @@
 
 #include <gnuradio/io_signature.h>
 #include "recc_decode_impl.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <stdexcept>
 #include "utils.h"
 
 using namespace std;
@@ -19,73 +24,405 @@ using boost::shared_ptr;
 namespace gr {
   namespace amps {
 
+    // Without word from the FOCC, a retry this soon is taken to be a
+    // duplicate (a mobile waits longer than this for its answer).
+    static const uint64_t DUP_UNCONFIRMED_NS = 1000000000ULL;
+
     recc_decode::sptr
-    recc_decode::make()
+    recc_decode::make(const std::string &registry_path, int first_chan, int nchans, const std::vector<int> &scc, int vmac, const std::string &journal_prefix, double dup_ttl)
     {
       return gnuradio::get_initial_sptr
-        (new recc_decode_impl());
+        (new recc_decode_impl(registry_path, first_chan, nchans, scc, vmac, journal_prefix, dup_ttl));
     }
 
     /*
      * The private constructor
      */
-    recc_decode_impl::recc_decode_impl()
-      : bch(63, 2, true),
-      gr::block("recc_decode",
+    recc_decode_impl::recc_decode_impl(const std::string &registry_path, int first_chan, int nchans, const std::vector<int> &scc, int vmac, const std::string &journal_prefix, double dup_ttl)
+      : gr::block("recc_decode",
               gr::io_signature::make(0, 0, 0),
-              gr::io_signature::make(0, 0, 0))
+              gr::io_signature::make(0, 0, 0)),
+      bch(63, 2, true), d_pool(first_chan, nchans, scc, vmac), d_sid(GLOBAL_SID), d_finished(false),
+      d_stats_ns(0), d_dup_ttl_ns(dup_ttl * 1e9), d_have_sent_feedback(false), d_recent_sweep_ns(0),
+      d_profiler("recc_decode"), d_prof_bursts(d_profiler.add_site("bursts_message"))
     {
+        if(dup_ttl < 0) {
+            throw std::invalid_argument("recc_decode: dup_ttl can't be negative");
+        }
+        // Without a registry path, nothing is remembered about mobiles.
+        if(registry_path.empty() == false) {
+            d_registry = subscriber_registry::open(registry_path);
+        }
+        if(journal_prefix.empty() == false) {
+            d_journal.reset(new event_journal(journal_prefix));
+        }
+        memset(d_bch_fails, 0, sizeof(d_bch_fails));
+        memset(d_manchester_errs, 0, sizeof(d_manchester_errs));
+        memset(&d_stats, 0, sizeof(d_stats));
+        d_trace = pmt::make_dict();
         message_port_register_in(pmt::mp("bursts"));
 	  	set_msg_handler(pmt::mp("bursts"),
 			boost::bind(&recc_decode_impl::bursts_message, this, _1)
 		);
+        message_port_register_in(pmt::mp("voice_events"));
+        set_msg_handler(pmt::mp("voice_events"),
+            boost::bind(&recc_decode_impl::voice_events_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("focc_sent"));
+        set_msg_handler(pmt::mp("focc_sent"),
+            boost::bind(&recc_decode_impl::focc_sent_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("occupancy"));
+        set_msg_handler(pmt::mp("occupancy"),
+            boost::bind(&recc_decode_impl::occupancy_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("overhead"));
+        set_msg_handler(pmt::mp("overhead"),
+            boost::bind(&recc_decode_impl::overhead_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("profile_query"));
+        set_msg_handler(pmt::mp("profile_query"),
+            boost::bind(&recc_decode_impl::profile_query_message, this, _1)
+        );
+        message_port_register_out(pmt::mp("profile"));
         message_port_register_out(pmt::mp("focc_words"));
         message_port_register_out(pmt::mp("fvc_words"));
         message_port_register_out(pmt::mp("audio_mute"));
         message_port_register_out(pmt::mp("fvc_mute"));
         message_port_register_out(pmt::mp("command_out"));
+        message_port_register_out(pmt::mp("fvc_bank_words"));
+        message_port_register_out(pmt::mp("channel_state"));
+        message_port_register_out(pmt::mp("call_events"));
+        message_port_register_out(pmt::mp("decode_stats"));
+        message_port_register_out(pmt::mp("bad_bursts"));
+    }
+
+    // Tell Call Control that a mobile has been given a voice channel.
+    void recc_decode_impl::publish_call_event(const char *event, uint64_t min, int idx) {
+        pmt::pmt_t msg = pmt::make_dict();
+        msg = pmt::dict_add(msg, pmt::mp("event"), pmt::mp(event));
+        msg = pmt::dict_add(msg, pmt::mp("min"), pmt::from_uint64(min));
+        msg = pmt::dict_add(msg, pmt::mp("chan"), pmt::from_long(idx));
+        msg = pmt::dict_add(msg, pmt::mp("scc"), pmt::from_long(d_pool[idx].scc));
+        message_port_pub(pmt::mp("call_events"), msg);
+    }
+
+    /*
+     * Find a voice channel for the given mobile.  A mobile that already
+     * holds one (e.g. it repeated its origination) gets the same channel
+     * back.  Returns the channel's index in the pool, or -1 if there's
+     * nothing free.
+     */
+    int recc_decode_impl::assign_channel(uint64_t min) {
+        int idx = d_pool.find(min);
+        if(idx >= 0) {
+            return idx;
+        }
+        const time_t now = time(NULL);
+        idx = d_pool.allocate(min, now);
+        if(idx < 0 && d_pool.reclaim(now, VCHAN_SAT_TIMEOUT) > 0) {
+            idx = d_pool.allocate(min, now);
+        }
+        if(idx >= 0) {
+            publish_channel_state(idx);
+        }
+        return idx;
+    }
+
+    void recc_decode_impl::publish_channel_state(int idx) {
+        const voice_channel &vc = d_pool[idx];
+        pmt::pmt_t msg = pmt::make_dict();
+        msg = pmt::dict_add(msg, pmt::mp("chan"), pmt::from_long(idx));
+        msg = pmt::dict_add(msg, pmt::mp("number"), pmt::from_long(vc.chan));
+        msg = pmt::dict_add(msg, pmt::mp("state"), pmt::mp(voice_channel_state_name(vc.state)));
+        msg = pmt::dict_add(msg, pmt::mp("blocked"), pmt::from_bool(vc.blocked));
+        msg = pmt::dict_add(msg, pmt::mp("free"), pmt::from_long(d_pool.nfree()));
+        message_port_pub(pmt::mp("channel_state"), msg);
+    }
+
+    /*
+     * Append a record of a decoded (or undecodable) message to the journal,
+     * if there is one.  idx is the voice channel assigned (pool index), or
+     * -1 for none.
+     */
+    void recc_decode_impl::journal_event(journal_event_type type, const recc_word_a *worda, const recc_word_b *wordb,
+            bool has_esn, unsigned long esn, const std::string &dialed, int idx, bool blocked) {
+        if(!d_journal) {
+            return;
+        }
+        boost::mutex::scoped_lock lock(d_journal_mutex);
+        journal_record *rec = d_journal->next_record();
+        if(rec == NULL) {
+            return;
+        }
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        rec->stamp_ns = ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+        rec->type = type;
+        if(worda != NULL && wordb != NULL) {
+            rec->min = pack_min(worda->MIN1, wordb->MIN2);
+            const std::string min = calc_min(*worda, *wordb);
+            memcpy(rec->min_digits, min.data(), std::min(min.size(), sizeof(rec->min_digits)));
+            rec->scm = worda->SCM | (wordb->SCM4 ? 0x10 : 0);
+            rec->nwords = worda->NAWC + 1;
+        }
+        if(has_esn) {
+            rec->esn = esn;
+            rec->flags |= JOURNAL_HAS_ESN;
+        }
+        if(blocked) {
+            rec->flags |= JOURNAL_BLOCKED;
+        }
+        if(idx >= 0) {
+            rec->chan = d_pool[idx].chan;
+        }
+        rec->ndigits = std::min(dialed.size(), sizeof(rec->digits));
+        memcpy(rec->digits, dialed.data(), rec->ndigits);
+        memcpy(rec->bch_fails, d_bch_fails, sizeof(rec->bch_fails));
+        memcpy(rec->manchester_errs, d_manchester_errs, sizeof(rec->manchester_errs));
+        d_journal->commit();
+    }
+
+    /*
+     * Send a mobile station control message with the given order (ORDQ 000)
+     * on the FOCC.
+     */
+    void recc_decode_impl::send_order(const recc_word_a &worda, const recc_word_b &wordb, unsigned char order) {
+        unsigned char word1[28], word2[28];
+        focc_word1(word1, true, GLOBAL_DCC_SHORT, worda.MIN1);
+        focc_word2_general(word2, wordb.MIN2, 0, 0, order);
+        long stream = STREAM_BOTH;       // XXX XXX
+        publish_focc_words(stream, word1, word2);
     }
 
     /*
-     * Convert a 48-bit value (one byte per bit) to a 36-bit value, after 
-     * performing BCH decoding.
+     * Post the running totals on decode_stats, at most once a second (and
+     * only when bursts are coming in).  They're cumulative, so a listener
+     * gets rates from the difference between two of them.
      */
-    bool 
-    recc_decode_impl::recc_bch_decode(const unsigned char *srcbuf, unsigned char *dstbuf) {
-        bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
-        bvec srcbits(48);
-        for(int i = 0; i < 48; i++) {
-            const unsigned char b = srcbuf[i];
-            assert(b == 0 || b == 1);
-            srcbits[i] = b;
-        }
-        bvec padded(concat(zeroes, srcbits));
-        cout << " padded: " << padded << endl;      // XXX
-        bvec errbv;
-        bvec decoded(51);
-        bool retval = bch.decode(padded, decoded, errbv);
-        cout << "decoded: " << decoded << endl;     // XXX
-        bvec final = decoded(15, 50);
-        cout << "  final: " << final << endl;       // XXX
-        cout << "  errbv: " << errbv << endl;       // XXX
-        for(int i = 0; i < 48; i++) {
-            if(final[i] == 0) {
-                dstbuf[i] = 0;
-            } else {
-                dstbuf[i] = 1;
+    void recc_decode_impl::publish_stats(uint64_t now) {
+        if(now - d_stats_ns < 1000000000ULL) {
+            return;
+        }
+        d_stats_ns = now;
+        pmt::pmt_t d = pmt::make_dict();
+        d = pmt::dict_add(d, pmt::mp("time_ns"), pmt::from_uint64(now));
+        d = pmt::dict_add(d, pmt::mp("bursts"), pmt::from_uint64(d_stats.bursts));
+        d = pmt::dict_add(d, pmt::mp("bad_word_a"), pmt::from_uint64(d_stats.bad_word_a));
+        d = pmt::dict_add(d, pmt::mp("rejected"), pmt::from_uint64(d_stats.rejected));
+        d = pmt::dict_add(d, pmt::mp("registrations"), pmt::from_uint64(d_stats.registrations));
+        d = pmt::dict_add(d, pmt::mp("originations"), pmt::from_uint64(d_stats.originations));
+        d = pmt::dict_add(d, pmt::mp("page_responses"), pmt::from_uint64(d_stats.page_responses));
+        d = pmt::dict_add(d, pmt::mp("unknown"), pmt::from_uint64(d_stats.unknown));
+        d = pmt::dict_add(d, pmt::mp("duplicates"), pmt::from_uint64(d_stats.duplicates));
+        message_port_pub(pmt::mp("decode_stats"), d);
+    }
+
+    void recc_decode_impl::profile_query_message(pmt::pmt_t msg) {
+        message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+    }
+
+    /*
+     * Post a two-word mobile station control message for the FOCC.  The
+     * burst's trace goes along as a trailing dict, stamped with when we
+     * decided on the answer.
+     */
+    void recc_decode_impl::publish_focc_words(long stream, const unsigned char *word1, const unsigned char *word2) {
+        pmt::pmt_t trace = pmt::dict_add(d_trace, pmt::mp("decode_ns"), pmt::from_uint64(monotonic_ns()));
+        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(stream), pmt::from_long(2),
+                pmt::mp(word1, 28), pmt::mp(word2, 28), trace);
+        message_port_pub(pmt::mp("focc_words"), tuple);
+    }
+
+    /*
+     * Supervision events from the RVCs, whose "chan" is the pool index:
+     * either straight from the RVC Supervision block, or filtered through
+     * Call Control.  The mobile's SAT coming up means the channel is in use;
+     * losing it (or Call Control saying the call is over) frees it.
+     */
+    void recc_decode_impl::voice_events_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            LOG_WARNING("recc_decode: ignoring voice event that isn't a dict");
+            return;
+        }
+        pmt::pmt_t chanp = pmt::dict_ref(msg, pmt::mp("chan"), pmt::PMT_NIL);
+        pmt::pmt_t eventp = pmt::dict_ref(msg, pmt::mp("event"), pmt::PMT_NIL);
+        if(pmt::is_integer(chanp) == false || pmt::is_symbol(eventp) == false) {
+            LOG_WARNING("recc_decode: ignoring voice event without chan/event");
+            return;
+        }
+        const int idx = pmt::to_long(chanp);
+        if(idx < 0 || idx >= d_pool.size()) {
+            LOG_WARNING("recc_decode: voice event for unknown channel %d", idx);
+            return;
+        }
+        const std::string event = pmt::symbol_to_string(eventp);
+        if(event == "sat_detected") {
+            if(d_pool.mark_busy(idx, time(NULL))) {
+                publish_channel_state(idx);
             }
+        } else if(event == "sat_lost" || event == "release") {
+            if(d_pool.release(idx)) {
+                LOG_DEBUG("voice channel %hu released", d_pool[idx].chan);
+                publish_channel_state(idx);
+            }
+        }
+    }
+
+    /*
+     * The same overhead settings the FOCC gets; only the SID matters here,
+     * for the registry.  The FOCC checks the rest.
+     */
+    void recc_decode_impl::overhead_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            return;
+        }
+        pmt::pmt_t sid = pmt::dict_ref(msg, pmt::mp("sid"), pmt::PMT_NIL);
+        if(pmt::is_integer(sid) && pmt::to_long(sid) >= 0 && pmt::to_long(sid) <= 32767) {
+            d_sid = pmt::to_long(sid);
         }
-        return retval;
     }
 
+    /*
+     * Occupancy reports from the channel monitor.  A channel that's busy
+     * on the air, and isn't one of our calls, is kept out of the pool
+     * until it clears; assigning a mobile to it would only waste the call
+     * setup.
+     */
+    void recc_decode_impl::occupancy_message(pmt::pmt_t msg) {
+        pmt::pmt_t first = pmt::is_dict(msg) ? pmt::dict_ref(msg, pmt::mp("first_chan"), pmt::PMT_NIL) : pmt::PMT_NIL;
+        pmt::pmt_t busy = pmt::is_dict(msg) ? pmt::dict_ref(msg, pmt::mp("busy"), pmt::PMT_NIL) : pmt::PMT_NIL;
+        if(pmt::is_integer(first) == false || pmt::is_u8vector(busy) == false) {
+            LOG_WARNING("recc_decode: ignoring occupancy report without first_chan/busy");
+            return;
+        }
+        // Report entry i is channel first_chan + i; match by channel number.
+        const long offset = d_pool[0].chan - pmt::to_long(first);
+        size_t len = 0;
+        const uint8_t *b = pmt::u8vector_elements(busy, len);
+        for(int idx = 0; idx < d_pool.size(); idx++) {
+            const long i = offset + idx;
+            if(i < 0 || i >= (long)len) {
+                continue;
+            }
+            const voice_channel &vc = d_pool[idx];
+            const bool blocked = (b[i] != 0);
+            // Our own calls show up as busy; that says nothing about
+            // interference.
+            if(blocked && vc.state != VCHAN_FREE) {
+                continue;
+            }
+            if(d_pool.set_blocked(idx, blocked)) {
+                LOG_INFO("voice channel %hu %s", vc.chan, blocked ? "is busy on the air; not assigning it" : "is clear again");
+                publish_channel_state(idx);
+            }
+        }
+    }
+
+    /*
+     * Completed traces from the FOCC block (its latency output): the answer
+     * to that burst has started going out.
+     */
+    void recc_decode_impl::focc_sent_message(pmt::pmt_t msg) {
+        pmt::pmt_t id = pmt::is_dict(msg) ? pmt::dict_ref(msg, pmt::mp("trace_id"), pmt::PMT_NIL) : pmt::PMT_NIL;
+        if(pmt::is_uint64(id) == false) {
+            return;
+        }
+        d_have_sent_feedback = true;
+        boost::unordered_map<uint64_t, std::string>::iterator it = d_recent_by_trace.find(pmt::to_uint64(id));
+        if(it == d_recent_by_trace.end()) {
+            return;
+        }
+        boost::unordered_map<std::string, recent_seizure>::iterator rit = d_recent.find(it->second);
+        if(rit != d_recent.end()) {
+            rit->second.sent = true;
+        }
+        d_recent_by_trace.erase(it);
+    }
+
+    /*
+     * A mobile that doesn't hear its answer in time tries again, and under
+     * load, answering each retry too only makes the FOCC queue longer.
+     * Returns true if this message repeats one answered within the last
+     * dup_ttl seconds whose answer hasn't gone out yet.  Dropped retries
+     * don't extend the entry, so if that answer never goes out (or we never
+     * hear that it did), the first retry after dup_ttl is answered again.
+     * A retry of an answer that did go out (so the mobile missed it) is
+     * answered again straight away.
+     */
+    bool recc_decode_impl::duplicate_seizure(uint64_t min, char type, const std::string &digits) {
+        if(d_dup_ttl_ns == 0) {
+            return false;
+        }
+        const uint64_t now = monotonic_ns();
+        if(now - d_recent_sweep_ns >= 1000000000ULL) {
+            d_recent_sweep_ns = now;
+            boost::unordered_map<std::string, recent_seizure>::iterator it = d_recent.begin();
+            while(it != d_recent.end()) {
+                if(it->second.expires_ns <= now) {
+                    d_recent_by_trace.erase(it->second.trace_id);
+                    it = d_recent.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        char prefix[24];
+        snprintf(prefix, sizeof(prefix), "%llx/%c/", (unsigned long long)min, type);
+        const std::string key = prefix + digits;
+        pmt::pmt_t idp = pmt::dict_ref(d_trace, pmt::mp("trace_id"), pmt::PMT_NIL);
+        const uint64_t trace_id = pmt::is_uint64(idp) ? pmt::to_uint64(idp) : 0;
+        boost::unordered_map<std::string, recent_seizure>::iterator it = d_recent.find(key);
+        if(it != d_recent.end() && it->second.expires_ns > now) {
+            recent_seizure &r = it->second;
+            r.retries++;
+            if(r.sent == false && (d_have_sent_feedback || now - r.answered_ns < DUP_UNCONFIRMED_NS)) {
+                d_stats.duplicates++;
+                LOG_DEBUG("dropping retry %u of %s: the answer is still queued", r.retries, key.c_str());
+                return true;
+            }
+            d_recent_by_trace.erase(r.trace_id);
+            r.expires_ns = now + d_dup_ttl_ns;
+            r.answered_ns = now;
+            r.trace_id = trace_id;
+            r.sent = false;
+        } else {
+            recent_seizure &r = d_recent[key];
+            r.expires_ns = now + d_dup_ttl_ns;
+            r.answered_ns = now;
+            r.trace_id = trace_id;
+            r.sent = false;
+            r.retries = 0;
+        }
+        d_recent_by_trace[trace_id] = key;
+        return false;
+    }
+
+    /*
+     * Bursts come from the RECC block as (metadata . blob) pairs; a bare
+     * blob (from the Mobile Population block, say) starts a trace here.
+     */
     void recc_decode_impl::bursts_message(pmt::pmt_t msg) {
-        assert(pmt::is_blob(msg));
+        profile_scope prof(d_profiler, d_prof_bursts);
+        if(pmt::is_pair(msg)) {
+            d_trace = pmt::is_dict(pmt::car(msg)) ? pmt::car(msg) : pmt::make_dict();
+            msg = pmt::cdr(msg);
+        } else {
+            d_trace = pmt::make_dict();
+        }
+        if(pmt::dict_has_key(d_trace, pmt::mp("trace_id")) == false) {
+            d_trace = pmt::dict_add(d_trace, pmt::mp("trace_id"), pmt::from_uint64(next_trace_id()));
+            d_trace = pmt::dict_add(d_trace, pmt::mp("detect_ns"), pmt::from_uint64(monotonic_ns()));
+        }
+        publish_stats(monotonic_ns());
+        if(pmt::is_blob(msg) == false) {
+            LOG_WARNING("recc_decode: ignoring burst that isn't a blob");
+            return;
+        }
         size_t blen = pmt::blob_length(msg);
         const unsigned char *bdata = static_cast<const unsigned char *>(pmt::blob_data(msg));
-        printf("XXX got blob len %zu  %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu %hhu\n", blen, 
-                bdata[0], bdata[1], bdata[2], bdata[3], bdata[4], bdata[5], bdata[6],
-                bdata[7], bdata[8], bdata[9], bdata[10], bdata[11], bdata[12], bdata[13]
-                );
+        d_stats.bursts++;
         unsigned char dcc[7];
         size_t dccerrbits = manchester_decode_binbuf(bdata, dcc, sizeof(dcc));
         // XXX: validate DCC
@@ -95,23 +432,32 @@ namespace gr {
         bool validwords[7];
         for(int i = 0; i < 7; i++) {
             errs[i] = manchester_decode_binbuf(&bdata[14 + (480 * i)], words[i], 240);
-            printf("%d: %zu errs\n", i, errs[i]);
+            d_manchester_errs[i] = errs[i];
         }
+        LOG_DEBUG("RECC burst: %zu bytes; Manchester errors %zu %zu %zu %zu %zu %zu %zu", blen,
+                errs[0], errs[1], errs[2], errs[3], errs[4], errs[5], errs[6]);
         for(int w = 0; w < 7; w++) {
+            d_bch_fails[w] = 5;
             for(int r = 0; r < 5; r++) {
-                validwords[w] = recc_bch_decode(&words[w][(r * 48)], decwords[w]);
+                validwords[w] = bch_decode_48(bch, &words[w][(r * 48)], decwords[w]);
                 if(validwords[w] == true) {
+                    d_bch_fails[w] = r;
                     break;
                 }
             }
         }
         if(validwords[0] == false) {
             LOG_DEBUG("got a burst with an invalid Word A");
+            d_stats.bad_word_a++;
+            journal_event(JOURNAL_BAD_BURST, NULL, NULL, false, 0, "", -1, false);
+            // Worth a look at the IQ (see amps::iq_capture).
+            message_port_pub(pmt::mp("bad_bursts"), pmt::dict_add(d_trace, pmt::mp("reason"), pmt::mp("bad_word_a")));
             return;
         }
         recc_word_a worda(words[0]);
         if(worda.E == false) {
             LOG_WARNING("got a RECC message with E=0; not sure what this is");
+            d_stats.rejected++;
             return;
         }
         recc_word_b wordb(words[1]);
@@ -119,6 +465,10 @@ namespace gr {
         // Handle cases.  Most of these are in TIA/EIA-553-A Table 3.7.1-1.
 
         if(worda.T == 0 && (wordb.ORDER == 0 && wordb.ORDQ == 0 && wordb.MSG_TYPE == 0)) {
+            d_stats.page_responses++;
+            if(duplicate_seizure(pack_min(worda.MIN1, wordb.MIN2), 'P', "")) {
+                return;
+            }
             handle_response(worda, wordb);
         } else if(worda.T == 1 && wordb.ORDER == 0xd) {
             // ORDER == 01101 (0xd) is a word-C-not-included registration order.
@@ -135,6 +485,10 @@ namespace gr {
                     LOG_WARNING("protocol violation!  Word C NAWC does not agree with Word A's -- continuing anyway");
                 }
             }
+            d_stats.registrations++;
+            if(duplicate_seizure(pack_min(worda.MIN1, wordb.MIN2), 'R', "")) {
+                return;
+            }
             handle_registration(worda, wordb, reqmin, hasesn, esn);
         } else if(worda.T == 1 && (worda.NAWC > 2 || (wordb.ORDER == 0 && wordb.ORDQ == 0 && wordb.MSG_TYPE == 0))) {
             // Assume this is an origination.  Word D will be sent.
@@ -154,6 +508,7 @@ namespace gr {
             // XXX: verify NAWC
             if(nawc < 1 || nawc > 4) {
                 LOG_WARNING("invalid NAWC value in RECC origination: 0x%x", nawc);
+                d_stats.rejected++;
                 return;
             }
             string dialed = "";
@@ -162,9 +517,15 @@ namespace gr {
                 nextword++;
                 dialed = dialed + curword.digits();
             }
+            d_stats.originations++;
+            if(duplicate_seizure(pack_min(worda.MIN1, wordb.MIN2), 'O', dialed)) {
+                return;
+            }
             handle_origination(worda, wordb, esn, dialed);
         } else {
             LOG_WARNING("got unknown RECC message: ORDER 0x%hhx  ORDQ 0x%hhx  MSG_TYPE 0x%hhx", wordb.ORDER, wordb.ORDQ, wordb.MSG_TYPE);
+            d_stats.unknown++;
+            journal_event(JOURNAL_UNKNOWN, &worda, &wordb, false, 0, "", -1, false);
         }
     }
 
@@ -179,14 +540,20 @@ namespace gr {
      * with an Audit order.
      */
     void recc_decode_impl::handle_registration(recc_word_a &worda, recc_word_b &wordb, std::string reqmin, bool has_esn, unsigned long esn) {
+        if(d_registry) {
+            const uint8_t scm = worda.SCM | (wordb.SCM4 ? 0x10 : 0);
+            if(d_registry->registered(pack_min(worda.MIN1, wordb.MIN2), has_esn ? esn : 0, scm, d_sid, time(NULL)) == false) {
+                LOG_WARNING("subscriber registry full; not recording MIN=%s", reqmin.c_str());
+            }
+        }
+        journal_event(JOURNAL_REGISTRATION, &worda, &wordb, has_esn, esn, "", -1, false);
         LOG_DEBUG("sending registration order confirmation");
         unsigned char word1[28], word2[28];
         focc_word1(word1, true, GLOBAL_DCC_SHORT, worda.MIN1);
-        focc_word2_general(word2, wordb.MIN2, 0, 0, 7);
+        focc_word2_general(word2, wordb.MIN2, 0, 0, ORDER_AUDIT);
         long stream;
         stream = STREAM_BOTH;       // XXX XXX
-        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(stream), pmt::from_long(2), pmt::mp(word1, 28), pmt::mp(word2, 28));
-        message_port_pub(pmt::mp("focc_words"), tuple);
+        publish_focc_words(stream, word1, word2);
     }
 
     /**
@@ -198,27 +565,35 @@ namespace gr {
 
         string reqmin = calc_min(worda, wordb);
         LOG_DEBUG("got a response from MIN=%s", reqmin.c_str());
+        if(d_registry) {
+            d_registry->seen(pack_min(worda.MIN1, wordb.MIN2), time(NULL));
+        }
+        const int idx = assign_channel(pack_min(worda.MIN1, wordb.MIN2));
+        if(idx < 0) {
+            LOG_WARNING("no voice channel free for MIN=%s; sending reorder", reqmin.c_str());
+            journal_event(JOURNAL_PAGE_RESPONSE, &worda, &wordb, false, 0, "", -1, true);
+            send_order(worda, wordb, ORDER_REORDER);
+            return;
+        }
+        journal_event(JOURNAL_PAGE_RESPONSE, &worda, &wordb, false, 0, "", idx, false);
+        const voice_channel &vc = d_pool[idx];
         long stream = STREAM_BOTH;
         unsigned char word1[28], word2[28];
-        focc_word1(word1, true, GLOBAL_DCC_SHORT, worda.MIN1);
-        const unsigned char vmac = 0;
-        const unsigned short chan = 355;    // XXX: 355: fwd 880.650 rev 835.650
 
         focc_word1(word1, true, GLOBAL_DCC_SHORT, worda.MIN1);
-        focc_word2_voice_channel(word2, GLOBAL_SCC, wordb.MIN2, vmac, chan);
-        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(stream), pmt::from_long(2), pmt::mp(word1, 28), pmt::mp(word2, 28));
-        message_port_pub(pmt::mp("focc_words"), tuple);
+        focc_word2_voice_channel(word2, vc.scc, wordb.MIN2, vc.vmac, vc.chan);
+        publish_call_event("page_response", pack_min(worda.MIN1, wordb.MIN2), idx);
+        publish_focc_words(stream, word1, word2);
 
-        // On the FVC, start sending an alert message.
+        // On the FVC, start sending an alert message.  The FVC mutes audio
+        // while the order is out and switches back to audio on its own once
+        // it has been repeated 35 times.  The order is tagged with the
+        // channel; single FVC blocks on fvc_words each pick out their own.
         unsigned char fvc_word1[28];
-        fvc_word1_general(fvc_word1, GLOBAL_SCC, 0, 0, 1);
-        pmt::pmt_t fvc_tuple = pmt::make_tuple(pmt::from_long(1), pmt::mp(fvc_word1, 28), pmt::from_uint64(35));
-        message_port_pub(pmt::mp("fvc_words"), fvc_tuple);
-
-        // Disable audio and put the FVC in.
-        message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(false));
-        message_port_pub(pmt::mp("audio_mute"), pmt::from_bool(true));
-
+        fvc_word1_general(fvc_word1, vc.scc, 0, 0, ORDER_ALERT);
+        pmt::pmt_t bank_tuple = pmt::make_tuple(pmt::from_long(idx), pmt::from_long(1), pmt::mp(fvc_word1, 28), pmt::from_uint64(35));
+        message_port_pub(pmt::mp("fvc_bank_words"), bank_tuple);
+        message_port_pub(pmt::mp("fvc_words"), bank_tuple);
     }
 
     /**
@@ -232,10 +607,15 @@ namespace gr {
      *     - Directed Retry Message
      *     - Intercept
      *     - Reorder
+     *
+     * We send Reorder when there's no voice channel to give it.
      */
     void recc_decode_impl::handle_origination(recc_word_a &worda, recc_word_b &wordb, unsigned long esn, std::string dialed) {
         string reqmin = calc_min(worda, wordb);
         LOG_DEBUG("origination: MIN=%s ESN=%lx dialed %s", reqmin.c_str(), esn, dialed.c_str());
+        if(d_registry) {
+            d_registry->seen(pack_min(worda.MIN1, wordb.MIN2), time(NULL));
+        }
         long stream;
         char c = reqmin.back() - '0';
         if(c & 1) {
@@ -247,19 +627,26 @@ namespace gr {
         stream = STREAM_BOTH;       // XXX XXX
 
         unsigned char word1[28], word2[28];
-        // Initial Voice Designation: Word 1 + Word 2 with SCC != 11
-        const unsigned char vmac = 0;
-        const unsigned short chan = 356;    // XXX: 356: fwd 880.680 rev 835.680
-
         focc_word1(word1, true, GLOBAL_DCC_SHORT, worda.MIN1);
         if(dialed[0] == '0') {      // XXX XXX 
-            focc_word2_general(word2, wordb.MIN2, 0, 0, 9);
+            journal_event(JOURNAL_ORIGINATION, &worda, &wordb, worda.S, esn, dialed, -1, false);
+            focc_word2_general(word2, wordb.MIN2, 0, 0, ORDER_INTERCEPT);
         } else {
-            focc_word2_voice_channel(word2, GLOBAL_SCC, wordb.MIN2, vmac, chan);
+            // Initial Voice Designation: Word 1 + Word 2 with SCC != 11
+            const int idx = assign_channel(pack_min(worda.MIN1, wordb.MIN2));
+            if(idx < 0) {
+                LOG_WARNING("no voice channel free for MIN=%s; sending reorder", reqmin.c_str());
+                journal_event(JOURNAL_ORIGINATION, &worda, &wordb, worda.S, esn, dialed, -1, true);
+                send_order(worda, wordb, ORDER_REORDER);
+                return;
+            }
+            journal_event(JOURNAL_ORIGINATION, &worda, &wordb, worda.S, esn, dialed, idx, false);
+            const voice_channel &vc = d_pool[idx];
+            focc_word2_voice_channel(word2, vc.scc, wordb.MIN2, vc.vmac, vc.chan);
+            publish_call_event("origination", pack_min(worda.MIN1, wordb.MIN2), idx);
         }
 
-        pmt::pmt_t tuple = pmt::make_tuple(pmt::from_long(stream), pmt::from_long(2), pmt::mp(word1, 28), pmt::mp(word2, 28));
-        message_port_pub(pmt::mp("focc_words"), tuple);
+        publish_focc_words(stream, word1, word2);
 
         // XXX: unmute the audio
         message_port_pub(pmt::mp("fvc_mute"), pmt::from_bool(true));
@@ -278,6 +665,38 @@ namespace gr {
     {
     }
 
+    bool
+    recc_decode_impl::start() {
+        d_finished = false;
+        if(d_journal) {
+            d_journal_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&recc_decode_impl::journal_flusher, this)));
+        }
+        return block::start();
+    }
+
+    bool
+    recc_decode_impl::stop() {
+        {
+            boost::mutex::scoped_lock lock(d_journal_mutex);
+            d_finished = true;
+        }
+        d_journal_cond.notify_one();
+        if(d_journal_thread) {
+            d_journal_thread->join();
+            d_journal_thread.reset();
+        }
+        return block::stop();
+    }
+
+    void
+    recc_decode_impl::journal_flusher() {
+        boost::mutex::scoped_lock lock(d_journal_mutex);
+        while(d_finished == false) {
+            d_journal_cond.timed_wait(lock, boost::posix_time::seconds(1));
+            d_journal->flush();
+        }
+    }
+
     void
     recc_decode_impl::forecast (int noutput_items, gr_vector_int &ninput_items_required)
     {
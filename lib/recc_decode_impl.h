@@ -11,23 +11,106 @@
 #include <itpp/comm/bch.h>
 #include <amps/recc_decode.h>
 #include "amps_packet.h"
+#include "subscriber_registry.h"
+#include "voice_channel_pool.h"
+#include "event_journal.h"
+#include "block_profiler.h"
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/unordered_map.hpp>
+#include <string>
 
 using namespace itpp;
 
 namespace gr {
   namespace amps {
 
-    class recc_decode_impl : public recc_decode
+    // Running totals of what the decoder has seen.
+    struct recc_decode_stats {
+        uint64_t bursts;
+        uint64_t bad_word_a;        // Word A failed BCH on every repeat
+        uint64_t rejected;          // decoded, but malformed (E=0, bad NAWC)
+        uint64_t registrations;
+        uint64_t originations;
+        uint64_t page_responses;
+        uint64_t unknown;
+        uint64_t duplicates;        // retries answered by an answer still on its way
+    };
+
+    /*
+     * A recently answered message, so a retry of it can be recognized.  If
+     * our answer hasn't gone out on the FOCC yet, the retry is dropped
+     * rather than queueing a second answer behind the first.
+     */
+    struct recent_seizure {
+        uint64_t expires_ns;
+        uint64_t answered_ns;
+        uint64_t trace_id;          // trace of the burst we answered
+        bool sent;                  // the FOCC has started sending the answer
+        unsigned int retries;
+    };
+
+    // Exported for the replay harness (apps/amps_replay.cc).
+    class AMPS_API recc_decode_impl : public recc_decode
     {
      private:
          itpp::BCH bch;
+         subscriber_registry::sptr d_registry;
+         voice_channel_pool d_pool;
+         unsigned short d_sid;       // the FOCC's SID, as last heard on overhead
+         boost::scoped_ptr<event_journal> d_journal;
+
+         // The journal publishes records in batches as they're committed;
+         // this thread publishes whatever is left once a second, so the
+         // last records of a burst of traffic don't wait for the next one.
+         boost::mutex d_journal_mutex;
+         boost::condition_variable d_journal_cond;
+         bool d_finished;
+         boost::shared_ptr<boost::thread> d_journal_thread;
 
-         bool recc_bch_decode(const unsigned char *srcbuf, unsigned char *dstbuf);
+         // Decode statistics for the burst being handled, for the journal.
+         uint8_t d_bch_fails[7];
+         uint16_t d_manchester_errs[7];
+         recc_decode_stats d_stats;
+         uint64_t d_stats_ns;        // when d_stats was last posted
+
+         // Duplicate seizure suppression, keyed by MIN, message type and
+         // dialed digits.  The FOCC block's latency output, connected to
+         // focc_sent, tells us which answers have gone out.
+         const uint64_t d_dup_ttl_ns;
+         boost::unordered_map<std::string, recent_seizure> d_recent;
+         boost::unordered_map<uint64_t, std::string> d_recent_by_trace;
+         bool d_have_sent_feedback;
+         uint64_t d_recent_sweep_ns;
+
+         // Trace metadata of the burst being handled; it rides along on
+         // whatever we send the FOCC in response.
+         pmt::pmt_t d_trace;
+
+         // Message handler timing (see block_profiler.h)
+         block_profiler d_profiler;
+         const int d_prof_bursts;
+
+         int assign_channel(uint64_t min);
+         void publish_channel_state(int idx);
+         void publish_call_event(const char *event, uint64_t min, int idx);
+         void journal_event(journal_event_type type, const recc_word_a *worda, const recc_word_b *wordb,
+                 bool has_esn, unsigned long esn, const std::string &dialed, int idx, bool blocked);
+         void send_order(const recc_word_a &worda, const recc_word_b &wordb, unsigned char order);
+         void publish_focc_words(long stream, const unsigned char *word1, const unsigned char *word2);
+         void publish_stats(uint64_t now);
+         bool duplicate_seizure(uint64_t min, char type, const std::string &digits);
+         void journal_flusher();
 
      public:
-      recc_decode_impl();
+      recc_decode_impl(const std::string &registry_path, int first_chan, int nchans, const std::vector<int> &scc, int vmac, const std::string &journal_prefix, double dup_ttl);
       ~recc_decode_impl();
 
+      bool start();
+      bool stop();
+
       // Where all the action really happens
       void forecast (int noutput_items, gr_vector_int &ninput_items_required);
 
@@ -37,6 +120,12 @@ namespace gr {
            gr_vector_void_star &output_items);
 
       void bursts_message(pmt::pmt_t msg);
+      const recc_decode_stats &stats() const { return d_stats; }
+      void voice_events_message(pmt::pmt_t msg);
+      void focc_sent_message(pmt::pmt_t msg);
+      void occupancy_message(pmt::pmt_t msg);
+      void overhead_message(pmt::pmt_t msg);
+      void profile_query_message(pmt::pmt_t msg);
       void handle_origination(recc_word_a &worda, recc_word_b &wordb, unsigned long esn, std::string dialed);
       void handle_response(const recc_word_a &worda, const recc_word_b &wordb);
       void handle_registration(recc_word_a &worda, recc_word_b &wordb, std::string reqmin, bool has_esn, unsigned long esn);
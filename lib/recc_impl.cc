@@ -11,6 +11,7 @@
 #include <gnuradio/io_signature.h>
 #include "recc_impl.h"
 #include <string.h>
+#include <math.h>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -65,21 +66,27 @@ namespace gr {
         }
 
         recc_impl::recc_impl()
-          : d_symbufsz(65536), d_symbuflen(0),
-          d_windowsz(4096), d_curstart(NULL), 
-          capture_len(3374),    // figure 2.7.1-1; (DCC (7 bits) + up to 7 words of 240 bits each) * 2 syms/bit = 3374 symbols
-          sync_block("recc",
+          : sync_block("recc",
                   io_signature::make(1, 1, sizeof (unsigned char)),
-                  io_signature::make(0, 0, 0))
+                  io_signature::make(0, 0, 0)),
+          d_symbufsz(65536), d_symbuflen(0),
+          d_curstart(NULL), d_windowsz(4096),
+          capture_len(3374),    // figure 2.7.1-1; (DCC (7 bits) + up to 7 words of 240 bits each) * 2 syms/bit = 3374 symbols
+          d_nsyms(0), d_have_rx_time(false), d_rx_time_offset(0), d_rx_time_secs(0), d_rx_time_frac(0.0),
+          d_profiler("recc"), d_prof_work(d_profiler.add_site("work"))
         {
             d_symbuf = new unsigned char[d_symbufsz]();
             const char *trigbuf = "1010101010101010101010101011100010010";
             trigger_len = strlen(trigbuf) * 2;
             trigger_data = new unsigned char[trigger_len]();
             manchester_encode(trigbuf, strlen(trigbuf), trigger_data);
-            XXXbitcount = 0;
 
             message_port_register_out(pmt::mp("bursts"));
+            message_port_register_in(pmt::mp("profile_query"));
+            set_msg_handler(pmt::mp("profile_query"),
+                boost::bind(&recc_impl::profile_query_message, this, _1)
+            );
+            message_port_register_out(pmt::mp("profile"));
         }
 
         recc_impl::~recc_impl()
@@ -90,27 +97,56 @@ namespace gr {
 
 
 
-        int
-        recc_impl::work(int noutput_items,
-                  gr_vector_const_void_star &input_items,
-                  gr_vector_void_star &output_items) {
-            const unsigned char *in = (const unsigned char *)input_items[0];
+        void recc_impl::publish_burst(pmt::pmt_t burst) {
+            message_port_pub(pmt::mp("bursts"), burst);
+        }
 
-            if(noutput_items < 1) {
-                printf("XXX noutput_items is %d\n", noutput_items);
-                return 0;
+        void
+        recc_impl::profile_query_message(pmt::pmt_t msg) {
+            message_port_pub(pmt::mp("profile"), d_profiler.query(msg));
+        }
+
+        /*
+         * Metadata for a burst whose first symbol (just past the seizure
+         * precursor) is symbol number offset: a new trace ID, when we found
+         * it, and -- if the source tags rx_time -- when it was received on
+         * the source's clock.
+         */
+        pmt::pmt_t recc_impl::burst_meta(uint64_t offset) {
+            pmt::pmt_t meta = pmt::make_dict();
+            meta = pmt::dict_add(meta, pmt::mp("trace_id"), pmt::from_uint64(next_trace_id()));
+            meta = pmt::dict_add(meta, pmt::mp("offset"), pmt::from_uint64(offset));
+            meta = pmt::dict_add(meta, pmt::mp("detect_ns"), pmt::from_uint64(monotonic_ns()));
+            if(d_have_rx_time) {
+                const double delta = ((double)offset - (double)d_rx_time_offset) / 20000.0;
+                double whole = floor(d_rx_time_frac + delta);
+                const uint64_t secs = d_rx_time_secs + (int64_t)whole;
+                meta = pmt::dict_add(meta, pmt::mp("rx_time"),
+                        pmt::make_tuple(pmt::from_uint64(secs), pmt::from_double(d_rx_time_frac + delta - whole)));
             }
+            return meta;
+        }
+
+        /*
+         * Append symbols to the search buffer and publish any bursts that
+         * are complete.  This is all of work() except the scheduler
+         * bookkeeping, so it can be driven directly (see apps/amps_replay.cc).
+         */
+        void
+        recc_impl::search(const unsigned char *in, size_t nsyms) {
+            const int noutput_items = nsyms;
             assert(noutput_items < (d_symbufsz-d_windowsz));     // if this fails, just make the bufsz values bigger
             if((d_symbuflen + noutput_items) > d_symbufsz) {
-                memmove(d_symbuf, &d_symbuf[d_symbufsz - d_windowsz], d_windowsz);
+                // keep the newest d_windowsz symbols
+                memmove(d_symbuf, &d_symbuf[d_symbuflen - d_windowsz], d_windowsz);
                 d_symbuflen = d_windowsz;
                 d_curstart = NULL;
             }
             assert((d_symbuflen + noutput_items) <= d_symbufsz);
             memmove(&d_symbuf[d_symbuflen], in, noutput_items);
             d_symbuflen += noutput_items;
+            d_nsyms += noutput_items;
 
-            consume_each(noutput_items);
             if(d_symbuflen > trigger_len) {
                 size_t searchsz = MIN(d_symbuflen, (noutput_items + trigger_len - 1));
                 assert(searchsz <= d_symbufsz && searchsz <= d_symbuflen);
@@ -120,27 +156,47 @@ namespace gr {
 
                 if(d_curstart != NULL) {
                     ptrdiff_t startoff = (d_curstart - d_symbuf);
-                    //busy_idle_bit = 0;
                     ptrdiff_t capturedsyms = d_symbuflen - startoff - trigger_len;
                     if(capturedsyms > capture_len) {
-                        message_port_pub(pmt::mp("bursts"), pmt::mp(&d_curstart[trigger_len], capture_len));
-                        // XXX XXX XXX: REMOVE LEAK
-                        printf("XXX YO GOT IT off %tu  d_symbuflen %zu  capturedsyms %tu  trigger_len %zu   bit @%lu  d_symbuf %p  noutput_items %d  trigger_len %lu  searchsz %lu\n", startoff, d_symbuflen, capturedsyms, trigger_len, XXXbitcount, d_symbuf, noutput_items, trigger_len, searchsz);
-                        ptrdiff_t tomove = d_symbuflen - (capturedsyms + trigger_len);
-                        assert(tomove >= 0);
-                        if(tomove > 0) {
-                            memmove(d_symbuf, &d_symbuf[(capturedsyms + trigger_len)], tomove);
-                        }
-                        d_symbuflen -= tomove;
+                        const uint64_t offset = d_nsyms - d_symbuflen + startoff + trigger_len;
+                        pmt::pmt_t blob = pmt::make_blob(&d_curstart[trigger_len], capture_len);
+                        publish_burst(pmt::cons(burst_meta(offset), blob));
+                        LOG_DEBUG("RECC burst: off %td capturedsyms %td symbol %llu", startoff, capturedsyms, (unsigned long long)offset);
+                        // drop everything up to the end of the burst
+                        const size_t consumed = startoff + trigger_len + capture_len;
+                        memmove(d_symbuf, &d_symbuf[consumed], d_symbuflen - consumed);
+                        d_symbuflen -= consumed;
                         d_curstart = NULL;
-                        //printout(trigger_data, trigger_len);
-                        //printout(start, trigger_len);
                     }
                 }
             }
+        }
 
-            XXXbitcount += noutput_items;
+        int
+        recc_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            const unsigned char *in = (const unsigned char *)input_items[0];
+            profile_scope prof(d_profiler, d_prof_work);
+            prof.set_budget((noutput_items * 1000000000ULL) / 20000);
 
+            if(noutput_items < 1) {
+                LOG_WARNING("noutput_items is %d", noutput_items);
+                return 0;
+            }
+            d_tags.clear();
+            get_tags_in_range(d_tags, 0, nitems_read(0), nitems_read(0) + noutput_items, pmt::mp("rx_time"));
+            if(d_tags.empty() == false) {
+                const gr::tag_t &tag = d_tags.back();
+                if(pmt::is_tuple(tag.value) && pmt::length(tag.value) == 2) {
+                    d_rx_time_secs = pmt::to_uint64(pmt::tuple_ref(tag.value, 0));
+                    d_rx_time_frac = pmt::to_double(pmt::tuple_ref(tag.value, 1));
+                    d_rx_time_offset = tag.offset;
+                    d_have_rx_time = true;
+                }
+            }
+            search(in, noutput_items);
+            consume_each(noutput_items);
             return 0;
         }
 
@@ -9,7 +9,9 @@
 
 #include <amps/recc.h>
 #include <queue>
+#include <vector>
 #include "amps_common.h"
+#include "block_profiler.h"
 
 using std::string;
 using boost::shared_ptr;
@@ -25,7 +27,8 @@ using boost::shared_ptr;
 namespace gr {
   namespace amps {
       
-    class recc_impl : public recc
+    // Exported for the replay harness (apps/amps_replay.cc).
+    class AMPS_API recc_impl : public recc
     {
     private:
         size_t d_symbufsz;          // size of d_symbuf
@@ -40,11 +43,32 @@ namespace gr {
         size_t capture_len;         // length of symbols to capture after the trigger sequence
         size_t trigger_len;         // length of trigger buffer in bytes
         unsigned char *trigger_data;
-        unsigned long XXXbitcount;
+
+        // Symbol clock: d_nsyms symbols have been searched so far, so
+        // d_symbuf[i] is symbol (d_nsyms - d_symbuflen + i).  The last
+        // rx_time tag seen pins a symbol to the source's clock.
+        uint64_t d_nsyms;
+        bool d_have_rx_time;
+        uint64_t d_rx_time_offset;
+        uint64_t d_rx_time_secs;
+        double d_rx_time_frac;
+        std::vector<gr::tag_t> d_tags;
+
+        pmt::pmt_t burst_meta(uint64_t offset);
+
+        // work() and message handler timing (see block_profiler.h)
+        block_profiler d_profiler;
+        const int d_prof_work;
+
+    protected:
+        virtual void publish_burst(pmt::pmt_t burst);
 
     public:
       recc_impl();
-      ~recc_impl();
+      virtual ~recc_impl();
+
+        void search(const unsigned char *in, size_t nsyms);
+        void profile_query_message(pmt::pmt_t msg);
 
         int work(int noutput_items,
            gr_vector_const_void_star &input_items,
@@ -0,0 +1,276 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "registration_control_impl.h"
+#include <algorithm>
+#include <stdexcept>
+#include <math.h>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    // REGINCR is only changed when the smoothed registration rate is off
+    // target by more than this factor either way, and then by at most a
+    // factor of REG_MAX_STEP at a time.
+    static const double REG_DEADBAND = 1.25;
+    static const double REG_MAX_STEP = 2.0;
+    static const double REG_SMOOTHING = 0.3;
+
+    registration_control::sptr
+    registration_control::make(double regid_period, double target_rate, int regincr,
+            int min_regincr, int max_regincr, double max_collisions, double report_interval) {
+        return gnuradio::get_initial_sptr (new registration_control_impl(regid_period, target_rate, regincr,
+                    min_regincr, max_regincr, max_collisions, report_interval));
+    }
+
+    registration_control_impl::registration_control_impl(double regid_period, double target_rate, int regincr,
+            int min_regincr, int max_regincr, double max_collisions, double report_interval)
+      : gr::block("registration_control",
+              gr::io_signature::make(0, 0, 0),
+              gr::io_signature::make(0, 0, 0)),
+        d_regid_period_ns(regid_period * 1e9), d_target_rate(target_rate),
+        d_min_regincr(min_regincr), d_max_regincr(max_regincr), d_max_collisions(max_collisions),
+        d_report_ns(report_interval * 1e9), d_regid(0), d_regincr(regincr), d_rate_avg(-1),
+        d_last_regs(0), d_last_bursts(0), d_last_bad(0), d_last_ns(0),
+        d_have_stats(false), d_regs(0), d_bursts(0), d_bad(0), d_reg_off(false), d_reg_was_off(false),
+        d_finished(false)
+    {
+        if(regid_period <= 0 || report_interval <= 0) {
+            throw std::invalid_argument("registration_control: periods must be positive");
+        }
+        if(target_rate <= 0) {
+            throw std::invalid_argument("registration_control: target_rate must be positive");
+        }
+        if(min_regincr < 1 || max_regincr > 4095 || min_regincr > max_regincr
+                || regincr < min_regincr || regincr > max_regincr) {
+            throw std::invalid_argument("registration_control: need 1 <= min_regincr <= regincr <= max_regincr <= 4095");
+        }
+        if(max_collisions <= 0 || max_collisions > 1) {
+            throw std::invalid_argument("registration_control: max_collisions must be in (0, 1]");
+        }
+        message_port_register_in(pmt::mp("decode_stats"));
+        set_msg_handler(pmt::mp("decode_stats"),
+            boost::bind(&registration_control_impl::decode_stats_message, this, _1)
+        );
+        message_port_register_in(pmt::mp("overload"));
+        set_msg_handler(pmt::mp("overload"),
+            boost::bind(&registration_control_impl::overload_message, this, _1)
+        );
+        message_port_register_out(pmt::mp("overhead"));
+        message_port_register_out(pmt::mp("stats"));
+    }
+
+    registration_control_impl::~registration_control_impl()
+    {
+    }
+
+    bool
+    registration_control_impl::start() {
+        d_finished = false;
+        d_thread = boost::shared_ptr<boost::thread>(new boost::thread(boost::bind(&registration_control_impl::run, this)));
+        return block::start();
+    }
+
+    bool
+    registration_control_impl::stop() {
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            d_finished = true;
+        }
+        d_cond.notify_one();
+        if(d_thread) {
+            d_thread->join();
+            d_thread.reset();
+        }
+        return block::stop();
+    }
+
+    // Running totals from the RECC Decode block; see recc_decode_impl::publish_stats().
+    void
+    registration_control_impl::decode_stats_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            LOG_WARNING("registration_control: ignoring decode stats that aren't a dict");
+            return;
+        }
+        pmt::pmt_t regs = pmt::dict_ref(msg, pmt::mp("registrations"), pmt::PMT_NIL);
+        pmt::pmt_t bursts = pmt::dict_ref(msg, pmt::mp("bursts"), pmt::PMT_NIL);
+        pmt::pmt_t bad = pmt::dict_ref(msg, pmt::mp("bad_word_a"), pmt::PMT_NIL);
+        if(pmt::is_uint64(regs) == false || pmt::is_uint64(bursts) == false || pmt::is_uint64(bad) == false) {
+            LOG_WARNING("registration_control: ignoring incomplete decode stats");
+            return;
+        }
+        boost::mutex::scoped_lock lock(d_mutex);
+        d_regs = pmt::to_uint64(regs);
+        d_bursts = pmt::to_uint64(bursts);
+        d_bad = pmt::to_uint64(bad);
+        d_have_stats = true;
+    }
+
+    /*
+     * The Overload Control block's overhead changes.  While it has
+     * registration turned off, the registration rate says nothing about
+     * REGINCR, so adjust() leaves it alone.
+     */
+    void
+    registration_control_impl::overload_message(pmt::pmt_t msg) {
+        if(pmt::is_dict(msg) == false) {
+            return;
+        }
+        pmt::pmt_t regh = pmt::dict_ref(msg, pmt::mp("regh"), pmt::PMT_NIL);
+        pmt::pmt_t regr = pmt::dict_ref(msg, pmt::mp("regr"), pmt::PMT_NIL);
+        if(pmt::is_bool(regh) == false && pmt::is_bool(regr) == false) {
+            return;
+        }
+        const bool off = (pmt::is_bool(regh) == false || pmt::to_bool(regh) == false)
+            && (pmt::is_bool(regr) == false || pmt::to_bool(regr) == false);
+        boost::mutex::scoped_lock lock(d_mutex);
+        if(off && d_reg_off == false) {
+            LOG_INFO("registration control: registration is off; holding REGINCR");
+        }
+        d_reg_off = off;
+        if(off) {
+            d_reg_was_off = true;
+        }
+    }
+
+    void
+    registration_control_impl::publish_overhead(bool with_regincr) {
+        pmt::pmt_t d = pmt::make_dict();
+        d = pmt::dict_add(d, pmt::mp("regid"), pmt::from_long(d_regid));
+        if(with_regincr) {
+            d = pmt::dict_add(d, pmt::mp("regincr"), pmt::from_long(d_regincr));
+        }
+        message_port_pub(pmt::mp("overhead"), d);
+    }
+
+    /*
+     * Once per report interval: measure the registration and collision
+     * rates since last time, and move REGINCR toward the value that would
+     * bring the registration rate to the target.  Each mobile registers
+     * once every REGINCR REGID steps, so the rate goes as 1/REGINCR; a
+     * mobile only picks up a new REGINCR when it next registers, though,
+     * hence the smoothing, dead band and step limit.
+     *
+     * Intervals in which registration was off (see overload_message()) are
+     * skipped, and the average starts over once it's back on; otherwise
+     * the near-zero rate would drive REGINCR to its minimum, and every
+     * mobile would come back at once.
+     */
+    void
+    registration_control_impl::adjust(uint64_t now) {
+        uint64_t regs, bursts, bad;
+        bool have, was_off;
+        {
+            boost::mutex::scoped_lock lock(d_mutex);
+            have = d_have_stats;
+            regs = d_regs;
+            bursts = d_bursts;
+            bad = d_bad;
+            was_off = d_reg_was_off;
+            d_reg_was_off = d_reg_off;
+        }
+        if(have == false) {
+            return;
+        }
+        if(d_last_ns == 0 || was_off || regs < d_last_regs || bursts < d_last_bursts) {
+            // first totals, registration was off, or the decoder started over
+            if(was_off) {
+                d_rate_avg = -1;
+            }
+            d_last_regs = regs;
+            d_last_bursts = bursts;
+            d_last_bad = bad;
+            d_last_ns = now;
+            return;
+        }
+        const double secs = (now - d_last_ns) / 1e9;
+        const double rate = (regs - d_last_regs) / secs;
+        const uint64_t nbursts = bursts - d_last_bursts;
+        const double collisions = (nbursts > 0) ? (double)(bad - d_last_bad) / nbursts : 0.0;
+        d_last_regs = regs;
+        d_last_bursts = bursts;
+        d_last_bad = bad;
+        d_last_ns = now;
+        d_rate_avg = (d_rate_avg < 0) ? rate : ((1.0 - REG_SMOOTHING) * d_rate_avg) + (REG_SMOOTHING * rate);
+
+        // Shed registrations in proportion when the channel is colliding.
+        double target = d_target_rate;
+        if(collisions > d_max_collisions) {
+            target *= d_max_collisions / collisions;
+        }
+        bool changed = false;
+        if(d_rate_avg > 0) {
+            double ratio = d_rate_avg / target;
+            if(ratio > REG_DEADBAND || ratio < (1.0 / REG_DEADBAND)) {
+                ratio = std::max(1.0 / REG_MAX_STEP, std::min(REG_MAX_STEP, ratio));
+                long regincr = lround(d_regincr * ratio);
+                regincr = std::max((long)d_min_regincr, std::min((long)d_max_regincr, regincr));
+                if(regincr != (long)d_regincr) {
+                    LOG_INFO("registration control: %.2f registrations/s (target %.2f, %.1f%% collisions); REGINCR %u -> %ld",
+                            d_rate_avg, target, collisions * 100.0, d_regincr, regincr);
+                    d_regincr = regincr;
+                    changed = true;
+                }
+            }
+        }
+        if(changed) {
+            publish_overhead(true);
+        }
+
+        pmt::pmt_t d = pmt::make_dict();
+        d = pmt::dict_add(d, pmt::mp("regid"), pmt::from_long(d_regid));
+        d = pmt::dict_add(d, pmt::mp("regincr"), pmt::from_long(d_regincr));
+        d = pmt::dict_add(d, pmt::mp("reg_rate"), pmt::from_double(rate));
+        d = pmt::dict_add(d, pmt::mp("reg_rate_avg"), pmt::from_double(d_rate_avg));
+        d = pmt::dict_add(d, pmt::mp("target_rate"), pmt::from_double(target));
+        d = pmt::dict_add(d, pmt::mp("collisions"), pmt::from_double(collisions));
+        message_port_pub(pmt::mp("stats"), d);
+    }
+
+    /*
+     * Controller thread: step REGID every period (the FOCC block swaps the
+     * new value in at its next superframe), and adjust REGINCR every report
+     * interval.
+     */
+    void
+    registration_control_impl::run() {
+        uint64_t now = monotonic_ns();
+        uint64_t next_step = now + d_regid_period_ns;
+        uint64_t next_adjust = now + d_report_ns;
+        publish_overhead(true);
+        while(true) {
+            {
+                boost::mutex::scoped_lock lock(d_mutex);
+                const uint64_t wake = std::min(next_step, next_adjust);
+                now = monotonic_ns();
+                if(d_finished == false && wake > now) {
+                    d_cond.timed_wait(lock, boost::posix_time::microseconds((wake - now) / 1000));
+                }
+                if(d_finished) {
+                    break;
+                }
+            }
+            now = monotonic_ns();
+            if(now >= next_adjust) {
+                adjust(now);
+                next_adjust += d_report_ns;
+            }
+            if(now >= next_step) {
+                d_regid = (d_regid + 1) & 0xfffff;
+                publish_overhead(false);
+                next_step += d_regid_period_ns;
+            }
+        }
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,69 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_REGISTRATION_CONTROL_IMPL_H
+#define INCLUDED_AMPS_REGISTRATION_CONTROL_IMPL_H
+
+#include <amps/registration_control.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    class registration_control_impl : public registration_control
+    {
+    private:
+        const uint64_t d_regid_period_ns;
+        const double d_target_rate;
+        const unsigned int d_min_regincr;
+        const unsigned int d_max_regincr;
+        const double d_max_collisions;
+        const uint64_t d_report_ns;
+
+        // Owned by the controller thread.
+        unsigned long d_regid;
+        unsigned int d_regincr;
+        double d_rate_avg;              // smoothed registrations per second; < 0 until measured
+        uint64_t d_last_regs;           // decoder totals at the last adjustment
+        uint64_t d_last_bursts;
+        uint64_t d_last_bad;
+        uint64_t d_last_ns;
+
+        // Latest decoder totals, from the message handler.
+        boost::mutex d_mutex;
+        boost::condition_variable d_cond;
+        bool d_have_stats;
+        uint64_t d_regs;
+        uint64_t d_bursts;
+        uint64_t d_bad;
+        bool d_reg_off;                 // Overload Control has REGH and REGR off
+        bool d_reg_was_off;             // ...or did at some point since the last adjustment
+        bool d_finished;
+        boost::shared_ptr<boost::thread> d_thread;
+
+        void run();
+        void publish_overhead(bool with_regincr);
+        void adjust(uint64_t now);
+
+    public:
+        registration_control_impl(double regid_period, double target_rate, int regincr,
+                int min_regincr, int max_regincr, double max_collisions, double report_interval);
+        ~registration_control_impl();
+
+        bool start();
+        bool stop();
+
+        void decode_stats_message(pmt::pmt_t msg);
+        void overload_message(pmt::pmt_t msg);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_REGISTRATION_CONTROL_IMPL_H */
@@ -0,0 +1,229 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "rvc_data_impl.h"
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+#include "utils.h"
+
+using std::vector;
+using std::string;
+
+namespace gr {
+    namespace amps {
+
+        /*
+         * RVC message layout (553 2.7.2): 101 bits of dotting and 11 bits of
+         * word sync, then the first repeat of word 1 (48 bits).  Every
+         * following repeat -- five per word -- is preceded by 37 bits of
+         * dotting and another word sync.  Everything below counts symbols
+         * (two per bit).
+         */
+        static const size_t RVC_WORD_SYMS = 48 * 2;
+        static const size_t RVC_GAP_SYMS = (37 + 11) * 2;
+        static const size_t RVC_REPEATS = 5;
+        static const size_t RVC_REPEAT_STRIDE = RVC_WORD_SYMS + RVC_GAP_SYMS;
+        static const size_t RVC_WORD_SPAN = (RVC_REPEATS * RVC_WORD_SYMS) + ((RVC_REPEATS - 1) * RVC_GAP_SYMS);
+
+        rvc_data::sptr
+        rvc_data::make(double samp_rate, int chan) {
+            return gnuradio::get_initial_sptr (new rvc_data_impl(samp_rate, chan));
+        }
+
+        rvc_data_impl::rvc_data_impl(double samp_rate, int chan)
+          : sync_block("rvc_data",
+                  io_signature::make(1, 1, sizeof (float)),
+                  io_signature::make(0, 0, 0)),
+          bch(63, 2, true), samples_per_sym(samp_rate / 20000), d_chan(chan),
+          d_sampnum(0), d_first_match(-1), d_nmatch(0),
+          d_locked(false), d_phase(0), d_need(0), d_bad_repeats(0)
+        {
+            if(samples_per_sym < 1 || (samples_per_sym * 20000) != samp_rate) {
+                throw std::invalid_argument("rvc_data: sample rate must be a multiple of 20 kHz");
+            }
+
+            // Last 40 bits of dotting, then word sync.  Every repeat after
+            // the first is preceded by only 37 bits of dotting, so this only
+            // matches the start of a message, never a later repeat.
+            // Manchester: 0 -> 10, 1 -> 01.
+            const char *trigbits = "0101010101" "0101010101" "0101010101" "0101010101" "11100010010";
+            d_trigger_hi = d_trigger_lo = 0;
+            d_trigger_mask_hi = d_trigger_mask_lo = 0;
+            for(const char *c = trigbits; *c != 0; c++) {
+                const uint64_t pair = (*c == '1') ? 0x1 : 0x2;
+                d_trigger_hi = (d_trigger_hi << 2) | (d_trigger_lo >> 62);
+                d_trigger_lo = (d_trigger_lo << 2) | pair;
+                d_trigger_mask_hi = (d_trigger_mask_hi << 2) | (d_trigger_mask_lo >> 62);
+                d_trigger_mask_lo = (d_trigger_mask_lo << 2) | 0x3;
+            }
+            d_shift_hi.assign(samples_per_sym, 0);
+            d_shift.assign(samples_per_sym, 0);
+            d_capture.reserve(RVC_WORD_SPAN * 2 + RVC_GAP_SYMS);
+
+            message_port_register_out(pmt::mp("messages"));
+        }
+
+        rvc_data_impl::~rvc_data_impl()
+        {
+        }
+
+        void
+        rvc_data_impl::reset() {
+            d_locked = false;
+            d_first_match = -1;
+            d_nmatch = 0;
+            d_capture.clear();
+            d_words.clear();
+            d_need = 0;
+            d_bad_repeats = 0;
+            std::fill(d_shift_hi.begin(), d_shift_hi.end(), 0);
+            std::fill(d_shift.begin(), d_shift.end(), 0);
+        }
+
+        /*
+         * Decode one word from its five repeats.  The repeats are combined
+         * with a bitwise 3-of-5 majority vote first; if that doesn't pass
+         * BCH, fall back to the first repeat that does on its own.
+         */
+        bool
+        rvc_data_impl::decode_word(const unsigned char *syms, unsigned char *outbits) {
+            unsigned char repeats[RVC_REPEATS][48];
+            unsigned char votes[48];
+            memset(votes, 0, sizeof(votes));
+            for(size_t r = 0; r < RVC_REPEATS; r++) {
+                manchester_decode_binbuf(&syms[r * RVC_REPEAT_STRIDE], repeats[r], 48);
+                for(int i = 0; i < 48; i++) {
+                    votes[i] += repeats[r][i];
+                }
+            }
+            unsigned char majority[48];
+            for(int i = 0; i < 48; i++) {
+                majority[i] = (votes[i] > (RVC_REPEATS / 2)) ? 1 : 0;
+            }
+            if(bch_decode_48(bch, majority, outbits) == true) {
+                return true;
+            }
+            for(size_t r = 0; r < RVC_REPEATS; r++) {
+                if(bch_decode_48(bch, repeats[r], outbits) == true) {
+                    return true;
+                }
+                d_bad_repeats++;
+            }
+            return false;
+        }
+
+        /*
+         * Enough symbols have been captured for another word.  Decode it, and
+         * either extend the capture for the next word (per NAWC) or post the
+         * finished message.
+         */
+        void
+        rvc_data_impl::word_captured() {
+            vector<unsigned char> word(36);
+            if(decode_word(&d_capture[d_need - RVC_WORD_SPAN], &word[0]) == false) {
+                LOG_DEBUG("RVC word %zu failed to decode", d_words.size()+1);
+                reset();
+                return;
+            }
+            d_words.push_back(word);
+            rvc_word first(&d_words[0][0]);
+            if(first.F == false) {
+                LOG_DEBUG("RVC message without F set on its first word; dropping");
+                reset();
+                return;
+            }
+            if(d_words.size() < (size_t)(1 + first.NAWC)) {
+                d_need += RVC_GAP_SYMS + RVC_WORD_SPAN;
+                return;
+            }
+            post_message();
+            reset();
+        }
+
+        void
+        rvc_data_impl::post_message() {
+            rvc_word first(&d_words[0][0]);
+            pmt::pmt_t msg = pmt::make_dict();
+            if(first.T == true) {
+                rvc_word_order order(&d_words[0][0]);
+                LOG_DEBUG("RVC order confirmation: LOCAL 0x%hhx ORDQ 0x%hhx ORDER 0x%hhx", order.LOCAL, order.ORDQ, order.ORDER);
+                msg = pmt::dict_add(msg, pmt::mp("type"), pmt::mp("order_confirmation"));
+                msg = pmt::dict_add(msg, pmt::mp("local"), pmt::from_long(order.LOCAL));
+                msg = pmt::dict_add(msg, pmt::mp("ordq"), pmt::from_long(order.ORDQ));
+                msg = pmt::dict_add(msg, pmt::mp("order"), pmt::from_long(order.ORDER));
+            } else {
+                string digits = "";
+                for(size_t i = 0; i < d_words.size(); i++) {
+                    recc_word_called called(&d_words[i][0]);
+                    digits = digits + called.digits();
+                }
+                LOG_DEBUG("RVC called address: %s", digits.c_str());
+                msg = pmt::dict_add(msg, pmt::mp("type"), pmt::mp("called_address"));
+                msg = pmt::dict_add(msg, pmt::mp("digits"), pmt::mp(digits));
+            }
+            msg = pmt::dict_add(msg, pmt::mp("bad_repeats"), pmt::from_long(d_bad_repeats));
+            if(d_chan >= 0) {
+                msg = pmt::dict_add(msg, pmt::mp("chan"), pmt::from_long(d_chan));
+            }
+            message_port_pub(pmt::mp("messages"), msg);
+        }
+
+        /*
+         * Hard-slice the audio and search for the trigger on every sampling
+         * phase at once.  Adjacent phases usually all see it; we lock onto the
+         * middle one of the run, which is closest to the center of the eye.
+         */
+        int
+        rvc_data_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            const float *in = (const float *)input_items[0];
+
+            for(int i = 0; i < noutput_items; i++) {
+                const unsigned int phase = d_sampnum;
+                const unsigned char bit = (in[i] > 0.0f) ? 1 : 0;
+                d_sampnum = (d_sampnum + 1) % samples_per_sym;
+
+                if(d_locked) {
+                    if(phase == d_phase) {
+                        d_capture.push_back(bit);
+                        if(d_capture.size() == d_need) {
+                            word_captured();
+                        }
+                    }
+                    continue;
+                }
+
+                d_shift_hi[phase] = (d_shift_hi[phase] << 1) | (d_shift[phase] >> 63);
+                d_shift[phase] = (d_shift[phase] << 1) | bit;
+                const bool match = ((d_shift[phase] & d_trigger_mask_lo) == d_trigger_lo)
+                    && ((d_shift_hi[phase] & d_trigger_mask_hi) == d_trigger_hi);
+                if(match) {
+                    if(d_first_match < 0) {
+                        d_first_match = phase;
+                    }
+                    d_nmatch++;
+                }
+                if(d_first_match >= 0 && (match == false || d_nmatch == samples_per_sym)) {
+                    d_phase = (d_first_match + ((d_nmatch - 1) / 2)) % samples_per_sym;
+                    d_locked = true;
+                    d_need = RVC_WORD_SPAN;
+                    d_capture.clear();
+                    d_words.clear();
+                    d_bad_repeats = 0;
+                }
+            }
+            return noutput_items;
+        }
+
+    } /* namespace amps */
+} /* namespace gr */
@@ -0,0 +1,65 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_RVC_DATA_IMPL_H
+#define INCLUDED_AMPS_RVC_DATA_IMPL_H
+
+#include <amps/rvc_data.h>
+#include <itpp/comm/bch.h>
+#include <vector>
+#include "amps_packet.h"
+#include "amps_common.h"
+
+namespace gr {
+  namespace amps {
+
+    class rvc_data_impl : public rvc_data
+    {
+    private:
+        itpp::BCH bch;
+        const unsigned int samples_per_sym;
+        const int d_chan;               // FVC Bank channel, or -1
+
+        // Trigger: the tail of the dotting plus word sync, Manchester-encoded,
+        // packed into the low bits of a 128-bit shift register (hi:lo).
+        uint64_t d_trigger_hi;
+        uint64_t d_trigger_lo;
+        uint64_t d_trigger_mask_hi;
+        uint64_t d_trigger_mask_lo;
+
+        // While searching, one shift register per sampling phase.
+        std::vector<uint64_t> d_shift_hi;
+        std::vector<uint64_t> d_shift;
+        uint64_t d_sampnum;             // samples seen, mod samples_per_sym
+        int d_first_match;              // first phase to see the trigger, -1 if none yet
+        unsigned int d_nmatch;          // consecutive phases that have seen it
+
+        // Once triggered, symbols from the winning phase are captured here.
+        bool d_locked;
+        unsigned int d_phase;
+        std::vector<unsigned char> d_capture;
+        size_t d_need;                  // symbols needed before the next word can be decoded
+        std::vector<std::vector<unsigned char> > d_words;   // decoded 36-bit words
+        unsigned int d_bad_repeats;     // repeats that failed BCH on their own
+
+        void reset();
+        bool decode_word(const unsigned char *syms, unsigned char *outbits);
+        void word_captured();
+        void post_message();
+
+    public:
+        rvc_data_impl(double samp_rate, int chan);
+        ~rvc_data_impl();
+
+        int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_RVC_DATA_IMPL_H */
@@ -0,0 +1,189 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gnuradio/io_signature.h>
+#include "rvc_supervision_impl.h"
+#include <math.h>
+#include <stdexcept>
+#include <algorithm>
+#include "utils.h"
+
+using std::vector;
+
+namespace gr {
+    namespace amps {
+
+        static const double rvc_tone_freqs[RVC_NTONES] = { 5970.0, 6000.0, 6030.0, 10000.0 };
+
+        // Samples staged per pass through the Goertzel bank.
+        static const int RVC_CHUNK = 256;
+
+        rvc_supervision::sptr
+        rvc_supervision::make(double samp_rate, int nchans, float threshold, int debounce) {
+            return gnuradio::get_initial_sptr (new rvc_supervision_impl(samp_rate, nchans, threshold, debounce));
+        }
+
+        /*
+         * The analysis window is 50 ms, which gives 20 Hz bins -- enough to
+         * tell the three SAT frequencies (30 Hz apart) from each other.
+         */
+        rvc_supervision_impl::rvc_supervision_impl(double samp_rate, int nchans, float threshold, int debounce)
+          : sync_block("rvc_supervision",
+                  io_signature::make(nchans, nchans, sizeof (float)),
+                  io_signature::make(0, 0, 0)),
+          d_nchans(nchans), d_nlanes(nchans * RVC_NTONES), d_threshold(threshold),
+          d_debounce(MAX(debounce, 1)), d_window((int)(samp_rate * 0.05)), d_window_off(0)
+        {
+            if(nchans < 1) {
+                throw std::invalid_argument("rvc_supervision: need at least one channel");
+            }
+            if(samp_rate <= 2 * rvc_tone_freqs[RVC_TONE_ST]) {
+                throw std::invalid_argument("rvc_supervision: sample rate must be above 20 kHz to see ST");
+            }
+            d_coeff.resize(d_nlanes);
+            d_s1.assign(d_nlanes, 0.0);
+            d_s2.assign(d_nlanes, 0.0);
+            d_energy.assign(d_nchans, 0.0);
+            d_staging.resize(RVC_CHUNK * d_nlanes);
+            d_chans.resize(d_nchans);
+            for(int c = 0; c < d_nchans; c++) {
+                for(int t = 0; t < RVC_NTONES; t++) {
+                    d_coeff[c * RVC_NTONES + t] = 2.0 * cos(2.0 * M_PI * rvc_tone_freqs[t] / samp_rate);
+                }
+            }
+
+            message_port_register_out(pmt::mp("events"));
+        }
+
+        rvc_supervision_impl::~rvc_supervision_impl()
+        {
+        }
+
+        void
+        rvc_supervision_impl::post_event(int chan, const char *event, const rvc_chan_state &cs) {
+            pmt::pmt_t ev = pmt::make_dict();
+            ev = pmt::dict_add(ev, pmt::mp("chan"), pmt::from_long(chan));
+            ev = pmt::dict_add(ev, pmt::mp("event"), pmt::mp(event));
+            ev = pmt::dict_add(ev, pmt::mp("sat"), pmt::from_long(cs.sat));
+            ev = pmt::dict_add(ev, pmt::mp("st"), pmt::from_bool(cs.st));
+            message_port_pub(pmt::mp("events"), ev);
+        }
+
+        /*
+         * A full window has been accumulated: finish the Goertzel filters,
+         * decide which tones are present on each channel, run the debounce
+         * counters, and reset for the next window.
+         *
+         * Tone power is normalized against the window's total energy; a pure
+         * tone comes out at ~1.0 regardless of audio level.
+         */
+        void
+        rvc_supervision_impl::end_window() {
+            const float norm = 0.5f * d_window;
+            for(int c = 0; c < d_nchans; c++) {
+                float present[RVC_NTONES];
+                for(int t = 0; t < RVC_NTONES; t++) {
+                    const int l = c * RVC_NTONES + t;
+                    const float power = d_s1[l] * d_s1[l] + d_s2[l] * d_s2[l] - d_coeff[l] * d_s1[l] * d_s2[l];
+                    present[t] = (d_energy[c] > 0.0f) ? (power / (norm * d_energy[c])) : 0.0f;
+                }
+
+                int sat = -1;
+                float best = d_threshold;
+                for(int t = RVC_TONE_SAT0; t <= RVC_TONE_SAT2; t++) {
+                    if(present[t] > best) {
+                        best = present[t];
+                        sat = t;
+                    }
+                }
+                const bool st = (present[RVC_TONE_ST] > d_threshold);
+
+                rvc_chan_state &cs = d_chans[c];
+                if(sat == cs.cand_sat) {
+                    cs.sat_count++;
+                } else {
+                    cs.cand_sat = sat;
+                    cs.sat_count = 1;
+                }
+                if(st == cs.cand_st) {
+                    cs.st_count++;
+                } else {
+                    cs.cand_st = st;
+                    cs.st_count = 1;
+                }
+
+                if(cs.sat_count >= d_debounce && cs.cand_sat != cs.sat) {
+                    cs.sat = cs.cand_sat;
+                    post_event(c, (cs.sat == -1) ? "sat_lost" : "sat_detected", cs);
+                }
+                if(cs.st_count >= d_debounce && cs.cand_st != cs.st) {
+                    cs.st = cs.cand_st;
+                    post_event(c, cs.st ? "st_on" : "st_off", cs);
+                }
+            }
+            std::fill(d_s1.begin(), d_s1.end(), 0.0f);
+            std::fill(d_s2.begin(), d_s2.end(), 0.0f);
+            std::fill(d_energy.begin(), d_energy.end(), 0.0f);
+            d_window_off = 0;
+        }
+
+        /*
+         * Input samples are spread out into d_staging so that every
+         * (channel, tone) lane sees its sample at the same stride; the
+         * Goertzel recurrence then runs as one flat loop across all lanes,
+         * which the compiler can vectorize.
+         */
+        int
+        rvc_supervision_impl::work(int noutput_items,
+                  gr_vector_const_void_star &input_items,
+                  gr_vector_void_star &output_items) {
+            const int nlanes = d_nlanes;
+            const float * __restrict coeff = &d_coeff[0];
+            float * __restrict s1 = &d_s1[0];
+            float * __restrict s2 = &d_s2[0];
+            float * __restrict staging = &d_staging[0];
+
+            int done = 0;
+            while(done < noutput_items) {
+                const int n = MIN(MIN(noutput_items - done, RVC_CHUNK), d_window - d_window_off);
+
+                for(int c = 0; c < d_nchans; c++) {
+                    const float *in = (const float *)input_items[c] + done;
+                    float energy = 0.0f;
+                    for(int i = 0; i < n; i++) {
+                        float *dst = &staging[i * nlanes + c * RVC_NTONES];
+                        for(int t = 0; t < RVC_NTONES; t++) {
+                            dst[t] = in[i];
+                        }
+                        energy += in[i] * in[i];
+                    }
+                    d_energy[c] += energy;
+                }
+
+                for(int i = 0; i < n; i++) {
+                    const float * __restrict x = &staging[i * nlanes];
+                    for(int l = 0; l < nlanes; l++) {
+                        const float s0 = x[l] + coeff[l] * s1[l] - s2[l];
+                        s2[l] = s1[l];
+                        s1[l] = s0;
+                    }
+                }
+
+                done += n;
+                d_window_off += n;
+                if(d_window_off == d_window) {
+                    end_window();
+                }
+            }
+            return noutput_items;
+        }
+
+    } /* namespace amps */
+} /* namespace gr */
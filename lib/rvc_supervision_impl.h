@@ -0,0 +1,81 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_RVC_SUPERVISION_IMPL_H
+#define INCLUDED_AMPS_RVC_SUPERVISION_IMPL_H
+
+#include <amps/rvc_supervision.h>
+#include <vector>
+#include "amps_common.h"
+
+#ifndef MAX
+#define MAX(x,y) ((x)>(y)?(x):(y))
+#endif /* MAX */
+
+#ifndef MIN
+#define MIN(x,y) ((x)<(y)?(x):(y))
+#endif /* MIN */
+
+namespace gr {
+  namespace amps {
+
+    // Tones in each channel's Goertzel bank; the first three are the SAT
+    // color codes 0-2 (553 2.4.1.2), the last is ST (553 2.4.1.1).
+    enum rvc_tone {
+        RVC_TONE_SAT0 = 0,
+        RVC_TONE_SAT1 = 1,
+        RVC_TONE_SAT2 = 2,
+        RVC_TONE_ST = 3,
+        RVC_NTONES = 4
+    };
+
+    struct rvc_chan_state {
+        int sat;            // reported SAT color code, -1 if none
+        bool st;            // reported ST state
+        int cand_sat;       // SAT seen in the most recent windows
+        bool cand_st;       // ST seen in the most recent windows
+        int sat_count;      // consecutive windows cand_sat has been seen
+        int st_count;       // consecutive windows cand_st has been seen
+
+        rvc_chan_state()
+            : sat(-1), st(false), cand_sat(-1), cand_st(false), sat_count(0), st_count(0) { }
+    };
+
+    class rvc_supervision_impl : public rvc_supervision
+    {
+    private:
+        const int d_nchans;
+        const int d_nlanes;         // d_nchans * RVC_NTONES
+        const float d_threshold;
+        const int d_debounce;
+        const int d_window;         // Goertzel window length in samples
+
+        // Goertzel state, one lane per (channel, tone); lane = chan * RVC_NTONES + tone.
+        std::vector<float> d_coeff;
+        std::vector<float> d_s1;
+        std::vector<float> d_s2;
+        std::vector<float> d_energy;    // per channel: sum of x^2 over the window
+        std::vector<float> d_staging;   // input samples spread out to one per lane
+        int d_window_off;               // samples accumulated into the current window
+
+        std::vector<rvc_chan_state> d_chans;
+
+        void end_window();
+        void post_event(int chan, const char *event, const rvc_chan_state &cs);
+
+    public:
+        rvc_supervision_impl(double samp_rate, int nchans, float threshold, int debounce);
+        ~rvc_supervision_impl();
+
+        int work(int noutput_items,
+           gr_vector_const_void_star &input_items,
+           gr_vector_void_star &output_items);
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_RVC_SUPERVISION_IMPL_H */
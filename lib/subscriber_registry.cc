@@ -0,0 +1,197 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "subscriber_registry.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <map>
+#include <stdexcept>
+#include <boost/weak_ptr.hpp>
+#include "utils.h"
+
+namespace gr {
+  namespace amps {
+
+    static const char REGISTRY_MAGIC[8] = { 'A', 'M', 'P', 'S', 'R', 'E', 'G', '1' };
+
+    // Refuse new subscribers past this fill level, so probes stay short.
+    static const double REGISTRY_MAX_LOAD = 0.75;
+
+    static boost::mutex registry_list_mutex;
+    static std::map<std::string, boost::weak_ptr<subscriber_registry> > registry_list;
+
+    subscriber_registry::sptr
+    subscriber_registry::open(const std::string &path, uint64_t capacity) {
+        boost::mutex::scoped_lock lock(registry_list_mutex);
+        sptr reg = registry_list[path].lock();
+        if(reg.get() == NULL) {
+            reg = sptr(new subscriber_registry(path, capacity));
+            registry_list[path] = reg;
+        }
+        return reg;
+    }
+
+    /*
+     * Map the registry file, creating it if necessary.  An existing file
+     * keeps its own capacity; the capacity argument only applies to new
+     * files, and is rounded up to a power of two.
+     */
+    subscriber_registry::subscriber_registry(const std::string &path, uint64_t capacity)
+        : d_path(path), d_fd(-1), d_maplen(0), d_header(NULL), d_slots(NULL), d_mask(0), d_shift(64) {
+        uint64_t cap = 1;
+        while(cap < capacity) {
+            cap <<= 1;
+        }
+
+        d_fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if(d_fd == -1) {
+            throw std::runtime_error("subscriber_registry: can't open " + path + ": " + strerror(errno));
+        }
+        struct stat st;
+        if(fstat(d_fd, &st) == -1) {
+            ::close(d_fd);
+            throw std::runtime_error("subscriber_registry: can't stat " + path);
+        }
+        bool fresh = (st.st_size == 0);
+        if(fresh == false) {
+            subscriber_registry_header hdr;
+            if(pread(d_fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || memcmp(hdr.magic, REGISTRY_MAGIC, sizeof(REGISTRY_MAGIC)) != 0
+                    || hdr.capacity == 0 || (hdr.capacity & (hdr.capacity - 1)) != 0
+                    || (size_t)st.st_size != sizeof(hdr) + (hdr.capacity * sizeof(subscriber_record))) {
+                ::close(d_fd);
+                throw std::runtime_error("subscriber_registry: " + path + " is not a valid registry file");
+            }
+            cap = hdr.capacity;
+        }
+        d_maplen = sizeof(subscriber_registry_header) + (cap * sizeof(subscriber_record));
+        if(fresh && ftruncate(d_fd, d_maplen) == -1) {
+            ::close(d_fd);
+            throw std::runtime_error("subscriber_registry: can't size " + path);
+        }
+        void *map = mmap(NULL, d_maplen, PROT_READ | PROT_WRITE, MAP_SHARED, d_fd, 0);
+        if(map == MAP_FAILED) {
+            ::close(d_fd);
+            throw std::runtime_error("subscriber_registry: can't map " + path);
+        }
+        d_header = static_cast<subscriber_registry_header *>(map);
+        d_slots = reinterpret_cast<subscriber_record *>(d_header + 1);
+        if(fresh) {
+            memcpy(d_header->magic, REGISTRY_MAGIC, sizeof(REGISTRY_MAGIC));
+            d_header->capacity = cap;
+            d_header->count = 0;
+        }
+        d_mask = cap - 1;
+        for(uint64_t c = cap; c > 1; c >>= 1) {
+            d_shift--;
+        }
+        LOG_DEBUG("subscriber registry %s: %llu of %llu slots in use", path.c_str(),
+                (unsigned long long)d_header->count, (unsigned long long)d_header->capacity);
+    }
+
+    subscriber_registry::~subscriber_registry() {
+        if(d_header != NULL) {
+            msync(d_header, d_maplen, MS_ASYNC);
+            munmap(d_header, d_maplen);
+        }
+        if(d_fd != -1) {
+            ::close(d_fd);
+        }
+    }
+
+    /*
+     * Find the slot for a MIN.  If it isn't there and insert is true, claim
+     * an empty slot for it (unless the table is too full).  Returns NULL if
+     * there's no such slot.  Called with d_mutex held.
+     */
+    subscriber_record *
+    subscriber_registry::find_slot(uint64_t min, bool insert) {
+        // Fibonacci hashing spreads out the (very sequential) MINs: the top
+        // log2(capacity) bits of the product, which every MIN bit feeds.
+        uint64_t idx = (d_shift < 64) ? ((min * 0x9e3779b97f4a7c15ULL) >> d_shift) : 0;
+        for(uint64_t probes = 0; probes <= d_mask; probes++, idx++) {
+            subscriber_record *rec = &d_slots[idx & d_mask];
+            if((rec->flags & SUBSCRIBER_USED) == 0) {
+                if(insert == false || d_header->count >= (uint64_t)(d_header->capacity * REGISTRY_MAX_LOAD)) {
+                    return NULL;
+                }
+                memset(rec, 0, sizeof(*rec));
+                rec->min = min;
+                rec->flags = SUBSCRIBER_USED;
+                d_header->count++;
+                return rec;
+            }
+            if(rec->min == min) {
+                return rec;
+            }
+        }
+        return NULL;
+    }
+
+    bool
+    subscriber_registry::lookup(uint64_t min, subscriber_record &out) {
+        boost::mutex::scoped_lock lock(d_mutex);
+        subscriber_record *rec = find_slot(min, false);
+        if(rec == NULL) {
+            return false;
+        }
+        out = *rec;
+        return true;
+    }
+
+    /*
+     * Note that a mobile was heard from (origination, page response, ...).
+     * Returns false if it's new and the registry is full.
+     */
+    bool
+    subscriber_registry::seen(uint64_t min, time_t when) {
+        boost::mutex::scoped_lock lock(d_mutex);
+        subscriber_record *rec = find_slot(min, true);
+        if(rec == NULL) {
+            return false;
+        }
+        rec->last_seen = when;
+        return true;
+    }
+
+    /*
+     * Record a registration.  An ESN of 0 (not sent) leaves any known ESN
+     * in place.  Returns false if it's new and the registry is full.
+     */
+    bool
+    subscriber_registry::registered(uint64_t min, uint32_t esn, uint8_t scm, uint16_t cell, time_t when) {
+        boost::mutex::scoped_lock lock(d_mutex);
+        subscriber_record *rec = find_slot(min, true);
+        if(rec == NULL) {
+            return false;
+        }
+        if(esn != 0) {
+            rec->esn = esn;
+        }
+        rec->scm = scm;
+        rec->flags |= SUBSCRIBER_REGISTERED;
+        rec->last_cell = cell;
+        rec->last_seen = when;
+        rec->registered = when;
+        return true;
+    }
+
+    uint64_t
+    subscriber_registry::count() {
+        boost::mutex::scoped_lock lock(d_mutex);
+        return d_header->count;
+    }
+
+  } // namespace amps
+} // namespace gr
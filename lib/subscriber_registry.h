@@ -0,0 +1,88 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_SUBSCRIBER_REGISTRY_H
+#define INCLUDED_AMPS_SUBSCRIBER_REGISTRY_H
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <stdint.h>
+#include <time.h>
+
+namespace gr {
+  namespace amps {
+
+    /*
+     * On-disk layout.  The file is a header followed by a power-of-two
+     * number of slots; it's mapped shared, so every update is persisted by
+     * the kernel and a restart picks up where the last run left off.
+     */
+    struct subscriber_record {
+        uint64_t min;           // packed MIN: (MIN2 << 24) | MIN1
+        uint32_t esn;           // 0 if never seen
+        uint8_t scm;            // station class mark, including SCM4 as bit 4
+        uint8_t flags;          // SUBSCRIBER_*
+        uint16_t last_cell;     // SID of the system it last registered with
+        int64_t last_seen;      // unix time of the last RECC message from it
+        int64_t registered;     // unix time of the last registration
+    };
+
+    enum subscriber_flags {
+        SUBSCRIBER_USED = 0x1,
+        SUBSCRIBER_REGISTERED = 0x2
+    };
+
+    struct subscriber_registry_header {
+        char magic[8];          // "AMPSREG1"
+        uint64_t capacity;      // number of slots (power of two)
+        uint64_t count;         // slots in use
+    };
+
+    inline uint64_t pack_min(uint64_t MIN1, uint64_t MIN2) {
+        return ((MIN2 & 0x3ff) << 24) | (MIN1 & 0xffffff);
+    }
+
+    /*
+     * Subscriber registry: an open-addressing (linear probing) hash table of
+     * subscriber_records in a memory-mapped file.  Lookups and updates are
+     * O(1) and never allocate.  Records are never removed; stale ones just
+     * age out via last_seen.
+     *
+     * Blocks get a registry with subscriber_registry::open(); everything
+     * opening the same path in a process shares one mapping.
+     */
+    class subscriber_registry {
+        private:
+        std::string d_path;
+        int d_fd;
+        size_t d_maplen;
+        subscriber_registry_header *d_header;
+        subscriber_record *d_slots;
+        uint64_t d_mask;
+        unsigned int d_shift;   // 64 - log2(capacity): the hash's top bits pick the slot
+        boost::mutex d_mutex;
+
+        subscriber_registry(const std::string &path, uint64_t capacity);
+        subscriber_record *find_slot(uint64_t min, bool insert);
+
+        public:
+        typedef boost::shared_ptr<subscriber_registry> sptr;
+
+        static sptr open(const std::string &path, uint64_t capacity = 65536);
+        ~subscriber_registry();
+
+        bool lookup(uint64_t min, subscriber_record &out);
+        bool seen(uint64_t min, time_t when);
+        bool registered(uint64_t min, uint32_t esn, uint8_t scm, uint16_t cell, time_t when);
+        uint64_t count();
+        uint64_t capacity() const { return d_header->capacity; }
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_SUBSCRIBER_REGISTRY_H */
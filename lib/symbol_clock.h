@@ -0,0 +1,55 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_SYMBOL_CLOCK_H
+#define INCLUDED_AMPS_SYMBOL_CLOCK_H
+
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    /*
+     * Lays Manchester half-bits (20000 a second) onto an output sample
+     * grid of any rate at or above that, so the symbol generators can run
+     * straight at the radio's rate instead of a multiple of 20 kHz.  This
+     * is a polyphase interpolator whose filter is the rectangular symbol
+     * itself: with one tap per phase, all the phase does is decide how many
+     * output samples each half-bit gets.  The phase is kept exactly (as a
+     * remainder in units of 1/20000 of an output sample), so edges land on
+     * the nearest output sample and never drift.  At a multiple of 20 kHz
+     * every half-bit gets the same number of samples, as it always has.
+     */
+    class symbol_clock {
+        public:
+        static const unsigned long HALFBIT_RATE = 20000;
+
+        private:
+        uint64_t d_outrate;
+        uint64_t d_phase;
+
+        public:
+        symbol_clock(unsigned long outrate)
+            : d_outrate(outrate), d_phase(HALFBIT_RATE / 2) { }
+
+        bool integral() const { return (d_outrate % HALFBIT_RATE) == 0; }
+        unsigned int nominal() const { return d_outrate / HALFBIT_RATE; }
+
+        // Output samples for the next half-bit.
+        unsigned int next() {
+            d_phase += d_outrate;
+            const unsigned int n = d_phase / HALFBIT_RATE;
+            d_phase -= (uint64_t)n * HALFBIT_RATE;
+            return n;
+        }
+
+        void reset() { d_phase = HALFBIT_RATE / 2; }
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_SYMBOL_CLOCK_H */
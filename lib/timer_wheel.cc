@@ -0,0 +1,137 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "timer_wheel.h"
+
+namespace gr {
+  namespace amps {
+
+    static inline void list_init(wheel_timer *head) {
+        head->prev = head;
+        head->next = head;
+    }
+
+    static inline void list_append(wheel_timer *head, wheel_timer *t) {
+        t->prev = head->prev;
+        t->next = head;
+        head->prev->next = t;
+        head->prev = t;
+    }
+
+    static inline void list_unlink(wheel_timer *t) {
+        t->prev->next = t->next;
+        t->next->prev = t->prev;
+        t->prev = NULL;
+        t->next = NULL;
+    }
+
+    timer_wheel::timer_wheel(uint64_t now)
+        : d_next_tick(now), d_pending(0) {
+        for(int i = 0; i < ROOT_SIZE; i++) {
+            list_init(&d_root[i]);
+        }
+        for(int l = 0; l < NLEVELS; l++) {
+            for(int i = 0; i < LEVEL_SIZE; i++) {
+                list_init(&d_levels[l][i]);
+            }
+        }
+    }
+
+    // Put a timer on the list for its expiry.  Timers already due go in the
+    // slot for the next tick.
+    void timer_wheel::insert(wheel_timer *t) {
+        const uint64_t max_delay = (1ULL << (ROOT_BITS + (NLEVELS * LEVEL_BITS))) - 1;
+        if(t->expires < d_next_tick) {
+            t->expires = d_next_tick;
+        }
+        uint64_t delta = t->expires - d_next_tick;
+        if(delta > max_delay) {
+            t->expires = d_next_tick + max_delay;
+            delta = max_delay;
+        }
+        wheel_timer *head;
+        if(delta < (uint64_t)ROOT_SIZE) {
+            head = &d_root[t->expires & (ROOT_SIZE - 1)];
+        } else {
+            int level = 0;
+            while(delta >= (1ULL << (ROOT_BITS + ((level + 1) * LEVEL_BITS)))) {
+                level++;
+            }
+            const int shift = ROOT_BITS + (level * LEVEL_BITS);
+            head = &d_levels[level][(t->expires >> shift) & (LEVEL_SIZE - 1)];
+        }
+        list_append(head, t);
+    }
+
+    // Redistribute one slot of a higher level into the levels below it.
+    int timer_wheel::cascade(int level, int idx) {
+        wheel_timer *head = &d_levels[level][idx];
+        wheel_timer *t = head->next;
+        list_init(head);
+        while(t != head) {
+            wheel_timer *next = t->next;
+            insert(t);
+            t = next;
+        }
+        return idx;
+    }
+
+    /*
+     * Arm a timer to fire delay ticks from the last tick advanced to.  A
+     * timer that's already pending is moved.
+     */
+    void timer_wheel::schedule(wheel_timer *t, uint64_t delay) {
+        if(t->pending()) {
+            list_unlink(t);
+        } else {
+            d_pending++;
+        }
+        t->expires = d_next_tick + delay;
+        insert(t);
+    }
+
+    void timer_wheel::cancel(wheel_timer *t) {
+        if(t->pending()) {
+            list_unlink(t);
+            d_pending--;
+        }
+    }
+
+    /*
+     * Run the wheel up to and including tick now, appending every timer that
+     * expired to expired (in expiry order).  Expired timers are no longer
+     * pending, and can be rearmed right away.  Returns the number expired.
+     */
+    size_t timer_wheel::advance(uint64_t now, std::vector<wheel_timer *> &expired) {
+        const size_t before = expired.size();
+        while(d_next_tick <= now) {
+            const int idx = d_next_tick & (ROOT_SIZE - 1);
+            if(idx == 0) {
+                for(int l = 0; l < NLEVELS; l++) {
+                    const int shift = ROOT_BITS + (l * LEVEL_BITS);
+                    if(cascade(l, (d_next_tick >> shift) & (LEVEL_SIZE - 1)) != 0) {
+                        break;
+                    }
+                }
+            }
+            wheel_timer *head = &d_root[idx];
+            while(head->next != head) {
+                wheel_timer *t = head->next;
+                list_unlink(t);
+                d_pending--;
+                expired.push_back(t);
+            }
+            d_next_tick++;
+        }
+        return expired.size() - before;
+    }
+
+  } // namespace amps
+} // namespace gr
@@ -0,0 +1,72 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_TIMER_WHEEL_H
+#define INCLUDED_AMPS_TIMER_WHEEL_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gr {
+  namespace amps {
+
+    /*
+     * A timer, meant to be embedded in whatever owns it (so arming one never
+     * allocates).  The wheel only touches the list links and expiry; the
+     * owner finds its way back from the pointer.
+     */
+    struct wheel_timer {
+        wheel_timer *prev;
+        wheel_timer *next;
+        uint64_t expires;       // absolute tick
+
+        wheel_timer() : prev(NULL), next(NULL), expires(0) { }
+        bool pending() const { return prev != NULL; }
+    };
+
+    /*
+     * Hierarchical timing wheel (the classic Varghese/Lauck scheme, as in
+     * the Linux kernel's old timer code).  Level 0 has one slot per tick for
+     * the next 256 ticks; each of the three levels above covers 64 times the
+     * span of the one below.  Timers are kept on intrusive doubly-linked
+     * lists, so arming and cancelling are O(1); a timer is moved down a
+     * level at most three times on its way to expiry.  Delays past the top
+     * level are clamped to its span (2^26 ticks).
+     *
+     * Not thread safe; it belongs to one thread.
+     */
+    class timer_wheel {
+        private:
+        static const int ROOT_BITS = 8;
+        static const int LEVEL_BITS = 6;
+        static const int ROOT_SIZE = 1 << ROOT_BITS;
+        static const int LEVEL_SIZE = 1 << LEVEL_BITS;
+        static const int NLEVELS = 3;
+
+        // list heads; a head's expires field is unused
+        wheel_timer d_root[ROOT_SIZE];
+        wheel_timer d_levels[NLEVELS][LEVEL_SIZE];
+        uint64_t d_next_tick;   // the next tick advance() will process
+        size_t d_pending;
+
+        void insert(wheel_timer *t);
+        int cascade(int level, int idx);
+
+        public:
+        timer_wheel(uint64_t now);
+
+        void schedule(wheel_timer *t, uint64_t delay);
+        void cancel(wheel_timer *t);
+        size_t advance(uint64_t now, std::vector<wheel_timer *> &expired);
+
+        size_t pending() const { return d_pending; }
+    };
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_TIMER_WHEEL_H */
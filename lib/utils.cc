@@ -75,7 +75,7 @@ namespace gr {
                     case 0:
                         break;
                     default:
-                        std::cerr << "invalid value: " << (int)c << std::endl;
+                        LOG_WARNING("invalid value: %d", (int)c);
                         throw std::invalid_argument("invalid character in bit vector string: expected 1, 0, or space");
                 }
             }
@@ -107,9 +107,61 @@ namespace gr {
             }
         }
 
-		/* NOTE: NOT THREAD SAFE */
+        /**
+         * BCH-decode a 48-bit RECC/RVC word (one byte per bit) using a
+         * BCH(63, 2) decoder, writing the 36 data bits to dstbuf.  The word is
+         * a shortened code, so it's padded out with 15 leading zeroes first.
+         *
+         * Returns true iff the word was valid (or correctable).
+         */
+        bool bch_decode_48(itpp::BCH &bch, const unsigned char *srcbuf, unsigned char *dstbuf) {
+            bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
+            bvec srcbits(48);
+            for(int i = 0; i < 48; i++) {
+                const unsigned char b = srcbuf[i];
+                assert(b == 0 || b == 1);
+                srcbits[i] = b;
+            }
+            bvec padded(concat(zeroes, srcbits));
+            bvec errbv;
+            bvec decoded(51);
+            bool retval = bch.decode(padded, decoded, errbv);
+            bvec final = decoded(15, 50);
+            for(int i = 0; i < 36; i++) {
+                dstbuf[i] = (final[i] == 0) ? 0 : 1;
+            }
+            return retval;
+        }
+
+        /**
+         * BCH-decode a 40-bit FOCC/FVC word (one byte per bit), writing the
+         * 28 data bits to dstbuf.  As above, but shortened from BCH(63, 51)
+         * by 23 bits.
+         *
+         * Returns true iff the word was valid (or correctable).
+         */
+        bool bch_decode_40(itpp::BCH &bch, const unsigned char *srcbuf, unsigned char *dstbuf) {
+            bvec zeroes("0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0");
+            bvec srcbits(40);
+            for(int i = 0; i < 40; i++) {
+                const unsigned char b = srcbuf[i];
+                assert(b == 0 || b == 1);
+                srcbits[i] = b;
+            }
+            bvec padded(concat(zeroes, srcbits));
+            bvec errbv;
+            bvec decoded(51);
+            bool retval = bch.decode(padded, decoded, errbv);
+            bvec final = decoded(23, 50);
+            for(int i = 0; i < 28; i++) {
+                dstbuf[i] = (final[i] == 0) ? 0 : 1;
+            }
+            return retval;
+        }
+
+		/* The returned buffer is per thread, and reused on the next call. */
 		const char * getstamp() {
-			static char stampbuf[1024];
+			static __thread char stampbuf[64];
 			struct timeval tv;
 			memset(&tv, 0, sizeof(struct timeval));
 			if(gettimeofday(&tv, NULL) == -1) {
@@ -131,5 +183,21 @@ namespace gr {
 			return stampbuf;
 		}
 
+        uint64_t monotonic_ns() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+        }
+
+        /*
+         * Trace IDs follow a transaction from the RECC burst that starts it
+         * to the first FOCC sample of the answer.  Unique within the
+         * process; never 0.
+         */
+        uint64_t next_trace_id() {
+            static uint64_t last = 0;
+            return __atomic_add_fetch(&last, 1, __ATOMIC_RELAXED);
+        }
+
 	}
 }
@@ -15,8 +15,7 @@ using std::string;
 using std::vector;
 using std::ostringstream;
 
-#define LOG_WARNING(fmt, ...) printf("%s: %s:%d WARNING: " fmt "\n", getstamp(), __FILE__, __LINE__, ##__VA_ARGS__);
-#define LOG_DEBUG(fmt, ...) printf("%s: %s:%d DEBUG: " fmt "\n", getstamp(), __FILE__, __LINE__, ##__VA_ARGS__);
+#include "amps_log.h"
 
 namespace gr {
     namespace amps {
@@ -24,7 +23,11 @@ namespace gr {
         std::vector<char> string_to_cvec(std::string binstr);
         size_t manchester_decode_binbuf(const unsigned char *srcbuf, unsigned char *dstbuf, size_t dstbufsz);
         void expandbits(unsigned char *outbuf, size_t nbits, u_int64_t val);
+        bool bch_decode_48(itpp::BCH &bch, const unsigned char *srcbuf, unsigned char *dstbuf);
+        bool bch_decode_40(itpp::BCH &bch, const unsigned char *srcbuf, unsigned char *dstbuf);
 		const char * getstamp();
+        uint64_t monotonic_ns();
+        uint64_t next_trace_id();
     }
 }
 
@@ -0,0 +1,178 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "voice_channel_pool.h"
+#include <stdexcept>
+#include "amps_packet.h"
+
+namespace gr {
+  namespace amps {
+
+    /*
+     * Channels first_chan ... first_chan+nchans-1.  scc gives each channel's
+     * SAT color code, cycling if it's shorter than the pool (so {0, 1, 2}
+     * spreads adjacent channels across all three SATs); if it's empty, every
+     * channel gets GLOBAL_SCC.
+     */
+    voice_channel_pool::voice_channel_pool(int first_chan, int nchans, const std::vector<int> &scc, int vmac)
+        : d_free_head(-1), d_nfree(0) {
+        if(nchans < 1) {
+            throw std::invalid_argument("voice_channel_pool: need at least one channel");
+        }
+        if(first_chan < 1 || (first_chan + nchans - 1) > 2047) {
+            throw std::invalid_argument("voice_channel_pool: channel numbers must be 1-2047");
+        }
+        if(vmac < 0 || vmac > 7) {
+            throw std::invalid_argument("voice_channel_pool: VMAC must be 0-7");
+        }
+        for(size_t i = 0; i < scc.size(); i++) {
+            if(scc[i] < 0 || scc[i] > 2) {
+                throw std::invalid_argument("voice_channel_pool: SAT color codes must be 0, 1 or 2");
+            }
+        }
+        d_chans.resize(nchans);
+        // Build the free list back to front, so channels are handed out in
+        // ascending order on a fresh pool.
+        for(int i = nchans - 1; i >= 0; i--) {
+            voice_channel &vc = d_chans[i];
+            vc.chan = first_chan + i;
+            vc.scc = scc.empty() ? GLOBAL_SCC : scc[i % scc.size()];
+            vc.vmac = vmac;
+            vc.state = VCHAN_FREE;
+            vc.min = 0;
+            vc.since = 0;
+            vc.blocked = false;
+            vc.next_free = d_free_head;
+            d_free_head = i;
+            d_nfree++;
+        }
+    }
+
+    /*
+     * Take a channel off the free list for the given mobile.  Returns its
+     * index, or -1 if every channel is in use.
+     */
+    int voice_channel_pool::allocate(uint64_t min, time_t now) {
+        if(d_free_head < 0) {
+            return -1;
+        }
+        const int idx = d_free_head;
+        voice_channel &vc = d_chans[idx];
+        d_free_head = vc.next_free;
+        d_nfree--;
+        vc.next_free = -1;
+        vc.state = VCHAN_ASSIGNED;
+        vc.min = min;
+        vc.since = now;
+        return idx;
+    }
+
+    /*
+     * Return a channel to the pool.  Returns false if it was already free
+     * (e.g. a duplicate SAT-lost event).
+     */
+    bool voice_channel_pool::release(int idx) {
+        if(idx < 0 || idx >= (int)d_chans.size() || d_chans[idx].state == VCHAN_FREE) {
+            return false;
+        }
+        voice_channel &vc = d_chans[idx];
+        vc.state = VCHAN_FREE;
+        vc.min = 0;
+        vc.next_free = -1;
+        if(vc.blocked == false) {
+            vc.next_free = d_free_head;
+            d_free_head = idx;
+            d_nfree++;
+        }
+        return true;
+    }
+
+    /*
+     * Block a channel (something else is on it) or unblock it.  A free
+     * channel comes off the free list while it's blocked; one in use is
+     * left alone, and just isn't put back on the list when it's released.
+     * Returns false if nothing changed.
+     */
+    bool voice_channel_pool::set_blocked(int idx, bool blocked) {
+        if(idx < 0 || idx >= (int)d_chans.size() || d_chans[idx].blocked == blocked) {
+            return false;
+        }
+        voice_channel &vc = d_chans[idx];
+        vc.blocked = blocked;
+        if(vc.state != VCHAN_FREE) {
+            return true;
+        }
+        if(blocked) {
+            // Unlink it.  Blocking is rare, so walking the list is fine.
+            int *link = &d_free_head;
+            while(*link != idx) {
+                link = &d_chans[*link].next_free;
+            }
+            *link = vc.next_free;
+            vc.next_free = -1;
+            d_nfree--;
+        } else {
+            vc.next_free = d_free_head;
+            d_free_head = idx;
+            d_nfree++;
+        }
+        return true;
+    }
+
+    bool voice_channel_pool::mark_busy(int idx, time_t now) {
+        if(idx < 0 || idx >= (int)d_chans.size() || d_chans[idx].state != VCHAN_ASSIGNED) {
+            return false;
+        }
+        d_chans[idx].state = VCHAN_BUSY;
+        d_chans[idx].since = now;
+        return true;
+    }
+
+    /*
+     * Release channels that were designated but never came up (no SAT from
+     * the mobile within timeout seconds).  This walks the whole pool, so
+     * it's only meant to be run when the pool runs dry.  Returns the number
+     * of channels reclaimed.
+     */
+    size_t voice_channel_pool::reclaim(time_t now, time_t timeout) {
+        size_t n = 0;
+        for(size_t i = 0; i < d_chans.size(); i++) {
+            if(d_chans[i].state == VCHAN_ASSIGNED && (now - d_chans[i].since) >= timeout) {
+                release(i);
+                n++;
+            }
+        }
+        return n;
+    }
+
+    // Returns the index of the channel held by the given mobile, or -1.
+    int voice_channel_pool::find(uint64_t min) const {
+        for(size_t i = 0; i < d_chans.size(); i++) {
+            if(d_chans[i].state != VCHAN_FREE && d_chans[i].min == min) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    const char *voice_channel_state_name(voice_channel_state state) {
+        switch(state) {
+            case VCHAN_FREE:
+                return "free";
+            case VCHAN_ASSIGNED:
+                return "assigned";
+            case VCHAN_BUSY:
+                return "busy";
+        }
+        return "unknown";
+    }
+
+  } // namespace amps
+} // namespace gr
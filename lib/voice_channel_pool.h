@@ -0,0 +1,74 @@
+/* Written by Brandon Creighton <cstone@pobox.com>.
+ *
+ * This code is in the public domain; however, note that most of its
+ * dependent code, including GNU Radio, is not.
+ */
+
+#ifndef INCLUDED_AMPS_VOICE_CHANNEL_POOL_H
+#define INCLUDED_AMPS_VOICE_CHANNEL_POOL_H
+
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+
+namespace gr {
+  namespace amps {
+
+    // How long a designated channel waits for the mobile's SAT before it
+    // can be taken back (the MS gives up after 5 s; 553 2.6.4.1).
+    static const time_t VCHAN_SAT_TIMEOUT = 5;
+
+    enum voice_channel_state {
+        VCHAN_FREE = 0,
+        VCHAN_ASSIGNED,         // designated to a mobile; waiting for its SAT
+        VCHAN_BUSY              // the mobile's SAT has been seen on the RVC
+    };
+
+    struct voice_channel {
+        unsigned short chan;    // channel number, as sent in the CHAN field
+        unsigned char scc;      // SAT color code (0-2)
+        unsigned char vmac;     // voice mobile attenuation code
+        voice_channel_state state;
+        uint64_t min;           // packed MIN of the mobile holding it
+        time_t since;           // when it entered its current state
+        bool blocked;           // busy on the air (see channel_monitor); not handed out
+        int next_free;          // free list link; -1 at the end
+    };
+
+    /*
+     * Pool of voice channels available for voice designation.  Channels are
+     * identified by their index in the pool, which is also their lane in an
+     * FVC bank / RVC supervision block.  Allocation and release are O(1)
+     * (a free list threaded through the channel array).  A blocked channel
+     * is kept off the free list until it's unblocked.
+     *
+     * Not thread safe: the pool belongs to the block that assigns channels,
+     * and is only touched from its message handlers.
+     */
+    class voice_channel_pool {
+        private:
+        std::vector<voice_channel> d_chans;
+        int d_free_head;
+        size_t d_nfree;
+
+        public:
+        voice_channel_pool(int first_chan, int nchans, const std::vector<int> &scc, int vmac);
+
+        int allocate(uint64_t min, time_t now);
+        bool release(int idx);
+        bool mark_busy(int idx, time_t now);
+        size_t reclaim(time_t now, time_t timeout);
+        bool set_blocked(int idx, bool blocked);
+
+        int find(uint64_t min) const;
+        const voice_channel &operator[](int idx) const { return d_chans[idx]; }
+        int size() const { return d_chans.size(); }
+        size_t nfree() const { return d_nfree; }
+    };
+
+    const char *voice_channel_state_name(voice_channel_state state);
+
+  } // namespace amps
+} // namespace gr
+
+#endif /* INCLUDED_AMPS_VOICE_CHANNEL_POOL_H */
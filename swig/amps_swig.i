@@ -13,6 +13,17 @@
 #include "amps/recc.h"
 #include "amps/recc_decode.h"
 #include "amps/command_processor.h"
+#include "amps/rvc_supervision.h"
+#include "amps/rvc_data.h"
+#include "amps/fvc_bank.h"
+#include "amps/call_control.h"
+#include "amps/mobile_population.h"
+#include "amps/ms_emulator.h"
+#include "amps/registration_control.h"
+#include "amps/overload_control.h"
+#include "amps/carrier_synth.h"
+#include "amps/channel_monitor.h"
+#include "amps/iq_capture.h"
 %}
 
 
@@ -26,3 +37,25 @@ GR_SWIG_BLOCK_MAGIC2(amps, recc);
 GR_SWIG_BLOCK_MAGIC2(amps, recc_decode);
 %include "amps/command_processor.h"
 GR_SWIG_BLOCK_MAGIC2(amps, command_processor);
+%include "amps/rvc_supervision.h"
+GR_SWIG_BLOCK_MAGIC2(amps, rvc_supervision);
+%include "amps/rvc_data.h"
+GR_SWIG_BLOCK_MAGIC2(amps, rvc_data);
+%include "amps/fvc_bank.h"
+GR_SWIG_BLOCK_MAGIC2(amps, fvc_bank);
+%include "amps/call_control.h"
+GR_SWIG_BLOCK_MAGIC2(amps, call_control);
+%include "amps/mobile_population.h"
+GR_SWIG_BLOCK_MAGIC2(amps, mobile_population);
+%include "amps/ms_emulator.h"
+GR_SWIG_BLOCK_MAGIC2(amps, ms_emulator);
+%include "amps/registration_control.h"
+GR_SWIG_BLOCK_MAGIC2(amps, registration_control);
+%include "amps/overload_control.h"
+GR_SWIG_BLOCK_MAGIC2(amps, overload_control);
+%include "amps/carrier_synth.h"
+GR_SWIG_BLOCK_MAGIC2(amps, carrier_synth);
+%include "amps/channel_monitor.h"
+GR_SWIG_BLOCK_MAGIC2(amps, channel_monitor);
+%include "amps/iq_capture.h"
+GR_SWIG_BLOCK_MAGIC2(amps, iq_capture);